@@ -0,0 +1,221 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "utils/mem_tracker.h"
+
+// Minimal timing harness for the CPU hot paths.
+//
+// Each benchmark is warmed up, then the iteration count is calibrated so one
+// sample takes at least minSampleMs; `samples` samples are taken and reported
+// as median / MAD (median absolute deviation) per iteration, plus throughput
+// in items per second when the benchmark says how many items one iteration
+// processes. One extra iteration measures heap use per MemTracker tag: peak
+// bytes above what was live before it, and allocation count.
+
+// keep the optimiser from deleting work whose result is unused
+template <class T>
+inline void doNotOptimize(const T &value)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    static volatile const void *sink;
+    sink = &value;
+#endif
+}
+
+struct BenchResult
+{
+    std::string name;
+    std::string itemName; // what "items" are, e.g. "samples", "vertices"
+    long long iterations = 0; // per sample
+    int samples = 0;
+    double medianNs = 0.0; // per iteration
+    double madNs = 0.0;
+    double minNs = 0.0;
+    double itemsPerSec = 0.0; // 0 = not reported
+
+    // one iteration, from MemTracker
+    std::int64_t peakBytes = 0;
+    std::uint64_t allocations = 0;
+    std::int64_t tagPeakBytes[MemTracker::TagCount] = {};
+    std::uint64_t tagAllocations[MemTracker::TagCount] = {};
+};
+
+class BenchRunner
+{
+public:
+    int samples = 15;
+    double minSampleMs = 20.0;
+    std::string filter; // substring; empty = run everything
+
+    // fn() runs one iteration and processes itemsPerIter items
+    void run(const std::string &name, double itemsPerIter, const std::string &itemName,
+             const std::function<void()> &fn)
+    {
+        if (!filter.empty() && name.find(filter) == std::string::npos)
+            return;
+
+        using clock = std::chrono::steady_clock;
+        auto timeIters = [&](long long iters)
+        {
+            auto t0 = clock::now();
+            for (long long i = 0; i < iters; ++i)
+                fn();
+            return std::chrono::duration<double, std::nano>(clock::now() - t0).count();
+        };
+
+        // warm-up + calibration: double until one sample is long enough
+        long long iters = 1;
+        double ns = timeIters(iters);
+        while (ns < minSampleMs * 1e6 && iters < (1ll << 40))
+        {
+            iters *= 2;
+            ns = timeIters(iters);
+        }
+
+        std::vector<double> perIter(samples);
+        for (int s = 0; s < samples; ++s)
+            perIter[s] = timeIters(iters) / double(iters);
+
+        BenchResult r;
+        r.name = name;
+        r.itemName = itemName;
+        r.iterations = iters;
+        r.samples = samples;
+        r.medianNs = median(perIter);
+        std::vector<double> dev(perIter.size());
+        for (std::size_t i = 0; i < perIter.size(); ++i)
+            dev[i] = std::abs(perIter[i] - r.medianNs);
+        r.madNs = median(dev);
+        r.minNs = *std::min_element(perIter.begin(), perIter.end());
+        r.itemsPerSec = (itemsPerIter > 0.0 && r.medianNs > 0.0) ? itemsPerIter * 1e9 / r.medianNs : 0.0;
+        measureMemory(r, fn);
+
+        print(r);
+        m_results.push_back(r);
+    }
+
+    const std::vector<BenchResult> &results() const { return m_results; }
+
+    bool writeJson(const std::string &path) const
+    {
+        std::ofstream out(path);
+        if (!out)
+        {
+            std::cerr << "Error: could not write " << path << std::endl;
+            return false;
+        }
+        out.precision(9);
+        out << "{\n  \"benchmarks\": [\n";
+        for (std::size_t i = 0; i < m_results.size(); ++i)
+        {
+            const BenchResult &r = m_results[i];
+            out << "    {\"name\": \"" << r.name << "\", \"iterations\": " << r.iterations
+                << ", \"samples\": " << r.samples << ", \"medianNs\": " << r.medianNs
+                << ", \"madNs\": " << r.madNs << ", \"minNs\": " << r.minNs
+                << ", \"itemsPerSec\": " << r.itemsPerSec << ", \"items\": \"" << r.itemName << "\""
+                << ", \"peakBytes\": " << r.peakBytes << ", \"allocations\": " << r.allocations
+                << ", \"memory\": {";
+            bool firstTag = true;
+            for (int t = 0; t < MemTracker::TagCount; ++t)
+            {
+                if (r.tagAllocations[t] == 0)
+                    continue;
+                out << (firstTag ? "" : ", ") << "\"" << MemTracker::tagName(MemTracker::Tag(t))
+                    << "\": {\"peakBytes\": " << r.tagPeakBytes[t]
+                    << ", \"allocations\": " << r.tagAllocations[t] << "}";
+                firstTag = false;
+            }
+            out << "}}" << (i + 1 < m_results.size() ? "," : "") << "\n";
+        }
+        out << "  ]\n}\n";
+        std::cout << "[bench] wrote " << m_results.size() << " results to " << path << "\n";
+        return true;
+    }
+
+private:
+    static void measureMemory(BenchResult &r, const std::function<void()> &fn)
+    {
+        MemTracker::TagStats before[MemTracker::TagCount];
+        for (int t = 0; t < MemTracker::TagCount; ++t)
+            before[t] = MemTracker::stats(MemTracker::Tag(t));
+        MemTracker::TagStats totalBefore = MemTracker::total();
+
+        MemTracker::resetPeaks();
+        fn();
+
+        MemTracker::TagStats totalAfter = MemTracker::total();
+        r.peakBytes = totalAfter.peakBytes - totalBefore.currentBytes;
+        r.allocations = totalAfter.allocations - totalBefore.allocations;
+        for (int t = 0; t < MemTracker::TagCount; ++t)
+        {
+            MemTracker::TagStats after = MemTracker::stats(MemTracker::Tag(t));
+            r.tagPeakBytes[t] = after.peakBytes - before[t].currentBytes;
+            r.tagAllocations[t] = after.allocations - before[t].allocations;
+        }
+    }
+
+    static double median(std::vector<double> v)
+    {
+        std::sort(v.begin(), v.end());
+        std::size_t n = v.size();
+        if (n == 0)
+            return 0.0;
+        return (n % 2) ? v[n / 2] : 0.5 * (v[n / 2 - 1] + v[n / 2]);
+    }
+
+    static void print(const BenchResult &r)
+    {
+        auto fmtTime = [](double ns, char *buf, std::size_t size)
+        {
+            if (ns >= 1e6)
+                std::snprintf(buf, size, "%.3f ms", ns * 1e-6);
+            else if (ns >= 1e3)
+                std::snprintf(buf, size, "%.3f us", ns * 1e-3);
+            else
+                std::snprintf(buf, size, "%.1f ns", ns);
+        };
+        char med[32], mad[32], mem[64] = "";
+        fmtTime(r.medianNs, med, sizeof(med));
+        fmtTime(r.madNs, mad, sizeof(mad));
+        if (MemTracker::enabled())
+            std::snprintf(mem, sizeof(mem), "  %9.1f KB peak %8llu allocs", r.peakBytes / 1024.0,
+                          (unsigned long long)r.allocations);
+        double madPct = r.medianNs > 0.0 ? 100.0 * r.madNs / r.medianNs : 0.0;
+
+        char line[256];
+        if (r.itemsPerSec > 0.0)
+        {
+            double rate = r.itemsPerSec;
+            const char *unit = "";
+            if (rate >= 1e6)
+            {
+                rate *= 1e-6;
+                unit = "M";
+            }
+            else if (rate >= 1e3)
+            {
+                rate *= 1e-3;
+                unit = "k";
+            }
+            std::snprintf(line, sizeof(line), "%-36s %12s  +- %10s (%4.1f%%)  %10.3f %s%s/s%s\n",
+                          r.name.c_str(), med, mad, madPct, rate, unit, r.itemName.c_str(), mem);
+        }
+        else
+            std::snprintf(line, sizeof(line), "%-36s %12s  +- %10s (%4.1f%%)%s\n",
+                          r.name.c_str(), med, mad, madPct, mem);
+        std::cout << line << std::flush;
+    }
+
+    std::vector<BenchResult> m_results;
+};
@@ -0,0 +1,413 @@
+// CPU micro-benchmarks: terrain noise/mesh, voxel chunk, L-system trees,
+// forest placement, particle update, camera spline, LUT generation,
+// primitive mesh indexing, light clustering and scene flattening.
+// No window or GL context is created.
+//
+//   bench [--filter <substring>] [--json <file>] [--samples <n>] [--min-ms <ms>]
+//
+// Results go to stdout and to a JSON file (default bench_results.json) that
+// can be diffed between builds.
+
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "bench_harness.h"
+#include "lut_utils.h"
+#include "particles/particlesystem.h"
+#include "shapes/Cylinder.h"
+#include "shapes/Sphere.h"
+#include "terrain/terraingenerator.h"
+#include "terrain/voxel_chunk.h"
+#include "utils/bezier.h"
+#include "utils/light_clusters.h"
+#include "utils/mesh_optimizer.h"
+#include "utils/scene_flatten.h"
+#include "vegetation/forest_placement.h"
+#include "vegetation/lsystem_tree.h"
+
+namespace
+{
+// the same z-up -> y-up transform Realtime uses for the terrain
+glm::mat4 terrainModel()
+{
+    glm::mat4 T = glm::translate(glm::mat4(1.f), glm::vec3(-0.5f, -0.5f, 0.f));
+    glm::mat4 S = glm::scale(glm::mat4(1.f), glm::vec3(120.f, 120.f, 10.f));
+    glm::mat4 R = glm::rotate(glm::mat4(1.f), -glm::half_pi<float>(), glm::vec3(1, 0, 0));
+    return R * S * T;
+}
+
+void benchTerrain(BenchRunner &b)
+{
+    TerrainGenerator gen;
+
+    const int N = 128; // N*N samples per iteration
+    b.run("terrain/computePerlin", N * N, "samples", [&]
+          {
+        float acc = 0.f;
+        for (int i = 0; i < N; ++i)
+            for (int j = 0; j < N; ++j)
+                acc += gen.computePerlin(i * 0.037f, j * 0.041f);
+        doNotOptimize(acc); });
+
+    // getHeight is private; sampleSurfacePos is a thin public wrapper around it
+    b.run("terrain/getHeight", N * N, "samples", [&]
+          {
+        float acc = 0.f;
+        for (int i = 0; i < N; ++i)
+            for (int j = 0; j < N; ++j)
+                acc += gen.sampleSurfacePos(float(i) / N, float(j) / N).z;
+        doNotOptimize(acc); });
+
+    const int res = gen.getResolution();
+    for (int step : {1, 4})
+    {
+        double triangles = 2.0 * (res / step) * (res / step);
+        b.run("terrain/generateTerrain step=" + std::to_string(step), triangles, "tris", [&]
+              {
+            std::vector<float> v = gen.generateTerrain(step, 16);
+            doNotOptimize(v.data()); });
+    }
+}
+
+void benchVoxel(BenchRunner &b)
+{
+    VoxelChunk chunk; // 64^3 default
+    double voxels = double(chunk.sx) * chunk.sy * chunk.sz;
+    b.run("voxel/build 64^3", voxels, "voxels", [&]
+          {
+        std::vector<float> v = chunk.build();
+        doNotOptimize(v.data()); });
+}
+
+void benchLSystem(BenchRunner &b)
+{
+    const std::vector<std::string> xRules = {
+        "F[+FX][-FX][&FX][^FX]FX",
+        "F[+F&X][-F^X][+FX][&FX]X",
+        "F[+FX[&X]][-FX[^X]][&FX[+X]][^FX[-X]]X"};
+
+    for (int iterations : {2, 3})
+    {
+        LSystemParams p;
+        p.iterations = iterations;
+        b.run("lsystem/generate iter=" + std::to_string(iterations), double(xRules.size()), "trees", [&]
+              {
+            for (const std::string &x : xRules)
+            {
+                std::unordered_map<char, std::string> rules;
+                rules['X'] = x;
+                rules['F'] = "FF";
+                LSystemTree tree(p);
+                tree.generate("X", rules);
+                doNotOptimize(tree.branches().size());
+            } });
+    }
+}
+
+void benchForest(BenchRunner &b)
+{
+    TerrainGenerator gen;
+    glm::mat4 model = terrainModel();
+
+    // default sliders and a dense forest
+    struct Case
+    {
+        const char *name;
+        int coverage, size, leaf;
+    };
+    for (const Case &c : {Case{"forest/placement default", 1, 1, 1}, Case{"forest/placement dense", 100, 40, 40}})
+    {
+        ForestPlacementParams params;
+        params.coverage = c.coverage;
+        params.treeSize = c.size;
+        params.leafDensity = c.leaf;
+        params.seaLevel = -0.1f;
+
+        // count once so throughput is in trees
+        int trees = 0;
+        {
+            ForestPlacer placer(gen, model, params);
+            TreePlacement tp;
+            while (placer.next(tp))
+                ++trees;
+        }
+
+        b.run(c.name, trees, "trees", [&]
+              {
+            ForestPlacer placer(gen, model, params);
+            TreePlacement tp;
+            int n = 0;
+            while (placer.next(tp))
+                ++n;
+            doNotOptimize(n); });
+    }
+}
+
+void benchParticles(BenchRunner &b)
+{
+    for (int type : {0, 1})
+    {
+        ParticleSystem ps;
+        ps.seed(1230);
+        ps.initParticles();
+        ps.setType(type);
+        b.run(type == 0 ? "particles/update snow" : "particles/update rain", 10000, "particles", [&]
+              { ps.update(1.f / 60.f); });
+    }
+}
+
+void benchBezier(BenchRunner &b)
+{
+    BezierSpline<glm::vec3> pos;
+    BezierSpline<glm::quat> rot;
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> d(-50.f, 50.f);
+    for (int k = 0; k <= 10; ++k)
+    {
+        pos.addKeyframe(glm::vec3(d(rng), d(rng) * 0.2f, d(rng)), k * 2.f);
+        rot.addKeyframe(glm::angleAxis(d(rng) * 0.05f, glm::normalize(glm::vec3(d(rng), d(rng), d(rng)))), k * 2.f);
+    }
+
+    const int N = 4096;
+    b.run("bezier/evaluate vec3", N, "evals", [&]
+          {
+        glm::vec3 acc(0.f);
+        for (int i = 0; i < N; ++i)
+            acc += pos.evaluate(20.f * i / N);
+        doNotOptimize(acc); });
+    b.run("bezier/evaluate quat", N, "evals", [&]
+          {
+        glm::quat acc(1.f, 0.f, 0.f, 0.f);
+        for (int i = 0; i < N; ++i)
+            acc = acc * rot.evaluate(20.f * i / N);
+        doNotOptimize(acc); });
+}
+
+void benchLUT(BenchRunner &b)
+{
+    for (int size : {32, 64})
+    {
+        double texels = double(size) * size * size;
+        b.run("lut/generateStyledLUT " + std::to_string(size), texels, "texels", [&]
+              {
+            std::vector<float> v = LUTUtils::generateStyledLUT(size, 3);
+            doNotOptimize(v.data()); });
+    }
+}
+
+void benchMeshes(BenchRunner &b)
+{
+    Sphere sphere;
+    sphere.updateParams(25, 25);
+    Cylinder cylinder;
+    cylinder.updateParams(20, 40);
+
+    struct Case
+    {
+        const char *name;
+        std::vector<float> soup;
+    };
+    for (const Case &c : {Case{"mesh/buildIndexedMesh sphere 25x25", sphere.generateShape()},
+                          Case{"mesh/buildIndexedMesh cylinder 20x40", cylinder.generateShape()}})
+    {
+        if (!b.filter.empty() && std::string(c.name).find(b.filter) == std::string::npos)
+            continue;
+
+        // what the reordering buys, next to its cost
+        IndexedMesh welded = weldVertices(c.soup, 6);
+        IndexedMesh built = buildIndexedMesh(c.soup, 6);
+        std::printf("[bench] %s: %zu -> %zu vertices, ACMR %.2f welded, %.2f optimised\n", c.name,
+                    c.soup.size() / 6, built.vertexCount(),
+                    averageCacheMissRatio(welded.indices, welded.vertexCount()),
+                    averageCacheMissRatio(built.indices, built.vertexCount()));
+
+        b.run(c.name, double(c.soup.size() / 18), "tris", [&]
+              {
+            IndexedMesh m = buildIndexedMesh(c.soup, 6);
+            doNotOptimize(m.indices.data()); });
+    }
+}
+
+// scene-file point lights scattered over the terrain, seen from the default camera
+void benchLightClusters(BenchRunner &b)
+{
+    glm::mat4 view = glm::lookAt(glm::vec3(0.f, 15.f, 60.f), glm::vec3(0.f, 0.f, 0.f), glm::vec3(0, 1, 0));
+    for (int count : {16, 256})
+    {
+        std::string name = "lights/cluster build " + std::to_string(count);
+        if (!b.filter.empty() && name.find(b.filter) == std::string::npos)
+            continue;
+
+        std::mt19937 rng(7);
+        std::uniform_real_distribution<float> xz(-60.f, 60.f), y(0.f, 10.f);
+        std::vector<ClusterLight> lights(count);
+        for (ClusterLight &l : lights)
+        {
+            glm::vec3 atten(1.f, 0.35f, 0.44f), color(1.f, 0.8f, 0.6f);
+            l.posType = glm::vec4(xz(rng), y(rng), xz(rng), 0.f);
+            l.colorAngle = glm::vec4(color, 0.f);
+            l.attenPenumbra = glm::vec4(atten, 0.f);
+            l.dirRadius = glm::vec4(0.f, -1.f, 0.f, lightInfluenceRadius(atten, color));
+        }
+
+        LightClusterGrid grid;
+        grid.build(lights, view, glm::radians(45.f), 16.f / 9.f, 0.1f, 400.f);
+        std::printf("[bench] %s: %zu light references, at most %d per cluster\n", name.c_str(),
+                    grid.lightReferences(), grid.maxLightsPerCluster());
+
+        b.run(name, count, "lights", [&]
+              {
+            grid.build(lights, view, glm::radians(45.f), 16.f / 9.f, 0.1f, 400.f);
+            doNotOptimize(grid.gpuData().data()); });
+    }
+}
+
+// A procedural scene graph like the generated city / forest scene files:
+// groups of transformed subgroups, each with its own primitives plus one
+// shared template group.
+struct SyntheticScene
+{
+    std::vector<std::unique_ptr<SceneNode>> nodes;
+    std::vector<std::unique_ptr<SceneTransformation>> transforms;
+    std::vector<std::unique_ptr<ScenePrimitive>> prims;
+    SceneNode *root = nullptr;
+
+    SceneNode *node()
+    {
+        nodes.push_back(std::make_unique<SceneNode>());
+        return nodes.back().get();
+    }
+    void transform(SceneNode *n, TransformationType type, glm::vec3 v, float angle = 0.f)
+    {
+        auto t = std::make_unique<SceneTransformation>();
+        t->type = type;
+        t->translate = t->scale = t->rotate = v;
+        t->angle = angle;
+        n->transformations.push_back(t.get());
+        transforms.push_back(std::move(t));
+    }
+    void primitive(SceneNode *n, PrimitiveType type, float tint)
+    {
+        auto p = std::make_unique<ScenePrimitive>();
+        p->type = type;
+        p->material.clear();
+        p->material.cDiffuse = glm::vec4(tint, 0.5f, 0.2f, 1.f);
+        p->material.shininess = 20.f;
+        n->primitives.push_back(p.get());
+        prims.push_back(std::move(p));
+    }
+
+    SyntheticScene(int groups, int subgroups, int primsPerSub)
+    {
+        root = node();
+        SceneNode *shared = node();
+        for (int k = 0; k < 8; ++k)
+            primitive(shared, PrimitiveType::PRIMITIVE_CUBE, 0.1f * k);
+        for (int g = 0; g < groups; ++g)
+        {
+            SceneNode *group = node();
+            transform(group, TransformationType::TRANSFORMATION_TRANSLATE, glm::vec3(g * 10.f, 0.f, 0.f));
+            transform(group, TransformationType::TRANSFORMATION_ROTATE, glm::vec3(0, 1, 0), 0.1f * g);
+            root->children.push_back(group);
+            for (int s = 0; s < subgroups; ++s)
+            {
+                SceneNode *sub = node();
+                transform(sub, TransformationType::TRANSFORMATION_TRANSLATE, glm::vec3(0.f, 0.f, s * 2.f));
+                transform(sub, TransformationType::TRANSFORMATION_SCALE, glm::vec3(0.5f + 0.01f * s));
+                for (int p = 0; p < primsPerSub; ++p)
+                    primitive(sub, p % 2 ? PrimitiveType::PRIMITIVE_SPHERE : PrimitiveType::PRIMITIVE_CUBE,
+                              float(p) / primsPerSub);
+                sub->children.push_back(shared);
+                group->children.push_back(sub);
+            }
+        }
+    }
+};
+
+void benchScene(BenchRunner &b)
+{
+    const bool flatten = b.filter.empty() || std::string("scene/flatten").find(b.filter) != std::string::npos;
+    const bool cache = b.filter.empty() || std::string("scene/cache read").find(b.filter) != std::string::npos;
+    if (!flatten && !cache)
+        return;
+
+    SyntheticScene graph(32, 16, 32);
+    FlatScene scene;
+    flattenSceneGraph(graph.root, scene);
+    std::printf("[bench] scene: %zu shapes, %zu materials\n", scene.shapeCount(), scene.materials.size());
+
+    if (flatten)
+        b.run("scene/flatten 32x16x40", double(scene.shapeCount()), "shapes", [&]
+              {
+            flattenSceneGraph(graph.root, scene);
+            doNotOptimize(scene.ctms.data()); });
+
+    if (cache)
+    {
+        // the cache is stamped with its source, so any existing file will do
+        std::filesystem::path dir = std::filesystem::temp_directory_path();
+        std::string source = (dir / "amazing_terrain_bench_scene.json").string();
+        std::string cachePath = source + ".atsc";
+        std::ofstream(source) << "{}";
+        if (writeSceneCache(cachePath, source, scene))
+        {
+            FlatScene loaded;
+            b.run("scene/cache read 32x16x40", double(scene.shapeCount()), "shapes", [&]
+                  {
+                readSceneCache(cachePath, source, loaded);
+                doNotOptimize(loaded.ctms.data()); });
+        }
+        std::filesystem::remove(cachePath);
+        std::filesystem::remove(source);
+    }
+}
+}
+
+int main(int argc, char **argv)
+{
+    BenchRunner runner;
+    std::string jsonPath = "bench_results.json";
+
+    for (int i = 1; i < argc; ++i)
+    {
+        auto value = [&](const char *flag) -> const char *
+        {
+            if (std::strcmp(argv[i], flag) == 0 && i + 1 < argc)
+                return argv[++i];
+            return nullptr;
+        };
+        if (const char *v = value("--filter"))
+            runner.filter = v;
+        else if (const char *v = value("--json"))
+            jsonPath = v;
+        else if (const char *v = value("--samples"))
+            runner.samples = std::max(3, std::atoi(v));
+        else if (const char *v = value("--min-ms"))
+            runner.minSampleMs = std::max(1.0, std::atof(v));
+        else
+        {
+            std::cerr << "usage: bench [--filter <substring>] [--json <file>] [--samples <n>] [--min-ms <ms>]\n";
+            return 1;
+        }
+    }
+
+    std::cout << "[bench] " << runner.samples << " samples, >= " << runner.minSampleMs << " ms each\n";
+
+    benchTerrain(runner);
+    benchVoxel(runner);
+    benchLSystem(runner);
+    benchForest(runner);
+    benchParticles(runner);
+    benchBezier(runner);
+    benchLUT(runner);
+    benchMeshes(runner);
+    benchLightClusters(runner);
+    benchScene(runner);
+
+    return runner.writeJson(jsonPath) ? 0 : 1;
+}
@@ -0,0 +1,34 @@
+// Aerial perspective: what the atmosphere adds to and takes from a surface
+// between it and the eye, looked up in the froxel volume Atmosphere builds
+// each frame for the main camera (src/sky/atmosphere.h).
+
+uniform sampler3D uAerialPerspective;
+uniform mat4  uAerialViewProj;  // the camera the volume was built for
+uniform vec3  uAerialEye;       // the eye of the pass drawing now
+uniform float uAerialKmPerUnit;
+uniform float uAerialKmPerSlice;
+
+// rgb: in-scattered light, a: 1 - transmittance
+vec4 aerialPerspective(vec3 worldPos)
+{
+    // passes with a different camera (reflection) reuse the main camera's
+    // froxels; points outside its frustum take the nearest edge
+    vec4 clip = uAerialViewProj * vec4(worldPos, 1.0);
+    vec2 uv = clip.w > 0.0 ? clamp(clip.xy / clip.w * 0.5 + 0.5, 0.0, 1.0) : vec2(0.5);
+
+    float slices = float(textureSize(uAerialPerspective, 0).z);
+    float slice = length(worldPos - uAerialEye) * uAerialKmPerUnit / uAerialKmPerSlice;
+    float weight = 1.0;
+    if (slice < 0.5)
+    {
+        // nothing in front of the first slice: fade to no atmosphere at the eye
+        weight = clamp(slice * 2.0, 0.0, 1.0);
+        slice = 0.5;
+    }
+    return weight * texture(uAerialPerspective, vec3(uv, sqrt(slice / slices)));
+}
+
+vec3 applyAerialPerspective(vec3 color, vec4 ap)
+{
+    return color * (1.0 - ap.a) + ap.rgb;
+}
@@ -0,0 +1,302 @@
+// Physically based atmosphere after Hillaire, "A Scalable and Production
+// Ready Sky and Atmosphere Rendering Technique" (EGSR 2020): Rayleigh and Mie
+// scattering plus ozone absorption in a spherical shell, evaluated through
+// a transmittance LUT and a multiple-scattering LUT.
+//
+// Distances are in kilometres. The planet centre is the origin and +Y is up,
+// so a point at altitude h straight above it is (0, uBottomRadius + h, 0).
+
+const float PI = 3.14159265358979;
+const float PLANET_RADIUS_OFFSET = 0.01; // keeps samples off the ground sphere
+
+uniform float uBottomRadius;
+uniform float uTopRadius;
+uniform vec3  uRayleighScattering; // per km at the ground
+uniform float uRayleighScaleHeight;
+uniform vec3  uMieScattering;
+uniform vec3  uMieExtinction;
+uniform float uMieScaleHeight;
+uniform float uMieG;
+uniform vec3  uOzoneAbsorption; // peak, at 25 km
+uniform vec3  uGroundAlbedo;
+
+uniform vec3 uSunDirection; // towards the sun
+uniform vec3 uSunIlluminance;
+
+uniform sampler2D uTransmittanceLut;
+uniform sampler2D uMultiScatteringLut;
+
+struct Medium
+{
+    vec3 scattering;
+    vec3 extinction;
+    vec3 scatteringRay;
+    vec3 scatteringMie;
+};
+
+Medium sampleMedium(vec3 p)
+{
+    float h = max(length(p) - uBottomRadius, 0.0);
+    float densityRay = exp(-h / uRayleighScaleHeight);
+    float densityMie = exp(-h / uMieScaleHeight);
+    float densityOzone = max(0.0, 1.0 - abs(h - 25.0) / 15.0); // tent from 10 to 40 km
+
+    Medium m;
+    m.scatteringRay = uRayleighScattering * densityRay;
+    m.scatteringMie = uMieScattering * densityMie;
+    m.scattering = m.scatteringRay + m.scatteringMie;
+    m.extinction = m.scatteringRay + uMieExtinction * densityMie + uOzoneAbsorption * densityOzone;
+    return m;
+}
+
+float rayleighPhase(float cosTheta)
+{
+    return 3.0 / (16.0 * PI) * (1.0 + cosTheta * cosTheta);
+}
+
+// Henyey-Greenstein; cosTheta between the view ray and the sun direction
+float miePhase(float g, float cosTheta)
+{
+    float k = 1.0 + g * g - 2.0 * g * cosTheta;
+    return (1.0 - g * g) / (4.0 * PI * k * sqrt(k));
+}
+
+// nearest hit in front of r0 with a sphere around the origin, -1 for none
+float raySphereIntersectNearest(vec3 r0, vec3 rd, float radius)
+{
+    float b = dot(r0, rd);
+    float c = dot(r0, r0) - radius * radius;
+    float delta = b * b - c;
+    if (delta < 0.0)
+        return -1.0;
+    float s = sqrt(delta);
+    float t0 = -b - s;
+    float t1 = -b + s;
+    if (t1 < 0.0)
+        return -1.0;
+    return t0 < 0.0 ? t1 : t0;
+}
+
+// A ray starting above the atmosphere starts at its top instead; false if it misses
+bool moveToTopAtmosphere(inout vec3 pos, vec3 dir)
+{
+    if (length(pos) <= uTopRadius)
+        return true;
+    float t = raySphereIntersectNearest(pos, dir, uTopRadius);
+    if (t < 0.0)
+        return false;
+    pos += dir * (t - PLANET_RADIUS_OFFSET);
+    return true;
+}
+
+// texel centres to [0, 1] and back, so the LUT ends hold the exact ends of the range
+float fromUnitToSubUvs(float u, float res) { return (u + 0.5 / res) * (res / (res + 1.0)); }
+float fromSubUvsToUnit(float u, float res) { return (u - 0.5 / res) * (res / (res - 1.0)); }
+
+// ---- transmittance LUT: (view zenith, height) -> transmittance to the top of the atmosphere
+
+void transmittanceUvToParams(vec2 uv, out float viewHeight, out float viewZenithCos)
+{
+    float H = sqrt(uTopRadius * uTopRadius - uBottomRadius * uBottomRadius);
+    float rho = H * uv.y;
+    viewHeight = sqrt(rho * rho + uBottomRadius * uBottomRadius);
+
+    float dMin = uTopRadius - viewHeight;
+    float dMax = rho + H;
+    float d = dMin + uv.x * (dMax - dMin);
+    viewZenithCos = d == 0.0 ? 1.0 : (H * H - rho * rho - d * d) / (2.0 * viewHeight * d);
+    viewZenithCos = clamp(viewZenithCos, -1.0, 1.0);
+}
+
+vec2 transmittanceParamsToUv(float viewHeight, float viewZenithCos)
+{
+    float H = sqrt(max(0.0, uTopRadius * uTopRadius - uBottomRadius * uBottomRadius));
+    float rho = sqrt(max(0.0, viewHeight * viewHeight - uBottomRadius * uBottomRadius));
+
+    float discriminant = viewHeight * viewHeight * (viewZenithCos * viewZenithCos - 1.0) + uTopRadius * uTopRadius;
+    float d = max(0.0, -viewHeight * viewZenithCos + sqrt(max(discriminant, 0.0)));
+    float dMin = uTopRadius - viewHeight;
+    float dMax = rho + H;
+    return vec2((d - dMin) / (dMax - dMin), rho / H);
+}
+
+vec3 transmittanceToTop(float viewHeight, float viewZenithCos)
+{
+    return texture(uTransmittanceLut, transmittanceParamsToUv(viewHeight, viewZenithCos)).rgb;
+}
+
+// ---- multiple-scattering LUT: (sun zenith, height) -> isotropic luminance of every order past the first
+
+vec3 multipleScattering(float viewHeight, float sunZenithCos)
+{
+    vec2 res = vec2(textureSize(uMultiScatteringLut, 0));
+    vec2 uv = clamp(vec2(sunZenithCos * 0.5 + 0.5,
+                         (viewHeight - uBottomRadius) / (uTopRadius - uBottomRadius)), 0.0, 1.0);
+    uv = vec2(fromUnitToSubUvs(uv.x, res.x), fromUnitToSubUvs(uv.y, res.y));
+    return texture(uMultiScatteringLut, uv).rgb;
+}
+
+// ---- sky-view LUT: (azimuth from the sun, view zenith) -> sky luminance, for one camera height.
+// Rows are packed non-linearly so the horizon gets most of them.
+
+void skyViewUvToParams(vec2 uv, vec2 res, float viewHeight, out float viewZenithCos, out float lightViewCos)
+{
+    uv = vec2(fromSubUvsToUnit(uv.x, res.x), fromSubUvsToUnit(uv.y, res.y));
+
+    float vHorizon = sqrt(max(0.0, viewHeight * viewHeight - uBottomRadius * uBottomRadius));
+    float beta = acos(clamp(vHorizon / viewHeight, -1.0, 1.0)); // horizon below the horizontal
+    float zenithHorizonAngle = PI - beta;
+
+    if (uv.y < 0.5)
+    {
+        float coord = 1.0 - 2.0 * uv.y;
+        coord = 1.0 - coord * coord;
+        viewZenithCos = cos(zenithHorizonAngle * coord);
+    }
+    else
+    {
+        float coord = uv.y * 2.0 - 1.0;
+        coord *= coord;
+        viewZenithCos = cos(zenithHorizonAngle + beta * coord);
+    }
+
+    float coord = uv.x * uv.x;
+    lightViewCos = -(coord * 2.0 - 1.0);
+}
+
+vec2 skyViewParamsToUv(vec2 res, bool intersectGround, float viewZenithCos, float lightViewCos, float viewHeight)
+{
+    float vHorizon = sqrt(max(0.0, viewHeight * viewHeight - uBottomRadius * uBottomRadius));
+    float beta = acos(clamp(vHorizon / viewHeight, -1.0, 1.0));
+    float zenithHorizonAngle = PI - beta;
+    float viewZenith = acos(clamp(viewZenithCos, -1.0, 1.0));
+
+    vec2 uv;
+    if (!intersectGround)
+    {
+        float coord = 1.0 - clamp(viewZenith / zenithHorizonAngle, 0.0, 1.0);
+        coord = 1.0 - sqrt(coord);
+        uv.y = coord * 0.5;
+    }
+    else
+    {
+        float coord = clamp((viewZenith - zenithHorizonAngle) / beta, 0.0, 1.0);
+        uv.y = sqrt(coord) * 0.5 + 0.5;
+    }
+    uv.x = sqrt(clamp(-lightViewCos * 0.5 + 0.5, 0.0, 1.0));
+
+    return vec2(fromUnitToSubUvs(uv.x, res.x), fromUnitToSubUvs(uv.y, res.y));
+}
+
+// ---- ray marching
+
+struct ScatteringResult
+{
+    vec3 luminance;
+    vec3 transmittance;
+    vec3 multiScatAs1; // light a uniform unit illumination scatters once towards the eye
+};
+
+// Integrates single scattering along pos + t * dir, with the multiple
+// scattering of the LUT on top when multiScattering is set.
+//  ground:          the ray may end on the ground, which then reflects the sun
+//  variableSamples: sampleCount is an upper bound, fewer are taken for short rays
+//  physicalPhase:   Rayleigh + Mie phase; otherwise isotropic (multiple-scattering LUT)
+ScatteringResult integrateScatteredLuminance(vec3 pos, vec3 dir, vec3 sunDir, vec3 illuminance, bool ground,
+                                             float sampleCount, bool variableSamples, bool physicalPhase,
+                                             bool multiScattering, float tMaxMax)
+{
+    ScatteringResult r;
+    r.luminance = vec3(0.0);
+    r.transmittance = vec3(1.0);
+    r.multiScatAs1 = vec3(0.0);
+
+    float tBottom = raySphereIntersectNearest(pos, dir, uBottomRadius);
+    float tTop = raySphereIntersectNearest(pos, dir, uTopRadius);
+    float tMax;
+    if (tBottom < 0.0)
+    {
+        if (tTop < 0.0)
+            return r;
+        tMax = tTop;
+    }
+    else
+    {
+        tMax = tTop > 0.0 ? min(tTop, tBottom) : tBottom;
+    }
+    bool hitsGround = tBottom >= 0.0 && tMax == tBottom;
+    if (tMax > tMaxMax)
+    {
+        tMax = tMaxMax;
+        hitsGround = false;
+    }
+
+    if (variableSamples)
+        sampleCount = mix(max(sampleCount * 0.25, 1.0), sampleCount, clamp(tMax * 0.01, 0.0, 1.0));
+    float sampleCountFloor = floor(sampleCount);
+    float tMaxFloor = tMax * sampleCountFloor / sampleCount;
+
+    float cosTheta = dot(dir, sunDir);
+    float phaseMie = miePhase(uMieG, cosTheta);
+    float phaseRay = rayleighPhase(cosTheta);
+    const float uniformPhase = 1.0 / (4.0 * PI);
+    const float segmentT = 0.3; // where in its segment each sample sits
+
+    vec3 throughput = vec3(1.0);
+    float dt = tMax / sampleCount;
+    for (float s = 0.0; s < sampleCount; s += 1.0)
+    {
+        float t;
+        if (variableSamples)
+        {
+            // quadratic spacing: dense near the eye
+            float t0 = s / sampleCountFloor;
+            float t1 = (s + 1.0) / sampleCountFloor;
+            t0 = t0 * t0 * tMaxFloor;
+            t1 = t1 > 1.0 ? tMax : t1 * t1 * tMaxFloor;
+            t = t0 + (t1 - t0) * segmentT;
+            dt = t1 - t0;
+        }
+        else
+        {
+            t = (s + segmentT) * dt;
+        }
+
+        vec3 p = pos + t * dir;
+        Medium m = sampleMedium(p);
+        vec3 extinction = max(m.extinction, vec3(1e-7));
+        vec3 sampleTransmittance = exp(-extinction * dt);
+
+        float pHeight = length(p);
+        vec3 up = p / pHeight;
+        float sunZenithCos = dot(sunDir, up);
+        vec3 sunTransmittance = transmittanceToTop(pHeight, sunZenithCos);
+        float earthShadow = raySphereIntersectNearest(p - PLANET_RADIUS_OFFSET * up, sunDir, uBottomRadius) >= 0.0
+                                ? 0.0 : 1.0;
+
+        vec3 phaseTimesScattering = physicalPhase ? m.scatteringMie * phaseMie + m.scatteringRay * phaseRay
+                                                  : m.scattering * uniformPhase;
+        vec3 multi = multiScattering ? multipleScattering(pHeight, sunZenithCos) : vec3(0.0);
+        vec3 S = illuminance * (earthShadow * sunTransmittance * phaseTimesScattering + multi * m.scattering);
+
+        // analytic integral over the segment, energy conserving for any step length
+        vec3 msInt = (m.scattering - m.scattering * sampleTransmittance) / extinction;
+        r.multiScatAs1 += throughput * msInt;
+        vec3 sInt = (S - S * sampleTransmittance) / extinction;
+        r.luminance += throughput * sInt;
+        throughput *= sampleTransmittance;
+    }
+
+    if (ground && hitsGround)
+    {
+        vec3 p = pos + tBottom * dir;
+        float pHeight = length(p);
+        vec3 up = p / pHeight;
+        float sunZenithCos = dot(sunDir, up);
+        r.luminance += illuminance * transmittanceToTop(pHeight, sunZenithCos) * throughput *
+                       clamp(sunZenithCos, 0.0, 1.0) * uGroundAlbedo / PI;
+    }
+
+    r.transmittance = throughput;
+    return r;
+}
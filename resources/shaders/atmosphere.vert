@@ -0,0 +1,8 @@
+#version 330 core
+
+// Full-screen triangle from gl_VertexID alone: draw 3 vertices, no buffers
+void main()
+{
+    vec2 p = vec2(float((gl_VertexID << 1) & 2), float(gl_VertexID & 2));
+    gl_Position = vec4(p * 2.0 - 1.0, 0.0, 1.0);
+}
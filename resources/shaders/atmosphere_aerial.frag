@@ -0,0 +1,51 @@
+#version 330 core
+
+#include "atmosphere.glsl"
+
+out vec4 fragColor;
+
+uniform vec2  uLutSize;     // froxels across and down
+uniform float uSlice;       // depth slice being rendered
+uniform float uSliceCount;
+uniform float uKmPerSlice;
+uniform mat4  uInvViewProj; // the camera the volume is for, world units
+uniform vec3  uCameraPos;   // world units
+uniform float uKmPerUnit;
+uniform float uSeaLevelY;   // world y of the ground sphere
+
+// One depth slice of the aerial-perspective volume: light scattered towards
+// the camera, and 1 - transmittance, between the eye and the slice's depth
+// along each froxel's ray. Slices are spaced quadratically in depth.
+void main()
+{
+    vec2 ndc = gl_FragCoord.xy / uLutSize * 2.0 - 1.0;
+    vec4 h = uInvViewProj * vec4(ndc, 0.5, 1.0);
+    vec3 dir = normalize(h.xyz / h.w - uCameraPos);
+
+    vec3 camPos = vec3(0.0, uBottomRadius + max((uCameraPos.y - uSeaLevelY) * uKmPerUnit, PLANET_RADIUS_OFFSET), 0.0);
+    vec3 sunDir = normalize(uSunDirection);
+
+    float slice = (uSlice + 0.5) / uSliceCount;
+    slice = slice * slice * uSliceCount;
+    float tMax = slice * uKmPerSlice;
+
+    // a froxel below the ground sphere is pulled up onto it
+    vec3 end = camPos + tMax * dir;
+    if (length(end) <= uBottomRadius + PLANET_RADIUS_OFFSET)
+    {
+        end = normalize(end) * (uBottomRadius + PLANET_RADIUS_OFFSET + 0.001);
+        dir = normalize(end - camPos);
+        tMax = length(end - camPos);
+    }
+
+    vec3 pos = camPos;
+    if (!moveToTopAtmosphere(pos, dir))
+    {
+        fragColor = vec4(0.0);
+        return;
+    }
+
+    ScatteringResult r = integrateScatteredLuminance(pos, dir, sunDir, uSunIlluminance, false,
+                                                     max(1.0, (uSlice + 1.0) * 2.0), false, true, true, tMax);
+    fragColor = vec4(r.luminance, 1.0 - dot(r.transmittance, vec3(1.0 / 3.0)));
+}
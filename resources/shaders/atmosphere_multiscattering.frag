@@ -0,0 +1,51 @@
+#version 330 core
+
+#include "atmosphere.glsl"
+
+out vec4 fragColor;
+
+uniform vec2 uLutSize;
+
+const int SQRT_DIRECTIONS = 8; // 64 directions over the sphere
+const float SAMPLE_COUNT = 20.0;
+
+// Hillaire's multiple-scattering approximation: light arriving at a point from
+// every direction after one bounce is assumed isotropic, and each further
+// order scatters the same fraction f_ms of it again, so all orders together
+// are the second order times 1 / (1 - f_ms).
+void main()
+{
+    vec2 uv = gl_FragCoord.xy / uLutSize;
+    uv = vec2(fromSubUvsToUnit(uv.x, uLutSize.x), fromSubUvsToUnit(uv.y, uLutSize.y));
+
+    float sunZenithCos = uv.x * 2.0 - 1.0;
+    vec3 sunDir = vec3(sqrt(max(0.0, 1.0 - sunZenithCos * sunZenithCos)), sunZenithCos, 0.0);
+    float viewHeight = uBottomRadius + clamp(uv.y + PLANET_RADIUS_OFFSET, 0.0, 1.0) *
+                                           (uTopRadius - uBottomRadius - PLANET_RADIUS_OFFSET);
+    vec3 pos = vec3(0.0, viewHeight, 0.0);
+
+    vec3 luminance = vec3(0.0);
+    vec3 fms = vec3(0.0);
+    for (int i = 0; i < SQRT_DIRECTIONS; ++i)
+    {
+        for (int j = 0; j < SQRT_DIRECTIONS; ++j)
+        {
+            // uniform over the sphere
+            float theta = 2.0 * PI * (float(i) + 0.5) / float(SQRT_DIRECTIONS);
+            float phi = acos(1.0 - 2.0 * (float(j) + 0.5) / float(SQRT_DIRECTIONS));
+            vec3 dir = vec3(cos(theta) * sin(phi), cos(phi), sin(theta) * sin(phi));
+
+            ScatteringResult r = integrateScatteredLuminance(pos, dir, sunDir, vec3(1.0), true, SAMPLE_COUNT,
+                                                             false, false, false, 9.0e9);
+            luminance += r.luminance;
+            fms += r.multiScatAs1;
+        }
+    }
+
+    // (sum * sphere solid angle / N) * isotropic phase = sum / N
+    float n = float(SQRT_DIRECTIONS * SQRT_DIRECTIONS);
+    luminance /= n;
+    fms /= n;
+
+    fragColor = vec4(luminance / (1.0 - fms), 1.0);
+}
@@ -0,0 +1,35 @@
+#version 330 core
+
+#include "atmosphere.glsl"
+
+out vec4 fragColor;
+
+uniform vec2 uLutSize;
+uniform float uViewHeight; // camera distance from the planet centre
+
+const float SAMPLE_COUNT = 30.0;
+
+void main()
+{
+    float viewZenithCos, lightViewCos;
+    skyViewUvToParams(gl_FragCoord.xy / uLutSize, uLutSize, uViewHeight, viewZenithCos, lightViewCos);
+
+    // a frame with the sun in the XY plane; only the angle to it matters
+    vec3 pos = vec3(0.0, uViewHeight, 0.0);
+    float sunZenithCos = clamp(uSunDirection.y, -1.0, 1.0);
+    vec3 sunDir = vec3(sqrt(max(0.0, 1.0 - sunZenithCos * sunZenithCos)), sunZenithCos, 0.0);
+
+    float viewZenithSin = sqrt(max(0.0, 1.0 - viewZenithCos * viewZenithCos));
+    vec3 dir = vec3(viewZenithSin * lightViewCos, viewZenithCos,
+                    viewZenithSin * sqrt(max(0.0, 1.0 - lightViewCos * lightViewCos)));
+
+    if (!moveToTopAtmosphere(pos, dir))
+    {
+        fragColor = vec4(0.0, 0.0, 0.0, 1.0);
+        return;
+    }
+
+    ScatteringResult r = integrateScatteredLuminance(pos, dir, sunDir, uSunIlluminance, false, SAMPLE_COUNT,
+                                                     true, true, true, 9.0e9);
+    fragColor = vec4(r.luminance, 1.0);
+}
@@ -0,0 +1,28 @@
+#version 330 core
+
+#include "atmosphere.glsl"
+
+out vec4 fragColor;
+
+uniform vec2 uLutSize;
+
+const float SAMPLE_COUNT = 40.0;
+
+void main()
+{
+    float viewHeight, viewZenithCos;
+    transmittanceUvToParams(gl_FragCoord.xy / uLutSize, viewHeight, viewZenithCos);
+
+    // optical depth to the top of the atmosphere; the parametrisation only
+    // holds rays that clear the ground
+    vec3 pos = vec3(0.0, viewHeight, 0.0);
+    vec3 dir = vec3(sqrt(max(0.0, 1.0 - viewZenithCos * viewZenithCos)), viewZenithCos, 0.0);
+    float tMax = raySphereIntersectNearest(pos, dir, uTopRadius);
+
+    vec3 opticalDepth = vec3(0.0);
+    float dt = max(tMax, 0.0) / SAMPLE_COUNT;
+    for (float s = 0.0; s < SAMPLE_COUNT; s += 1.0)
+        opticalDepth += sampleMedium(pos + (s + 0.5) * dt * dir).extinction * dt;
+
+    fragColor = vec4(exp(-opticalDepth), 1.0);
+}
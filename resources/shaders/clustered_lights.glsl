@@ -0,0 +1,73 @@
+// Scene-file point and spot lights, culled per view-space cluster on the CPU
+// (utils/light_clusters.h, Realtime::updateLightClusters). Included by the
+// terrain, forest and default fragment shaders after their #version line.
+
+const int MAX_CLUSTER_LIGHTS = 256;
+
+// four vec4s per light, see ClusterLight
+layout(std140) uniform ClusterLights {
+    vec4 uLightData[MAX_CLUSTER_LIGHTS * 4];
+};
+
+// (offset, count) per cluster, then the light index lists
+uniform usamplerBuffer uClusterData;
+
+uniform int   uClusterEnabled;  // 0 in passes the grid was not built for (water reflection/refraction)
+uniform ivec3 uClusterGrid;     // tiles x, tiles y, depth slices
+uniform vec2  uClusterZParams;  // slice = log(view depth) * x - y
+uniform vec4  uClusterWindow;   // xy: gl_FragCoord offset into the full view, zw: its size (pixels)
+uniform mat4  uClusterView;
+
+float attenuation(vec3 c, float d)
+{
+    return min(1.0, 1.0 / max(c.x + c.y * d + c.z * d * d, 1e-4));
+}
+
+int clusterIndex(vec3 worldPos)
+{
+    ivec2 tile = ivec2((gl_FragCoord.xy + uClusterWindow.xy) / uClusterWindow.zw * vec2(uClusterGrid.xy));
+    tile = clamp(tile, ivec2(0), uClusterGrid.xy - 1);
+    float depth = max(-(uClusterView * vec4(worldPos, 1.0)).z, 1e-4);
+    int slice = clamp(int(log(depth) * uClusterZParams.x - uClusterZParams.y), 0, uClusterGrid.z - 1);
+    return tile.x + uClusterGrid.x * (tile.y + uClusterGrid.y * slice);
+}
+
+// Blinn-Phong sum over the lights reaching this fragment's cluster
+vec3 clusteredLighting(vec3 P, vec3 N, vec3 V, vec3 kd, vec3 ks, float shininess)
+{
+    if (uClusterEnabled == 0)
+        return vec3(0.0);
+
+    int c = clusterIndex(P);
+    int offset = int(texelFetch(uClusterData, 2 * c).r);
+    int count  = int(texelFetch(uClusterData, 2 * c + 1).r);
+
+    vec3 sum = vec3(0.0);
+    for (int i = 0; i < count; ++i) {
+        int li = 4 * int(texelFetch(uClusterData, offset + i).r);
+        vec4 posType       = uLightData[li];
+        vec4 colorAngle    = uLightData[li + 1];
+        vec4 attenPenumbra = uLightData[li + 2];
+        vec4 dirRadius     = uLightData[li + 3];
+
+        vec3 toL = posType.xyz - P;
+        float d  = length(toL);
+        if (d > dirRadius.w)
+            continue;
+        vec3 L = toL / max(d, 1e-4);
+
+        float k = attenuation(attenPenumbra.xyz, d);
+        if (posType.w > 0.5) {
+            float x     = acos(clamp(dot(-L, dirRadius.xyz), -1.0, 1.0));
+            float inner = colorAngle.w - attenPenumbra.w;
+            float t     = clamp((x - inner) / max(attenPenumbra.w, 1e-4), 0.0, 1.0);
+            k *= x > colorAngle.w ? 0.0 : 1.0 - t * t * (3.0 - 2.0 * t);
+        }
+
+        float NdotL = max(dot(N, L), 0.0);
+        vec3 H      = normalize(L + V);
+        float spec  = NdotL > 0.0 ? pow(max(dot(N, H), 0.0), shininess) : 0.0;
+        sum += k * (kd * NdotL + ks * spec) * colorAngle.rgb;
+    }
+    return sum;
+}
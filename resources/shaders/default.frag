@@ -1,5 +1,8 @@
 #version 330 core
 
+#include "aerial_perspective.glsl"
+#include "clustered_lights.glsl"
+
 in vec3 v_worldPos;
 in vec3 v_worldNormal;
 
@@ -11,9 +14,6 @@ uniform vec3 uSunDir;       // FROM light TO scene
 uniform vec3 uSunColor;
 uniform vec3 uAmbientColor;
 
-uniform vec3  uFogColor;
-uniform float uFogDensity;
-
 struct Material {
     vec3 ka;
     vec3 kd;
@@ -23,6 +23,24 @@ struct Material {
 
 uniform Material u_mat;
 
+// scene-file directional lights (Realtime::uploadLights), on top of the sun;
+// point and spot lights come through the cluster grid
+const int MAX_LIGHTS = 8;
+struct DirLight {
+    vec3 dir;   // FROM light TO scene
+    vec3 color;
+};
+uniform int uDirCount;
+uniform DirLight uDirs[MAX_LIGHTS];
+
+vec3 phong(vec3 N, vec3 V, vec3 L, vec3 color)
+{
+    float NdotL = max(dot(N, L), 0.0);
+    vec3 H      = normalize(L + V);
+    float spec  = NdotL > 0.0 ? pow(max(dot(N, H), 0.0), u_mat.shininess) : 0.0;
+    return (u_mat.kd * NdotL + u_mat.ks * spec) * color;
+}
+
 void main()
 {
     vec3 N = normalize(v_worldNormal);
@@ -38,14 +56,14 @@ void main()
     vec3 specular = u_mat.ks * spec    * uSunColor;
 
 
-    vec3 color = ambient + diffuse + specular;
+    vec3 color = u_mat.ka + ambient + diffuse + specular;
+
+    for (int i = 0; i < uDirCount; ++i)
+        color += phong(N, V, normalize(-uDirs[i].dir), uDirs[i].color);
 
-    // simple distance fog: using world-space distance
-    float dist = length(uEye - v_worldPos);
-    float fog  = 1.0 - exp(-uFogDensity * dist);
-    fog = clamp(fog, 0.0, 1.0);
+    color += clusteredLighting(v_worldPos, N, V, u_mat.kd, u_mat.ks, u_mat.shininess);
 
-    color = mix(color, uFogColor, fog);
+    color = applyAerialPerspective(color, aerialPerspective(v_worldPos));
 
     fragColor = vec4(color, 1.0);
 }
@@ -3,19 +3,28 @@
 layout(location = 0) in vec3 a_pos;
 layout(location = 1) in vec3 a_nor;
 
-uniform mat4 uModel;
+// transforms of the batch being drawn, one per instance (Realtime::rebuildSceneBatches)
+const int MAX_INSTANCES = 128;
+struct Instance {
+    mat4 model;
+    mat4 normalMat; // mat3 in the upper left, std140 pads the columns anyway
+};
+layout(std140) uniform SceneInstances {
+    Instance uInstances[MAX_INSTANCES];
+};
+
 uniform mat4 uView;
 uniform mat4 uProj;
-uniform mat3 uNormalMat;
 
 out vec3 v_worldPos;
 out vec3 v_worldNormal;
 
 void main()
 {
-    vec4 world = uModel * vec4(a_pos, 1.0);
+    Instance inst = uInstances[gl_InstanceID];
+    vec4 world = inst.model * vec4(a_pos, 1.0);
     v_worldPos    = world.xyz;
-    v_worldNormal = normalize(uNormalMat * a_nor);
+    v_worldNormal = normalize(mat3(inst.normalMat) * a_nor);
 
     gl_Position = uProj * uView * world;
 }
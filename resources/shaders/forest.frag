@@ -1,5 +1,8 @@
 #version 330 core
 
+#include "aerial_perspective.glsl"
+#include "clustered_lights.glsl"
+
 in vec3 v_worldPos;
 in vec3 v_worldNormal;
 
@@ -12,9 +15,6 @@ uniform vec3 uSunDir;       // FROM light TO scene
 uniform vec3 uSunColor;
 uniform vec3 uAmbientColor;
 
-uniform vec3  uFogColor;
-uniform float uFogDensity;
-
 struct Material {
     vec3 ka;
     vec3 kd;
@@ -57,6 +57,7 @@ void main()
     vec3 specular = u_mat.ks * spec    * uSunColor;
 
     vec3 color = ambient + diffuse + specular;
+    color += clusteredLighting(v_worldPos, N, V, albedo, u_mat.ks, u_mat.shininess);
 
     // color jitter: All forest (dry + leaves) have slight color variations
     float hash = fract(sin(dot(v_worldPos.xy, vec2(12.9898,78.233))) * 43758.5453);
@@ -69,12 +70,7 @@ void main()
 
     color *= tint;
 
-    // simple distance fog: using world-space distance
-    float dist = length(uEye - v_worldPos);
-    float fog  = 1.0 - exp(-uFogDensity * dist);
-    fog = clamp(fog, 0.0, 1.0);
-
-    color = mix(color, uFogColor, fog);
+    color = applyAerialPerspective(color, aerialPerspective(v_worldPos));
 
     fragColor = vec4(color, 1.0);
 }
@@ -6,6 +6,7 @@ out vec4 fragColor;
 
 uniform sampler2D uSceneColor;
 uniform sampler2D uSceneDepth;
+uniform vec2 uUVScale; // pooled targets can be larger than the viewport
 
 uniform mat4 uInvViewProj;
 uniform vec3 uCameraPos;
@@ -16,14 +17,17 @@ uniform vec3  uFogColor;
 uniform float uFogDensity;
 uniform float uFogHeightFalloff;
 
+// Baked grade LUT (exposure, lift/gamma/gain, preset grade, tint, style LUT)
 uniform sampler3D uColorLUT;
 uniform bool      uEnableColorGrading;
+uniform float     uLUTSize;
 
 // Depth of Field uniforms
 uniform float uNear;
 uniform float uFar;
 uniform float uFocusDistance;
 uniform float uBlurStrength;
+uniform int   uDoFMaxSamples = 16; // lowered by the quality governor
 
 vec3 reconstructWorldPos(float depth01, vec2 texCoord) {
     // Convert texture coordinates and depth to NDC space
@@ -77,14 +81,14 @@ vec3 dofBlur(vec2 uv, float coc, vec2 texelSize) {
     float weightSum = 0.0;
     
     // Sample count based on CoC size
-    int sampleCount = int(clamp(coc * 16.0, 4.0, 16.0));
+    int sampleCount = int(clamp(coc * 16.0, 4.0, float(uDoFMaxSamples)));
     
     for (int i = 0; i < 16; i++) {
         if (i >= sampleCount) break;
         
         // Calculate sample offset based on CoC
         vec2 offset = poissonDisk[i] * coc * texelSize;
-        vec2 sampleUV = uv + offset;
+        vec2 sampleUV = clamp(uv + offset, vec2(0.0), uUVScale - 0.5 * texelSize);
         
         // Sample color
         vec3 sampleColor = texture(uSceneColor, sampleUV).rgb;
@@ -131,8 +135,9 @@ float calculateAltitudeFog(vec3 worldPos) {
 
 void main()
 {
-    vec3 sceneColor = texture(uSceneColor, v_uv).rgb;
-    float depth = texture(uSceneDepth, v_uv).r;
+    vec2 uv = v_uv * uUVScale; // texture space; v_uv stays screen space
+    vec3 sceneColor = texture(uSceneColor, uv).rgb;
+    float depth = texture(uSceneDepth, uv).r;
     
     if (uEnableFog && depth < 1.0) {
         vec3 worldPos = reconstructWorldPos(depth, v_uv);
@@ -143,10 +148,6 @@ void main()
         }
     }
 
-    if (uEnableColorGrading) {
-        sceneColor = texture(uColorLUT, sceneColor).rgb;
-    }
-    
     // Depth of Field processing
     if (depth < 1.0) {
         // Linearize depth
@@ -160,7 +161,7 @@ void main()
         
         // Apply blur if CoC is significant
         if (coc > 0.001) {
-            vec3 blurredColor = dofBlur(v_uv, coc, texelSize);
+            vec3 blurredColor = dofBlur(uv, coc, texelSize);
             
             // Mix original and blurred based on CoC
             // Normalize CoC to [0, 1] range for mixing
@@ -169,5 +170,11 @@ void main()
         }
     }
     
+    // Single lookup for the whole grade chain; remap to texel centres
+    if (uEnableColorGrading) {
+        vec3 uvw = clamp(sceneColor, 0.0, 1.0) * ((uLUTSize - 1.0) / uLUTSize) + 0.5 / uLUTSize;
+        sceneColor = texture(uColorLUT, uvw).rgb;
+    }
+
     fragColor = vec4(sceneColor, 1.0);
 }
@@ -1,13 +1,41 @@
 #version 330 core
 
+#include "atmosphere.glsl"
+
 in vec3 v_dir;
 out vec4 fragColor;
 
-uniform samplerCube uSkybox;
-
+uniform sampler2D uSkyViewLut;
+uniform float uViewHeight;  // km from the planet centre the LUT was made for
+uniform float uSunDiskCos;  // cos of the sun's angular radius
+uniform float uSunDiskLuminance; // relative to uSunIlluminance
 
 void main()
 {
-   
-    fragColor = texture(uSkybox, v_dir);
+    vec3 dir = normalize(v_dir);
+    vec3 pos = vec3(0.0, uViewHeight, 0.0);
+    float viewZenithCos = dir.y;
+
+    // the view's azimuth relative to the sun's
+    vec3 side = cross(vec3(0.0, 1.0, 0.0), dir);
+    side = dot(side, side) > 1e-8 ? normalize(side) : vec3(1.0, 0.0, 0.0);
+    vec3 forward = normalize(cross(side, vec3(0.0, 1.0, 0.0)));
+    vec2 sunOnPlane = vec2(dot(uSunDirection, forward), dot(uSunDirection, side));
+    float lightViewCos = dot(sunOnPlane, sunOnPlane) > 1e-8 ? normalize(sunOnPlane).x : 1.0;
+
+    bool intersectGround = raySphereIntersectNearest(pos, dir, uBottomRadius) >= 0.0;
+    vec2 uv = skyViewParamsToUv(vec2(textureSize(uSkyViewLut, 0)), intersectGround, viewZenithCos, lightViewCos,
+                                uViewHeight);
+    vec3 color = texture(uSkyViewLut, uv).rgb;
+
+    // sun disk, dimmed by the air in front of it, soft at the limb
+    if (!intersectGround)
+    {
+        float cosSun = dot(dir, uSunDirection);
+        float disk = smoothstep(uSunDiskCos - (1.0 - uSunDiskCos) * 0.5, uSunDiskCos, cosSun);
+        if (disk > 0.0)
+            color += disk * uSunDiskLuminance * uSunIlluminance * transmittanceToTop(uViewHeight, viewZenithCos);
+    }
+
+    fragColor = vec4(color, 1.0);
 }
@@ -1,8 +1,12 @@
 #version 330 core
 
+#include "aerial_perspective.glsl"
+#include "clustered_lights.glsl"
+
 in vec3 v_worldPos;
 in vec3 v_worldNormal;
 in vec2 v_uv;
+in vec4 v_aerial;
 
 out vec4 fragColor;
 
@@ -38,10 +42,7 @@ uniform sampler2D uRockHighRough;
 uniform sampler2D uBeachRough;
 uniform sampler2D uSnowRough;
 
-// Fog
-uniform vec3  uFogColor;
-uniform float uFogDensity;
-
+// Aerial perspective (v_aerial) on or off
 uniform bool uEnableFog;
 
 // Height normalization
@@ -315,26 +316,9 @@ void main()
     vec3 ambient  = albedo * uAmbientColor;
 
     vec3 color = ambient + diffuse + specular;
+    color += clusteredLighting(v_worldPos, N, V, albedo, vec3(specAmount), specPower);
 
-    float finalFog = 0.0;
-
-    if (uEnableFog) {
-        // distance Fog
-        float dist = length(uEye - v_worldPos);
-        float fogDist = 1.0 - exp(-uFogDensity * 0.5* dist);
-
-        // altitude Fog
-        float fogBottom = -40.0;
-        float fogTop = 20.0;
-        float fogHeight = 1.0 - smoothstep(fogBottom, fogTop, v_worldPos.y);
-
-        fogHeight = fogHeight * 0.4;
-
-        finalFog = clamp(max(fogDist, fogHeight), 0.0, 1.0);
-    }
-
-    vec3 safeFogColor = (length(uFogColor) < 0.001) ? vec3(0.5, 0.6, 0.7) : uFogColor;
-    vec3 finalColor = mix(color, safeFogColor, finalFog);
+    vec3 finalColor = uEnableFog ? applyAerialPerspective(color, v_aerial) : color;
 
     fragColor = vec4(finalColor, 1.0);
 }
@@ -22,6 +22,8 @@
 
 #version 330 core
 
+#include "aerial_perspective.glsl"
+
 layout(location=0) in vec3 vertex;
 layout(location=1) in vec3 normal;
 layout(location=2) in vec3 inTex;   // 现在这就是 (u,v,0)
@@ -29,6 +31,7 @@ layout(location=2) in vec3 inTex;   // 现在这就是 (u,v,0)
 out vec3 v_worldPos;
 out vec3 v_worldNormal;
 out vec2 v_uv;
+out vec4 v_aerial; // per vertex: the fragment stage has no texture unit left for it
 
 uniform mat4 uProj;
 uniform mat4 uView;
@@ -47,5 +50,7 @@ void main()
     // 把 attribute2 的 xy 当成 UV
     v_uv = inTex.xy;
 
+    v_aerial = aerialPerspective(world.xyz);
+
     gl_Position = uProj * uView * world;
 }
@@ -1,5 +1,7 @@
 #version 330 core
 
+#include "aerial_perspective.glsl"
+
 in vec3 ws_pos;
 in vec3 ws_norm;
 in vec2 uv;
@@ -12,10 +14,14 @@ uniform sampler2D u_refractionTexture;
 uniform sampler2D u_depthTexture;
 uniform sampler2D u_normalMap;
 uniform sampler2D u_dudvMap;
+uniform vec2 u_reflectionUVScale; // pooled targets can be larger than the viewport
+uniform vec2 u_refractionUVScale;
+
+// view-space depth reconstruction (refraction uses an oblique projection)
+uniform mat4 u_invProj;
+uniform mat4 u_refractionInvProj;
 
 uniform vec3 ws_cam_pos;
-uniform vec3 uFogColor;
-uniform float uFogDensity;
 uniform bool uEnableFog;
 uniform float u_timeFactor;
 
@@ -27,6 +33,12 @@ uniform float u_waveSpeed;
 
 
 
+// distance along the view axis for a screen uv in [0,1] and a depth-buffer value
+float viewDepth(mat4 invProj, vec2 uv01, float depth01) {
+    vec4 p = invProj * vec4(uv01 * 2.0 - 1.0, depth01 * 2.0 - 1.0, 1.0);
+    return -p.z / p.w;
+}
+
 // Fresnel
 float calculateFresnel(vec3 viewDir, vec3 normal) {
     float fresnel = dot(viewDir, normal);
@@ -48,8 +60,12 @@ void main() {
     vec2 refractTexCoords = ndc + distortion;
     vec2 reflectTexCoords = vec2(1.0 - ndc.x, ndc.y) + distortion;
 
-    refractTexCoords = clamp(refractTexCoords, 0.001, 0.999);
-    reflectTexCoords = clamp(reflectTexCoords, 0.001, 0.999);
+    // into the live part of the pooled targets, half a texel inside it so
+    // bilinear filtering never reaches the stale padding beyond
+    vec2 refractHalfTexel = 0.5 / vec2(textureSize(u_refractionTexture, 0));
+    vec2 reflectHalfTexel = 0.5 / vec2(textureSize(u_reflectionTexture, 0));
+    refractTexCoords = clamp(refractTexCoords * u_refractionUVScale, refractHalfTexel, u_refractionUVScale - refractHalfTexel);
+    reflectTexCoords = clamp(reflectTexCoords * u_reflectionUVScale, reflectHalfTexel, u_reflectionUVScale - reflectHalfTexel);
 
     vec3 reflectionColor = texture(u_reflectionTexture, reflectTexCoords).rgb;
     vec3 refractionColor = texture(u_refractionTexture, refractTexCoords).rgb;
@@ -66,10 +82,8 @@ void main() {
     float floorDepth = texture(u_depthTexture, refractTexCoords).r;
     float waterDepthVal = gl_FragCoord.z;
 
-    float near = 0.1;
-    float far = 100.0;
-    float floorDist = 2.0 * near * far / (far + near - (2.0 * floorDepth - 1.0) * (far - near));
-    float waterDist = 2.0 * near * far / (far + near - (2.0 * waterDepthVal - 1.0) * (far - near));
+    float floorDist = viewDepth(u_refractionInvProj, refractTexCoords / u_refractionUVScale, floorDepth);
+    float waterDist = viewDepth(u_invProj, ndc, waterDepthVal);
     float waterDepth = floorDist - waterDist;
     float depthFactor = clamp(waterDepth * u_waterClarity, 0.0, 1.0);
 
@@ -78,12 +92,8 @@ void main() {
     waterColor = mix(waterColor, waterBase, depthFactor * 0.5);
 
     // Apply fog
-    if (uEnableFog) {
-        float dist = length(ws_cam_pos - ws_pos);
-        float fog = 1.0 - exp(-uFogDensity * dist);
-        vec3 fogColor = length(uFogColor) < 0.001 ? vec3(0.6, 0.7, 0.8) : uFogColor;
-        waterColor = mix(waterColor, fogColor, clamp(fog, 0.0, 1.0));
-    }
+    if (uEnableFog)
+        waterColor = applyAerialPerspective(waterColor, aerialPerspective(ws_pos));
 
     fragColor = vec4(waterColor, 1.0);
 }
@@ -1,4 +1,5 @@
 #include "camera.h"
+#include "utils/tile_layout.h"
 #include <glm/gtc/constants.hpp>
 #include <algorithm>   // <-- needed for std::max
 #include <cmath>
@@ -57,9 +58,35 @@ glm::mat4 Camera::proj() const {
     glm::mat4 S   = makeScaleSxyz(fovyRad, aspect);
     glm::mat4 Mpp = makeUnhinge(n, f);
     glm::mat4 L   = makeOpenGLZFix();
-    return L * Mpp * S;
+    if (window == glm::vec4(-1.f, -1.f, 1.f, 1.f))
+        return L * Mpp * S;
+    return windowMatrix(window) * L * Mpp * S;
 }
 
+glm::mat4 Camera::obliqueProj(const glm::mat4& view, const glm::vec4& planeWorld) const {
+    glm::mat4 P = proj();
+
+    // plane into view space (planes transform by the inverse transpose)
+    glm::vec4 C = glm::transpose(glm::inverse(view)) * planeWorld;
+    if (C.w >= -EPS) return P; // eye on (or too close to) the kept side
+
+    // proj() is the usual GL matrix scaled by 1/far; rescale so that w = -z
+    P /= -P[2][3];
+
+    auto sgn = [](float a) { return (a > 0.f) ? 1.f : ((a < 0.f) ? -1.f : 0.f); };
+    glm::vec4 q((sgn(C.x) + P[2][0]) / P[0][0],
+                (sgn(C.y) + P[2][1]) / P[1][1],
+                -1.f,
+                (1.f + P[2][2]) / P[3][2]);
+    glm::vec4 c = C * (2.f / glm::dot(C, q));
+
+    // replace the third row
+    P[0][2] = c.x;
+    P[1][2] = c.y;
+    P[2][2] = c.z + 1.f;
+    P[3][2] = c.w;
+    return P;
+}
 
 // Axis-angle rotation (Rodrigues)
 glm::mat3 Camera::makeAxisAngleMat3(const glm::vec3& axis, float radians) {
@@ -13,12 +13,23 @@ public:
     float nearP   = 0.1f;               // near plane (> 0)
     float farP    = 100.f;              // far  plane (> near)
 
+    // Part of the view that proj() maps onto the viewport, as an NDC rectangle
+    // (left, bottom, right, top); smaller than [-1, 1]^2 for one tile of a
+    // tiled render (see utils/tile_layout.h)
+    glm::vec4 window {-1.f, -1.f, 1.f, 1.f};
+
     // Build view (lookAt) matrix
     glm::mat4 view() const;
 
     // Build OpenGL-style perspective matrix (z_NDC in [-1, 1])
     glm::mat4 proj() const;
 
+    // proj() with its near plane replaced by a world-space plane (Lengyel's oblique
+    // frustum), so everything on the plane's negative side is clipped by the
+    // rasterizer. 'view' is the view matrix the projection will be used with.
+    // Falls back to proj() when the eye is not on the negative side of the plane.
+    glm::mat4 obliqueProj(const glm::mat4& view, const glm::vec4& planeWorld) const;
+
     // Camera motion helpers
     void translateWorld(const glm::vec3& d);  // translate in world space
     void yaw(float radians);                  // rotate around world +Y (heading)
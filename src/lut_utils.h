@@ -3,8 +3,14 @@
 #include <GL/glew.h>
 #include <vector>
 #include <string>
+#include <fstream>
+#include <sstream>
+#include <cmath>
+#include <iostream>
 #include <glm/glm.hpp>
 
+#include "utils/gl_state.h"
+
 namespace LUTUtils {
 
 /**
@@ -113,7 +119,7 @@ inline std::vector<float> generateStyledLUT(int size, int preset = 0) {
 inline GLuint createLUT3DTexture(int size, const std::vector<float>& data) {
     GLuint texture;
     glGenTextures(1, &texture);
-    glBindTexture(GL_TEXTURE_3D, texture);
+    glState.bindTexture(GL_TEXTURE_3D, texture);
     
     // Set texture parameters
     glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
@@ -127,25 +133,192 @@ inline GLuint createLUT3DTexture(int size, const std::vector<float>& data) {
                  size, size, size,
                  0, GL_RGB, GL_FLOAT, data.data());
     
-    glBindTexture(GL_TEXTURE_3D, 0);
+    glState.bindTexture(GL_TEXTURE_3D, 0);
     
     return texture;
 }
 
 /**
- * @brief Load a .cube LUT file (Adobe .cube format)
- * This is a simplified loader for basic .cube files
+ * @brief Load a .cube LUT file (Adobe / Resolve .cube format)
+ * Supports LUT_3D_SIZE, DOMAIN_MIN / DOMAIN_MAX, TITLE and '#' comments.
+ * Entries are stored red-fastest, which matches the layout used above.
+ * Values are remapped from [DOMAIN_MIN, DOMAIN_MAX] to [0, 1].
  * @param filename Path to the .cube file
  * @param outSize Output size of the LUT
  * @param outData Output data vector
- * @return true if successful
+ * @return true if successful (outSize / outData are untouched on failure)
  */
 inline bool loadCubeLUT(const std::string& filename, int& outSize, std::vector<float>& outData) {
-    // This is a placeholder - you would implement full .cube file parsing here
-    // For now, return an identity LUT
-    outSize = 32;
-    outData = generateIdentityLUT(outSize);
+    std::ifstream in(filename);
+    if (!in.is_open()) {
+        return false;
+    }
+
+    int size = 0;
+    glm::vec3 domainMin(0.0f);
+    glm::vec3 domainMax(1.0f);
+    std::vector<float> data;
+
+    std::string line;
+    while (std::getline(in, line)) {
+        // strip comments and surrounding whitespace
+        std::size_t hash = line.find('#');
+        if (hash != std::string::npos) line.erase(hash);
+        std::istringstream ls(line);
+        std::string head;
+        if (!(ls >> head)) continue;
+
+        if (head == "TITLE") {
+            continue;
+        } else if (head == "LUT_3D_SIZE") {
+            ls >> size;
+            if (size < 2 || size > 256) return false;
+            data.reserve(size * size * size * 3);
+        } else if (head == "LUT_1D_SIZE") {
+            return false; // 1D shapers are not supported
+        } else if (head == "DOMAIN_MIN") {
+            ls >> domainMin.r >> domainMin.g >> domainMin.b;
+        } else if (head == "DOMAIN_MAX") {
+            ls >> domainMax.r >> domainMax.g >> domainMax.b;
+        } else {
+            // data row: three floats
+            glm::vec3 v;
+            std::istringstream row(line);
+            if (!(row >> v.r >> v.g >> v.b)) continue; // unknown keyword
+            glm::vec3 range = glm::max(domainMax - domainMin, glm::vec3(1e-6f));
+            v = (v - domainMin) / range;
+            data.push_back(v.r);
+            data.push_back(v.g);
+            data.push_back(v.b);
+        }
+    }
+
+    if (size < 2 || data.size() != static_cast<std::size_t>(size * size * size * 3)) {
+        return false;
+    }
+
+    outSize = size;
+    outData = std::move(data);
     return true;
 }
 
+/**
+ * @brief Trilinear lookup into a CPU-side LUT (same layout as the texture)
+ * @param data RGB float data (size^3 * 3 floats)
+ * @param size Size of the LUT cube
+ * @param c Input color, clamped to [0, 1]
+ */
+inline glm::vec3 sampleLUT(const std::vector<float>& data, int size, glm::vec3 c) {
+    c = glm::clamp(c, 0.0f, 1.0f) * static_cast<float>(size - 1);
+    glm::ivec3 i0 = glm::min(glm::ivec3(c), glm::ivec3(size - 2));
+    glm::vec3 f = c - glm::vec3(i0);
+
+    auto at = [&](int r, int g, int b) {
+        std::size_t idx = (static_cast<std::size_t>(b) * size * size +
+                           static_cast<std::size_t>(g) * size + r) * 3;
+        return glm::vec3(data[idx], data[idx + 1], data[idx + 2]);
+    };
+
+    glm::vec3 c00 = glm::mix(at(i0.x, i0.y,     i0.z),     at(i0.x + 1, i0.y,     i0.z),     f.x);
+    glm::vec3 c10 = glm::mix(at(i0.x, i0.y + 1, i0.z),     at(i0.x + 1, i0.y + 1, i0.z),     f.x);
+    glm::vec3 c01 = glm::mix(at(i0.x, i0.y,     i0.z + 1), at(i0.x + 1, i0.y,     i0.z + 1), f.x);
+    glm::vec3 c11 = glm::mix(at(i0.x, i0.y + 1, i0.z + 1), at(i0.x + 1, i0.y + 1, i0.z + 1), f.x);
+    return glm::mix(glm::mix(c00, c10, f.y), glm::mix(c01, c11, f.y), f.z);
+}
+
+/**
+ * @brief Full color grading chain that gets baked into one 3D LUT.
+ * Applied in order: exposure -> lift/gamma/gain -> tint -> style/.cube LUT.
+ */
+struct GradeParams {
+    float exposure = 0.0f;          // in stops
+    glm::vec3 lift{0.0f};
+    glm::vec3 gamma{1.0f};
+    glm::vec3 gain{1.0f};
+    glm::vec3 tint{1.0f};
+    int stylePreset = 0;            // generateStyledLUT preset, 0 = identity
+    std::string cubeFile;           // optional .cube file, overrides stylePreset when it loads
+
+    bool isIdentity() const {
+        return exposure == 0.0f && lift == glm::vec3(0.0f) && gamma == glm::vec3(1.0f) &&
+               gain == glm::vec3(1.0f) && tint == glm::vec3(1.0f) && stylePreset == 0 && cubeFile.empty();
+    }
+
+    bool operator==(const GradeParams& o) const {
+        return exposure == o.exposure && lift == o.lift && gamma == o.gamma && gain == o.gain &&
+               tint == o.tint && stylePreset == o.stylePreset && cubeFile == o.cubeFile;
+    }
+    bool operator!=(const GradeParams& o) const { return !(*this == o); }
+};
+
+/**
+ * @brief Evaluate the grade chain for a single color
+ * @param styleData Optional style LUT (empty = identity)
+ */
+inline glm::vec3 evaluateGrade(glm::vec3 color, const GradeParams& p,
+                               const std::vector<float>& styleData, int styleSize) {
+    color *= std::exp2(p.exposure);
+
+    // ASC-CDL style lift/gamma/gain
+    color = color * (p.gain - p.lift) + p.lift;
+    color = glm::pow(glm::max(color, glm::vec3(0.0f)), 1.0f / glm::max(p.gamma, glm::vec3(1e-3f)));
+
+    color *= p.tint;
+    color = glm::clamp(color, 0.0f, 1.0f);
+
+    if (!styleData.empty()) {
+        color = sampleLUT(styleData, styleSize, color);
+    }
+    return glm::clamp(color, 0.0f, 1.0f);
+}
+
+/**
+ * @brief Bake the whole grade chain into a size^3 LUT (CPU only, safe to call off the GL thread)
+ * @param size Size of the LUT cube (32 or 64)
+ * @param p Grade parameters
+ * @return Vector of RGB float data, same layout as generateIdentityLUT
+ */
+inline std::vector<float> bakeGradeLUT(int size, const GradeParams& p) {
+    std::vector<float> styleData;
+    int styleSize = 0;
+    if (!p.cubeFile.empty()) {
+        if (!loadCubeLUT(p.cubeFile, styleSize, styleData)) {
+            std::cerr << "[LUT] failed to load .cube file: " << p.cubeFile << std::endl;
+            styleData.clear();
+            styleSize = 0;
+        }
+    }
+    if (styleData.empty() && p.stylePreset != 0) {
+        styleSize = size;
+        styleData = generateStyledLUT(styleSize, p.stylePreset);
+    }
+
+    std::vector<float> data;
+    data.reserve(size * size * size * 3);
+    float inv = 1.0f / static_cast<float>(size - 1);
+
+    for (int b = 0; b < size; ++b) {
+        for (int g = 0; g < size; ++g) {
+            for (int r = 0; r < size; ++r) {
+                glm::vec3 c = evaluateGrade(glm::vec3(r, g, b) * inv, p, styleData, styleSize);
+                data.push_back(c.r);
+                data.push_back(c.g);
+                data.push_back(c.b);
+            }
+        }
+    }
+    return data;
+}
+
+/**
+ * @brief Re-upload LUT contents into an existing texture of the same size
+ */
+inline void updateLUT3DTexture(GLuint texture, int size, const std::vector<float>& data) {
+    glState.bindTexture(GL_TEXTURE_3D, texture);
+    glTexSubImage3D(GL_TEXTURE_3D, 0, 0, 0, 0,
+                    size, size, size,
+                    GL_RGB, GL_FLOAT, data.data());
+    glState.bindTexture(GL_TEXTURE_3D, 0);
+}
+
 } // namespace LUTUtils
@@ -4,8 +4,78 @@
 #include <QScreen>
 #include <iostream>
 #include <QSettings>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <cmath>
+
+#include "render_farm.h"
+#include "settings.h"
 
 int main(int argc, char *argv[]) {
+    // optional scene file drawn on top of the terrain: --scene <file.json>
+    // offline capture of the camera path: --capture <dir> [--capture-fps <n>] [--capture-raw]
+    //   [--capture-range <first>:<end>] [--cache-dir <dir>] [--farm <worker processes>]
+    // tiled still of the start view: --poster <file.ppm> [--poster-size <w>x<h>]
+    int farmWorkers = 0;
+    QStringList workerArgs; // the same arguments, less the coordinator's own
+    for (int i = 1; i < argc; ++i)
+    {
+        const int at = i;
+        if (std::strcmp(argv[i], "--farm") == 0 && i + 1 < argc)
+        {
+            farmWorkers = std::max(1, std::atoi(argv[++i]));
+            continue;
+        }
+        if (std::strcmp(argv[i], "--capture-range") == 0 && i + 1 < argc)
+        {
+            std::sscanf(argv[++i], "%d:%d", &settings.captureFirst, &settings.captureEnd);
+            continue;
+        }
+
+        if (std::strcmp(argv[i], "--scene") == 0 && i + 1 < argc)
+            settings.sceneFilePath = argv[++i];
+        else if (std::strcmp(argv[i], "--capture") == 0 && i + 1 < argc)
+            settings.captureDir = argv[++i];
+        else if (std::strcmp(argv[i], "--capture-fps") == 0 && i + 1 < argc)
+            settings.captureFps = std::max(1, std::atoi(argv[++i]));
+        else if (std::strcmp(argv[i], "--capture-raw") == 0)
+            settings.captureRaw = true;
+        else if (std::strcmp(argv[i], "--cache-dir") == 0 && i + 1 < argc)
+            settings.cacheDir = argv[++i];
+        else if (std::strcmp(argv[i], "--poster") == 0 && i + 1 < argc)
+            settings.posterPath = argv[++i];
+        else if (std::strcmp(argv[i], "--poster-size") == 0 && i + 1 < argc)
+        {
+            int w = 0, h = 0;
+            if (std::sscanf(argv[++i], "%dx%d", &w, &h) == 2 && w > 0 && h > 0)
+            {
+                settings.posterWidth = w;
+                settings.posterHeight = h;
+            }
+        }
+
+        for (int j = at; j <= i; ++j) // option and value, as given
+            workerArgs << QString::fromLocal8Bit(argv[j]);
+    }
+
+    // render farm: this process only hands out frame ranges, no window or GL
+    if (farmWorkers > 0 && !settings.captureDir.empty())
+    {
+        QCoreApplication app(argc, argv);
+        if (settings.cacheDir.empty())
+            workerArgs << "--cache-dir" << QString::fromStdString(settings.captureDir + "/world_cache");
+        const int fps = settings.captureFps;
+        const int first = std::max(0, settings.captureFirst);
+        const int end = settings.captureEnd >= 0 ? settings.captureEnd
+                                                 : int(std::lround(Realtime::CAMERA_PATH_SECONDS * float(fps)));
+        RenderFarm farm(QCoreApplication::applicationFilePath(), workerArgs, settings.captureDir,
+                        settings.captureRaw ? FrameWriter::Format::PPM : FrameWriter::Format::PNG, first, end, fps,
+                        farmWorkers);
+        return farm.run();
+    }
+
     QApplication a(argc, argv);
 
     QCoreApplication::setApplicationName("Project 5: Realtime");
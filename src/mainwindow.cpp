@@ -94,6 +94,22 @@ void MainWindow::initialize()
     QLabel *blurStrength_label = new QLabel();
     blurStrength_label->setText("Blur Strength:");
 
+    // quality governor UI
+    QLabel *quality_label = new QLabel();
+    quality_label->setText("Performance");
+    quality_label->setFont(font);
+
+    autoQualityToggle = new QCheckBox();
+    autoQualityToggle->setText(QStringLiteral("Auto Quality (%1 ms budget)").arg(settings.frameBudgetMs));
+    autoQualityToggle->setChecked(settings.autoQuality);
+
+    qualityStatusLabel = new QLabel();
+    qualityStatusLabel->setWordWrap(true);
+
+    // the governor runs inside paintGL; poll its state instead of signalling from the GL thread
+    qualityStatusTimer = new QTimer(this);
+    qualityStatusTimer->setInterval(500);
+
     // color grading UI
     QLabel *grade_label = new QLabel();
     grade_label->setText("Color Grading");
@@ -500,6 +516,10 @@ void MainWindow::initialize()
     vLayout->addWidget(checkBoxColdBlue);
     vLayout->addWidget(checkBoxRainy);
 
+    vLayout->addWidget(quality_label);
+    vLayout->addWidget(autoQualityToggle);
+    vLayout->addWidget(qualityStatusLabel);
+
     connectUIElements();
 
     // Set default values of 5 for tesselation parameters
@@ -548,6 +568,7 @@ void MainWindow::connectUIElements()
     connectColorGrade();
     connectWaterSettings();
     connectDoFSettings();
+    connectQualitySettings();
 }
 
 // From old Project 6
@@ -693,6 +714,12 @@ void MainWindow::connectDoFSettings() {
             this, &MainWindow::onValChangeBlurStrengthBox);
 }
 
+void MainWindow::connectQualitySettings() {
+    connect(autoQualityToggle, &QCheckBox::clicked, this, &MainWindow::onToggleAutoQuality);
+    connect(qualityStatusTimer, &QTimer::timeout, this, &MainWindow::onQualityStatusTimer);
+    qualityStatusTimer->start();
+}
+
 // From old Project 6
 // void MainWindow::onPerPixelFilter() {
 //     settings.perPixelFilter = !settings.perPixelFilter;
@@ -986,3 +1013,15 @@ void MainWindow::onValChangeBlurStrengthBox(double v)
     settings.blurStrength = blurStrengthBox->value();
     realtime->settingsChanged();
 }
+
+void MainWindow::onToggleAutoQuality()
+{
+    // read by paintGL every frame; no scene rebuild needed
+    settings.autoQuality = autoQualityToggle->isChecked();
+    realtime->update();
+}
+
+void MainWindow::onQualityStatusTimer()
+{
+    qualityStatusLabel->setText(QString::fromStdString(realtime->qualityStatus()));
+}
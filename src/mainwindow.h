@@ -6,6 +6,8 @@
 #include <QSpinBox>
 #include <QDoubleSpinBox>
 #include <QPushButton>
+#include <QLabel>
+#include <QTimer>
 #include "realtime.h"
 #include "utils/aspectratiowidget/aspectratiowidget.hpp"
 
@@ -30,6 +32,7 @@ private:
     void connectFar();
     void connectWaterSettings();
     void connectDoFSettings();
+    void connectQualitySettings();
 
     // From old Project 6
     // void connectPerPixelFilter();
@@ -94,6 +97,11 @@ private:
     QSlider *blurStrengthSlider;
     QDoubleSpinBox *blurStrengthBox;
 
+    // Quality governor
+    QCheckBox *autoQualityToggle;
+    QLabel *qualityStatusLabel;
+    QTimer *qualityStatusTimer;
+
 private slots:
     // From old Project 6
     // void onPerPixelFilter();
@@ -137,4 +145,8 @@ private slots:
     void onValChangeFocusDistBox(double v);
     void onValChangeBlurStrengthSlider(int v);
     void onValChangeBlurStrengthBox(double v);
+
+    // Quality governor slots
+    void onToggleAutoQuality();
+    void onQualityStatusTimer();
 };
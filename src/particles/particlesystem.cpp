@@ -1,38 +1,53 @@
 #include "particlesystem.h"
 #include "utils/shaderloader.h"
-#include <cstdlib> // for rand()
+#include "utils/gl_state.h"
+#include "utils/mem_tracker.h"
+#include "utils/render_stats.h"
+#include <algorithm>
 
 ParticleSystem::ParticleSystem()
 {
 }
 
-ParticleSystem::~ParticleSystem()
-{
-    glDeleteBuffers(1, &m_vbo_pos);
-    glDeleteBuffers(1, &m_vbo_color);
-    glDeleteBuffers(1, &m_vbo_size);
-    glDeleteVertexArrays(1, &m_vao);
-    glDeleteProgram(m_shaderProgram);
-}
+// GL handles release themselves; nothing to do when init() never ran (CPU-only use)
+ParticleSystem::~ParticleSystem() = default;
 
-void ParticleSystem::init()
+void ParticleSystem::initParticles()
 {
-    // 1. Initialize Particles
+    MemTagScope memTag(MemTracker::Particles);
+    m_time = m_prevTime = 0.0f;
     m_particles.resize(m_maxParticles);
     for (auto &p : m_particles)
     {
         respawnParticle(p);
         // Give them random initial life so they don't all die at once
-        p.m_lifeRemaining = static_cast<float>(rand()) / RAND_MAX * p.m_lifeSpan;
+        p.m_lifeRemaining = random01() * p.m_lifeSpan;
     }
+    m_prevPositions.resize(m_particles.size());
+    for (size_t i = 0; i < m_particles.size(); ++i)
+        m_prevPositions[i] = m_particles[i].m_position;
+}
+
+void ParticleSystem::seed(unsigned seed)
+{
+    m_rng.seed(seed);
+}
 
-    // 2. Load Shaders
+float ParticleSystem::random01()
+{
+    return float(m_rng() - m_rng.min()) / float(m_rng.max() - m_rng.min());
+}
+
+void ParticleSystem::init()
+{
+    // 1. Load Shaders
     // Note: You need to ensure these paths are correct relative to your executable or resource loader
-    m_shaderProgram = ShaderLoader::createShaderProgram(":/resources/shaders/particle.vert", ":/resources/shaders/particle.frag");
+    m_shaderProgram = GLProgram::adopt(
+        ShaderLoader::createShaderProgram(":/resources/shaders/particle.vert", ":/resources/shaders/particle.frag"));
 
-    // 3. Setup VAO/VBO
-    glGenVertexArrays(1, &m_vao);
-    glBindVertexArray(m_vao);
+    // 2. Setup VAO/VBO
+    m_vao = GLVertexArray::create();
+    glState.bindVertexArray(m_vao);
 
     // We will use a simple quad for the particle (2 triangles)
     // But to use Instanced Rendering efficiently, we can just generate the geometry in the Geometry Shader
@@ -46,77 +61,76 @@ void ParticleSystem::init()
         -0.5f, 0.5f, 0.0f,
         0.5f, 0.5f, 0.0f};
 
-    GLuint quadVBO;
-    glGenBuffers(1, &quadVBO);
-    glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), quadVertices, GL_STATIC_DRAW);
+    m_vbo_quad = GLBuffer::create();
+    glBindBuffer(GL_ARRAY_BUFFER, m_vbo_quad);
+    statBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), quadVertices, GL_STATIC_DRAW);
 
     glEnableVertexAttribArray(0); // Position (local)
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void *)0);
 
     // Instance Data VBOs
     // Position
-    glGenBuffers(1, &m_vbo_pos);
+    m_vbo_pos = GLBuffer::create();
     glBindBuffer(GL_ARRAY_BUFFER, m_vbo_pos);
-    glBufferData(GL_ARRAY_BUFFER, m_maxParticles * sizeof(glm::vec3), nullptr, GL_STREAM_DRAW);
+    statBufferData(GL_ARRAY_BUFFER, m_maxParticles * sizeof(glm::vec3), nullptr, GL_STREAM_DRAW);
     glEnableVertexAttribArray(1); // World Position
     glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, (void *)0);
     glVertexAttribDivisor(1, 1); // Tell OpenGL this is per-instance
 
     // Color
-    glGenBuffers(1, &m_vbo_color);
+    m_vbo_color = GLBuffer::create();
     glBindBuffer(GL_ARRAY_BUFFER, m_vbo_color);
-    glBufferData(GL_ARRAY_BUFFER, m_maxParticles * sizeof(glm::vec4), nullptr, GL_STREAM_DRAW);
+    statBufferData(GL_ARRAY_BUFFER, m_maxParticles * sizeof(glm::vec4), nullptr, GL_STREAM_DRAW);
     glEnableVertexAttribArray(2); // Color
     glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, 0, (void *)0);
     glVertexAttribDivisor(2, 1);
 
     // Size
-    glGenBuffers(1, &m_vbo_size);
+    m_vbo_size = GLBuffer::create();
     glBindBuffer(GL_ARRAY_BUFFER, m_vbo_size);
-    glBufferData(GL_ARRAY_BUFFER, m_maxParticles * sizeof(float), nullptr, GL_STREAM_DRAW);
+    statBufferData(GL_ARRAY_BUFFER, m_maxParticles * sizeof(float), nullptr, GL_STREAM_DRAW);
     glEnableVertexAttribArray(3); // Size
     glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, 0, (void *)0);
     glVertexAttribDivisor(3, 1);
 
-    glBindVertexArray(0);
+    glState.bindVertexArray(0);
 }
 
 void ParticleSystem::respawnParticle(Particle &p)
 {
     // Random position in a box around the origin (or camera)
     // For now, let's assume a fixed world box: x[-20, 20], y[0, 20], z[-20, 20]
-    float x = (static_cast<float>(rand()) / RAND_MAX * 40.0f) - 20.0f;
-    float y = (static_cast<float>(rand()) / RAND_MAX * 10.0f) + 10.0f; // Start high up
-    float z = (static_cast<float>(rand()) / RAND_MAX * 40.0f) - 20.0f;
+    float x = (random01() * 40.0f) - 20.0f;
+    float y = (random01() * 10.0f) + 10.0f; // Start high up
+    float z = (random01() * 40.0f) - 20.0f;
 
     p.m_position = glm::vec3(x, y, z);
-    p.m_lifeSpan = 20.0f + static_cast<float>(rand()) / RAND_MAX * 10.0f; // Increased to 20-30 seconds to ensure they hit ground
+    p.m_lifeSpan = 20.0f + random01() * 10.0f; // Increased to 20-30 seconds to ensure they hit ground
     p.m_lifeRemaining = p.m_lifeSpan;
     p.m_state = 0; // Reset to Falling
 
     if (m_type == 0)
     { // Snow
         // Wider area for snow
-        float x = (static_cast<float>(rand()) / RAND_MAX * 60.0f) - 30.0f;
-        float z = (static_cast<float>(rand()) / RAND_MAX * 60.0f) - 30.0f;
+        float x = (random01() * 60.0f) - 30.0f;
+        float z = (random01() * 60.0f) - 30.0f;
         p.m_position = glm::vec3(x, 25.0f, z); // Start higher
 
-        p.m_velocity = glm::vec3(0.0f, -1.0f - (static_cast<float>(rand()) / RAND_MAX * 1.0f), 0.0f); // Slower fall
+        p.m_velocity = glm::vec3(0.0f, -1.0f - (random01() * 1.0f), 0.0f); // Slower fall
 
         // Random horizontal drift (wind)
-        float driftX = (static_cast<float>(rand()) / RAND_MAX * 0.5f) - 0.25f;
-        float driftZ = (static_cast<float>(rand()) / RAND_MAX * 0.5f) - 0.25f;
+        float driftX = (random01() * 0.5f) - 0.25f;
+        float driftZ = (random01() * 0.5f) - 0.25f;
         p.m_acceleration = glm::vec3(driftX, 0.0f, driftZ);
 
         p.m_color = glm::vec4(1.0f, 0.98f, 0.98f, 0.9f);                    // Warm White
-        p.m_size = 0.02f + (static_cast<float>(rand()) / RAND_MAX * 0.03f); // Much smaller (approx 1/5)
+        p.m_size = 0.02f + (random01() * 0.03f); // Much smaller (approx 1/5)
         p.m_deltaColor = glm::vec4(0.f, 0.f, 0.f, -0.02f);                  // Fade out very slowly
     }
     else
     { // Rain
         // Reduced speed: -8.0 to -12.0 (was -15 to -20)
-        p.m_velocity = glm::vec3(0.0f, -8.0f - (static_cast<float>(rand()) / RAND_MAX * 4.0f), 0.0f);
+        p.m_velocity = glm::vec3(0.0f, -8.0f - (random01() * 4.0f), 0.0f);
         p.m_acceleration = glm::vec3(0.0f, -5.0f, 0.0f); // Reduced gravity effect
         p.m_color = glm::vec4(0.8f, 0.9f, 1.0f, 0.5f);   // Slightly more transparent
         p.m_size = 0.03f;                                // Much smaller (approx 1/5)
@@ -126,9 +140,12 @@ void ParticleSystem::respawnParticle(Particle &p)
 
 void ParticleSystem::update(float deltaTime)
 {
+    m_prevTime = m_time;
     m_time += deltaTime;
-    for (auto &p : m_particles)
+    for (size_t i = 0; i < m_particles.size(); ++i)
     {
+        Particle &p = m_particles[i];
+        m_prevPositions[i] = p.m_position;
         p.update(deltaTime);
 
         // Rain Splash Logic
@@ -144,9 +161,9 @@ void ParticleSystem::update(float deltaTime)
                     p.m_position.y = 0.0f; // Clamp to ground
 
                     // Bounce up with random spread
-                    float rndX = (static_cast<float>(rand()) / RAND_MAX * 2.0f) - 1.0f;
-                    float rndZ = (static_cast<float>(rand()) / RAND_MAX * 2.0f) - 1.0f;
-                    p.m_velocity = glm::vec3(rndX, 1.0f + static_cast<float>(rand()) / RAND_MAX * 1.0f, rndZ);
+                    float rndX = (random01() * 2.0f) - 1.0f;
+                    float rndZ = (random01() * 2.0f) - 1.0f;
+                    p.m_velocity = glm::vec3(rndX, 1.0f + random01() * 1.0f, rndZ);
 
                     p.m_acceleration = glm::vec3(0.0f, -9.8f, 0.0f); // Normal gravity
                     p.m_lifeRemaining = 0.2f;                        // Short life for splash
@@ -158,6 +175,7 @@ void ParticleSystem::update(float deltaTime)
                 if (p.isDead())
                 {
                     respawnParticle(p);
+                    m_prevPositions[i] = p.m_position; // no streak back to the ground
                 }
             }
         }
@@ -180,62 +198,86 @@ void ParticleSystem::update(float deltaTime)
             if (p.isDead())
             {
                 respawnParticle(p);
+                m_prevPositions[i] = p.m_position;
             }
         }
     }
 }
 
-void ParticleSystem::draw(const glm::mat4 &view, const glm::mat4 &proj)
+void ParticleSystem::snapshot(ParticleFrame &out) const
 {
-    glUseProgram(m_shaderProgram);
+    MemTagScope memTag(MemTracker::Particles);
+    out.type = m_type;
+    out.time = m_time;
+    out.prevTime = m_prevTime;
+    out.positions.resize(m_particles.size());
+    out.colors.resize(m_particles.size());
+    out.sizes.resize(m_particles.size());
+    for (size_t i = 0; i < m_particles.size(); ++i)
+    {
+        const Particle &p = m_particles[i];
+        out.positions[i] = p.m_position;
+        out.colors[i] = p.m_color;
+        out.sizes[i] = p.m_size;
+    }
+    out.prevPositions = m_prevPositions;
+}
 
+void ParticleSystem::draw(const ParticleFrame &frame, float alpha, const glm::mat4 &view, const glm::mat4 &proj)
+{
     // Update GPU buffers
+    MemTagScope memTag(MemTracker::Upload);
     std::vector<glm::vec3> positions;
-    std::vector<glm::vec4> colors;
-    std::vector<float> sizes;
 
-    positions.reserve(m_particles.size());
-    colors.reserve(m_particles.size());
-    sizes.reserve(m_particles.size());
+    size_t drawCount = std::min(static_cast<size_t>(frame.positions.size() * m_drawFraction),
+                                static_cast<size_t>(m_maxParticles));
+    if (drawCount == 0 || frame.prevPositions.size() < drawCount)
+        return;
 
-    for (const auto &p : m_particles)
-    {
-        positions.push_back(p.m_position);
-        colors.push_back(p.m_color);
-        sizes.push_back(p.m_size);
-    }
+    // between the last two simulation steps, where the render time falls
+    positions.resize(drawCount);
+    for (size_t i = 0; i < drawCount; ++i)
+        positions[i] = glm::mix(frame.prevPositions[i], frame.positions[i], alpha);
+
+    glState.useProgram(m_shaderProgram);
 
     glBindBuffer(GL_ARRAY_BUFFER, m_vbo_pos);
-    glBufferSubData(GL_ARRAY_BUFFER, 0, positions.size() * sizeof(glm::vec3), positions.data());
+    statBufferSubData(GL_ARRAY_BUFFER, 0, positions.size() * sizeof(glm::vec3), positions.data());
 
     glBindBuffer(GL_ARRAY_BUFFER, m_vbo_color);
-    glBufferSubData(GL_ARRAY_BUFFER, 0, colors.size() * sizeof(glm::vec4), colors.data());
+    statBufferSubData(GL_ARRAY_BUFFER, 0, drawCount * sizeof(glm::vec4), frame.colors.data());
 
     glBindBuffer(GL_ARRAY_BUFFER, m_vbo_size);
-    glBufferSubData(GL_ARRAY_BUFFER, 0, sizes.size() * sizeof(float), sizes.data());
+    statBufferSubData(GL_ARRAY_BUFFER, 0, drawCount * sizeof(float), frame.sizes.data());
 
     // Set Uniforms
     GLint viewLoc = glGetUniformLocation(m_shaderProgram, "view");
     GLint projLoc = glGetUniformLocation(m_shaderProgram, "proj");
-    glUniformMatrix4fv(viewLoc, 1, GL_FALSE, &view[0][0]);
-    glUniformMatrix4fv(projLoc, 1, GL_FALSE, &proj[0][0]);
+    statUniform(glUniformMatrix4fv, viewLoc, 1, GL_FALSE, &view[0][0]);
+    statUniform(glUniformMatrix4fv, projLoc, 1, GL_FALSE, &proj[0][0]);
 
-    glUniform1i(glGetUniformLocation(m_shaderProgram, "uType"), m_type);
-    glUniform1f(glGetUniformLocation(m_shaderProgram, "uTime"), m_time);
+    statUniform(glUniform1i, glGetUniformLocation(m_shaderProgram, "uType"), frame.type);
+    statUniform(glUniform1f, glGetUniformLocation(m_shaderProgram, "uTime"),
+                glm::mix(frame.prevTime, frame.time, alpha));
 
     // Draw
-    glBindVertexArray(m_vao);
-    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, m_particles.size());
-    glBindVertexArray(0);
-    glUseProgram(0);
+    glState.bindVertexArray(m_vao);
+    renderStats.draw(GL_TRIANGLE_STRIP, 4, static_cast<GLsizei>(drawCount));
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, static_cast<GLsizei>(drawCount));
+}
+
+void ParticleSystem::setDrawFraction(float fraction)
+{
+    m_drawFraction = glm::clamp(fraction, 0.0f, 1.0f);
 }
 
 void ParticleSystem::setType(int type)
 {
     m_type = type;
     // Reset all particles to new type
-    for (auto &p : m_particles)
+    for (size_t i = 0; i < m_particles.size(); ++i)
     {
-        respawnParticle(p);
+        respawnParticle(m_particles[i]);
+        m_prevPositions[i] = m_particles[i].m_position;
     }
 }
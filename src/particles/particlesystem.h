@@ -1,9 +1,23 @@
 #pragma once
 
 #include "particle.h"
+#include <random>
 #include <vector>
 #include <GL/glew.h>
 #include <glm/glm.hpp>
+#include "utils/gl_handle.h"
+
+// What draw() needs of the particles, copied out after a simulation step
+// (the simulation thread owns the particles themselves)
+struct ParticleFrame
+{
+    int type = 0;
+    float time = 0.f, prevTime = 0.f;
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> prevPositions; // one step earlier; equal to positions for a respawned particle
+    std::vector<glm::vec4> colors;
+    std::vector<float> sizes;
+};
 
 class ParticleSystem
 {
@@ -11,31 +25,49 @@ public:
     ParticleSystem();
     ~ParticleSystem();
 
-    // Initialize OpenGL resources
+    // Initialize OpenGL resources; the particles themselves come from initParticles()
     void init();
 
+    // CPU-side particle state only; no GL context needed (benchmarks, the simulation thread)
+    void initParticles();
+
+    // Random stream for spawning; the same seed and steps give the same particles
+    void seed(unsigned seed);
+
     // Update all particles
     void update(float deltaTime);
 
-    // Render all particles
-    void draw(const glm::mat4 &view, const glm::mat4 &proj);
+    // Copy the current state out for drawing
+    void snapshot(ParticleFrame &out) const;
+
+    // Render a snapshot, positions interpolated alpha of the way from the previous step
+    void draw(const ParticleFrame &frame, float alpha, const glm::mat4 &view, const glm::mat4 &proj);
 
     // Reset/Re-emit particles (e.g. for snow/rain)
     void setType(int type); // 0 = Snow, 1 = Rain
 
+    // Draw only the first fraction of the particles (quality scaling); all keep simulating
+    void setDrawFraction(float fraction);
+
 private:
     std::vector<Particle> m_particles;
+    std::vector<glm::vec3> m_prevPositions; // before the last update()
     int m_maxParticles = 10000; // Increased for better density
     int m_type = 0;             // 0: Snow, 1: Rain
     float m_time = 0.0f;
+    float m_prevTime = 0.0f;
+    std::mt19937 m_rng{1337};
+    float m_drawFraction = 1.0f;
 
-    // OpenGL handles
-    GLuint m_vao;
-    GLuint m_vbo_pos;   // Instance positions
-    GLuint m_vbo_color; // Instance colors
-    GLuint m_vbo_size;  // Instance sizes
-    GLuint m_shaderProgram;
+    // OpenGL handles (empty until init())
+    GLVertexArray m_vao;
+    GLBuffer m_vbo_quad;  // Shared quad corners
+    GLBuffer m_vbo_pos;   // Instance positions
+    GLBuffer m_vbo_color; // Instance colors
+    GLBuffer m_vbo_size;  // Instance sizes
+    GLProgram m_shaderProgram;
 
     // Helper to respawn a particle when it dies
     void respawnParticle(Particle &p);
+    float random01(); // uniform in [0, 1]
 };
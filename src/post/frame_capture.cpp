@@ -0,0 +1,251 @@
+#include "frame_capture.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+#include <QImage>
+
+#include "utils/render_stats.h"
+#include "utils/trace.h"
+
+FrameWriter::FrameWriter(std::string dir, Format format, int threads, int maxQueued)
+    : m_dir(std::move(dir)), m_format(format), m_maxQueued(std::size_t(std::max(1, maxQueued)))
+{
+    for (int i = 0; i < std::max(1, threads); ++i)
+        m_workers.emplace_back(&FrameWriter::workerLoop, this);
+}
+
+FrameWriter::~FrameWriter()
+{
+    finish();
+}
+
+void FrameWriter::submit(Frame &&frame)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_hasRoom.wait(lock, [this] { return m_queue.size() < m_maxQueued; });
+    m_queue.push_back(std::move(frame));
+    lock.unlock();
+    m_hasWork.notify_one();
+}
+
+void FrameWriter::finish()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_quit = true;
+    }
+    m_hasWork.notify_all();
+    for (std::thread &t : m_workers)
+        if (t.joinable())
+            t.join();
+    m_workers.clear();
+}
+
+int FrameWriter::written() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_written;
+}
+
+int FrameWriter::failed() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_failed;
+}
+
+void FrameWriter::workerLoop()
+{
+    for (;;)
+    {
+        Frame frame;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_hasWork.wait(lock, [this] { return m_quit || !m_queue.empty(); });
+            if (m_queue.empty())
+                return; // quitting, and everything is written
+            frame = std::move(m_queue.front());
+            m_queue.pop_front();
+        }
+        m_hasRoom.notify_one();
+
+        bool ok = write(frame);
+        std::lock_guard<std::mutex> lock(m_mutex);
+        ++(ok ? m_written : m_failed);
+    }
+}
+
+std::string FrameWriter::fileName(int index, Format format)
+{
+    char name[32];
+    std::snprintf(name, sizeof(name), "frame_%05d.%s", index, format == Format::PNG ? "png" : "ppm");
+    return name;
+}
+
+bool FrameWriter::write(const Frame &frame) const
+{
+    TRACE_SCOPE("capture encode");
+    const std::filesystem::path path = std::filesystem::path(m_dir) / fileName(frame.index, m_format);
+    std::filesystem::path tmp = path;
+    tmp += ".tmp";
+
+    bool ok;
+    if (m_format == Format::PNG)
+    {
+        QImage image(frame.rgba.data(), frame.width, frame.height, frame.width * 4, QImage::Format_RGBA8888);
+        // the default framebuffer's alpha is not meant to be seen
+        QImage rgb = image.flipped(Qt::Vertical).convertToFormat(QImage::Format_RGB888);
+        ok = rgb.save(QString::fromStdString(tmp.string()), "PNG");
+    }
+    else
+    {
+        std::ofstream out(tmp, std::ios::binary);
+        out << "P6\n" << frame.width << " " << frame.height << "\n255\n";
+        std::vector<unsigned char> row(std::size_t(frame.width) * 3);
+        for (int y = frame.height - 1; y >= 0; --y)
+        {
+            const unsigned char *src = frame.rgba.data() + std::size_t(y) * frame.width * 4;
+            for (int x = 0; x < frame.width; ++x)
+                std::memcpy(&row[std::size_t(x) * 3], src + std::size_t(x) * 4, 3);
+            out.write(reinterpret_cast<const char *>(row.data()), std::streamsize(row.size()));
+        }
+        ok = bool(out.flush());
+    }
+
+    std::error_code ec;
+    if (ok)
+        std::filesystem::rename(tmp, path, ec);
+    if (!ok || ec)
+    {
+        std::filesystem::remove(tmp, ec);
+        return false;
+    }
+    return true;
+}
+
+FrameCapture::~FrameCapture()
+{
+    stop();
+}
+
+bool FrameCapture::start(const std::string &dir, FrameWriter::Format format, int firstFrame)
+{
+    stop();
+    std::error_code ec;
+    std::filesystem::create_directories(dir, ec);
+    if (ec)
+    {
+        std::cerr << "[capture] cannot create " << dir << ": " << ec.message() << std::endl;
+        return false;
+    }
+
+    // leave a core to the render thread; PNG encoding is the slow part
+    int threads = std::clamp(int(std::thread::hardware_concurrency()) - 1, 1, 4);
+    m_writer = std::make_unique<FrameWriter>(dir, format, threads, 2 * threads + RING_SIZE);
+    m_dir = dir;
+    m_frame = firstFrame;
+    m_next = 0;
+    m_unmapped = 0;
+    std::cout << "[capture] writing frames to " << dir << " (" << threads << " encoder threads)" << std::endl;
+    return true;
+}
+
+void FrameCapture::grab(GLuint fbo, int width, int height)
+{
+    if (!active() || width <= 0 || height <= 0)
+        return;
+    TRACE_SCOPE("capture grab");
+
+    Slot &slot = m_ring[m_next];
+    if (slot.frame >= 0)
+        retire(slot); // from RING_SIZE frames ago
+
+    const GLsizeiptr bytes = GLsizeiptr(width) * height * 4;
+    if (!slot.pbo)
+        slot.pbo = GLBuffer::create();
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+    if (slot.capacity < bytes)
+    {
+        statBufferData(GL_PIXEL_PACK_BUFFER, bytes, nullptr, GL_STREAM_READ);
+        slot.capacity = bytes;
+    }
+
+    // into the bound pack buffer: returns without waiting for the frame to finish
+    GLint prevRead = 0;
+    glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &prevRead);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, prevRead);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot.frame = m_frame++;
+    slot.width = width;
+    slot.height = height;
+    m_next = (m_next + 1) % RING_SIZE;
+}
+
+void FrameCapture::retire(Slot &slot)
+{
+    TRACE_SCOPE("capture readback");
+    // normally signalled long ago; if the GPU is RING_SIZE frames behind, wait for it
+    while (glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ull) == GL_TIMEOUT_EXPIRED)
+    {
+    }
+    glDeleteSync(slot.fence);
+    slot.fence = nullptr;
+
+    FrameWriter::Frame frame;
+    frame.index = slot.frame;
+    frame.width = slot.width;
+    frame.height = slot.height;
+    frame.rgba.resize(std::size_t(slot.width) * slot.height * 4);
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+    if (const void *src = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, GLsizeiptr(frame.rgba.size()), GL_MAP_READ_BIT))
+    {
+        std::memcpy(frame.rgba.data(), src, frame.rgba.size());
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        m_writer->submit(std::move(frame));
+    }
+    else
+    {
+        std::cerr << "[capture] could not map frame " << slot.frame << std::endl;
+        ++m_unmapped;
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    slot.frame = -1;
+}
+
+bool FrameCapture::stop()
+{
+    if (!active())
+        return true;
+
+    // oldest first, so the writer sees the frames in order
+    for (int i = 0; i < RING_SIZE; ++i)
+    {
+        Slot &slot = m_ring[(m_next + i) % RING_SIZE];
+        if (slot.frame >= 0)
+            retire(slot);
+    }
+    m_writer->finish();
+    const int failed = m_writer->failed() + m_unmapped;
+    std::cout << "[capture] " << m_writer->written() << " frames written to " << m_dir;
+    if (failed > 0)
+        std::cout << ", " << failed << " failed";
+    std::cout << std::endl;
+
+    m_writer.reset();
+    for (Slot &slot : m_ring)
+    {
+        slot.pbo.reset();
+        slot.capacity = 0;
+    }
+    return failed == 0;
+}
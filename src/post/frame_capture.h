@@ -0,0 +1,119 @@
+#pragma once
+
+#ifdef __APPLE__
+#define GL_SILENCE_DEPRECATION
+#endif
+#include <GL/glew.h>
+
+#include "utils/gl_handle.h"
+
+#include <array>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Writes captured frames as <dir>/frame_00000.png (or .ppm) on a pool of
+// worker threads. submit() blocks while maxQueued frames are waiting, so a
+// slow disk throttles the renderer instead of dropping frames or letting
+// memory grow. Each file is written under a temporary name and renamed, so
+// a frame file that exists is complete (the render farm relies on this).
+class FrameWriter
+{
+public:
+    enum class Format
+    {
+        PNG,
+        PPM, // raw binary RGB: no compression, for when encoding is the bottleneck
+    };
+
+    struct Frame
+    {
+        int index = 0;
+        int width = 0;
+        int height = 0;
+        std::vector<unsigned char> rgba; // as glReadPixels returns it: bottom row first
+    };
+
+    FrameWriter(std::string dir, Format format, int threads, int maxQueued);
+    ~FrameWriter(); // finish()
+
+    FrameWriter(const FrameWriter &) = delete;
+    FrameWriter &operator=(const FrameWriter &) = delete;
+
+    void submit(Frame &&frame);
+
+    // write everything queued, then stop the workers
+    void finish();
+
+    // "frame_00042.png": where frame index goes in the output directory
+    static std::string fileName(int index, Format format);
+
+    int written() const;
+    int failed() const;
+
+private:
+    void workerLoop();
+    bool write(const Frame &frame) const;
+
+    std::string m_dir;
+    Format m_format;
+    std::size_t m_maxQueued;
+
+    std::vector<std::thread> m_workers;
+    mutable std::mutex m_mutex;
+    std::condition_variable m_hasWork;
+    std::condition_variable m_hasRoom;
+    std::deque<Frame> m_queue;
+    bool m_quit = false;
+    int m_written = 0;
+    int m_failed = 0;
+};
+
+// Asynchronous readback of rendered frames through a ring of pixel-pack
+// buffers. grab() only queues a glReadPixels into the next buffer plus a
+// fence; the pixels are mapped when that buffer comes round again,
+// RING_SIZE - 1 frames later, by which time the GPU is normally done with
+// them, and go to a FrameWriter. Needs the GL context current for every call.
+class FrameCapture
+{
+public:
+    static constexpr int RING_SIZE = 3;
+
+    ~FrameCapture(); // stop()
+
+    // frames are numbered from firstFrame
+    bool start(const std::string &dir, FrameWriter::Format format, int firstFrame = 0);
+    bool active() const { return m_writer != nullptr; }
+
+    // read the colour attachment of fbo, (0, 0, width, height), as frame number nextFrame()
+    void grab(GLuint fbo, int width, int height);
+    int nextFrame() const { return m_frame; }
+
+    // map what is still in flight, wait for the writer, release the buffers;
+    // false if any frame could not be written
+    bool stop();
+
+private:
+    struct Slot
+    {
+        GLBuffer pbo;
+        GLsizeiptr capacity = 0;
+        GLsync fence = nullptr;
+        int frame = -1; // -1: nothing in flight
+        int width = 0;
+        int height = 0;
+    };
+
+    void retire(Slot &slot);
+
+    std::array<Slot, RING_SIZE> m_ring;
+    int m_next = 0;
+    int m_frame = 0;
+    int m_unmapped = 0; // frames lost because their buffer could not be mapped
+    std::string m_dir;
+    std::unique_ptr<FrameWriter> m_writer;
+};
@@ -0,0 +1,86 @@
+#include "lut_baker.h"
+
+#include <iostream>
+
+#include "utils/trace.h"
+
+LUTBaker::LUTBaker()
+{
+    m_worker = std::thread(&LUTBaker::workerLoop, this);
+}
+
+LUTBaker::~LUTBaker()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_quit = true;
+    }
+    m_cv.notify_all();
+    if (m_worker.joinable())
+        m_worker.join();
+}
+
+void LUTBaker::request(const LUTUtils::GradeParams &params, int size)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_lastSize == size && m_lastParams == params)
+            return;
+        m_lastParams = params;
+        m_lastSize = size;
+
+        // latest wins: overwrite any job that has not started yet
+        m_jobParams = params;
+        m_jobSize = size;
+        m_hasJob = true;
+    }
+    m_cv.notify_one();
+}
+
+bool LUTBaker::takeResult(int &outSize, std::vector<float> &outData, bool &outIdentity)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_hasResult)
+        return false;
+    outSize = m_resultSize;
+    outData = std::move(m_resultData);
+    outIdentity = m_resultIdentity;
+    m_resultData.clear();
+    m_hasResult = false;
+    return true;
+}
+
+void LUTBaker::workerLoop()
+{
+    Tracer::setThreadName("LUT baker");
+    for (;;)
+    {
+        LUTUtils::GradeParams params;
+        int size = 0;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cv.wait(lock, [this]
+                      { return m_quit || m_hasJob; });
+            if (m_quit)
+                return;
+            params = m_jobParams;
+            size = m_jobSize;
+            m_hasJob = false;
+        }
+
+        std::vector<float> data;
+        {
+            TRACE_SCOPE("bakeGradeLUT");
+            data = LUTUtils::bakeGradeLUT(size, params);
+        }
+        bool identity = params.isIdentity();
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_hasJob)
+            continue; // a newer request arrived while baking; drop this one
+        m_resultSize = size;
+        m_resultData = std::move(data);
+        m_resultIdentity = identity;
+        m_hasResult = true;
+    }
+}
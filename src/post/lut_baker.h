@@ -0,0 +1,51 @@
+#pragma once
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "lut_utils.h"
+
+// Bakes LUTUtils::GradeParams into a 3D LUT on a worker thread.
+// The GL thread calls request() whenever parameters may have changed (cheap if
+// they did not) and polls takeResult() once per frame to upload finished LUTs.
+// Only the newest request is kept; stale ones are dropped before they start.
+class LUTBaker
+{
+public:
+    LUTBaker();
+    ~LUTBaker();
+
+    LUTBaker(const LUTBaker &) = delete;
+    LUTBaker &operator=(const LUTBaker &) = delete;
+
+    // Queue a bake. Ignored if identical to the last requested params/size.
+    void request(const LUTUtils::GradeParams &params, int size);
+
+    // Returns true and fills the outputs if a bake finished since the last call.
+    bool takeResult(int &outSize, std::vector<float> &outData, bool &outIdentity);
+
+private:
+    void workerLoop();
+
+    std::thread m_worker;
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    bool m_quit = false;
+
+    // last requested (used to skip duplicates)
+    LUTUtils::GradeParams m_lastParams;
+    int m_lastSize = 0;
+
+    // pending job
+    bool m_hasJob = false;
+    LUTUtils::GradeParams m_jobParams;
+    int m_jobSize = 0;
+
+    // finished result
+    bool m_hasResult = false;
+    int m_resultSize = 0;
+    bool m_resultIdentity = true;
+    std::vector<float> m_resultData;
+};
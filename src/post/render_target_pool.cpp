@@ -0,0 +1,217 @@
+#include "render_target_pool.h"
+
+#include <iostream>
+#include <limits>
+
+#include "utils/gl_state.h"
+
+void RenderTargetPool::formatInfo(GLenum internalFormat, GLenum &baseFormat, GLenum &type, bool &isDepth)
+{
+    isDepth = false;
+    switch (internalFormat)
+    {
+    case GL_DEPTH_COMPONENT24:
+    case GL_DEPTH_COMPONENT32F:
+    case GL_DEPTH_COMPONENT:
+        baseFormat = GL_DEPTH_COMPONENT;
+        type = GL_FLOAT;
+        isDepth = true;
+        break;
+    case GL_RGBA16F:
+    case GL_RGBA32F:
+        baseFormat = GL_RGBA;
+        type = GL_FLOAT;
+        break;
+    case GL_RGB16F:
+    case GL_R11F_G11F_B10F:
+        baseFormat = GL_RGB;
+        type = GL_FLOAT;
+        break;
+    default: // GL_RGBA8 / GL_RGBA
+        baseFormat = GL_RGBA;
+        type = GL_UNSIGNED_BYTE;
+        break;
+    }
+}
+
+std::size_t RenderTargetPool::bytesPerPixel(GLenum internalFormat)
+{
+    switch (internalFormat)
+    {
+    case GL_RGBA32F:
+        return 16;
+    case GL_RGBA16F:
+        return 8;
+    case GL_RGB16F:
+        return 6;
+    default: // RGBA8, R11G11B10F, DEPTH24 (padded), DEPTH32F
+        return 4;
+    }
+}
+
+void RenderTargetPool::beginFrame()
+{
+    ++m_frame;
+    m_allocsThisFrame = 0;
+
+    for (std::size_t i = 0; i < m_entries.size();)
+    {
+        Entry &e = m_entries[i];
+        if (!e.inUse && m_frame - e.lastUsedFrame > std::uint64_t(EVICT_FRAMES))
+        {
+            // textures and framebuffers go through the deferred deletion queue,
+            // so a pass still in flight on the GPU is not stalled
+            deleteFramebuffersUsing(e.tex);
+            if (&e != &m_entries.back())
+                e = std::move(m_entries.back());
+            m_entries.pop_back();
+            continue;
+        }
+        ++i;
+    }
+}
+
+RenderTarget RenderTargetPool::acquire(GLenum internalFormat, int w, int h)
+{
+    RenderTarget rt;
+    if (w <= 0 || h <= 0)
+        return rt;
+
+    // best fit among free textures of the same format
+    Entry *best = nullptr;
+    long long bestArea = std::numeric_limits<long long>::max();
+    for (Entry &e : m_entries)
+    {
+        if (e.inUse || e.format != internalFormat)
+            continue;
+        if (e.allocWidth < w || e.allocHeight < h)
+            continue;
+        long long area = (long long)e.allocWidth * e.allocHeight;
+        if (area < bestArea)
+        {
+            best = &e;
+            bestArea = area;
+        }
+    }
+
+    // don't hand out something far larger than needed if a fresh bucket is much smaller
+    long long wantArea = (long long)bucketed(w) * bucketed(h);
+    if (best && bestArea > wantArea * 4)
+        best = nullptr;
+
+    if (!best)
+    {
+        Entry e;
+        e.format = internalFormat;
+        e.allocWidth = bucketed(w);
+        e.allocHeight = bucketed(h);
+
+        GLenum baseFormat, type;
+        bool isDepth;
+        formatInfo(internalFormat, baseFormat, type, isDepth);
+
+        e.tex = GLTexture::create();
+        glState.bindTexture(GL_TEXTURE_2D, e.tex);
+        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, e.allocWidth, e.allocHeight, 0,
+                     baseFormat, type, nullptr);
+        GLint filter = isDepth ? GL_NEAREST : GL_LINEAR;
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glState.bindTexture(GL_TEXTURE_2D, 0);
+
+        m_entries.push_back(std::move(e));
+        best = &m_entries.back();
+        ++m_allocsThisFrame;
+    }
+
+    best->inUse = true;
+    best->lastUsedFrame = m_frame;
+
+    rt.tex = best->tex;
+    rt.format = internalFormat;
+    rt.width = w;
+    rt.height = h;
+    rt.allocWidth = best->allocWidth;
+    rt.allocHeight = best->allocHeight;
+    return rt;
+}
+
+void RenderTargetPool::release(RenderTarget &rt)
+{
+    if (Entry *e = findEntry(rt.tex))
+    {
+        e->inUse = false;
+        e->lastUsedFrame = m_frame;
+    }
+    rt = RenderTarget();
+}
+
+GLuint RenderTargetPool::framebuffer(const RenderTarget &color, const RenderTarget &depth)
+{
+    auto key = std::make_pair(color.tex, depth.tex);
+    auto it = m_framebuffers.find(key);
+    if (it != m_framebuffers.end())
+        return it->second;
+
+    GLFramebuffer fbo = GLFramebuffer::create();
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    if (color.tex)
+    {
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, color.tex, 0);
+        GLenum bufs[1] = {GL_COLOR_ATTACHMENT0};
+        glDrawBuffers(1, bufs);
+    }
+    else
+    {
+        glDrawBuffer(GL_NONE);
+    }
+    if (depth.tex)
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depth.tex, 0);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    {
+        std::cerr << "Error: pooled framebuffer is not complete!" << std::endl;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    GLuint name = fbo;
+    m_framebuffers[key] = std::move(fbo);
+    return name;
+}
+
+void RenderTargetPool::destroy()
+{
+    m_framebuffers.clear();
+    m_entries.clear();
+}
+
+std::size_t RenderTargetPool::bytesAllocated() const
+{
+    std::size_t total = 0;
+    for (const Entry &e : m_entries)
+        total += std::size_t(e.allocWidth) * e.allocHeight * bytesPerPixel(e.format);
+    return total;
+}
+
+RenderTargetPool::Entry *RenderTargetPool::findEntry(GLuint tex)
+{
+    if (!tex)
+        return nullptr;
+    for (Entry &e : m_entries)
+        if (e.tex == tex)
+            return &e;
+    return nullptr;
+}
+
+void RenderTargetPool::deleteFramebuffersUsing(GLuint tex)
+{
+    for (auto it = m_framebuffers.begin(); it != m_framebuffers.end();)
+    {
+        if (it->first.first == tex || it->first.second == tex)
+            it = m_framebuffers.erase(it);
+        else
+            ++it;
+    }
+}
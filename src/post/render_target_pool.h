@@ -0,0 +1,91 @@
+#pragma once
+
+#ifdef __APPLE__
+#define GL_SILENCE_DEPRECATION
+#endif
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "utils/gl_handle.h"
+
+#include <cstdint>
+#include <map>
+#include <vector>
+
+// A 2D texture handed out by RenderTargetPool. The texture may be larger than
+// the requested size (sizes are bucketed), so passes render into the
+// (0, 0, width, height) sub-rectangle and sample with uvScale().
+struct RenderTarget
+{
+    GLuint tex = 0;
+    GLenum format = 0;  // internal format
+    int width = 0;      // requested size (viewport)
+    int height = 0;
+    int allocWidth = 0; // actual texture size
+    int allocHeight = 0;
+
+    glm::vec2 uvScale() const
+    {
+        if (!allocWidth || !allocHeight)
+            return glm::vec2(1.f);
+        return glm::vec2(float(width) / allocWidth, float(height) / allocHeight);
+    }
+    bool valid() const { return tex != 0; }
+};
+
+// Pool of render-target textures keyed by (format, bucketed size).
+//  - acquire() returns the smallest free texture of that format that fits,
+//    allocating a new bucket only if none does; release() puts it back.
+//  - A target released earlier in the frame is handed to the next acquire()
+//    of the same format, so passes whose lifetimes do not overlap alias the
+//    same memory (e.g. reflection depth -> refraction depth).
+//  - Textures that stay unused for EVICT_FRAMES frames are deleted in
+//    beginFrame(), so a window-resize drag only allocates when it crosses a
+//    bucket boundary and the stale buckets go away once it settles.
+class RenderTargetPool
+{
+public:
+    static constexpr int BUCKET = 128;       // sizes are rounded up to this
+    static constexpr int EVICT_FRAMES = 120; // ~2s at 60 fps
+
+    RenderTargetPool() = default;
+    RenderTargetPool(const RenderTargetPool &) = delete;
+    RenderTargetPool &operator=(const RenderTargetPool &) = delete;
+
+    void beginFrame(); // advance the frame counter and evict stale textures
+    RenderTarget acquire(GLenum internalFormat, int w, int h);
+    void release(RenderTarget &rt); // resets rt
+
+    // Framebuffer for a (color, depth) attachment pair, cached across frames.
+    // Either attachment may be 0.
+    GLuint framebuffer(const RenderTarget &color, const RenderTarget &depth);
+
+    void destroy(); // release every texture and framebuffer (needs a current context)
+
+    // stats
+    int textureCount() const { return int(m_entries.size()); }
+    std::size_t bytesAllocated() const;
+    int allocationsThisFrame() const { return m_allocsThisFrame; }
+
+private:
+    struct Entry
+    {
+        GLTexture tex;
+        GLenum format = 0;
+        int allocWidth = 0;
+        int allocHeight = 0;
+        bool inUse = false;
+        std::uint64_t lastUsedFrame = 0;
+    };
+
+    static int bucketed(int v) { return ((v + BUCKET - 1) / BUCKET) * BUCKET; }
+    static void formatInfo(GLenum internalFormat, GLenum &baseFormat, GLenum &type, bool &isDepth);
+    static std::size_t bytesPerPixel(GLenum internalFormat);
+    Entry *findEntry(GLuint tex);
+    void deleteFramebuffersUsing(GLuint tex);
+
+    std::vector<Entry> m_entries;
+    std::map<std::pair<GLuint, GLuint>, GLFramebuffer> m_framebuffers; // (color, depth) -> fbo
+    std::uint64_t m_frame = 0;
+    int m_allocsThisFrame = 0;
+};
@@ -5,13 +5,24 @@
 #include <QKeyEvent>
 #include <iostream>
 #include "settings.h"
+#include "utils/parallel.h"
+#include "utils/striped_image_writer.h"
+#include "utils/tile_layout.h"
 
 #include "shapes/Cube.h"
 #include "shapes/Sphere.h"
 #include "shapes/Cone.h"
 #include "shapes/Cylinder.h"
+#include "shapes/primitive_tables.h"
 #include <algorithm>
+#include <array>
 #include <cmath>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
 #include <glm/gtx/norm.hpp>
 #include <random>
 
@@ -46,43 +57,115 @@ namespace
         return 24.f + 4.f * float(v - 1); // v=10 => 24 + 36 = 60
     }
 
+    // Scene-file LOD: distance bands and the tessellation scale of each. An
+    // item changes band only once it is SCENE_LOD_HYSTERESIS past the edge,
+    // so a camera resting on a boundary does not flip meshes every frame.
+    constexpr int SCENE_LOD_LEVELS = 4;
+    constexpr float SCENE_LOD_SCALE[SCENE_LOD_LEVELS] = {1.f, 0.5f, 0.25f, 0.125f};
+    constexpr float SCENE_LOD_HYSTERESIS = 0.1f;
+
+    // the band whose scale is the smallest still >= the continuous LOD factor
+    int sceneLodBand(float d, float nearP, float farP)
+    {
+        float f = lodFactorByDistanceLog(d, nearP, farP, SCENE_LOD_SCALE[SCENE_LOD_LEVELS - 1]);
+        int level = 0;
+        while (level + 1 < SCENE_LOD_LEVELS && SCENE_LOD_SCALE[level + 1] >= f)
+            ++level;
+        return level;
+    }
+
+    // directional lights the default shader takes (MAX_LIGHTS in default.frag)
+    constexpr int MAX_SCENE_LIGHTS = 8;
+    // point + spot lights in the ClusterLights block (clustered_lights.glsl)
+    constexpr int MAX_CLUSTER_LIGHTS = 256;
+    constexpr GLuint CLUSTER_LIGHT_BINDING = 1;
+    constexpr GLint CLUSTER_DATA_UNIT = 15; // after the terrain's 15 material textures
+    // aerial-perspective volume; the terrain samples it in its vertex shader,
+    // its fragment shader already uses every unit the minimum spec has
+    constexpr GLint AERIAL_PERSPECTIVE_UNIT = 16;
+    // uniform block binding of SceneInstances (default.vert)
+    constexpr GLuint SCENE_INSTANCE_BINDING = 0;
+    constexpr GLsizeiptr SCENE_INSTANCE_BYTES = 2 * sizeof(glm::mat4); // model + padded normal matrix
+
+    // the sun, FROM light TO scene: lighting and the atmosphere's sky use the same one
+    glm::vec3 sunDirection()
+    {
+        return glm::normalize(glm::vec3(0.3f, -1.0f, 0.2f));
+    }
+
+    // the terrain block is 120 x 120 units with peaks ~10 high: 60 km of land, 5 km mountains
+    constexpr float ATMOSPHERE_KM_PER_UNIT = 0.5f;
+
+    // the air the colour-grade preset's weather calls for
+    AtmosphereParams atmosphereFor(int gradePreset)
+    {
+        AtmosphereParams p;
+        if (gradePreset == 1) // cold: snow haze, snow on the ground
+        {
+            p.mieScattering = glm::vec3(0.02f);
+            p.mieAbsorption = glm::vec3(0.002f);
+            p.mieScaleHeight = 1.5f;
+            p.mieG = 0.7f;
+            p.groundAlbedo = glm::vec3(0.8f);
+        }
+        else if (gradePreset == 3) // rainy: thick low haze under an overcast sun
+        {
+            p.mieScattering = glm::vec3(0.06f);
+            p.mieAbsorption = glm::vec3(0.008f);
+            p.mieScaleHeight = 2.f;
+            p.mieG = 0.6f;
+            p.sunIlluminance *= 0.5f;
+        }
+        return p;
+    }
+
+    // particles the colour-grade preset calls for: 0 snow, 1 rain, -1 leave them as they are
+    int particleTypeFor(int gradePreset)
+    {
+        if (gradePreset == 1)
+            return 0; // Snow
+        if (gradePreset == 3)
+            return 1; // Rain
+        return -1;
+    }
+
 }
 
 // helper functions
 
-// Map a ScenePrimitive (+ tess params) to an interleaved PN float array
-static std::vector<float> buildInterleavedForPrimitive(const ScenePrimitive &prim,
-                                                       int p1, int p2)
+// Map a ScenePrimitive (+ tess params) to an indexed, cache-ordered PN mesh
+static IndexedMesh buildIndexedForPrimitive(const ScenePrimitive &prim,
+                                            int p1, int p2)
 {
-    std::vector<float> data;
+    IndexedMesh data;
     switch (prim.type)
     {
     case PrimitiveType::PRIMITIVE_CUBE:
     {
         Cube s;
         s.updateParams(std::max(1, p1));
-        data = s.generateShape();
+        data = s.generateIndexedShape();
         break;
     }
     case PrimitiveType::PRIMITIVE_SPHERE:
     {
         Sphere s;
         s.updateParams(std::max(1, p1), std::max(3, p2));
-        data = s.generateShape();
+        data = s.generateIndexedShape();
         break;
     }
     case PrimitiveType::PRIMITIVE_CYLINDER:
     {
         Cylinder s;
         s.updateParams(std::max(1, p1), std::max(3, p2));
-        data = s.generateShape();
+        data = s.generateIndexedShape();
         break;
     }
     case PrimitiveType::PRIMITIVE_CONE:
     {
         Cone s;
         s.updateParams(std::max(1, p1), std::max(3, p2));
-        data = s.generateShape();
+        data = s.generateIndexedShape();
         break;
     }
     default:
@@ -103,12 +186,13 @@ GLMesh *Realtime::getOrCreateMesh(const ScenePrimitive &prim, int p1, int p2)
     if (it != m_meshCache.end())
         return &it->second;
 
-    // if cache unhit, construct new mesh
-    std::vector<float> interleaved = buildInterleavedForPrimitive(prim, p1, p2);
-
-    // create GLMesh and upload GPU
+    // if cache unhit, construct new mesh: the fixed forest/sky primitives
+    // are baked at compile time, anything else is tessellated here
     GLMesh mesh;
-    mesh.uploadinterleavedPN(interleaved);
+    if (const PrimitiveTable *table = findPrimitiveTable(prim.type, p1, p2))
+        mesh.uploadIndexedPN(table->vertices, table->vertexCount, table->indices, table->indexCount);
+    else
+        mesh.uploadIndexedPN(buildIndexedForPrimitive(prim, p1, p2));
 
     // insert cache (use move semantics to avoid copying)
     auto [ins, ok] = m_meshCache.emplace(key, std::move(mesh));
@@ -134,6 +218,347 @@ void Realtime::destroyMeshCache()
     m_meshCache.clear(); // clear map
 }
 
+void Realtime::rebuildDrawListFromRenderData(int p1, int p2)
+{
+    m_drawList.clear();
+    m_drawList.reserve(m_rd.shapeCount());
+
+    // scene materials with the global coefficients folded in, once per material
+    const SceneGlobalData &g = m_rd.globalData;
+    std::vector<MaterialCPU> materials(m_rd.materials.size());
+    for (std::size_t i = 0; i < materials.size(); ++i)
+    {
+        const SceneMaterial &m = m_rd.materials[i];
+        materials[i].ka = g.ka * glm::vec3(m.cAmbient);
+        materials[i].kd = g.kd * glm::vec3(m.cDiffuse);
+        materials[i].ks = g.ks * glm::vec3(m.cSpecular);
+        materials[i].shininess = std::max(m.shininess, 1.f);
+    }
+
+    int skipped = 0;
+    for (std::size_t i = 0; i < m_rd.shapeCount(); ++i)
+    {
+        if (m_rd.types[i] == PrimitiveType::PRIMITIVE_MESH)
+        {
+            ++skipped; // no .obj loader
+            continue;
+        }
+
+        DrawItem item;
+        item.type = m_rd.types[i];
+        item.model = m_rd.ctms[i];
+        item.normalMat = glm::transpose(glm::inverse(glm::mat3(item.model)));
+        item.mat = materials[m_rd.materialIndex[i]];
+
+        item.p1_base = p1;
+        item.p2_base = p2;
+        m_drawList.push_back(item); // mesh and lodLevel are picked by updateSceneLod()
+    }
+    if (skipped > 0)
+        std::cout << "[scene] skipped " << skipped << " mesh primitive(s): only the built-in shapes are supported" << std::endl;
+
+    m_sceneBatchesDirty = true;
+}
+
+void Realtime::updateSceneLod()
+{
+    // (p1, p2) of a band: the base tessellation scaled down, never below
+    // what the shape needs to stay closed
+    auto tessellation = [](const DrawItem &item, int level, int &p1, int &p2)
+    {
+        float s = SCENE_LOD_SCALE[level];
+        p1 = int(std::lround(item.p1_base * s));
+        p2 = int(std::lround(item.p2_base * s));
+        switch (item.type)
+        {
+        case PrimitiveType::PRIMITIVE_CUBE:
+            p1 = std::max(1, p1);
+            p2 = 1; // unused; one cache entry per p1
+            break;
+        case PrimitiveType::PRIMITIVE_SPHERE:
+            p1 = std::max(2, p1);
+            p2 = std::max(3, p2);
+            break;
+        default:
+            p1 = std::max(1, p1);
+            p2 = std::max(3, p2);
+            break;
+        }
+    };
+
+    bool changed = false;
+    for (DrawItem &item : m_drawList)
+    {
+        // distance to the surface of the bounding sphere (unit shapes: half-diagonal sqrt(3)/2)
+        glm::vec3 c(item.model[3]);
+        float scale = std::max({glm::length(glm::vec3(item.model[0])), glm::length(glm::vec3(item.model[1])),
+                                glm::length(glm::vec3(item.model[2]))});
+        float d = std::max(glm::length(c - m_cam.eye) - 0.866f * scale, m_cam.nearP);
+        item.lastDist = d;
+
+        int level = sceneLodBand(d, m_cam.nearP, m_cam.farP);
+        if (level == item.lodLevel)
+            continue;
+        if (item.lodLevel >= 0)
+        {
+            // still inside the band when probed a little back towards it?
+            float probe = level > item.lodLevel ? d * (1.f - SCENE_LOD_HYSTERESIS) : d * (1.f + SCENE_LOD_HYSTERESIS);
+            if (sceneLodBand(probe, m_cam.nearP, m_cam.farP) == item.lodLevel)
+                continue;
+        }
+
+        int p1 = 1, p2 = 1;
+        tessellation(item, level, p1, p2);
+        item.lodLevel = level;
+        item.mesh = getOrCreateMesh(item.type, p1, p2);
+        changed = true;
+    }
+    if (changed)
+        m_sceneBatchesDirty = true;
+}
+
+void Realtime::rebuildSceneBatches()
+{
+    TRACE_SCOPE("rebuildSceneBatches");
+    m_sceneBatchesDirty = false;
+    m_sceneBatches.clear();
+
+    std::vector<const DrawItem *> order;
+    order.reserve(m_drawList.size());
+    for (const DrawItem &item : m_drawList)
+        if (item.mesh && item.mesh->elementCount() > 0)
+            order.push_back(&item);
+    if (order.empty())
+        return;
+
+    auto matKey = [](const MaterialCPU &m)
+    {
+        return std::array<float, 10>{m.ka.r, m.ka.g, m.ka.b, m.kd.r, m.kd.g, m.kd.b,
+                                     m.ks.r, m.ks.g, m.ks.b, m.shininess};
+    };
+    std::sort(order.begin(), order.end(), [&](const DrawItem *a, const DrawItem *b)
+              {
+        if (a->mesh != b->mesh)
+            return std::less<const GLMesh *>()(a->mesh, b->mesh);
+        return matKey(a->mat) < matKey(b->mat); });
+
+    GLint align = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &align);
+    align = std::max<GLint>(align, 1);
+
+    std::vector<glm::mat4> data; // model, normal matrix, model, ...
+    data.reserve(order.size() * 2);
+    for (const DrawItem *item : order)
+    {
+        SceneBatch *cur = m_sceneBatches.empty() ? nullptr : &m_sceneBatches.back();
+        if (!cur || cur->mesh != item->mesh || matKey(cur->mat) != matKey(item->mat) ||
+            cur->count == SCENE_MAX_INSTANCES)
+        {
+            // every batch starts on a bindable offset
+            while ((data.size() * sizeof(glm::mat4)) % align != 0)
+                data.push_back(glm::mat4(1.f));
+            m_sceneBatches.push_back({item->mesh, item->mat, GLintptr(data.size() * sizeof(glm::mat4)), 0});
+            cur = &m_sceneBatches.back();
+        }
+        data.push_back(item->model);
+        data.push_back(glm::mat4(item->normalMat));
+        ++cur->count;
+    }
+    // each draw binds a whole block's worth, so the last one needs room behind it
+    data.resize(m_sceneBatches.back().offset / sizeof(glm::mat4) + SCENE_MAX_INSTANCES * 2, glm::mat4(1.f));
+
+    if (!m_sceneInstanceUBO)
+        m_sceneInstanceUBO = GLBuffer::create();
+    glBindBuffer(GL_UNIFORM_BUFFER, m_sceneInstanceUBO);
+    statBufferData(GL_UNIFORM_BUFFER, data.size() * sizeof(glm::mat4), data.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void Realtime::drawSceneItems(const glm::vec3 &sunDir, const glm::vec3 &sunColor, const glm::vec3 &ambColor)
+{
+    if (m_drawList.empty() || !m_prog)
+        return;
+    TRACE_SCOPE("scene items");
+
+    updateSceneLod();
+    if (m_sceneBatchesDirty)
+        rebuildSceneBatches();
+    if (m_sceneBatches.empty())
+        return;
+
+    glState.useProgram(m_prog);
+    auto loc = [&](const char *name) { return glGetUniformLocation(m_prog, name); };
+    glm::mat4 view = m_cam.view(), proj = m_cam.proj();
+    statUniform(glUniformMatrix4fv, loc("uView"), 1, GL_FALSE, &view[0][0]);
+    statUniform(glUniformMatrix4fv, loc("uProj"), 1, GL_FALSE, &proj[0][0]);
+    statUniform(glUniform3fv, loc("uEye"), 1, &m_cam.eye[0]);
+    statUniform(glUniform3fv, loc("uSunDir"), 1, &sunDir[0]);
+    statUniform(glUniform3fv, loc("uSunColor"), 1, &sunColor[0]);
+    statUniform(glUniform3fv, loc("uAmbientColor"), 1, &ambColor[0]);
+    m_atmosphere.bindAerialPerspective(m_prog, AERIAL_PERSPECTIVE_UNIT, m_cam.eye);
+    setClusterUniforms(m_prog, true);
+
+    GLint locKa = loc("u_mat.ka"), locKd = loc("u_mat.kd"), locKs = loc("u_mat.ks"), locShin = loc("u_mat.shininess");
+    const MaterialCPU *bound = nullptr;
+    for (const SceneBatch &b : m_sceneBatches)
+    {
+        // batches are sorted by mesh first, so equal materials often repeat
+        if (!bound || bound->ka != b.mat.ka || bound->kd != b.mat.kd || bound->ks != b.mat.ks ||
+            bound->shininess != b.mat.shininess)
+        {
+            statUniform(glUniform3fv, locKa, 1, &b.mat.ka[0]);
+            statUniform(glUniform3fv, locKd, 1, &b.mat.kd[0]);
+            statUniform(glUniform3fv, locKs, 1, &b.mat.ks[0]);
+            statUniform(glUniform1f, locShin, b.mat.shininess);
+            bound = &b.mat;
+        }
+        glBindBufferRange(GL_UNIFORM_BUFFER, SCENE_INSTANCE_BINDING, m_sceneInstanceUBO, b.offset,
+                          SCENE_MAX_INSTANCES * SCENE_INSTANCE_BYTES);
+        b.mesh->drawInstanced(b.count);
+    }
+}
+
+void Realtime::uploadLights(GLuint prog, const std::vector<SceneLightData> &lights)
+{
+    m_clusterLights.clear();
+    if (!prog)
+        return;
+    glState.useProgram(prog);
+
+    char name[64];
+    auto loc = [&](const char *array, int i, const char *field)
+    {
+        std::snprintf(name, sizeof(name), "%s[%d].%s", array, i, field);
+        return glGetUniformLocation(prog, name);
+    };
+
+    int nDir = 0, dropped = 0;
+    for (const SceneLightData &l : lights)
+    {
+        glm::vec3 color(l.color);
+        glm::vec3 pos(l.pos);
+        glm::vec3 dir = glm::length(glm::vec3(l.dir)) > EPS ? glm::normalize(glm::vec3(l.dir)) : glm::vec3(0, -1, 0);
+        if (l.type == LightType::LIGHT_DIRECTIONAL)
+        {
+            if (nDir == MAX_SCENE_LIGHTS)
+            {
+                ++dropped;
+                continue;
+            }
+            statUniform(glUniform3fv, loc("uDirs", nDir, "dir"), 1, &dir[0]);
+            statUniform(glUniform3fv, loc("uDirs", nDir, "color"), 1, &color[0]);
+            ++nDir;
+            continue;
+        }
+
+        if (int(m_clusterLights.size()) == MAX_CLUSTER_LIGHTS)
+        {
+            ++dropped;
+            continue;
+        }
+        bool spot = l.type == LightType::LIGHT_SPOT;
+        ClusterLight c;
+        c.posType = glm::vec4(pos, spot ? 1.f : 0.f);
+        c.colorAngle = glm::vec4(color, spot ? l.angle : 0.f);
+        c.attenPenumbra = glm::vec4(l.function, spot ? l.penumbra : 0.f);
+        c.dirRadius = glm::vec4(dir, lightInfluenceRadius(l.function, color));
+        m_clusterLights.push_back(c);
+    }
+    statUniform(glUniform1i, glGetUniformLocation(prog, "uDirCount"), nDir);
+
+    if (!m_clusterLights.empty() && m_clusterLightUBO)
+    {
+        glBindBuffer(GL_UNIFORM_BUFFER, m_clusterLightUBO);
+        statBufferSubData(GL_UNIFORM_BUFFER, 0, m_clusterLights.size() * sizeof(ClusterLight), m_clusterLights.data());
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+
+    if (dropped > 0)
+        std::cout << "[scene] " << dropped << " light(s) over the limit of " << MAX_SCENE_LIGHTS
+                  << " directional / " << MAX_CLUSTER_LIGHTS << " point and spot were ignored" << std::endl;
+}
+
+void Realtime::bindClusterInputs(GLuint prog)
+{
+    if (!prog)
+        return;
+    GLuint block = glGetUniformBlockIndex(prog, "ClusterLights");
+    if (block != GL_INVALID_INDEX)
+        glUniformBlockBinding(prog, block, CLUSTER_LIGHT_BINDING);
+    glState.useProgram(prog);
+    statUniform(glUniform1i, glGetUniformLocation(prog, "uClusterData"), CLUSTER_DATA_UNIT);
+
+    // full size from the start: the block is bound even while no lights are loaded
+    if (!m_clusterLightUBO)
+    {
+        m_clusterLightUBO = GLBuffer::create();
+        glBindBuffer(GL_UNIFORM_BUFFER, m_clusterLightUBO);
+        statBufferData(GL_UNIFORM_BUFFER, MAX_CLUSTER_LIGHTS * sizeof(ClusterLight), nullptr, GL_STATIC_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+}
+
+void Realtime::updateLightClusters(int w, int h)
+{
+    m_clusterGridValid = false;
+    if (m_clusterLights.empty() || w <= 0 || h <= 0)
+        return;
+
+    // a poster tile covers part of the full view the grid is built for
+    if (m_posterTile.z > 0)
+        m_clusterWindow = glm::vec4(m_posterTile);
+    else
+        m_clusterWindow = glm::vec4(0.f, 0.f, float(w), float(h));
+    m_lightClusters.build(m_clusterLights, m_cam.view(), m_cam.fovyRad, m_cam.aspect, m_cam.nearP, m_cam.farP);
+
+    if (!m_clusterDataTex)
+    {
+        m_clusterDataBuffer = GLBuffer::create();
+        m_clusterDataTex = GLTexture::create();
+        glState.activeTexture(GL_TEXTURE0 + CLUSTER_DATA_UNIT);
+        statBindTexture(GL_TEXTURE_BUFFER, m_clusterDataTex);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_R32UI, m_clusterDataBuffer);
+        glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &m_clusterDataLimit);
+    }
+
+    const std::vector<std::uint32_t> &data = m_lightClusters.gpuData();
+    if (GLint(data.size()) > m_clusterDataLimit)
+    {
+        // only reachable with hundreds of very wide lights on a minimum-spec (64K texel) GPU
+        if (!m_clusterOverflowReported)
+            std::cout << "[lights] cluster lists need " << data.size() << " entries, over the buffer texture limit of "
+                      << m_clusterDataLimit << "; point and spot lights are off" << std::endl;
+        m_clusterOverflowReported = true;
+        return;
+    }
+
+    // re-specifying the store orphans last frame's copy instead of waiting on it
+    glBindBuffer(GL_TEXTURE_BUFFER, m_clusterDataBuffer);
+    statBufferData(GL_TEXTURE_BUFFER, data.size() * sizeof(std::uint32_t), data.data(), GL_STREAM_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    m_clusterGridValid = true;
+}
+
+void Realtime::setClusterUniforms(GLuint prog, bool enabled)
+{
+    enabled = enabled && m_clusterGridValid;
+    statUniform(glUniform1i, glGetUniformLocation(prog, "uClusterEnabled"), enabled ? 1 : 0);
+    glBindBufferBase(GL_UNIFORM_BUFFER, CLUSTER_LIGHT_BINDING, m_clusterLightUBO); // active even when unused
+    if (!enabled)
+        return;
+
+    auto loc = [&](const char *name) { return glGetUniformLocation(prog, name); };
+    glm::mat4 view = m_cam.view();
+    statUniform(glUniform3i, loc("uClusterGrid"), LightClusterGrid::TILES_X, LightClusterGrid::TILES_Y,
+                LightClusterGrid::SLICES);
+    statUniform(glUniform2f, loc("uClusterZParams"), m_lightClusters.zScale(), m_lightClusters.zBias());
+    statUniform(glUniform4fv, loc("uClusterWindow"), 1, &m_clusterWindow[0]);
+    statUniform(glUniformMatrix4fv, loc("uClusterView"), 1, GL_FALSE, &view[0][0]);
+
+    glState.activeTexture(GL_TEXTURE0 + CLUSTER_DATA_UNIT);
+    statBindTexture(GL_TEXTURE_BUFFER, m_clusterDataTex);
+}
+
 void Realtime::calculateFrustumCorners(glm::vec3 corners[4]) const {
     float aspect = m_cam.aspect;
     float fovY = m_cam.fovyRad;
@@ -156,261 +581,317 @@ void Realtime::calculateFrustumCorners(glm::vec3 corners[4]) const {
     corners[3] = (nearCenter + halfRight - halfUp) - m_cam.eye;
 }
 
-void Realtime::buildForest() {
-    const size_t maxBranches = 800000;
-    const size_t maxLeaves = 1600000;
-
-    m_forestBranches.clear();
-    m_forestLeaves.clear();
+void Realtime::uploadTerrainMeshes()
+{
+    TRACE_SCOPE("uploadTerrainMeshes");
+    TerrainBuild build = buildTerrainMeshes();
+    applyTerrainMeshes(build);
+}
 
-    if (!m_treeCylinderMesh)
-        return;
+Realtime::TerrainBuild Realtime::buildTerrainMeshes()
+{
+    const int steps[TerrainBuild::LODS] = {1, 2, 4};
+    TerrainBuild build;
+    std::string cachePath;
+    if (!settings.cacheDir.empty())
+    {
+        cachePath = terrainCachePath(settings.cacheDir, m_terrainParams, m_terrainGen.getResolution(),
+                                     TERRAIN_PATCHES_PER_SIDE);
+        if (readTerrainCache(cachePath, build))
+        {
+            std::cout << "[cache] terrain from " << cachePath << "\n";
+            return build;
+        }
+    }
 
-    auto clamp01 = [](float v)
-    { return glm::clamp(v, 0.f, 1.f); };
+    for (int lod = 0; lod < TerrainBuild::LODS; ++lod)
+        build.vertices[lod] = m_terrainGen.generateTerrain(steps[lod], TERRAIN_PATCHES_PER_SIDE, &build.patches[lod]);
 
-    std::mt19937 rng(1337);
-    std::uniform_real_distribution<float> dist01(0.f, 1.f);
+    if (!cachePath.empty() && !writeTerrainCache(cachePath, build))
+        std::cout << "[cache] could not write " << cachePath << "\n";
+    return build;
+}
 
-    // Adjustable: basic params
-    LSystemParams baseP;
-    baseP.iterations = 4;
-    baseP.stepLength = 0.055f;
-    baseP.baseAngleDeg = 30.0f;
-    baseP.angleJitterDeg = 15.0f;
-    baseP.baseRadius = 0.018f;
-    baseP.radiusDecay = 0.75f;
-    baseP.leafDensity = 1.0f;
+void Realtime::applyTerrainMeshes(TerrainBuild &build)
+{
+    GLMesh *meshes[TerrainBuild::LODS] = {&m_terrainMesh, &m_terrainMeshLod[0], &m_terrainMeshLod[1]};
 
-    int s4 = std::max(1, settings.shapeParameter4); // Vegetation clusters / coverage
-    int s5 = std::max(1, settings.shapeParameter5); // Tree size / complexity
-    int s6 = std::max(1, settings.shapeParameter6); // Leaf density
+    for (int lod = 0; lod < TerrainBuild::LODS; ++lod)
+    {
+        meshes[lod]->uploadinterleavedPNC(build.vertices[lod]);
 
-    float cov01 = clamp01((s4 - 1) / 99.f);
-    float size01 = clamp01((s5 - 1) / 39.f);
-    float leaf01 = clamp01((s6 - 1) / 39.f);
+        TerrainPatchSet &set = m_terrainPatches[lod];
+        set.bounds.clear();
+        set.first.clear();
+        set.count.clear();
+        for (const TerrainGenerator::TerrainPatch &p : build.patches[lod])
+        {
+            set.bounds.push_back(AABB{p.aabbMin, p.aabbMax}.transformed(m_terrainModel));
+            set.first.push_back(p.first);
+            set.count.push_back(p.count);
+        }
+    }
 
-    // Coverage -> Number of clusters / Radius / Number of trees per cluster
+    updateHorizonHeightField();
+}
 
-    // cluster number
-    int clusterCount = 12 + int(glm::mix(40.f, 160.f, cov01)); // s4=1 → 10 簇, s4=10 → 64, s4=25 → 154
+void Realtime::updateHorizonHeightField()
+{
+    const int n = m_terrainGen.getResolution();
+    std::vector<float> heights = m_terrainGen.heightGrid(n);
 
-    // number of trees per cluster: The higher the density, the more trees per cluster.
-    int treesPerClusterMin = 4 + int(glm::mix(3.f, 10.f, size01)); // 7 ~ 14
-    int treesPerClusterMax = treesPerClusterMin + 4;
+    // grid (i, j) -> local (i / n, j / n, h); keep only what the culler needs in world space
+    const int stride = n + 1;
+    for (int i = 0; i < stride; ++i)
+        for (int j = 0; j < stride; ++j)
+        {
+            float &h = heights[std::size_t(i) * stride + j];
+            h = (m_terrainModel * glm::vec4(float(i) / n, float(j) / n, h, 1.f)).y;
+        }
 
-    // cluster radius: The larger the cov, the more compact the cluster.
-    float clusterRadiusBase = glm::mix(0.10f, 0.03f, cov01);
+    glm::vec4 o = m_terrainModel * glm::vec4(0.f, 0.f, 0.f, 1.f);
+    glm::vec4 di = m_terrainModel * glm::vec4(1.f / n, 0.f, 0.f, 0.f);
+    glm::vec4 dj = m_terrainModel * glm::vec4(0.f, 1.f / n, 0.f, 0.f);
+    m_horizonCuller.setHeightField(std::move(heights), n,
+                                   glm::vec2(o.x, o.z), glm::vec2(di.x, di.z), glm::vec2(dj.x, dj.z));
+}
 
-    // World space sea level / heightScale (aligned with terrain shader)
-    float seaHeightWorld = m_terrainParams.seaLevel; // uSeaHeight
-    float heightScale = m_terrainParams.heightScale; // uHeightScale
-    float seaMargin = 0.02f * heightScale;
+void Realtime::buildVegetationCells()
+{
+    MemTagScope memTag(MemTracker::Forest);
+    m_vegetationCells.clear();
+    if (m_forestTrees.empty())
+        return;
 
-    // *Tree location estimation: approximates computeGrassRockWeights in terrain.frag,
-    // returns [0,1]: the closer to 1, the more it resembles grass.
-    auto grassWeightApprox = [](float hNorm, float slope) -> float
+    glm::vec3 lo(std::numeric_limits<float>::max());
+    glm::vec3 hi(-std::numeric_limits<float>::max());
+    for (const ForestTree &t : m_forestTrees)
     {
-        // rockBeach
-        float rockBeach = 1.f - glm::smoothstep(0.02f, 0.12f, hNorm);
-
-        // grassBand
-        float grassBand = glm::smoothstep(0.05f, 0.80f, hNorm);
-
-        // rockSlope
-        float rockSlope = glm::smoothstep(0.75f, 0.90f, slope);
+        lo = glm::min(lo, t.center - t.radius);
+        hi = glm::max(hi, t.center + t.radius);
+    }
 
-        float wRock = std::max(rockBeach, rockSlope);
-        float wGrass = grassBand * (1.f - 0.7f * rockSlope);
+    const int N = VEGETATION_CELLS_PER_SIDE;
+    glm::vec2 extent = glm::max(glm::vec2(hi.x - lo.x, hi.z - lo.z), glm::vec2(1e-3f));
+    std::vector<VegetationCell> cells(N * N);
+    for (VegetationCell &c : cells)
+        c.bounds = AABB{glm::vec3(std::numeric_limits<float>::max()),
+                        glm::vec3(-std::numeric_limits<float>::max())};
 
-        wGrass *= 1.4f;
-        wRock *= 0.7f;
+    for (int i = 0; i < int(m_forestTrees.size()); ++i)
+    {
+        const ForestTree &t = m_forestTrees[i];
+        int cx = glm::clamp(int((t.center.x - lo.x) / extent.x * N), 0, N - 1);
+        int cz = glm::clamp(int((t.center.z - lo.z) / extent.y * N), 0, N - 1);
+        VegetationCell &c = cells[cz * N + cx];
+        c.bounds.min = glm::min(c.bounds.min, t.center - t.radius);
+        c.bounds.max = glm::max(c.bounds.max, t.center + t.radius);
+        c.trees.push_back(i);
+    }
 
-        float s = wGrass + wRock + EPS;
-        return wGrass / s;
-    };
+    for (VegetationCell &c : cells)
+        if (!c.trees.empty())
+            m_vegetationCells.push_back(std::move(c));
+}
 
-    // Cluster geneartion
-    for (int c = 0; c < clusterCount; ++c)
+void Realtime::drawTerrainPatches(int lod, const glm::mat4 &viewProj, const PassPolicy &policy)
+{
+    lod = glm::clamp(lod, 0, 2);
+    const GLMesh &mesh = (lod == 0) ? m_terrainMesh : m_terrainMeshLod[lod - 1];
+    const TerrainPatchSet &set = m_terrainPatches[lod];
+    if (!mesh.vao)
+        return;
+    if (set.bounds.empty())
     {
-        glm::vec2 centerUV(0.f);
-        bool foundCenter = false;
+        mesh.draw();
+        return;
+    }
 
-        // Find a center "above the sea surface"
-        for (int tries = 0; tries < 32 && !foundCenter; ++tries)
-        {
-            glm::vec2 uv(dist01(rng), dist01(rng));
-            glm::vec3 surfLocal = m_terrainGen.sampleSurfacePos(uv.x, uv.y);
-            glm::vec3 surfWorld = glm::vec3(m_terrainModel * glm::vec4(surfLocal, 1.f));
-            if (surfWorld.y <= seaHeightWorld + seaMargin)
-                continue;
+    Frustum frustum = Frustum::fromMatrix(viewProj);
 
-            centerUV = uv;
-            foundCenter = true;
-        }
-        if (!foundCenter)
+    m_visibleFirst.clear();
+    m_visibleCount.clear();
+    for (std::size_t i = 0; i < set.bounds.size(); ++i)
+    {
+        const AABB &b = set.bounds[i];
+        if (!frustum.intersects(b))
+            continue;
+        if (policy.useClipPlane && aabbOutsidePlane(policy.clipPlane, b.min, b.max))
             continue;
 
-        float clusterRadius = clusterRadiusBase * (0.7f + 0.6f * dist01(rng));
-        int bushesPerCluster = treesPerClusterMin +
-                               int(dist01(rng) * float(treesPerClusterMax - treesPerClusterMin + 1));
-
-        // Sample a point inside small disk
-        for (int k = 0; k < bushesPerCluster; ++k)
+        // neighbouring patches are adjacent in the buffer: merge into one range
+        if (!m_visibleFirst.empty() &&
+            m_visibleFirst.back() + m_visibleCount.back() == set.first[i])
+            m_visibleCount.back() += set.count[i];
+        else
         {
-            //
-            float ang = 2.f * float(M_PI) * dist01(rng);
-            float r = clusterRadius * std::sqrt(dist01(rng));
-            glm::vec2 uv = centerUV + r * glm::vec2(std::cos(ang), std::sin(ang));
-            uv.x = clamp01(uv.x);
-            uv.y = clamp01(uv.y);
-
-            glm::vec3 surfLocal = m_terrainGen.sampleSurfacePos(uv.x, uv.y);
-            glm::vec3 pWorld = glm::vec3(m_terrainModel * glm::vec4(surfLocal, 1.f));
-
-            if (pWorld.y <= seaHeightWorld + seaMargin)
-                continue;
-
-            // height normalization
-            float hNorm = glm::clamp(
-                (pWorld.y - seaHeightWorld) / std::max(heightScale, EPS),
-                0.0f, 1.0f);
-
-            // Estimate normal -> Estimate slope
-            auto sampleHeightWorld = [&](float u, float v)
-            {
-                glm::vec2 uvc(clamp01(u), clamp01(v));
-                glm::vec3 pL = m_terrainGen.sampleSurfacePos(uvc.x, uvc.y);
-                glm::vec3 pW = glm::vec3(m_terrainModel * glm::vec4(pL, 1.f));
-                return pW.y;
-            };
-
-            const float eps = 1.0f / 512.0f;
-            float h0 = pWorld.y;
-            float hdx = sampleHeightWorld(uv.x + eps, uv.y);
-            float hdy = sampleHeightWorld(uv.x, uv.y + eps);
-
-            glm::vec3 dx = glm::vec3(eps, hdx - h0, 0.f);
-            glm::vec3 dz = glm::vec3(0.f, hdy - h0, eps);
-            glm::vec3 nWorld = glm::normalize(glm::cross(dz, dx));
-
-            // slope = 0 (flat), 1 (vertical)
-            float slope = glm::clamp(
-                1.0f - glm::dot(nWorld, glm::vec3(0, 1, 0)),
-                0.0f, 1.0f);
-
-            // grassland weight (0..1), height & slope considered together
-            float wGrass = grassWeightApprox(hNorm, slope);
-
-            // too steep will be banned directly;
-            // the rest will be determined by the weight of the grass.
-            if (slope > 0.96f)
-                continue; // almost vertical cliff has no trees.
-
-            // Adjustable: wGrass threshold: between 0.12 and 0.25.
-            if (wGrass < 0.18f)
-                continue;
-
-            // L-system parameters of tree
-            LSystemParams treeP = baseP;
-
-            // Tree size slider (height/thickness/complexity)
-            treeP.stepLength *= (0.85f + 0.5f * dist01(rng)) * glm::mix(0.7f, 1.4f, size01);
-            treeP.baseRadius *= glm::mix(0.7f, 1.3f, size01);
+            m_visibleFirst.push_back(set.first[i]);
+            m_visibleCount.push_back(set.count[i]);
+        }
+    }
 
-            treeP.iterations = (size01 > 0.5f && dist01(rng) < 0.5f) ? 3 : 2;
+    if (m_visibleFirst.empty())
+        return;
 
-            treeP.baseAngleDeg += (dist01(rng) - 0.5f) * 12.0f;
-            treeP.angleJitterDeg *= (0.7f + 0.6f * dist01(rng));
-            treeP.radiusDecay = glm::clamp(
-                baseP.radiusDecay + (dist01(rng) - 0.5f) * 0.2f,
-                0.6f, 0.95f);
+    for (GLsizei count : m_visibleCount)
+        renderStats.draw(GL_TRIANGLES, count);
 
-            // leafDensity slider： 0.5 ~ 2.0 times the leaf volume
-            treeP.leafDensity = glm::mix(0.5f, 2.0f, leaf01);
+    glState.bindVertexArray(mesh.vao);
+    glMultiDrawArrays(GL_TRIANGLES, m_visibleFirst.data(), m_visibleCount.data(),
+                      GLsizei(m_visibleFirst.size()));
+}
 
-            // grammar: randomly select one rule X
-            LSystemTree tree(treeP);
+void Realtime::collectForestRuns(const glm::mat4 &viewProj, const PassPolicy &policy, ForestRuns &out)
+{
+    // neighbouring trees coalesce into one run
+    auto appendRun = [](std::vector<InstanceRun> &runs, GLint first, GLsizei count)
+    {
+        if (count <= 0)
+            return;
+        if (!runs.empty() && runs.back().first + runs.back().count == first)
+            runs.back().count += count;
+        else
+            runs.push_back({first, count});
+    };
 
-            std::vector<std::string> xRules = {
-                "F[+FX][-FX][&FX][^FX]FX",
-                "F[+F&X][-F^X][+FX][&FX]X",
-                "F[+FX[&X]][-FX[^X]][&FX[+X]][^FX[-X]]X"};
-            int idx = int(dist01(rng) * xRules.size());
-            if (idx >= (int)xRules.size())
-                idx = (int)xRules.size() - 1;
+    out = ForestRuns();
+    Frustum frustum = Frustum::fromMatrix(viewProj);
 
-            std::unordered_map<char, std::string> rules;
-            rules['X'] = xRules[idx];
-            rules['F'] = "FF";
+    // whole object on the clipped side of the water plane, or outside this view
+    auto culled = [&](const glm::vec3 &c, float r)
+    {
+        if (policy.useClipPlane && glm::dot(glm::vec3(policy.clipPlane), c) + policy.clipPlane.w < -r)
+            return true;
+        return !frustum.intersectsSphere(c, r);
+    };
 
-            tree.generate("X", rules);
+    // hidden behind a terrain ridge as seen from the camera
+    bool horizon = policy.horizonCull && m_enableHorizonCulling && m_horizonCuller.hasHeightField();
+    auto belowHorizon = [&](const glm::vec3 &c, float r)
+    {
+        return horizon && m_horizonCuller.boxOccluded(c - r, c + r);
+    };
 
-            const auto &branches = tree.branches();
-            const auto &leaves = tree.leaves();
-            if (branches.empty())
+    out.limitTrees = std::isfinite(policy.branchMaxDist) || std::isfinite(policy.leafMaxDist) ||
+                      policy.useClipPlane || horizon;
+    if (out.limitTrees)
+    {
+        // whole cells first, then the trees inside surviving cells
+        m_visibleTrees.clear();
+        for (const VegetationCell &cell : m_vegetationCells)
+        {
+            if (!frustum.intersects(cell.bounds))
                 continue;
+            if (horizon && m_horizonCuller.boxOccluded(cell.bounds.min, cell.bounds.max))
+                continue;
+            m_visibleTrees.insert(m_visibleTrees.end(), cell.trees.begin(), cell.trees.end());
+        }
+        std::sort(m_visibleTrees.begin(), m_visibleTrees.end());
 
-            // Random Size / Tilt / Orientation
-            // World Space Scaling: The size slider controls the overall size again
-            float treeScaleBase = glm::mix(0.12f, 0.28f, size01);
-            float treeScale = treeScaleBase * (0.8f + 0.4f * dist01(rng));
-
-            // Adjustable: for controlling the size of the generating L-system tree
-            const float TREE_GLOBAL_SCALE = 20.f;
-            treeScale *= TREE_GLOBAL_SCALE;
-
-            float yaw = 2.f * float(M_PI) * dist01(rng);
-            float tiltX = glm::radians((dist01(rng) - 0.5f) * 8.f); // [-4°,4°]
-            float tiltZ = glm::radians((dist01(rng) - 0.5f) * 8.f);
+        for (int ti : m_visibleTrees)
+        {
+            const ForestTree &t = m_forestTrees[ti];
+            if (culled(t.center, t.radius) || belowHorizon(t.center, t.radius))
+                continue;
+            float d = glm::length(t.center - m_cam.eye) - t.radius;
+            if (d <= policy.branchMaxDist)
+                appendRun(out.branches, t.branchFirst, t.branchCount);
+            if (d <= policy.leafMaxDist)
+                appendRun(out.leaves, t.leafFirst, t.leafCount);
+        }
+    }
+    out.limitRocks = std::isfinite(policy.rockMaxDist) || policy.useClipPlane || horizon;
+    if (out.limitRocks)
+    {
+        for (GLsizei i = 0; i < m_rockInstanceCount && i < GLsizei(m_rocks.size()); ++i)
+        {
+            const glm::mat4 &M = m_rocks[i];
+            glm::vec3 c(M[3]);
+            // unit-diameter sphere mesh: radius is half the largest axis scale
+            float r = 0.5f * std::max({glm::length(glm::vec3(M[0])),
+                                       glm::length(glm::vec3(M[1])),
+                                       glm::length(glm::vec3(M[2]))});
+            if (culled(c, r) || belowHorizon(c, r))
+                continue;
+            if (glm::length(c - m_cam.eye) - r <= policy.rockMaxDist)
+                appendRun(out.rocks, i, 1);
+        }
+    }
+}
 
-            glm::mat4 T = glm::translate(glm::mat4(1.f), pWorld);
-            glm::mat4 R_yaw = glm::rotate(glm::mat4(1.f), yaw, glm::vec3(0, 1, 0));
-            glm::mat4 R_tiltX = glm::rotate(glm::mat4(1.f), tiltX, glm::vec3(1, 0, 0));
-            glm::mat4 R_tiltZ = glm::rotate(glm::mat4(1.f), tiltZ, glm::vec3(0, 0, 1));
-            glm::mat4 S = glm::scale(glm::mat4(1.f), glm::vec3(treeScale));
+void Realtime::drawInstanceRuns(GLMesh *mesh, GLuint instanceVBO, const std::vector<InstanceRun> &runs)
+{
+    if (!mesh || runs.empty())
+        return;
 
-            glm::mat4 baseModel = T * R_yaw * R_tiltZ * R_tiltX * S;
+    const GLsizei stride = sizeof(glm::mat4);
+    auto pointInstanceAttribs = [&](GLint first)
+    {
+        for (int i = 0; i < 4; ++i)
+        {
+            std::size_t offset = std::size_t(first) * sizeof(glm::mat4) + i * sizeof(glm::vec4);
+            glVertexAttribPointer(2 + i, 4, GL_FLOAT, GL_FALSE, stride, (void *)offset);
+        }
+    };
 
-            float bushScaleBase = 0.20f;
-            float bushScale = bushScaleBase * (0.7f + 0.6f * dist01(rng));
+    glState.bindVertexArray(mesh->vao);
+    glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+    for (const InstanceRun &run : runs)
+    {
+        pointInstanceAttribs(run.first);
+        mesh->submitInstanced(run.count);
+    }
+    pointInstanceAttribs(0); // back to the layout drawInstanced() expects
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
 
-            // add all branches to the instance list
-            for (const BranchInstance &b : branches)
-            {
-                BranchInstance inst;
-                inst.radius = b.radius * bushScale;
-                inst.model = baseModel * b.model;
-                m_forestBranches.push_back(inst);
-            }
+void Realtime::buildForest() {
+    TRACE_SCOPE("buildForest");
+    m_forestBranches.clear();
+    m_forestLeaves.clear();
+    m_forestTrees.clear();
 
-            // all leaves
-            for (const LeafInstance &leaf : leaves)
-            {
-                glm::mat4 M = baseModel * leaf.model;
-                m_forestLeaves.push_back(M);
-            }
+    if (!m_treeCylinderMesh)
+        return;
 
-            if (m_forestBranches.size() > maxBranches ||
-                m_forestLeaves.size() > maxLeaves)
-            {
-                break; // break bushesPerCluster
-            }
-        }
+    // placement (clusters on grassy, gentle terrain above the sea) and tree
+    // growth live in the GL-free core (vegetation/forest_placement)
+    ForestPlacementParams placement;
+    placement.coverage = settings.shapeParameter4;    // Vegetation clusters / coverage
+    placement.treeSize = settings.shapeParameter5;    // Tree size / complexity
+    placement.leafDensity = settings.shapeParameter6; // Leaf density
+    placement.seaLevel = m_terrainParams.seaLevel;    // uSeaHeight
+    placement.heightScale = m_terrainParams.heightScale; // uHeightScale
 
-        if (m_forestBranches.size() > maxBranches ||
-            m_forestLeaves.size() > maxLeaves)
-        {
-            break; // break clusterCount
-        }
+    ForestInstances forest;
+    std::string cachePath;
+    if (!settings.cacheDir.empty())
+        cachePath = forestCachePath(settings.cacheDir, m_terrainParams, placement);
+    if (!cachePath.empty() && readForestFile(cachePath, forest))
+    {
+        std::cout << "[cache] forest from " << cachePath << "\n";
     }
+    else
+    {
+        forest = buildForestInstances(m_terrainGen, m_terrainModel, placement);
+        if (!cachePath.empty() && !writeForestFile(cachePath, forest))
+            std::cout << "[cache] could not write " << cachePath << "\n";
+    }
+    m_forestBranches = std::move(forest.branches);
+    m_forestLeaves = std::move(forest.leaves);
+    m_forestTrees = std::move(forest.trees);
 
     std::cout << "[buildForest] branches=" << m_forestBranches.size()
               << ", leaves=" << m_forestLeaves.size()
-              << ", clusters=" << clusterCount
-              << " (s4=" << s4 << ", s5=" << s5 << ", s6=" << s6 << ")\n";
+              << ", clusters=" << forest.clusters
+              << " (s4=" << settings.shapeParameter4 << ", s5=" << settings.shapeParameter5
+              << ", s6=" << settings.shapeParameter6 << ")\n";
+
+    buildVegetationCells();
 
     // Upload branch instance matrix to VBO
+    TRACE_SCOPE("forest upload");
+    MemTagScope memTag(MemTracker::Upload);
     m_branchInstanceCount = static_cast<GLsizei>(m_forestBranches.size());
     std::vector<glm::mat4> branchModels;
     branchModels.reserve(m_branchInstanceCount);
@@ -419,145 +900,96 @@ void Realtime::buildForest() {
         branchModels.push_back(b.model);
     }
 
-    glBindBuffer(GL_ARRAY_BUFFER, m_branchInstanceVBO);
-    glBufferData(GL_ARRAY_BUFFER,
-                 branchModels.size() * sizeof(glm::mat4),
-                 branchModels.data(),
-                 GL_STATIC_DRAW);
+    uploadInstanceMatrices(m_treeCylinderMesh, m_branchInstanceVBO, branchModels.data(), branchModels.size());
 
     // Upload leaf instance matrix to VBO
     m_leafInstanceCount = static_cast<GLsizei>(m_forestLeaves.size());
     if (!m_forestLeaves.empty())
-    {
-        glBindBuffer(GL_ARRAY_BUFFER, m_leafInstanceVBO);
-        glBufferData(GL_ARRAY_BUFFER,
-                     m_forestLeaves.size() * sizeof(glm::mat4),
-                     m_forestLeaves.data(),
-                     GL_STATIC_DRAW);
-    }
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
+        uploadInstanceMatrices(m_leafMesh, m_leafInstanceVBO, m_forestLeaves.data(), m_forestLeaves.size());
 }
 
 void Realtime::buildRocks()
 {
+    TRACE_SCOPE("buildRocks");
     m_rocks.clear();
 
     if (!m_rockMesh)
         return;
 
-    std::mt19937 rng(5678); // Different seed
-    std::uniform_real_distribution<float> dist01(0.f, 1.f);
-
-    // Rock parameters
-    // Map slider (1-100) to rock count (e.g., 10 to 1000)
-    int rockCount = settings.shapeParameter7 * 10;
-    float seaHeightWorld = m_terrainParams.seaLevel;
-    float heightScale = m_terrainParams.heightScale;
-
-    auto clamp01 = [](float v)
-    { return glm::clamp(v, 0.f, 1.f); };
-
-    for (int i = 0; i < rockCount; ++i)
-    {
-        glm::vec2 uv(dist01(rng), dist01(rng));
-        glm::vec3 surfLocal = m_terrainGen.sampleSurfacePos(uv.x, uv.y);
-        glm::vec3 pWorld = glm::vec3(m_terrainModel * glm::vec4(surfLocal, 1.f));
-
-        // Don't place rocks underwater (or maybe some near the shore)
-        if (pWorld.y <= seaHeightWorld - 0.05f)
-            continue;
-
-        // Calculate slope
-        auto sampleHeightWorld = [&](float u, float v)
-        {
-            glm::vec2 uvc(clamp01(u), clamp01(v));
-            glm::vec3 pL = m_terrainGen.sampleSurfacePos(uvc.x, uvc.y);
-            glm::vec3 pW = glm::vec3(m_terrainModel * glm::vec4(pL, 1.f));
-            return pW.y;
-        };
-
-        const float eps = 1.0f / 512.0f;
-        float h0 = pWorld.y;
-        float hdx = sampleHeightWorld(uv.x + eps, uv.y);
-        float hdy = sampleHeightWorld(uv.x, uv.y + eps);
-
-        glm::vec3 dx = glm::vec3(eps, hdx - h0, 0.f);
-        glm::vec3 dz = glm::vec3(0.f, hdy - h0, eps);
-        glm::vec3 nWorld = glm::normalize(glm::cross(dz, dx));
-
-        float slope = glm::clamp(1.0f - glm::dot(nWorld, glm::vec3(0, 1, 0)), 0.0f, 1.0f);
-
-        // Place rocks on beaches or slopes, but not too steep
-        bool isBeach = (pWorld.y < seaHeightWorld + 0.1f * heightScale);
-        bool isSlope = (slope > 0.3f && slope < 0.8f);
-
-        if (!isBeach && !isSlope)
-        {
-            // Randomly place some on flat ground too, but fewer
-            if (dist01(rng) > 0.1f)
-                continue;
-        }
-
-        // Transform
-        float scaleBase = 0.5f + 1.5f * dist01(rng); // Random size
-        glm::vec3 scale(scaleBase);
-
-        // Deform slightly to look like a rock
-        scale.x *= 0.8f + 0.4f * dist01(rng);
-        scale.y *= 0.6f + 0.4f * dist01(rng); // Flatter
-        scale.z *= 0.8f + 0.4f * dist01(rng);
-
-        float yaw = 2.f * float(M_PI) * dist01(rng);
-        float pitch = 2.f * float(M_PI) * dist01(rng);
-        float roll = 2.f * float(M_PI) * dist01(rng);
-
-        glm::mat4 T = glm::translate(glm::mat4(1.f), pWorld);
-        glm::mat4 R = glm::rotate(glm::mat4(1.f), yaw, glm::vec3(0, 1, 0));
-        R = glm::rotate(R, pitch, glm::vec3(1, 0, 0));
-        R = glm::rotate(R, roll, glm::vec3(0, 0, 1));
-        glm::mat4 S = glm::scale(glm::mat4(1.f), scale);
-
-        // Sink the rock slightly into the ground
-        T = glm::translate(T, glm::vec3(0, -0.2f * scale.y, 0));
-
-        m_rocks.push_back(T * R * S);
-    }
+    RockPlacementParams placement;
+    placement.density = settings.shapeParameter7;
+    placement.seaLevel = m_terrainParams.seaLevel;
+    placement.heightScale = m_terrainParams.heightScale;
+    m_rocks = placeRocks(m_terrainGen, m_terrainModel, placement);
 
     std::cout << "[buildRocks] rocks=" << m_rocks.size() << "\n";
 
     // Upload to VBO
     m_rockInstanceCount = static_cast<GLsizei>(m_rocks.size());
     if (!m_rocks.empty())
+        uploadInstanceMatrices(m_rockMesh, m_rockInstanceVBO, m_rocks.data(), m_rocks.size());
+}
+
+void Realtime::uploadInstanceMatrices(GLMesh *mesh, GLBuffer &vbo, const glm::mat4 *models, std::size_t count)
+{
+    // A fresh buffer rather than glBufferData on the old one, which the GPU may
+    // still be reading; the old buffer is deleted once its frames have finished.
+    GLBuffer fresh = GLBuffer::create();
+    glState.bindVertexArray(mesh->vao);
+    glBindBuffer(GL_ARRAY_BUFFER, fresh);
+    statBufferData(GL_ARRAY_BUFFER, count * sizeof(glm::mat4), models, GL_STATIC_DRAW);
+
+    // mat4 occupies 4 vec4 attributes: location 2, 3, 4, 5
+    std::size_t vec4Size = sizeof(glm::vec4);
+    GLsizei stride = sizeof(glm::mat4);
+    for (int i = 0; i < 4; ++i)
     {
-        glBindBuffer(GL_ARRAY_BUFFER, m_rockInstanceVBO);
-        glBufferData(GL_ARRAY_BUFFER,
-                     m_rocks.size() * sizeof(glm::mat4),
-                     m_rocks.data(),
-                     GL_STATIC_DRAW);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        GLuint loc = 2 + i;
+        glEnableVertexAttribArray(loc);
+        glVertexAttribPointer(loc, 4, GL_FLOAT, GL_FALSE, stride, (void *)(i * vec4Size));
+        glVertexAttribDivisor(loc, 1); // one copy per instance
     }
+    glState.bindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    vbo = std::move(fresh);
 }
 
-GLuint Realtime::loadTexture2D(const QString &path, bool srgb)
+GLTexture Realtime::loadTexture2D(const QString &path, bool srgb)
 {
+    TRACE_SCOPE("loadTexture2D");
+    QImage img = decodeTexture2D(path);
+    if (img.isNull())
+        return {};
+    return uploadTexture2D(img, srgb);
+}
+
+QImage Realtime::decodeTexture2D(const QString &path)
+{
+    TRACE_SCOPE("decodeTexture2D");
     QImage img(path);
     if (img.isNull())
     {
         qWarning("Failed to load texture: %s", qPrintable(path));
-        return 0;
+        return img;
     }
 
-    img = img.convertToFormat(QImage::Format_RGBA8888).flipped(Qt::Vertical); // OpenGL: origin left-bottom corner
+    return img.convertToFormat(QImage::Format_RGBA8888).flipped(Qt::Vertical); // OpenGL: origin left-bottom corner
+}
 
-    GLuint tex = 0;
-    glGenTextures(1, &tex);
-    glBindTexture(GL_TEXTURE_2D, tex);
+GLTexture Realtime::uploadTexture2D(const QImage &img, bool srgb)
+{
+    if (img.isNull())
+        return {};
+
+    GLTexture tex = GLTexture::create();
+    statBindTexture(GL_TEXTURE_2D, tex);
 
     GLenum internalFmt = srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8;
 
     glTexImage2D(GL_TEXTURE_2D, 0, internalFmt,
                  img.width(), img.height(), 0,
-                 GL_RGBA, GL_UNSIGNED_BYTE, img.bits());
+                 GL_RGBA, GL_UNSIGNED_BYTE, img.constBits());
 
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
@@ -566,112 +998,48 @@ GLuint Realtime::loadTexture2D(const QString &path, bool srgb)
 
     glGenerateMipmap(GL_TEXTURE_2D);
 
-    glBindTexture(GL_TEXTURE_2D, 0);
+    statBindTexture(GL_TEXTURE_2D, 0);
     return tex;
 }
 
-GLuint Realtime::loadCubemap(const std::vector<QString> &faces)
+GLProgram Realtime::buildProgram(const char *vert, const char *frag, const char *label)
 {
-    GLuint textureID;
-    glGenTextures(1, &textureID);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
-
-    for (unsigned int i = 0; i < faces.size(); i++)
+    try
     {
-        QImage img(faces[i]);
-        if (img.isNull()) {
-            std::cout << "Cubemap texture failed to load at path: " << faces[i].toStdString() << std::endl;
-            continue;
-        }
-        img = img.convertToFormat(QImage::Format_RGBA8888); 
-    
-        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGBA, 
-                     img.width(), img.height(), 0, GL_RGBA, GL_UNSIGNED_BYTE, img.bits());
+        return GLProgram::adopt(ShaderLoader::createShaderProgram(vert, frag));
+    }
+    catch (const std::exception &e)
+    {
+        qWarning("%s shader compile/link error: %s", label, e.what());
+        return {};
     }
-
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-
-    return textureID;
 }
 
-void Realtime::destroySceneFBO()
+void Realtime::releaseSceneTargets()
 {
-    if (m_texSceneColor)
-    {
-        glDeleteTextures(1, &m_texSceneColor);
-        m_texSceneColor = 0;
-    }
-    if (m_texSceneDepth)
-    {
-        glDeleteTextures(1, &m_texSceneDepth);
-        m_texSceneDepth = 0;
-    }
-    if (m_fboScene)
-    {
-        glDeleteFramebuffers(1, &m_fboScene);
-        m_fboScene = 0;
-    }
-    m_sceneWidth = 0;
-    m_sceneHeight = 0;
+    m_rtPool.release(m_rtSceneColor);
+    m_rtPool.release(m_rtSceneDepth);
+    m_fboScene = 0;
 }
 
-void Realtime::ensureSceneFBO(int w, int h)
+void Realtime::acquireSceneTargets(int w, int h)
 {
     if (w <= 0 || h <= 0)
         return;
 
-    if (w == m_sceneWidth && h == m_sceneHeight &&
-        m_fboScene && m_texSceneColor && m_texSceneDepth)
-    {
-        return;
-    }
-
-    destroySceneFBO();
-
-    m_sceneWidth = w;
-    m_sceneHeight = h;
-
-    // FBO
-    glGenFramebuffers(1, &m_fboScene);
-    glBindFramebuffer(GL_FRAMEBUFFER, m_fboScene);
-
-    // Color attachment (HDR-friendly, use RGBA16F)
-    glGenTextures(1, &m_texSceneColor);
-    glBindTexture(GL_TEXTURE_2D, m_texSceneColor);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F,
-                 w, h, 0, GL_RGBA, GL_FLOAT, nullptr);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
-                           GL_TEXTURE_2D, m_texSceneColor, 0);
-
-    // Depth attachment
-    glGenTextures(1, &m_texSceneDepth);
-    glBindTexture(GL_TEXTURE_2D, m_texSceneDepth);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24,
-                 w, h, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
-                           GL_TEXTURE_2D, m_texSceneDepth, 0);
-
-    GLenum bufs[1] = {GL_COLOR_ATTACHMENT0};
-    glDrawBuffers(1, bufs);
-
-    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-    {
-        qWarning("Scene FBO incomplete!");
-    }
+    // Color attachment (HDR-friendly, use RGBA16F). Sizes are bucketed by the pool,
+    // so a resize only reallocates when it crosses a bucket boundary.
+    m_rtSceneColor = m_rtPool.acquire(GL_RGBA16F, w, h);
+    m_rtSceneDepth = m_rtPool.acquire(GL_DEPTH_COMPONENT24, w, h);
+    m_fboScene = m_rtPool.framebuffer(m_rtSceneColor, m_rtSceneDepth);
+}
 
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+void Realtime::releaseWaterTargets()
+{
+    m_rtPool.release(m_rtReflection);
+    m_rtPool.release(m_rtReflectionDepth);
+    m_rtPool.release(m_rtRefraction);
+    m_rtPool.release(m_rtRefractionDepth);
 }
 
 void Realtime::createScreenQuad()
@@ -739,52 +1107,39 @@ glm::mat4 Realtime::createMirroredViewMatrix(float waterHeight)
 
 void Realtime::renderScene()
 {
+    // main view, minus whatever the quality governor has dropped
+    const PassPolicy mainPolicy = mainViewPolicy();
 
     // global sun/ambient definition
-    glm::vec3 sunDir = glm::normalize(glm::vec3(0.3f, -1.0f, 0.2f));
+    glm::vec3 sunDir = sunDirection();
     glm::vec3 sunColor = glm::vec3(2.5f);
     glm::vec3 ambColor = glm::vec3(0.35f); // unified ambient light of "skylight + ground reflection"
 
-    // sky color + fog density
-    glm::vec3 fogColor(0.55f, 0.70f, 0.90f); // FIXME: can be set similar to color of the sky and horizon.
-    float fogDensity = 0.02f;                // 0.01 to 0.03
-
     // skybox
     if (m_progSky && m_skyCube)
     {
-        glDepthMask(GL_FALSE); // not specify depth, just draw the background
+        glState.depthMask(GL_FALSE); // not specify depth, just draw the background
 
         // turn off backface culling for "back face" rendering
-        glDisable(GL_CULL_FACE);
+        glState.disable(GL_CULL_FACE);
 
-        glUseProgram(m_progSky);
+        glState.useProgram(m_progSky);
 
         auto setSkyMat4 = [&](const char *name, const glm::mat4 &M)
         {
-            glUniformMatrix4fv(glGetUniformLocation(m_progSky, name), 1, GL_FALSE, &M[0][0]);
+            statUniform(glUniformMatrix4fv, glGetUniformLocation(m_progSky, name), 1, GL_FALSE, &M[0][0]);
         };
 
         glm::mat4 viewNoTrans = glm::mat4(glm::mat3(m_cam.view()));
         setSkyMat4("uView", viewNoTrans);
         setSkyMat4("uProj", m_cam.proj());
 
-        glActiveTexture(GL_TEXTURE0);
-        
-        // 逻辑判断：如果 Preset 是 3 (Rainy) 或 1 (Cold/Snow)，使用雨天贴图
-        // 否则使用晴天贴图
-        if (settings.colorGradePreset == 3 || settings.colorGradePreset == 1) {
-            glBindTexture(GL_TEXTURE_CUBE_MAP, m_texSkyRainy);
-        } else {
-            glBindTexture(GL_TEXTURE_CUBE_MAP, m_texSkySunny);
-        }
-        
-        // 传递给 Shader (假设 samplerCube 名字叫 uSkybox)
-        glUniform1i(glGetUniformLocation(m_progSky, "uSkybox"), 0);
+        m_atmosphere.bindSky(m_progSky, 0);
 
         m_skyCube->draw();
 
-        glEnable(GL_CULL_FACE);
-        glDepthMask(GL_TRUE);
+        glState.enable(GL_CULL_FACE);
+        glState.depthMask(GL_TRUE);
     }
 
     // terrain
@@ -792,158 +1147,163 @@ void Realtime::renderScene()
     {
         glPolygonMode(GL_FRONT_AND_BACK, m_terrainWire ? GL_LINE : GL_FILL);
 
-        glUseProgram(m_progTerrain);
+        glState.useProgram(m_progTerrain);
 
         auto set4 = [&](const char *n, const glm::mat4 &M)
         {
-            glUniformMatrix4fv(glGetUniformLocation(m_progTerrain, n),
-                               1, GL_FALSE, &M[0][0]);
+            statUniform(glUniformMatrix4fv, glGetUniformLocation(m_progTerrain, n),
+                        1, GL_FALSE, &M[0][0]);
         };
         set4("uProj", m_cam.proj());
         set4("uView", m_cam.view());
         set4("uModel", m_terrainModel);
-        glUniform1i(glGetUniformLocation(m_progTerrain, "wireshade"),
+        statUniform(glUniform1i, glGetUniformLocation(m_progTerrain, "wireshade"),
                     m_terrainWire ? 1 : 0);
 
         // Lighting & Height Parameters
-        glUniform3fv(glGetUniformLocation(m_progTerrain, "uEye"), 1, &m_cam.eye[0]);
+        statUniform(glUniform3fv, glGetUniformLocation(m_progTerrain, "uEye"), 1, &m_cam.eye[0]);
 
-        glUniform3fv(glGetUniformLocation(m_progTerrain, "uSunDir"), 1, &sunDir[0]);
-        glUniform3fv(glGetUniformLocation(m_progTerrain, "uSunColor"), 1, &sunColor[0]);
-        glUniform3fv(glGetUniformLocation(m_progTerrain, "uAmbientColor"), 1, &ambColor[0]);
+        statUniform(glUniform3fv, glGetUniformLocation(m_progTerrain, "uSunDir"), 1, &sunDir[0]);
+        statUniform(glUniform3fv, glGetUniformLocation(m_progTerrain, "uSunColor"), 1, &sunColor[0]);
+        statUniform(glUniform3fv, glGetUniformLocation(m_progTerrain, "uAmbientColor"), 1, &ambColor[0]);
 
-        glUniform1i(glGetUniformLocation(m_progTerrain, "uEnableFog"), m_enableFog);
-        glUniform1f(glGetUniformLocation(m_progTerrain, "uFogDensity"), m_fogDensity);
-        glUniform3fv(glGetUniformLocation(m_progTerrain, "uFogColor"), 1, &m_fogColor[0]);
+        statUniform(glUniform1i, glGetUniformLocation(m_progTerrain, "uEnableFog"), m_enableFog);
+        m_atmosphere.bindAerialPerspective(m_progTerrain, AERIAL_PERSPECTIVE_UNIT, m_cam.eye);
+        setClusterUniforms(m_progTerrain, true);
 
-        glUniform1f(glGetUniformLocation(m_progTerrain, "uSeaHeight"), m_seaHeightWorld);
-        glUniform1f(glGetUniformLocation(m_progTerrain, "uHeightScale"), m_heightScaleWorld);
+        statUniform(glUniform1f, glGetUniformLocation(m_progTerrain, "uSeaHeight"), m_seaHeightWorld);
+        statUniform(glUniform1f, glGetUniformLocation(m_progTerrain, "uHeightScale"), m_heightScaleWorld);
 
         // normal intentisty
-        glUniform1f(glGetUniformLocation(m_progTerrain, "uNormalStrength"), 1.15f);
+        statUniform(glUniform1f, glGetUniformLocation(m_progTerrain, "uNormalStrength"), 1.15f);
 
         // bind texture to sampler
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, m_texGrassAlbedo);
-        glUniform1i(glGetUniformLocation(m_progTerrain, "uGrassAlbedo"), 0);
+        glState.activeTexture(GL_TEXTURE0);
+        statBindTexture(GL_TEXTURE_2D, m_texGrassAlbedo);
+        statUniform(glUniform1i, glGetUniformLocation(m_progTerrain, "uGrassAlbedo"), 0);
 
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, m_texRockAlbedo);
-        glUniform1i(glGetUniformLocation(m_progTerrain, "uRockAlbedo"), 1);
+        glState.activeTexture(GL_TEXTURE1);
+        statBindTexture(GL_TEXTURE_2D, m_texRockAlbedo);
+        statUniform(glUniform1i, glGetUniformLocation(m_progTerrain, "uRockAlbedo"), 1);
 
-        glActiveTexture(GL_TEXTURE2);
-        glBindTexture(GL_TEXTURE_2D, m_texBeachAlbedo);
-        glUniform1i(glGetUniformLocation(m_progTerrain, "uBeachAlbedo"), 2);
+        glState.activeTexture(GL_TEXTURE2);
+        statBindTexture(GL_TEXTURE_2D, m_texBeachAlbedo);
+        statUniform(glUniform1i, glGetUniformLocation(m_progTerrain, "uBeachAlbedo"), 2);
 
-        glActiveTexture(GL_TEXTURE3);
-        glBindTexture(GL_TEXTURE_2D, m_texGrassNormal);
-        glUniform1i(glGetUniformLocation(m_progTerrain, "uGrassNormal"), 3);
+        glState.activeTexture(GL_TEXTURE3);
+        statBindTexture(GL_TEXTURE_2D, m_texGrassNormal);
+        statUniform(glUniform1i, glGetUniformLocation(m_progTerrain, "uGrassNormal"), 3);
 
-        glActiveTexture(GL_TEXTURE4);
-        glBindTexture(GL_TEXTURE_2D, m_texRockNormal);
-        glUniform1i(glGetUniformLocation(m_progTerrain, "uRockNormal"), 4);
+        glState.activeTexture(GL_TEXTURE4);
+        statBindTexture(GL_TEXTURE_2D, m_texRockNormal);
+        statUniform(glUniform1i, glGetUniformLocation(m_progTerrain, "uRockNormal"), 4);
 
-        glActiveTexture(GL_TEXTURE5);
-        glBindTexture(GL_TEXTURE_2D, m_texBeachNormal);
-        glUniform1i(glGetUniformLocation(m_progTerrain, "uBeachNormal"), 5);
+        glState.activeTexture(GL_TEXTURE5);
+        statBindTexture(GL_TEXTURE_2D, m_texBeachNormal);
+        statUniform(glUniform1i, glGetUniformLocation(m_progTerrain, "uBeachNormal"), 5);
 
-        glActiveTexture(GL_TEXTURE6);
-        glBindTexture(GL_TEXTURE_2D, m_texGrassRough);
-        glUniform1i(glGetUniformLocation(m_progTerrain, "uGrassRough"), 6);
+        glState.activeTexture(GL_TEXTURE6);
+        statBindTexture(GL_TEXTURE_2D, m_texGrassRough);
+        statUniform(glUniform1i, glGetUniformLocation(m_progTerrain, "uGrassRough"), 6);
 
-        glActiveTexture(GL_TEXTURE7);
-        glBindTexture(GL_TEXTURE_2D, m_texRockRough);
-        glUniform1i(glGetUniformLocation(m_progTerrain, "uRockRough"), 7);
+        glState.activeTexture(GL_TEXTURE7);
+        statBindTexture(GL_TEXTURE_2D, m_texRockRough);
+        statUniform(glUniform1i, glGetUniformLocation(m_progTerrain, "uRockRough"), 7);
 
-        glActiveTexture(GL_TEXTURE8);
-        glBindTexture(GL_TEXTURE_2D, m_texBeachRough);
-        glUniform1i(glGetUniformLocation(m_progTerrain, "uBeachRough"), 8);
+        glState.activeTexture(GL_TEXTURE8);
+        statBindTexture(GL_TEXTURE_2D, m_texBeachRough);
+        statUniform(glUniform1i, glGetUniformLocation(m_progTerrain, "uBeachRough"), 8);
 
-        glActiveTexture(GL_TEXTURE9);
-        glBindTexture(GL_TEXTURE_2D, m_texRockHighAlbedo);
-        glUniform1i(glGetUniformLocation(m_progTerrain, "uRockHighAlbedo"), 9);
+        glState.activeTexture(GL_TEXTURE9);
+        statBindTexture(GL_TEXTURE_2D, m_texRockHighAlbedo);
+        statUniform(glUniform1i, glGetUniformLocation(m_progTerrain, "uRockHighAlbedo"), 9);
 
-        glActiveTexture(GL_TEXTURE10);
-        glBindTexture(GL_TEXTURE_2D, m_texRockHighNormal);
-        glUniform1i(glGetUniformLocation(m_progTerrain, "uRockHighNormal"), 10);
+        glState.activeTexture(GL_TEXTURE10);
+        statBindTexture(GL_TEXTURE_2D, m_texRockHighNormal);
+        statUniform(glUniform1i, glGetUniformLocation(m_progTerrain, "uRockHighNormal"), 10);
 
-        glActiveTexture(GL_TEXTURE11);
-        glBindTexture(GL_TEXTURE_2D, m_texRockHighRough);
-        glUniform1i(glGetUniformLocation(m_progTerrain, "uRockHighRough"), 11);
+        glState.activeTexture(GL_TEXTURE11);
+        statBindTexture(GL_TEXTURE_2D, m_texRockHighRough);
+        statUniform(glUniform1i, glGetUniformLocation(m_progTerrain, "uRockHighRough"), 11);
 
-        glActiveTexture(GL_TEXTURE12);
-        glBindTexture(GL_TEXTURE_2D, m_texSnowAlbedo);
-        glUniform1i(glGetUniformLocation(m_progTerrain, "uSnowAlbedo"), 12);
+        glState.activeTexture(GL_TEXTURE12);
+        statBindTexture(GL_TEXTURE_2D, m_texSnowAlbedo);
+        statUniform(glUniform1i, glGetUniformLocation(m_progTerrain, "uSnowAlbedo"), 12);
 
-        glActiveTexture(GL_TEXTURE13);
-        glBindTexture(GL_TEXTURE_2D, m_texSnowNormal);
-        glUniform1i(glGetUniformLocation(m_progTerrain, "uSnowNormal"), 13);
+        glState.activeTexture(GL_TEXTURE13);
+        statBindTexture(GL_TEXTURE_2D, m_texSnowNormal);
+        statUniform(glUniform1i, glGetUniformLocation(m_progTerrain, "uSnowNormal"), 13);
 
-        glActiveTexture(GL_TEXTURE14);
-        glBindTexture(GL_TEXTURE_2D, m_texSnowRough);
-        glUniform1i(glGetUniformLocation(m_progTerrain, "uSnowRough"), 14);
+        glState.activeTexture(GL_TEXTURE14);
+        statBindTexture(GL_TEXTURE_2D, m_texSnowRough);
+        statUniform(glUniform1i, glGetUniformLocation(m_progTerrain, "uSnowRough"), 14);
 
-        m_terrainMesh.draw();
+        drawTerrainPatches(mainPolicy.terrainLod, m_cam.proj() * m_cam.view(), mainPolicy);
 
         glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
     }
 
     // water
     if (m_progWater) {
-        glEnable(GL_BLEND);
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-        glDepthMask(GL_FALSE);
+        glState.enable(GL_BLEND);
+        glState.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        glState.depthMask(GL_FALSE);
 
-        glUseProgram(m_progWater);
+        glState.useProgram(m_progWater);
 
-        glUniformMatrix4fv(glGetUniformLocation(m_progWater, "model_matrix"), 1, GL_FALSE, &m_terrainModel[0][0]);
-        glUniformMatrix4fv(glGetUniformLocation(m_progWater, "view_matrix"), 1, GL_FALSE, &m_cam.view()[0][0]);
-        glUniformMatrix4fv(glGetUniformLocation(m_progWater, "proj_matrix"), 1, GL_FALSE, &m_cam.proj()[0][0]);
-        glUniform3fv(glGetUniformLocation(m_progWater, "ws_cam_pos"), 1, &m_cam.eye[0]);
+        statUniform(glUniformMatrix4fv, glGetUniformLocation(m_progWater, "model_matrix"), 1, GL_FALSE, &m_terrainModel[0][0]);
+        statUniform(glUniformMatrix4fv, glGetUniformLocation(m_progWater, "view_matrix"), 1, GL_FALSE, &m_cam.view()[0][0]);
+        statUniform(glUniformMatrix4fv, glGetUniformLocation(m_progWater, "proj_matrix"), 1, GL_FALSE, &m_cam.proj()[0][0]);
+        statUniform(glUniform3fv, glGetUniformLocation(m_progWater, "ws_cam_pos"), 1, &m_cam.eye[0]);
 
-        glUniform1i(glGetUniformLocation(m_progWater, "uEnableFog"), m_enableFog);
-        glUniform1f(glGetUniformLocation(m_progWater, "uFogDensity"), m_fogDensity);
-        glUniform3fv(glGetUniformLocation(m_progWater, "uFogColor"), 1, &m_fogColor[0]);
+        statUniform(glUniform1i, glGetUniformLocation(m_progWater, "uEnableFog"), m_enableFog);
+        m_atmosphere.bindAerialPerspective(m_progWater, AERIAL_PERSPECTIVE_UNIT, m_cam.eye);
 
         m_waterMesh.draw();
 
-        glDepthMask(GL_TRUE);
-        glDisable(GL_BLEND);
+        glState.depthMask(GL_TRUE);
+        glState.disable(GL_BLEND);
     }
 
     // forest: use instance rendering shader
     if (m_drawForest && m_treeCylinderMesh && m_branchInstanceCount > 0)
     {
-        glUseProgram(m_progForest);
+        ForestRuns runs;
+        collectForestRuns(m_cam.proj() * m_cam.view(), mainPolicy, runs);
+
+        glState.useProgram(m_progForest);
 
         auto setMat4 = [&](const char *name, const glm::mat4 &M)
         {
-            glUniformMatrix4fv(glGetUniformLocation(m_progForest, name),
-                               1, GL_FALSE, &M[0][0]);
+            statUniform(glUniformMatrix4fv, glGetUniformLocation(m_progForest, name),
+                        1, GL_FALSE, &M[0][0]);
         };
 
         setMat4("uView", m_cam.view());
         setMat4("uProj", m_cam.proj());
-        glUniform3fv(glGetUniformLocation(m_progForest, "uEye"), 1, &m_cam.eye[0]);
+        statUniform(glUniform3fv, glGetUniformLocation(m_progForest, "uEye"), 1, &m_cam.eye[0]);
 
         // sunlight / ambientlLight / fog
-        glUniform3fv(glGetUniformLocation(m_progForest, "uSunDir"), 1, &sunDir[0]);
-        glUniform3fv(glGetUniformLocation(m_progForest, "uSunColor"), 1, &sunColor[0]);
-        glUniform3fv(glGetUniformLocation(m_progForest, "uAmbientColor"), 1, &ambColor[0]);
-        glUniform3fv(glGetUniformLocation(m_progForest, "uFogColor"), 1, &fogColor[0]);
-        glUniform1f(glGetUniformLocation(m_progForest, "uFogDensity"), fogDensity);
+        statUniform(glUniform3fv, glGetUniformLocation(m_progForest, "uSunDir"), 1, &sunDir[0]);
+        statUniform(glUniform3fv, glGetUniformLocation(m_progForest, "uSunColor"), 1, &sunColor[0]);
+        statUniform(glUniform3fv, glGetUniformLocation(m_progForest, "uAmbientColor"), 1, &ambColor[0]);
+        m_atmosphere.bindAerialPerspective(m_progForest, AERIAL_PERSPECTIVE_UNIT, m_cam.eye);
+        setClusterUniforms(m_progForest, true);
 
         // first, draw the tree branches (brown texture)
         glm::vec3 barkKa(0.1f, 0.08f, 0.05f);
         glm::vec3 barkKd(0.3f, 0.22f, 0.15f);
         glm::vec3 barkKs(0.02f);
 
-        glUniform3fv(glGetUniformLocation(m_progForest, "u_mat.ka"), 1, &barkKa[0]);
-        glUniform3fv(glGetUniformLocation(m_progForest, "u_mat.kd"), 1, &barkKd[0]);
-        glUniform3fv(glGetUniformLocation(m_progForest, "u_mat.ks"), 1, &barkKs[0]);
-        glUniform1f(glGetUniformLocation(m_progForest, "u_mat.shininess"), 12.f);
+        statUniform(glUniform3fv, glGetUniformLocation(m_progForest, "u_mat.ka"), 1, &barkKa[0]);
+        statUniform(glUniform3fv, glGetUniformLocation(m_progForest, "u_mat.kd"), 1, &barkKd[0]);
+        statUniform(glUniform3fv, glGetUniformLocation(m_progForest, "u_mat.ks"), 1, &barkKs[0]);
+        statUniform(glUniform1f, glGetUniformLocation(m_progForest, "u_mat.shininess"), 12.f);
 
-        m_treeCylinderMesh->drawInstanced(m_branchInstanceCount);
+        if (runs.limitTrees)
+            drawInstanceRuns(m_treeCylinderMesh, m_branchInstanceVBO, runs.branches);
+        else
+            m_treeCylinderMesh->drawInstanced(m_branchInstanceCount);
 
         // then, draw the leaves (green texture)
         if (m_leafMesh && m_leafInstanceCount > 0)
@@ -953,12 +1313,15 @@ void Realtime::renderScene()
             ;
             glm::vec3 leafKs(0.03f);
 
-            glUniform3fv(glGetUniformLocation(m_progForest, "u_mat.ka"), 1, &leafKa[0]);
-            glUniform3fv(glGetUniformLocation(m_progForest, "u_mat.kd"), 1, &leafKd[0]);
-            glUniform3fv(glGetUniformLocation(m_progForest, "u_mat.ks"), 1, &leafKs[0]);
-            glUniform1f(glGetUniformLocation(m_progForest, "u_mat.shininess"), 10.f);
+            statUniform(glUniform3fv, glGetUniformLocation(m_progForest, "u_mat.ka"), 1, &leafKa[0]);
+            statUniform(glUniform3fv, glGetUniformLocation(m_progForest, "u_mat.kd"), 1, &leafKd[0]);
+            statUniform(glUniform3fv, glGetUniformLocation(m_progForest, "u_mat.ks"), 1, &leafKs[0]);
+            statUniform(glUniform1f, glGetUniformLocation(m_progForest, "u_mat.shininess"), 10.f);
 
-            m_leafMesh->drawInstanced(m_leafInstanceCount);
+            if (runs.limitTrees)
+                drawInstanceRuns(m_leafMesh, m_leafInstanceVBO, runs.leaves);
+            else
+                m_leafMesh->drawInstanced(m_leafInstanceCount);
         }
 
         // then, draw the rocks (gray texture)
@@ -968,283 +1331,297 @@ void Realtime::renderScene()
             glm::vec3 rockKd(0.4f, 0.4f, 0.4f);
             glm::vec3 rockKs(0.1f);
 
-            glUniform3fv(glGetUniformLocation(m_progForest, "u_mat.ka"), 1, &rockKa[0]);
-            glUniform3fv(glGetUniformLocation(m_progForest, "u_mat.kd"), 1, &rockKd[0]);
-            glUniform3fv(glGetUniformLocation(m_progForest, "u_mat.ks"), 1, &rockKs[0]);
-            glUniform1f(glGetUniformLocation(m_progForest, "u_mat.shininess"), 10.f);
+            statUniform(glUniform3fv, glGetUniformLocation(m_progForest, "u_mat.ka"), 1, &rockKa[0]);
+            statUniform(glUniform3fv, glGetUniformLocation(m_progForest, "u_mat.kd"), 1, &rockKd[0]);
+            statUniform(glUniform3fv, glGetUniformLocation(m_progForest, "u_mat.ks"), 1, &rockKs[0]);
+            statUniform(glUniform1f, glGetUniformLocation(m_progForest, "u_mat.shininess"), 10.f);
 
-            m_rockMesh->drawInstanced(m_rockInstanceCount);
+            if (runs.limitRocks)
+                drawInstanceRuns(m_rockMesh, m_rockInstanceVBO, runs.rocks);
+            else
+                m_rockMesh->drawInstanced(m_rockInstanceCount);
         }
     }
 
+    // scene-file shapes, one instanced draw per mesh + material
+    drawSceneItems(sunDir, sunColor, ambColor);
+
     // Draw Particles
-    if (m_particleSystem)
+    if (m_particleSystem && m_simFrame)
     {
-        m_particleSystem->draw(m_cam.view(), m_cam.proj());
+        m_particleSystem->setDrawFraction(m_quality.level().particleFraction);
+        m_particleSystem->draw(m_simFrame->particles, m_simAlpha, m_cam.view(), m_cam.proj());
     }
 }
 
-void Realtime::renderSceneObject(const glm::mat4 &viewMatrix)
+void Realtime::renderSceneObject(const glm::mat4 &viewMatrix, const glm::mat4 &projMatrix, const PassPolicy &policy)
 {
     // global sun/ambient definition
-    glm::vec3 sunDir = glm::normalize(glm::vec3(0.3f, -1.0f, 0.2f));
+    glm::vec3 sunDir = sunDirection();
     glm::vec3 sunColor = glm::vec3(2.5f);
     glm::vec3 ambColor = glm::vec3(0.35f); // unified ambient light of "skylight + ground reflection"
 
-    // sky color + fog density
-    glm::vec3 fogColor(0.55f, 0.70f, 0.90f); // FIXME: can be set similar to color of the sky and horizon.
-    float fogDensity = 0.02f;                // 0.01 to 0.03
-
     // skybox
-    if (m_progSky && m_skyCube)
+    if (policy.draws(PassPolicy::Sky) && m_progSky && m_skyCube)
     {
-        glDepthMask(GL_FALSE); // not specify depth, just draw the background
+        glState.depthMask(GL_FALSE); // not specify depth, just draw the background
 
         // turn off backface culling for "back face" rendering
-        glDisable(GL_CULL_FACE);
+        glState.disable(GL_CULL_FACE);
 
-        glUseProgram(m_progSky);
+        glState.useProgram(m_progSky);
 
         auto setSkyMat4 = [&](const char *name, const glm::mat4 &M)
         {
-            glUniformMatrix4fv(glGetUniformLocation(m_progSky, name), 1, GL_FALSE, &M[0][0]);
+            statUniform(glUniformMatrix4fv, glGetUniformLocation(m_progSky, name), 1, GL_FALSE, &M[0][0]);
         };
 
         glm::mat4 viewNoTrans = glm::mat4(glm::mat3(viewMatrix));
         setSkyMat4("uView", viewNoTrans);
-        setSkyMat4("uProj", m_cam.proj());
-
-        glActiveTexture(GL_TEXTURE0);
-        
-        // if Preset = 3 (Rainy) or 1 (Cold/Snow), use rainy skybox
-        // or use sunny skybox
-        if (settings.colorGradePreset == 3 || settings.colorGradePreset == 1) {
-            glBindTexture(GL_TEXTURE_CUBE_MAP, m_texSkyRainy);
-        } else {
-            glBindTexture(GL_TEXTURE_CUBE_MAP, m_texSkySunny);
-        }
-        
+        setSkyMat4("uProj", m_cam.proj()); // sky stays on the regular projection
 
-        glUniform1i(glGetUniformLocation(m_progSky, "uSkybox"), 0);
+        m_atmosphere.bindSky(m_progSky, 0);
 
         m_skyCube->draw();
 
-        glEnable(GL_CULL_FACE);
-        glDepthMask(GL_TRUE);
+        glState.enable(GL_CULL_FACE);
+        glState.depthMask(GL_TRUE);
     }
 
     // terrain
-    if (m_hasTerrain && m_progTerrain)
+    if (policy.draws(PassPolicy::Terrain) && m_hasTerrain && m_progTerrain)
     {
         glPolygonMode(GL_FRONT_AND_BACK, m_terrainWire ? GL_LINE : GL_FILL);
 
-        glUseProgram(m_progTerrain);
+        glState.useProgram(m_progTerrain);
 
         auto set4 = [&](const char *n, const glm::mat4 &M)
         {
-            glUniformMatrix4fv(glGetUniformLocation(m_progTerrain, n),
-                               1, GL_FALSE, &M[0][0]);
+            statUniform(glUniformMatrix4fv, glGetUniformLocation(m_progTerrain, n),
+                        1, GL_FALSE, &M[0][0]);
         };
-        set4("uProj", m_cam.proj());
+        set4("uProj", projMatrix);
         set4("uView", viewMatrix);
         set4("uModel", m_terrainModel);
-        glUniform1i(glGetUniformLocation(m_progTerrain, "wireshade"),
+        statUniform(glUniform1i, glGetUniformLocation(m_progTerrain, "wireshade"),
                     m_terrainWire ? 1 : 0);
 
         // Lighting & Height Parameters
-        glUniform3fv(glGetUniformLocation(m_progTerrain, "uEye"), 1, &m_cam.eye[0]);
+        statUniform(glUniform3fv, glGetUniformLocation(m_progTerrain, "uEye"), 1, &m_cam.eye[0]);
 
-        glUniform3fv(glGetUniformLocation(m_progTerrain, "uSunDir"), 1, &sunDir[0]);
-        glUniform3fv(glGetUniformLocation(m_progTerrain, "uSunColor"), 1, &sunColor[0]);
-        glUniform3fv(glGetUniformLocation(m_progTerrain, "uAmbientColor"), 1, &ambColor[0]);
+        statUniform(glUniform3fv, glGetUniformLocation(m_progTerrain, "uSunDir"), 1, &sunDir[0]);
+        statUniform(glUniform3fv, glGetUniformLocation(m_progTerrain, "uSunColor"), 1, &sunColor[0]);
+        statUniform(glUniform3fv, glGetUniformLocation(m_progTerrain, "uAmbientColor"), 1, &ambColor[0]);
 
-        glUniform3fv(glGetUniformLocation(m_progTerrain, "uFogColor"), 1, &fogColor[0]);
-        glUniform1f(glGetUniformLocation(m_progTerrain, "uFogDensity"), fogDensity);
+        m_atmosphere.bindAerialPerspective(m_progTerrain, AERIAL_PERSPECTIVE_UNIT, m_cam.eye);
+        setClusterUniforms(m_progTerrain, false); // the grid is for the main camera
 
-        glUniform1f(glGetUniformLocation(m_progTerrain, "uSeaHeight"), m_seaHeightWorld);
-        glUniform1f(glGetUniformLocation(m_progTerrain, "uHeightScale"), m_heightScaleWorld);
+        statUniform(glUniform1f, glGetUniformLocation(m_progTerrain, "uSeaHeight"), m_seaHeightWorld);
+        statUniform(glUniform1f, glGetUniformLocation(m_progTerrain, "uHeightScale"), m_heightScaleWorld);
 
         // normal intentisty
-        glUniform1f(glGetUniformLocation(m_progTerrain, "uNormalStrength"), 1.15f);
+        statUniform(glUniform1f, glGetUniformLocation(m_progTerrain, "uNormalStrength"), 1.15f);
 
         // bind texture to sampler
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, m_texGrassAlbedo);
-        glUniform1i(glGetUniformLocation(m_progTerrain, "uGrassAlbedo"), 0);
+        glState.activeTexture(GL_TEXTURE0);
+        statBindTexture(GL_TEXTURE_2D, m_texGrassAlbedo);
+        statUniform(glUniform1i, glGetUniformLocation(m_progTerrain, "uGrassAlbedo"), 0);
 
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, m_texRockAlbedo);
-        glUniform1i(glGetUniformLocation(m_progTerrain, "uRockAlbedo"), 1);
+        glState.activeTexture(GL_TEXTURE1);
+        statBindTexture(GL_TEXTURE_2D, m_texRockAlbedo);
+        statUniform(glUniform1i, glGetUniformLocation(m_progTerrain, "uRockAlbedo"), 1);
 
-        glActiveTexture(GL_TEXTURE2);
-        glBindTexture(GL_TEXTURE_2D, m_texBeachAlbedo);
-        glUniform1i(glGetUniformLocation(m_progTerrain, "uBeachAlbedo"), 2);
+        glState.activeTexture(GL_TEXTURE2);
+        statBindTexture(GL_TEXTURE_2D, m_texBeachAlbedo);
+        statUniform(glUniform1i, glGetUniformLocation(m_progTerrain, "uBeachAlbedo"), 2);
 
-        glActiveTexture(GL_TEXTURE3);
-        glBindTexture(GL_TEXTURE_2D, m_texGrassNormal);
-        glUniform1i(glGetUniformLocation(m_progTerrain, "uGrassNormal"), 3);
+        glState.activeTexture(GL_TEXTURE3);
+        statBindTexture(GL_TEXTURE_2D, m_texGrassNormal);
+        statUniform(glUniform1i, glGetUniformLocation(m_progTerrain, "uGrassNormal"), 3);
 
-        glActiveTexture(GL_TEXTURE4);
-        glBindTexture(GL_TEXTURE_2D, m_texRockNormal);
-        glUniform1i(glGetUniformLocation(m_progTerrain, "uRockNormal"), 4);
+        glState.activeTexture(GL_TEXTURE4);
+        statBindTexture(GL_TEXTURE_2D, m_texRockNormal);
+        statUniform(glUniform1i, glGetUniformLocation(m_progTerrain, "uRockNormal"), 4);
 
-        glActiveTexture(GL_TEXTURE5);
-        glBindTexture(GL_TEXTURE_2D, m_texBeachNormal);
-        glUniform1i(glGetUniformLocation(m_progTerrain, "uBeachNormal"), 5);
+        glState.activeTexture(GL_TEXTURE5);
+        statBindTexture(GL_TEXTURE_2D, m_texBeachNormal);
+        statUniform(glUniform1i, glGetUniformLocation(m_progTerrain, "uBeachNormal"), 5);
 
-        glActiveTexture(GL_TEXTURE6);
-        glBindTexture(GL_TEXTURE_2D, m_texGrassRough);
-        glUniform1i(glGetUniformLocation(m_progTerrain, "uGrassRough"), 6);
+        glState.activeTexture(GL_TEXTURE6);
+        statBindTexture(GL_TEXTURE_2D, m_texGrassRough);
+        statUniform(glUniform1i, glGetUniformLocation(m_progTerrain, "uGrassRough"), 6);
 
-        glActiveTexture(GL_TEXTURE7);
-        glBindTexture(GL_TEXTURE_2D, m_texRockRough);
-        glUniform1i(glGetUniformLocation(m_progTerrain, "uRockRough"), 7);
+        glState.activeTexture(GL_TEXTURE7);
+        statBindTexture(GL_TEXTURE_2D, m_texRockRough);
+        statUniform(glUniform1i, glGetUniformLocation(m_progTerrain, "uRockRough"), 7);
 
-        glActiveTexture(GL_TEXTURE8);
-        glBindTexture(GL_TEXTURE_2D, m_texBeachRough);
-        glUniform1i(glGetUniformLocation(m_progTerrain, "uBeachRough"), 8);
+        glState.activeTexture(GL_TEXTURE8);
+        statBindTexture(GL_TEXTURE_2D, m_texBeachRough);
+        statUniform(glUniform1i, glGetUniformLocation(m_progTerrain, "uBeachRough"), 8);
 
-        glActiveTexture(GL_TEXTURE9);
-        glBindTexture(GL_TEXTURE_2D, m_texRockHighAlbedo);
-        glUniform1i(glGetUniformLocation(m_progTerrain, "uRockHighAlbedo"), 9);
+        glState.activeTexture(GL_TEXTURE9);
+        statBindTexture(GL_TEXTURE_2D, m_texRockHighAlbedo);
+        statUniform(glUniform1i, glGetUniformLocation(m_progTerrain, "uRockHighAlbedo"), 9);
 
-        glActiveTexture(GL_TEXTURE10);
-        glBindTexture(GL_TEXTURE_2D, m_texRockHighNormal);
-        glUniform1i(glGetUniformLocation(m_progTerrain, "uRockHighNormal"), 10);
+        glState.activeTexture(GL_TEXTURE10);
+        statBindTexture(GL_TEXTURE_2D, m_texRockHighNormal);
+        statUniform(glUniform1i, glGetUniformLocation(m_progTerrain, "uRockHighNormal"), 10);
 
-        glActiveTexture(GL_TEXTURE11);
-        glBindTexture(GL_TEXTURE_2D, m_texRockHighRough);
-        glUniform1i(glGetUniformLocation(m_progTerrain, "uRockHighRough"), 11);
+        glState.activeTexture(GL_TEXTURE11);
+        statBindTexture(GL_TEXTURE_2D, m_texRockHighRough);
+        statUniform(glUniform1i, glGetUniformLocation(m_progTerrain, "uRockHighRough"), 11);
 
-        glActiveTexture(GL_TEXTURE12);
-        glBindTexture(GL_TEXTURE_2D, m_texSnowAlbedo);
-        glUniform1i(glGetUniformLocation(m_progTerrain, "uSnowAlbedo"), 12);
+        glState.activeTexture(GL_TEXTURE12);
+        statBindTexture(GL_TEXTURE_2D, m_texSnowAlbedo);
+        statUniform(glUniform1i, glGetUniformLocation(m_progTerrain, "uSnowAlbedo"), 12);
 
-        glActiveTexture(GL_TEXTURE13);
-        glBindTexture(GL_TEXTURE_2D, m_texSnowNormal);
-        glUniform1i(glGetUniformLocation(m_progTerrain, "uSnowNormal"), 13);
+        glState.activeTexture(GL_TEXTURE13);
+        statBindTexture(GL_TEXTURE_2D, m_texSnowNormal);
+        statUniform(glUniform1i, glGetUniformLocation(m_progTerrain, "uSnowNormal"), 13);
 
-        glActiveTexture(GL_TEXTURE14);
-        glBindTexture(GL_TEXTURE_2D, m_texSnowRough);
-        glUniform1i(glGetUniformLocation(m_progTerrain, "uSnowRough"), 14);
+        glState.activeTexture(GL_TEXTURE14);
+        statBindTexture(GL_TEXTURE_2D, m_texSnowRough);
+        statUniform(glUniform1i, glGetUniformLocation(m_progTerrain, "uSnowRough"), 14);
 
-        m_terrainMesh.draw();
+        // coarse LODs for secondary passes; patches culled against the view and water plane
+        drawTerrainPatches(policy.terrainLod, projMatrix * viewMatrix, policy);
 
         glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
     }
     // forest: use instance rendering shader
-    if (m_drawForest && m_treeCylinderMesh && m_branchInstanceCount > 0)
+    bool anyForest = policy.draws(PassPolicy::Branches | PassPolicy::Leaves | PassPolicy::Rocks);
+    if (anyForest && m_drawForest && m_treeCylinderMesh && m_branchInstanceCount > 0)
     {
-        glUseProgram(m_progForest);
+        ForestRuns runs;
+        collectForestRuns(projMatrix * viewMatrix, policy, runs);
+
+        glState.useProgram(m_progForest);
 
         auto setMat4 = [&](const char *name, const glm::mat4 &M)
         {
-            glUniformMatrix4fv(glGetUniformLocation(m_progForest, name),
-                               1, GL_FALSE, &M[0][0]);
+            statUniform(glUniformMatrix4fv, glGetUniformLocation(m_progForest, name),
+                        1, GL_FALSE, &M[0][0]);
         };
 
         setMat4("uView", viewMatrix);
-        setMat4("uProj", m_cam.proj());
-        glUniform3fv(glGetUniformLocation(m_progForest, "uEye"), 1, &m_cam.eye[0]);
+        setMat4("uProj", projMatrix);
+        statUniform(glUniform3fv, glGetUniformLocation(m_progForest, "uEye"), 1, &m_cam.eye[0]);
 
         // sunlight / ambientlLight / fog
-        glUniform3fv(glGetUniformLocation(m_progForest, "uSunDir"), 1, &sunDir[0]);
-        glUniform3fv(glGetUniformLocation(m_progForest, "uSunColor"), 1, &sunColor[0]);
-        glUniform3fv(glGetUniformLocation(m_progForest, "uAmbientColor"), 1, &ambColor[0]);
-        glUniform3fv(glGetUniformLocation(m_progForest, "uFogColor"), 1, &fogColor[0]);
-        glUniform1f(glGetUniformLocation(m_progForest, "uFogDensity"), fogDensity);
+        statUniform(glUniform3fv, glGetUniformLocation(m_progForest, "uSunDir"), 1, &sunDir[0]);
+        statUniform(glUniform3fv, glGetUniformLocation(m_progForest, "uSunColor"), 1, &sunColor[0]);
+        statUniform(glUniform3fv, glGetUniformLocation(m_progForest, "uAmbientColor"), 1, &ambColor[0]);
+        m_atmosphere.bindAerialPerspective(m_progForest, AERIAL_PERSPECTIVE_UNIT, m_cam.eye);
+        setClusterUniforms(m_progForest, false);
 
         // first, draw the tree branches (brown texture)
         glm::vec3 barkKa(0.1f, 0.08f, 0.05f);
         glm::vec3 barkKd(0.3f, 0.22f, 0.15f);
         glm::vec3 barkKs(0.02f);
 
-        glUniform3fv(glGetUniformLocation(m_progForest, "u_mat.ka"), 1, &barkKa[0]);
-        glUniform3fv(glGetUniformLocation(m_progForest, "u_mat.kd"), 1, &barkKd[0]);
-        glUniform3fv(glGetUniformLocation(m_progForest, "u_mat.ks"), 1, &barkKs[0]);
-        glUniform1f(glGetUniformLocation(m_progForest, "u_mat.shininess"), 12.f);
+        statUniform(glUniform3fv, glGetUniformLocation(m_progForest, "u_mat.ka"), 1, &barkKa[0]);
+        statUniform(glUniform3fv, glGetUniformLocation(m_progForest, "u_mat.kd"), 1, &barkKd[0]);
+        statUniform(glUniform3fv, glGetUniformLocation(m_progForest, "u_mat.ks"), 1, &barkKs[0]);
+        statUniform(glUniform1f, glGetUniformLocation(m_progForest, "u_mat.shininess"), 12.f);
 
-        m_treeCylinderMesh->drawInstanced(m_branchInstanceCount);
+        if (policy.draws(PassPolicy::Branches))
+        {
+            if (runs.limitTrees)
+                drawInstanceRuns(m_treeCylinderMesh, m_branchInstanceVBO, runs.branches);
+            else
+                m_treeCylinderMesh->drawInstanced(m_branchInstanceCount);
+        }
 
         // then, draw the leaves (green texture)
-        if (m_leafMesh && m_leafInstanceCount > 0)
+        if (policy.draws(PassPolicy::Leaves) && m_leafMesh && m_leafInstanceCount > 0)
         {
             glm::vec3 leafKa(0.05f, 0.10f, 0.05f);
             glm::vec3 leafKd(0.20f, 0.70f, 0.25f);
             ;
             glm::vec3 leafKs(0.03f);
 
-            glUniform3fv(glGetUniformLocation(m_progForest, "u_mat.ka"), 1, &leafKa[0]);
-            glUniform3fv(glGetUniformLocation(m_progForest, "u_mat.kd"), 1, &leafKd[0]);
-            glUniform3fv(glGetUniformLocation(m_progForest, "u_mat.ks"), 1, &leafKs[0]);
-            glUniform1f(glGetUniformLocation(m_progForest, "u_mat.shininess"), 10.f);
+            statUniform(glUniform3fv, glGetUniformLocation(m_progForest, "u_mat.ka"), 1, &leafKa[0]);
+            statUniform(glUniform3fv, glGetUniformLocation(m_progForest, "u_mat.kd"), 1, &leafKd[0]);
+            statUniform(glUniform3fv, glGetUniformLocation(m_progForest, "u_mat.ks"), 1, &leafKs[0]);
+            statUniform(glUniform1f, glGetUniformLocation(m_progForest, "u_mat.shininess"), 10.f);
 
-            m_leafMesh->drawInstanced(m_leafInstanceCount);
+            if (runs.limitTrees)
+                drawInstanceRuns(m_leafMesh, m_leafInstanceVBO, runs.leaves);
+            else
+                m_leafMesh->drawInstanced(m_leafInstanceCount);
         }
 
         // then, draw the rocks (gray texture)
-        if (m_rockMesh && m_rockInstanceCount > 0)
+        if (policy.draws(PassPolicy::Rocks) && m_rockMesh && m_rockInstanceCount > 0)
         {
             glm::vec3 rockKa(0.1f, 0.1f, 0.1f);
             glm::vec3 rockKd(0.4f, 0.4f, 0.4f);
             glm::vec3 rockKs(0.1f);
 
-            glUniform3fv(glGetUniformLocation(m_progForest, "u_mat.ka"), 1, &rockKa[0]);
-            glUniform3fv(glGetUniformLocation(m_progForest, "u_mat.kd"), 1, &rockKd[0]);
-            glUniform3fv(glGetUniformLocation(m_progForest, "u_mat.ks"), 1, &rockKs[0]);
-            glUniform1f(glGetUniformLocation(m_progForest, "u_mat.shininess"), 10.f);
+            statUniform(glUniform3fv, glGetUniformLocation(m_progForest, "u_mat.ka"), 1, &rockKa[0]);
+            statUniform(glUniform3fv, glGetUniformLocation(m_progForest, "u_mat.kd"), 1, &rockKd[0]);
+            statUniform(glUniform3fv, glGetUniformLocation(m_progForest, "u_mat.ks"), 1, &rockKs[0]);
+            statUniform(glUniform1f, glGetUniformLocation(m_progForest, "u_mat.shininess"), 10.f);
 
             // Bind texture
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, m_texRockObjAlbedo);
-            glUniform1i(glGetUniformLocation(m_progForest, "uTexture"), 15);
-            glUniform1i(glGetUniformLocation(m_progForest, "uUseTexture"), 1);
+            glState.activeTexture(GL_TEXTURE0);
+            statBindTexture(GL_TEXTURE_2D, m_texRockObjAlbedo);
+            statUniform(glUniform1i, glGetUniformLocation(m_progForest, "uTexture"), 0); // the unit bound above
+            statUniform(glUniform1i, glGetUniformLocation(m_progForest, "uUseTexture"), 1);
 
-            m_rockMesh->drawInstanced(m_rockInstanceCount);
+            if (runs.limitRocks)
+                drawInstanceRuns(m_rockMesh, m_rockInstanceVBO, runs.rocks);
+            else
+                m_rockMesh->drawInstanced(m_rockInstanceCount);
 
             // Reset
-            glUniform1i(glGetUniformLocation(m_progForest, "uUseTexture"), 0);
+            statUniform(glUniform1i, glGetUniformLocation(m_progForest, "uUseTexture"), 0);
         }
     }
 }
 
-// Reflection: Render scene above water to m_reflectionFBO
+// Reflection: Render scene above water to m_rtReflection
 void Realtime::renderReflection()
 {
-    glBindFramebuffer(GL_FRAMEBUFFER, m_reflectionFBO);
+    m_rtReflection = m_rtPool.acquire(GL_RGBA8, m_fbo_width, m_fbo_height);
+    m_rtReflectionDepth = m_rtPool.acquire(GL_DEPTH_COMPONENT24, m_fbo_width, m_fbo_height);
+    glBindFramebuffer(GL_FRAMEBUFFER, m_rtPool.framebuffer(m_rtReflection, m_rtReflectionDepth));
     glViewport(0, 0, m_fbo_width, m_fbo_height);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-    glEnable(GL_CLIP_PLANE0);
-    // Set clipping plane: (0, 1, 0, -WATER_HEIGHT) - clips below water
-    m_currentClipPlane = glm::vec4(0.0f, 1.0f, 0.0f, -WATER_HEIGHT);
+    // Keep (0, 1, 0, -WATER_HEIGHT): everything below the water is clipped by the
+    // oblique near plane (core profile ignores GL_CLIP_PLANE0 without gl_ClipDistance)
+    PassPolicy policy = PassPolicy::reflection(WATER_HEIGHT);
 
     // Use mirrored view matrix
     glm::mat4 mirroredView = createMirroredViewMatrix(WATER_HEIGHT);
+    glm::mat4 obliqueProj = m_cam.obliqueProj(mirroredView, policy.clipPlane);
     glm::vec3 originalCamPos = m_cam.eye;
     m_cam.eye.y = 2.0f * WATER_HEIGHT - m_cam.eye.y;
 
-    renderSceneObject(mirroredView);
+    renderSceneObject(mirroredView, obliqueProj, policy);
     m_cam.eye = originalCamPos;
 
-    glDisable(GL_CLIP_PLANE0);
+    // nobody reads the reflection depth; hand it back so refraction can reuse it
+    m_rtPool.release(m_rtReflectionDepth);
 }
 
-// Refraction: Render scene below water to m_refractionFBO
+// Refraction: Render scene below water to m_rtRefraction
 void Realtime::renderRefraction()
 {
-    glBindFramebuffer(GL_FRAMEBUFFER, m_refractionFBO);
+    m_rtRefraction = m_rtPool.acquire(GL_RGBA8, m_fbo_width, m_fbo_height);
+    m_rtRefractionDepth = m_rtPool.acquire(GL_DEPTH_COMPONENT24, m_fbo_width, m_fbo_height);
+    glBindFramebuffer(GL_FRAMEBUFFER, m_rtPool.framebuffer(m_rtRefraction, m_rtRefractionDepth));
     glViewport(0, 0, m_fbo_width, m_fbo_height);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-    glEnable(GL_CLIP_PLANE0);
-    // Set clipping plane: (0, -1, 0, WATER_HEIGHT) - clips above water
-    m_currentClipPlane = glm::vec4(0.0f, -1.0f, 0.0f, WATER_HEIGHT);
-
-    // Use normal view matrix
-    renderSceneObject(m_cam.view());
+    // Keep (0, -1, 0, WATER_HEIGHT): everything above the water is clipped
+    PassPolicy policy = PassPolicy::refraction(WATER_HEIGHT);
 
-    glDisable(GL_CLIP_PLANE0);
+    // Use normal view matrix; renderWater() needs this projection to read the depth back
+    glm::mat4 view = m_cam.view();
+    m_refractionProj = m_cam.obliqueProj(view, policy.clipPlane);
+    renderSceneObject(view, m_refractionProj, policy);
 }
 
 // Water Part
@@ -1253,110 +1630,118 @@ void Realtime::renderWater()
     if (!m_progWater)
         return;
 
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glState.enable(GL_BLEND);
+    glState.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
     // Disable depth writing but keep depth testing for proper occlusion
-    glDepthMask(GL_FALSE);
+    glState.depthMask(GL_FALSE);
+
+    glState.useProgram(m_progWater);
+    statUniform(glUniform1f, glGetUniformLocation(m_progWater, "u_near"), m_cam.nearP);
+    statUniform(glUniform1f, glGetUniformLocation(m_progWater, "u_far"), m_cam.farP);
 
-    glUseProgram(m_progWater);
-    glUniform1f(glGetUniformLocation(m_progWater, "u_near"), m_cam.nearP);
-    glUniform1f(glGetUniformLocation(m_progWater, "u_far"), m_cam.farP);
+    // depth reconstruction: the refraction depth was written with an oblique projection
+    glm::mat4 invProj = glm::inverse(m_cam.proj());
+    glm::mat4 invRefractionProj = glm::inverse(m_refractionProj);
+    statUniform(glUniformMatrix4fv, glGetUniformLocation(m_progWater, "u_invProj"), 1, GL_FALSE, &invProj[0][0]);
+    statUniform(glUniformMatrix4fv, glGetUniformLocation(m_progWater, "u_refractionInvProj"), 1, GL_FALSE, &invRefractionProj[0][0]);
 
     // Bind textures to texture units
     // Reflection texture
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, m_reflectionFBO_texture);
-    glUniform1i(glGetUniformLocation(m_progWater, "u_reflectionTexture"), 0);
+    glState.activeTexture(GL_TEXTURE0);
+    statBindTexture(GL_TEXTURE_2D, m_rtReflection.tex);
+    statUniform(glUniform1i, glGetUniformLocation(m_progWater, "u_reflectionTexture"), 0);
+    glm::vec2 reflScale = m_rtReflection.uvScale();
+    statUniform(glUniform2fv, glGetUniformLocation(m_progWater, "u_reflectionUVScale"), 1, &reflScale[0]);
 
     // Refraction texture
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, m_refractionFBO_texture);
-    glUniform1i(glGetUniformLocation(m_progWater, "u_refractionTexture"), 1);
+    glState.activeTexture(GL_TEXTURE1);
+    statBindTexture(GL_TEXTURE_2D, m_rtRefraction.tex);
+    statUniform(glUniform1i, glGetUniformLocation(m_progWater, "u_refractionTexture"), 1);
+    glm::vec2 refrScale = m_rtRefraction.uvScale();
+    statUniform(glUniform2fv, glGetUniformLocation(m_progWater, "u_refractionUVScale"), 1, &refrScale[0]);
 
     // Depth texture
-    glActiveTexture(GL_TEXTURE2);
-    glBindTexture(GL_TEXTURE_2D, m_refractionDepthTexture);
-    glUniform1i(glGetUniformLocation(m_progWater, "u_depthTexture"), 2);
+    glState.activeTexture(GL_TEXTURE2);
+    statBindTexture(GL_TEXTURE_2D, m_rtRefractionDepth.tex);
+    statUniform(glUniform1i, glGetUniformLocation(m_progWater, "u_depthTexture"), 2);
 
     // Normal map
-    glActiveTexture(GL_TEXTURE3);
-    glBindTexture(GL_TEXTURE_2D, m_texWaterNormal);
-    glUniform1i(glGetUniformLocation(m_progWater, "u_normalMap"), 3);
+    glState.activeTexture(GL_TEXTURE3);
+    statBindTexture(GL_TEXTURE_2D, m_texWaterNormal);
+    statUniform(glUniform1i, glGetUniformLocation(m_progWater, "u_normalMap"), 3);
 
     // DUDV map
-    glActiveTexture(GL_TEXTURE4);
-    glBindTexture(GL_TEXTURE_2D, m_waterDUDVTexture);
-    glUniform1i(glGetUniformLocation(m_progWater, "u_dudvMap"), 4);
+    glState.activeTexture(GL_TEXTURE4);
+    statBindTexture(GL_TEXTURE_2D, m_waterDUDVTexture);
+    statUniform(glUniform1i, glGetUniformLocation(m_progWater, "u_dudvMap"), 4);
 
     // Set MVP matrix for water quad
-    glUniformMatrix4fv(glGetUniformLocation(m_progWater, "model_matrix"), 1, GL_FALSE, &m_terrainModel[0][0]);
+    statUniform(glUniformMatrix4fv, glGetUniformLocation(m_progWater, "model_matrix"), 1, GL_FALSE, &m_terrainModel[0][0]);
 
     // View & Proj
-    glUniformMatrix4fv(glGetUniformLocation(m_progWater, "view_matrix"), 1, GL_FALSE, &m_cam.view()[0][0]);
-    glUniformMatrix4fv(glGetUniformLocation(m_progWater, "proj_matrix"), 1, GL_FALSE, &m_cam.proj()[0][0]);
+    statUniform(glUniformMatrix4fv, glGetUniformLocation(m_progWater, "view_matrix"), 1, GL_FALSE, &m_cam.view()[0][0]);
+    statUniform(glUniformMatrix4fv, glGetUniformLocation(m_progWater, "proj_matrix"), 1, GL_FALSE, &m_cam.proj()[0][0]);
 
     // Camera position
-    glUniform3fv(glGetUniformLocation(m_progWater, "ws_cam_pos"), 1, &m_cam.eye[0]);
+    statUniform(glUniform3fv, glGetUniformLocation(m_progWater, "ws_cam_pos"), 1, &m_cam.eye[0]);
 
     // Time factor (for animation)
-    glUniform1f(glGetUniformLocation(m_progWater, "u_timeFactor"), m_time);
+    statUniform(glUniform1f, glGetUniformLocation(m_progWater, "u_timeFactor"), m_time);
 
-    glUniform1i(glGetUniformLocation(m_progWater, "uEnableFog"), m_enableFog);
-    glUniform1f(glGetUniformLocation(m_progWater, "uFogDensity"), m_fogDensity);
-    glUniform3fv(glGetUniformLocation(m_progWater, "uFogColor"), 1, &m_fogColor[0]);
+    statUniform(glUniform1i, glGetUniformLocation(m_progWater, "uEnableFog"), m_enableFog);
+    m_atmosphere.bindAerialPerspective(m_progWater, AERIAL_PERSPECTIVE_UNIT, m_cam.eye);
 
-    glm::vec3 sunDir = glm::normalize(glm::vec3(0.3f, -1.0f, 0.2f));
+    glm::vec3 sunDir = sunDirection();
     glm::vec3 sunColor = glm::vec3(2.5f);
 
     // Water parameters uniforms
     GLint loc_waveStrength = glGetUniformLocation(m_progWater, "u_waveStrength");
-    glUniform1f(loc_waveStrength, settings.waveStrength);
+    statUniform(glUniform1f, loc_waveStrength, settings.waveStrength);
 
     GLint loc_waterClarity = glGetUniformLocation(m_progWater, "u_waterClarity");
-    glUniform1f(loc_waterClarity, settings.waterClarity);
+    statUniform(glUniform1f, loc_waterClarity, settings.waterClarity);
 
     GLint loc_fresnelPower = glGetUniformLocation(m_progWater, "u_fresnelPower");
-    glUniform1f(loc_fresnelPower, settings.fresnelPower);
+    statUniform(glUniform1f, loc_fresnelPower, settings.fresnelPower);
 
     GLint loc_waveSpeed = glGetUniformLocation(m_progWater, "u_waveSpeed");
-    glUniform1f(loc_waveSpeed, settings.waveSpeed);
+    statUniform(glUniform1f, loc_waveSpeed, settings.waveSpeed);
 
     // Global data
-    glUniform1f(glGetUniformLocation(m_progWater, "globalData.ka"), 0.5f);
-    glUniform1f(glGetUniformLocation(m_progWater, "globalData.kd"), 0.5f);
-    glUniform1f(glGetUniformLocation(m_progWater, "globalData.ks"), 1.0f);
+    statUniform(glUniform1f, glGetUniformLocation(m_progWater, "globalData.ka"), 0.5f);
+    statUniform(glUniform1f, glGetUniformLocation(m_progWater, "globalData.kd"), 0.5f);
+    statUniform(glUniform1f, glGetUniformLocation(m_progWater, "globalData.ks"), 1.0f);
 
     // Lights
-    glUniform1i(glGetUniformLocation(m_progWater, "number_light"), 1);
+    statUniform(glUniform1i, glGetUniformLocation(m_progWater, "number_light"), 1);
 
-    glUniform1i(glGetUniformLocation(m_progWater, "light[0].type"), 0);
-    glUniform3fv(glGetUniformLocation(m_progWater, "light[0].dir"), 1, &sunDir[0]);
-    glUniform3fv(glGetUniformLocation(m_progWater, "light[0].color"), 1, &sunColor[0]);
+    statUniform(glUniform1i, glGetUniformLocation(m_progWater, "light[0].type"), 0);
+    statUniform(glUniform3fv, glGetUniformLocation(m_progWater, "light[0].dir"), 1, &sunDir[0]);
+    statUniform(glUniform3fv, glGetUniformLocation(m_progWater, "light[0].color"), 1, &sunColor[0]);
 
     glm::vec3 zero(0.0f);
-    glUniform3fv(glGetUniformLocation(m_progWater, "light[0].pos"), 1, &zero[0]);
-    glUniform3fv(glGetUniformLocation(m_progWater, "light[0].function"), 1, &zero[0]);
+    statUniform(glUniform3fv, glGetUniformLocation(m_progWater, "light[0].pos"), 1, &zero[0]);
+    statUniform(glUniform3fv, glGetUniformLocation(m_progWater, "light[0].function"), 1, &zero[0]);
 
     // draw water quad
     m_waterMesh.draw();
 
     // Restore depth writing and disable blending
-    glUseProgram(0);
-    glDepthMask(GL_TRUE);
-    glDisable(GL_BLEND);
+    glState.depthMask(GL_TRUE);
+    glState.disable(GL_BLEND);
 
     // Unbind textures
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, 0);
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, 0);
-    glActiveTexture(GL_TEXTURE2);
-    glBindTexture(GL_TEXTURE_2D, 0);
-    glActiveTexture(GL_TEXTURE3);
-    glBindTexture(GL_TEXTURE_2D, 0);
-    glActiveTexture(GL_TEXTURE4);
-    glBindTexture(GL_TEXTURE_2D, 0);
+    glState.activeTexture(GL_TEXTURE0);
+    statBindTexture(GL_TEXTURE_2D, 0);
+    glState.activeTexture(GL_TEXTURE1);
+    statBindTexture(GL_TEXTURE_2D, 0);
+    glState.activeTexture(GL_TEXTURE2);
+    statBindTexture(GL_TEXTURE_2D, 0);
+    glState.activeTexture(GL_TEXTURE3);
+    statBindTexture(GL_TEXTURE_2D, 0);
+    glState.activeTexture(GL_TEXTURE4);
+    statBindTexture(GL_TEXTURE_2D, 0);
 }
 
 // ================== Rendering the Scene!
@@ -1376,6 +1761,16 @@ Realtime::Realtime(QWidget *parent)
     m_keyMap[Qt::Key_Space] = false;
 
     // If you must use this function, do not edit anything above this
+
+    m_startupTimer.start(); // time to first frame is measured from here
+
+    // per-frame render stats, toggled with I
+    m_statsOverlay = new QLabel(this);
+    m_statsOverlay->setAttribute(Qt::WA_TransparentForMouseEvents);
+    m_statsOverlay->setStyleSheet("QLabel { background: rgba(0, 0, 0, 160); color: white;"
+                                  " font-family: monospace; font-size: 10px; padding: 4px; }");
+    m_statsOverlay->move(8, 8);
+    m_statsOverlay->hide();
 }
 
 void Realtime::rebuildWaterMesh()
@@ -1424,7 +1819,21 @@ void Realtime::rebuildWaterMesh()
 void Realtime::finish()
 {
     killTimer(m_timer);
+    m_startup.cancel();
     this->makeCurrent();
+    glState.invalidate();
+    stopCapture();
+    m_sim.stop();
+
+    if (m_gpuTimers[0])
+    {
+        glDeleteQueries(GPU_TIMER_FRAMES, m_gpuTimers);
+        for (int i = 0; i < GPU_TIMER_FRAMES; ++i)
+        {
+            m_gpuTimers[i] = 0;
+            m_gpuTimerPending[i] = false;
+        }
+    }
 
     // Cleanup Particles
     if (m_particleSystem)
@@ -1432,71 +1841,70 @@ void Realtime::finish()
         delete m_particleSystem;
         m_particleSystem = nullptr;
     }
+    m_simFrame = nullptr;
 
     // Students: anything requiring OpenGL calls when the program exits should be done here
+    m_drawList.clear(); // points into the mesh cache
+    m_sceneBatches.clear();
+    m_sceneInstanceUBO.reset();
+    m_clusterLights.clear();
+    m_clusterGridValid = false;
+    m_clusterLightUBO.reset();
+    m_clusterDataBuffer.reset();
+    m_clusterDataTex.reset();
     destroyMeshCache();
 
-    if (m_prog)
-    {
-        glDeleteProgram(m_prog);
-        m_prog = 0;
-    }
-    if (m_progTerrain)
-    {
-        glDeleteProgram(m_progTerrain);
-        m_progTerrain = 0;
-    }
-    if (m_progWater)
-    {
-        glDeleteProgram(m_progWater);
-        m_progWater = 0;
-    }
-    if (m_progSky)
-    {
-        glDeleteProgram(m_progSky);
-        m_progSky = 0;
-    }
-    
-    // Cleanup skybox textures
-    if (m_texSkySunny)
-    {
-        glDeleteTextures(1, &m_texSkySunny);
-        m_texSkySunny = 0;
-    }
-    if (m_texSkyRainy)
-    {
-        glDeleteTextures(1, &m_texSkyRainy);
-        m_texSkyRainy = 0;
-    }
-    
-    if (m_progForest)
-    {
-        glDeleteProgram(m_progForest);
-        m_progForest = 0;
-    }
-
-    if (m_progPost)
-    {
-        glDeleteProgram(m_progPost);
-        m_progPost = 0;
-    }
-    destroySceneFBO();
+    for (GLProgram *prog : {&m_prog, &m_progTerrain, &m_progWater, &m_progSky, &m_progForest, &m_progPost})
+        prog->reset();
+    m_atmosphere.destroy();
+
+    for (GLTexture *tex : {&m_texGrassAlbedo, &m_texRockAlbedo, &m_texBeachAlbedo, &m_texRockHighAlbedo,
+                           &m_texSnowAlbedo, &m_texGrassNormal, &m_texRockNormal, &m_texBeachNormal,
+                           &m_texRockHighNormal, &m_texSnowNormal, &m_texGrassRough, &m_texRockRough,
+                           &m_texBeachRough, &m_texRockHighRough, &m_texSnowRough, &m_texWaterNormal,
+                           &m_normalMapTexture, &m_waterDUDVTexture, &m_texColorLUT, &m_texRockObjAlbedo})
+        tex->reset();
+
+    m_branchInstanceVBO.reset();
+    m_leafInstanceVBO.reset();
+    m_rockInstanceVBO.reset();
+
+    releaseSceneTargets();
+    releaseWaterTargets();
+    m_rtPool.destroy();
+    m_terrainMesh.destroy();
+    for (GLMesh &lod : m_terrainMeshLod)
+        lod.destroy();
+    m_waterMesh.destroy();
     m_screenQuad.destroy();
 
-    if (m_texColorLUT) {
-        glDeleteTextures(1, &m_texColorLUT);
-        m_texColorLUT = 0;
+    if (m_lutBaker) {
+        delete m_lutBaker;
+        m_lutBaker = nullptr;
     }
 
+    // everything above was released: delete it now and report what is left
+    GLResources::flush();
+    std::string leaks = GLResources::leakReport();
+    if (leaks.empty())
+        std::cout << "[gl] no leaked handles" << std::endl;
+    else
+        std::cout << "[gl] " << leaks << std::endl;
+    if (m_statsOverlay)
+        m_statsOverlay->setText(QString::fromStdString(GLResources::summary() + "\n" + (leaks.empty() ? "no leaked handles" : leaks)));
+
     this->doneCurrent();
 }
 
 void Realtime::initializeGL()
 {
+    Tracer::setThreadName("main (GL)");
+    TRACE_SCOPE("initializeGL");
+    glState.invalidate(); // the context is new (or recreated)
     m_devicePixelRatio = this->devicePixelRatio();
 
     m_timer = startTimer(1000 / 60);
-    m_elapsedTimer.start();
+    WorkerPool::shared(); // per-frame culling workers, started once here rather than on the first frame
 
     // Initializing GL.
     // GLEW (GL Extension Wrangler) provides access to OpenGL functions.
@@ -1508,330 +1916,470 @@ void Realtime::initializeGL()
     }
     std::cout << "Initialized GL: Version " << glewGetString(GLEW_VERSION) << std::endl;
 
-    // Allows OpenGL to draw objects appropriately on top of one another
-    glEnable(GL_DEPTH_TEST);
-    // Tells OpenGL to only draw the front face
-    glEnable(GL_CULL_FACE);
-    // Tells OpenGL how big the screen is
-    glViewport(0, 0, size().width() * m_devicePixelRatio, size().height() * m_devicePixelRatio);
+    // Allows OpenGL to draw objects appropriately on top of one another
+    glState.enable(GL_DEPTH_TEST);
+    // Tells OpenGL to only draw the front face
+    glState.enable(GL_CULL_FACE);
+    // Tells OpenGL how big the screen is
+    glViewport(0, 0, size().width() * m_devicePixelRatio, size().height() * m_devicePixelRatio);
+
+    // Students: anything requiring OpenGL calls when the program starts should be done here
+    if (GLEW_VERSION_3_0 || GLEW_EXT_framebuffer_sRGB)
+    {
+        glEnable(GL_FRAMEBUFFER_SRGB);
+    }
+
+    m_devicePixelRatio = this->devicePixelRatio();
+
+    glViewport(0, 0, size().width() * m_devicePixelRatio, size().height() * m_devicePixelRatio);
+
+    // z-up (lab07) -> y-up (project)
+    m_terrainModel = TerrainGenerator::worldModel();
+
+    // Camera initial values (will be overridden by scene & settings)
+    m_cam.aspect = (height() > 0) ? float(width()) / float(height()) : 1.f;
+    m_cam.nearP = settings.nearPlane;
+    m_cam.farP = settings.farPlane;
+
+    // --- Startup tasks ---
+    // Critical: what the first frame draws. Image decoding and terrain
+    // generation run on helper threads while this thread builds the shaders.
+    using Stage = StartupGraph::Stage;
+    auto addTexture = [this](const char *path, GLTexture &target, Stage stage) {
+        auto img = std::make_shared<QImage>();
+        QString file(path);
+        return m_startup.add(path, stage,
+                             [img, file] { *img = decodeTexture2D(file); },
+                             [this, img, &target] {
+                                 target = uploadTexture2D(*img, false);
+                                 *img = QImage();
+                             });
+    };
+
+    auto terrain = std::make_shared<TerrainBuild>();
+    m_startup.add("terrain meshes", Stage::Critical,
+                  [this, terrain] { *terrain = buildTerrainMeshes(); },
+                  [this, terrain] {
+                      applyTerrainMeshes(*terrain);
+                      *terrain = TerrainBuild();
+                  });
+
+    m_startup.add("shaders", Stage::Critical, nullptr, [this] {
+        m_progTerrain = buildProgram(":/resources/shaders/terrain.vert", ":/resources/shaders/terrain.frag", "Terrain");
+        bindClusterInputs(m_progTerrain);
+        m_progWater = buildProgram(":/resources/shaders/water.vert", ":/resources/shaders/water.frag", "Water");
+        m_progSky = buildProgram(":/resources/shaders/sky.vert", ":/resources/shaders/sky.frag", "Sky");
+        m_progPost = buildProgram(":/resources/shaders/post.vert", ":/resources/shaders/post.frag", "Post");
+    });
+
+    // sky and aerial perspective: every LUT is made before the first frame
+    m_startup.add("atmosphere", Stage::Critical, nullptr, [this] {
+        m_atmosphere.setWorldScale(ATMOSPHERE_KM_PER_UNIT, WATER_HEIGHT);
+        m_atmosphere.setParams(atmosphereFor(settings.colorGradePreset));
+        m_atmosphere.setSun(-sunDirection());
+        if (m_atmosphere.init())
+            m_atmosphere.bake(m_cam.eye);
+    });
+
+    // loading terrain textures
+    addTexture(":/resources/textures/terrain/grass/albedo.jpg", m_texGrassAlbedo, Stage::Critical);
+    addTexture(":/resources/textures/terrain/rock_beach/albedo.jpg", m_texRockAlbedo, Stage::Critical);
+    addTexture(":/resources/textures/terrain/beach/albedo.jpg", m_texBeachAlbedo, Stage::Critical);
+    addTexture(":/resources/textures/terrain/rock/albedo.jpg", m_texRockHighAlbedo, Stage::Critical);
+    addTexture(":/resources/textures/terrain/snow/albedo.jpg", m_texSnowAlbedo, Stage::Critical);
+
+    addTexture(":/resources/textures/terrain/grass/normal.jpg", m_texGrassNormal, Stage::Critical);
+    addTexture(":/resources/textures/terrain/rock_beach/normal.jpg", m_texRockNormal, Stage::Critical);
+    addTexture(":/resources/textures/terrain/beach/normal.jpg", m_texBeachNormal, Stage::Critical);
+    addTexture(":/resources/textures/terrain/rock/normal.jpg", m_texRockHighNormal, Stage::Critical);
+    addTexture(":/resources/textures/terrain/snow/normal.jpg", m_texSnowNormal, Stage::Critical);
+
+    addTexture(":/resources/textures/terrain/grass/roughness.jpg", m_texGrassRough, Stage::Critical);
+    addTexture(":/resources/textures/terrain/rock_beach/roughness.jpg", m_texRockRough, Stage::Critical);
+    addTexture(":/resources/textures/terrain/beach/roughness.jpg", m_texBeachRough, Stage::Critical);
+    addTexture(":/resources/textures/terrain/rock/roughness.jpg", m_texRockHighRough, Stage::Critical);
+    addTexture(":/resources/textures/terrain/snow/roughness.jpg", m_texSnowRough, Stage::Critical);
+
+    addTexture(":/resources/textures/normalMap.png", m_texWaterNormal, Stage::Critical);
+    addTexture(":/resources/textures/waterDUDV.png", m_waterDUDVTexture, Stage::Critical);
+
+    // Background: prepared on the loader thread once the first frame is up
+    m_startup.add("particles", Stage::Background, nullptr, [this] {
+        m_particleSystem = new ParticleSystem();
+        m_particleSystem->init();
+    });
+    m_taskDefaultShader = m_startup.add("default shader", Stage::Background, nullptr, [this] {
+        m_prog = buildProgram(":/resources/shaders/default.vert", ":/resources/shaders/default.frag", "Default");
+        if (m_prog)
+            glUniformBlockBinding(m_prog, glGetUniformBlockIndex(m_prog, "SceneInstances"), SCENE_INSTANCE_BINDING);
+        bindClusterInputs(m_prog);
+    });
+
+    // OnDemand: the forest is off by default, controlled by EC4 checkbox
+    m_drawForest = false;
+    auto rockTex = addTexture(":/resources/textures/terrain/rock_beach/displacement.jpg", m_texRockObjAlbedo,
+                              Stage::OnDemand);
+    m_taskForest = m_startup.add("forest resources", Stage::OnDemand, nullptr,
+                                 [this] { initForestResources(); }, {rockTex});
+
+    m_startup.runCritical();
+    m_hasTerrain = m_progTerrain != 0;
+    std::cout << "[startup] critical resources loaded in " << m_startup.criticalMs() << " ms" << std::endl;
+
+    // use cube mesh as skybox
+    m_skyCube = getOrCreateMesh(PrimitiveType::PRIMITIVE_CUBE, 1, 1);
+
+    // start with identity; the baker replaces it once the grade params are known
+    std::vector<float> lutData = LUTUtils::generateIdentityLUT(m_lutSize);
+    m_texColorLUT = GLTexture::adopt(LUTUtils::createLUT3DTexture(m_lutSize, lutData));
+    m_lutTexSize = m_lutSize;
+    m_lutIsIdentity = true;
+    m_lutBaker = new LUTBaker();
+    requestGradeLUT();
+
+    // --- Camera Path Initialization ---
+    // Define a simple circular path around the center
+    // Keyframe 0: Start
+    m_cameraPath.addKeyframe(glm::vec3(0, 10, 20), glm::quat(glm::vec3(glm::radians(-20.f), 0, 0)), 0.0f);
+    // Keyframe 1: Left side
+    m_cameraPath.addKeyframe(glm::vec3(-20, 15, 0), glm::quat(glm::vec3(glm::radians(-15.f), glm::radians(-90.f), 0)), 5.0f);
+    // Keyframe 2: Back
+    m_cameraPath.addKeyframe(glm::vec3(0, 20, -20), glm::quat(glm::vec3(glm::radians(-25.f), glm::radians(-180.f), 0)), 10.0f);
+    // Keyframe 3: Right side
+    m_cameraPath.addKeyframe(glm::vec3(20, 15, 0), glm::quat(glm::vec3(glm::radians(-15.f), glm::radians(-270.f), 0)), 15.0f);
+    // Keyframe 4: Return to start
+    m_cameraPath.addKeyframe(glm::vec3(0, 10, 20), glm::quat(glm::vec3(glm::radians(-20.f), glm::radians(-360.f), 0)), 20.0f);
+
+    // the simulation starts from the default camera (a scene file moves it below)
+    m_sim.stop();
+    m_sim.setPath(m_cameraPath, CAMERA_PATH_SECONDS);
+    m_simGradePreset = settings.colorGradePreset;
+    m_sim.setParticleType(particleTypeFor(m_simGradePreset));
+    m_sim.reset({m_cam.eye, m_cam.look, m_cam.up}, false);
+    m_sim.start();
+
+    m_glInitialized = true;
+
+    // fullscreen quad
+    createScreenQuad();
+
+    // GPU frame timers for the quality governor
+    glGenQueries(GPU_TIMER_FRAMES, m_gpuTimers);
+
+    // scene / reflection / refraction targets are acquired from m_rtPool in paintGL
+
+    // a scene file given on the command line (--scene)
+    if (!settings.sceneFilePath.empty())
+        loadSceneFile();
+}
 
-    // Students: anything requiring OpenGL calls when the program starts should be done here
-    if (GLEW_VERSION_3_0 || GLEW_EXT_framebuffer_sRGB)
-    {
-        glEnable(GL_FRAMEBUFFER_SRGB);
-    }
+void Realtime::initForestResources()
+{
+    m_progForest = buildProgram(":/resources/shaders/forest.vert", ":/resources/shaders/forest.frag", "Forest");
+    bindClusterInputs(m_progForest);
 
-    m_devicePixelRatio = this->devicePixelRatio();
+    // cylinder shared mesh for preparing branches
+    m_treeCylinderMesh = getOrCreateMesh(PrimitiveType::PRIMITIVE_CYLINDER, 3, 8);
 
-    glViewport(0, 0, size().width() * m_devicePixelRatio, size().height() * m_devicePixelRatio);
+    // coarse sphere mesh for leaves
+    m_leafMesh = getOrCreateMesh(PrimitiveType::PRIMITIVE_SPHERE, 3, 6);
 
-    // Build shader program
-    try
-    {
-        m_prog = ShaderLoader::createShaderProgram(
-            ":/resources/shaders/default.vert",
-            ":/resources/shaders/default.frag");
-    }
-    catch (const std::exception &e)
-    {
-        qWarning("Shader compile/link error: %s", e.what());
-        m_prog = 0;
-    }
+    // rock mesh
+    m_rockMesh = getOrCreateMesh(PrimitiveType::PRIMITIVE_SPHERE, 4, 8);
 
-    // terrain shader
-    try
-    {
-        m_progTerrain = ShaderLoader::createShaderProgram(
-            ":/resources/shaders/terrain.vert",
-            ":/resources/shaders/terrain.frag");
+    // instance buffers (and their attributes) are created by uploadInstanceMatrices()
+}
+
+void Realtime::paintGL() {
+    TRACE_SCOPE("frame");
+    glState.invalidate(); // Qt composes with the context between frames
+    auto cpuStart = std::chrono::steady_clock::now();
+
+    // GPU time of this frame, read back GPU_TIMER_FRAMES frames later
+    int slot = m_gpuTimerFrame % GPU_TIMER_FRAMES;
+    GLuint query = m_gpuTimers[slot];
+    if (query && m_gpuTimerPending[slot])
+    {
+        GLint available = 0;
+        glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available)
+        {
+            GLuint64 ns = 0;
+            glGetQueryObjectui64v(query, GL_QUERY_RESULT, &ns);
+            m_lastGpuMs = float(double(ns) * 1e-6);
+        }
+        m_gpuTimerPending[slot] = false;
     }
-    catch (const std::exception &e)
+    if (query)
+        glBeginQuery(GL_TIME_ELAPSED, query);
+
+    // the weather checkboxes only repaint, so the particles follow the preset here
+    if (settings.colorGradePreset != m_simGradePreset)
     {
-        qWarning("Terrain shader compile/link error: %s", e.what());
-        m_progTerrain = 0;
+        m_simGradePreset = settings.colorGradePreset;
+        m_sim.setParticleType(particleTypeFor(m_simGradePreset));
     }
 
-    // forest shader
-    try
+    // the simulation's newest state, interpolated to now - or, while capturing,
+    // stepped here to frame n / fps however long the frame took to render
+    if (m_capture.active())
     {
-        m_progForest = ShaderLoader::createShaderProgram(
-            ":/resources/shaders/forest.vert",
-            ":/resources/shaders/forest.frag");
+        const double t = double(m_capture.nextFrame()) / double(m_captureFps);
+        m_sim.runUntil(t);
+        const SimFrame &frame = m_sim.latest();
+        applySimFrame(frame, Simulation::alphaAt(frame, t));
     }
-    catch (const std::exception &e)
+    else
     {
-        qWarning("Terrain shader compile/link error: %s", e.what());
-        m_progTerrain = 0;
+        const SimFrame &frame = m_sim.latest();
+        applySimFrame(frame, Simulation::alpha(frame));
     }
 
-    // water shader
-    try
+    renderStats.beginFrame();
+    renderFrame();
+
+    if (m_capture.active())
     {
-        m_progWater = ShaderLoader::createShaderProgram(
-            ":/resources/shaders/water.vert",
-            ":/resources/shaders/water.frag");
+        m_capture.grab(defaultFramebufferObject(), int(width() * m_devicePixelRatio),
+                       int(height() * m_devicePixelRatio));
+        if (m_capture.nextFrame() >= m_captureEnd)
+            stopCapture();
+        else
+            update(); // next frame right away, not on the timer
     }
-    catch (const std::exception &e)
+
+    if (query)
     {
-        qWarning("Water shader compile/link error: %s", e.what());
-        m_progWater = 0;
+        glEndQuery(GL_TIME_ELAPSED);
+        m_gpuTimerPending[slot] = true;
     }
+    ++m_gpuTimerFrame;
 
-    // sky shader
-    try
+    // CPU side: time spent recording this frame
+    float cpuMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - cpuStart).count();
+    m_quality.setEnabled(settings.autoQuality && !m_capture.active()); // captured frames keep full quality
+    m_quality.setTargetMs(settings.frameBudgetMs);
+    m_quality.addFrame(cpuMs, m_lastGpuMs);
+
+    renderStats.endFrame(cpuMs, m_lastGpuMs);
+
+    if (m_firstFrameMs < 0.f)
     {
-        m_progSky = ShaderLoader::createShaderProgram(
-            ":/resources/shaders/sky.vert",
-            ":/resources/shaders/sky.frag");
+        glFinish(); // once: include the GPU work of the first frame
+        m_firstFrameMs = float(double(m_startupTimer.nsecsElapsed()) * 1e-6);
+        std::cout << "[startup] first frame after " << m_firstFrameMs << " ms" << std::endl;
+        m_startup.start(); // everything else loads from now on
     }
-    catch (const std::exception &e)
+    else if (!m_startupLogged)
     {
-        qWarning("Sky shader compile/link error: %s", e.what());
-        m_progSky = 0;
+        m_startup.pump(STARTUP_UPLOAD_BUDGET_MS);
+        if (!m_startup.backgroundPending())
+        {
+            m_startupLogged = true;
+            std::cout << "[startup] background loading done after "
+                      << double(m_startupTimer.nsecsElapsed()) * 1e-6 << " ms\n"
+                      << m_startup.report() << std::flush;
+
+            // --poster / --capture: everything is loaded, so nothing shows a placeholder
+            // a failure exits non-zero, without going on to the capture
+            bool posterOk = true;
+            if (!settings.posterPath.empty())
+            {
+                posterOk = renderPoster(settings.posterPath, settings.posterWidth, settings.posterHeight);
+                if (!posterOk)
+                    std::cerr << "[poster] failed to write " << settings.posterPath << std::endl;
+                if (!posterOk || settings.captureDir.empty())
+                    QCoreApplication::exit(posterOk ? 0 : 1);
+            }
+            if (posterOk && !settings.captureDir.empty())
+            {
+                m_quitAfterCapture = true;
+                startCapture(settings.captureDir);
+                update();
+            }
+        }
     }
 
-    // use cube mesh as skybox
-    m_skyCube = getOrCreateMesh(PrimitiveType::PRIMITIVE_CUBE, 1, 1);
-
-    // Load skybox cubemaps
-    // 1. load sunny day texture (sequence: Right, Left, Top, Bottom, Back, Front)
-    std::vector<QString> sunnyFaces = {
-        ":/resources/textures/sky/Sunny/Right.bmp",
-        ":/resources/textures/sky/Sunny/Left.bmp",
-        ":/resources/textures/sky/Sunny/Top.bmp",
-        ":/resources/textures/sky/Sunny/Bottom.bmp",
-        ":/resources/textures/sky/Sunny/Front.bmp",
-        ":/resources/textures/sky/Sunny/Back.bmp"
-    };
-    m_texSkySunny = loadCubemap(sunnyFaces);
-
-    // 2. load rainy day texture (sequence: Left, Top, Bottom, Back, Front)
-    std::vector<QString> rainyFaces = {
-        ":/resources/textures/sky/Rainy/right.jpg",
-        ":/resources/textures/sky/Rainy/left.jpg",
-        ":/resources/textures/sky/Rainy/top.jpg",
-        ":/resources/textures/sky/Rainy/bottom.jpg",
-        ":/resources/textures/sky/Rainy/front.jpg",
-        ":/resources/textures/sky/Rainy/back.jpg"
-    };
-    m_texSkyRainy = loadCubemap(rainyFaces);
-
-    if (m_progTerrain)
-    {
-        std::vector<float> interlPNC = m_terrainGen.generateTerrain();
-        m_terrainMesh.uploadinterleavedPNC(interlPNC);
-        m_hasTerrain = true;
-
-        // loading terrain textures
-        m_texGrassAlbedo = loadTexture2D(":/resources/textures/terrain/grass/albedo.jpg", false);
-        m_texRockAlbedo = loadTexture2D(":/resources/textures/terrain/rock_beach/albedo.jpg", false);
-        m_texBeachAlbedo = loadTexture2D(":/resources/textures/terrain/beach/albedo.jpg", false);
-        m_texRockHighAlbedo = loadTexture2D(":/resources/textures/terrain/rock/albedo.jpg", false);
-        m_texSnowAlbedo = loadTexture2D(":/resources/textures/terrain/snow/albedo.jpg", false);
-        m_texRockObjAlbedo = loadTexture2D(":/resources/textures/terrain/rock_beach/displacement.jpg", false);
-
-        m_texGrassNormal = loadTexture2D(":/resources/textures/terrain/grass/normal.jpg", false);
-        m_texRockNormal = loadTexture2D(":/resources/textures/terrain/rock_beach/normal.jpg", false);
-        m_texBeachNormal = loadTexture2D(":/resources/textures/terrain/beach/normal.jpg", false);
-        m_texRockHighNormal = loadTexture2D(":/resources/textures/terrain/rock/normal.jpg", false);
-        m_texWaterNormal = loadTexture2D(":/resources/textures/water_normal_tile.jpg", false);
-        m_texSnowNormal = loadTexture2D(":/resources/textures/terrain/snow/normal.jpg", false);
-
-        m_texGrassRough = loadTexture2D(":/resources/textures/terrain/grass/roughness.jpg", false);
-        m_texRockRough = loadTexture2D(":/resources/textures/terrain/rock_beach/roughness.jpg", false);
-        m_texBeachRough = loadTexture2D(":/resources/textures/terrain/beach/roughness.jpg", false);
-        m_texRockHighRough  = loadTexture2D(":/resources/textures/terrain/rock/roughness.jpg", false);
-        m_texSnowRough  = loadTexture2D(":/resources/textures/terrain/snow/roughness.jpg", false);
-    } else {
-        m_hasTerrain = false;
+    if (m_statsOverlay && m_statsOverlay->isVisible() && renderStats.lastFrame().frame % 10 == 0)
+    {
+        char startup[64];
+        std::snprintf(startup, sizeof(startup), "\nfirst frame after %.0f ms", m_firstFrameMs);
+        m_statsOverlay->setText(QString::fromStdString(renderStats.summary() + "\n" + MemTracker::summary() + "\n" +
+                                                       GLResources::summary() + startup));
+        m_statsOverlay->adjustSize();
     }
 
-    std::vector<float> lutData = LUTUtils::generateIdentityLUT(m_lutSize);
-    m_texColorLUT = LUTUtils::createLUT3DTexture(m_lutSize, lutData);
-
-    // z-up (lab07) -> y-up (project) : translate center, scale, rotate -90° around +X
-    glm::mat4 T = glm::translate(glm::mat4(1.f), glm::vec3(-0.5f, -0.5f, 0.f));
-    glm::mat4 S = glm::scale(glm::mat4(1.f), glm::vec3(120.f, 120.f, 10.f));
-    glm::mat4 R = glm::rotate(glm::mat4(1.f),
-                              -glm::half_pi<float>(), glm::vec3(1, 0, 0));
-    m_terrainModel = R * S * T;
-
-    // cylinder shared mesh for preparing branches
-    m_treeCylinderMesh = getOrCreateMesh(PrimitiveType::PRIMITIVE_CYLINDER, 3, 8);
-
-    // coarse sphere mesh for leaves
-    m_leafMesh = getOrCreateMesh(PrimitiveType::PRIMITIVE_SPHERE, 3, 6);
-
-    // rock mesh
-    m_rockMesh = getOrCreateMesh(PrimitiveType::PRIMITIVE_SPHERE, 4, 8);
+    // hand the context back to Qt without our program / VAO bound
+    glState.useProgram(0);
+    glState.bindVertexArray(0);
 
-    m_drawForest = false; // off by default, controlled by EC4 checkbox.
+    // GL objects released during this frame are deleted once the GPU is past it
+    GLResources::endFrame();
+}
 
-    // instancing attribute for branches
-    glBindVertexArray(m_treeCylinderMesh->vao);
-    glGenBuffers(1, &m_branchInstanceVBO);
-    glBindBuffer(GL_ARRAY_BUFFER, m_branchInstanceVBO);
-    // fill data in later use buildingForest().
+void Realtime::startCapture(const std::string &dir)
+{
+    m_captureFps = std::max(1, settings.captureFps);
+    const int loopFrames = int(std::lround(CAMERA_PATH_SECONDS * float(m_captureFps)));
+    const int first = std::max(0, settings.captureFirst);
+    m_captureEnd = settings.captureEnd >= 0 ? settings.captureEnd : loopFrames;
 
-    // mat4 occupies 4 vec4 attributes: location 2, 3, 4, 5
-    std::size_t vec4Size = sizeof(glm::vec4);
-    GLsizei stride = sizeof(glm::mat4);
-    for (int i = 0; i < 4; ++i)
+    FrameWriter::Format format = settings.captureRaw ? FrameWriter::Format::PPM : FrameWriter::Format::PNG;
+    if (first >= m_captureEnd || !m_capture.start(dir, format, first))
     {
-        GLuint loc = 2 + i;
-        glEnableVertexAttribArray(loc);
-        glVertexAttribPointer(loc, 4, GL_FLOAT, GL_FALSE, stride, (void *)(i * vec4Size));
-        glVertexAttribDivisor(loc, 1); // one copy per instance
+        if (m_quitAfterCapture)
+            QCoreApplication::exit(1);
+        return;
     }
-    glBindVertexArray(0);
+    // the capture clock drives the simulation now: the path from step 0 and the
+    // particles from their seed, run up to the first frame, so every run (and
+    // every farm worker, whatever its range) sees the same state at frame n
+    m_sim.stop();
+    m_sim.reset({m_cam.eye, m_cam.look, m_cam.up}, true);
+    m_sim.runUntil(double(first) / double(m_captureFps));
 
-    // instancing attribute for leaves
-    glBindVertexArray(m_leafMesh->vao);
-    glGenBuffers(1, &m_leafInstanceVBO);
-    glBindBuffer(GL_ARRAY_BUFFER, m_leafInstanceVBO);
+    std::cout << "[capture] frames " << first << " to " << m_captureEnd - 1 << " at " << m_captureFps << " fps"
+              << std::endl;
+}
 
-    for (int i = 0; i < 4; ++i)
+void Realtime::stopCapture()
+{
+    if (!m_capture.active())
+        return;
+    bool ok = m_capture.stop();
+    if (m_quitAfterCapture)
     {
-        GLuint loc = 2 + i;
-        glEnableVertexAttribArray(loc);
-        glVertexAttribPointer(loc, 4, GL_FLOAT, GL_FALSE,
-                              stride, (void *)(i * vec4Size));
-        glVertexAttribDivisor(loc, 1);
+        QCoreApplication::exit(ok ? 0 : 1);
+        return;
     }
-    glBindVertexArray(0);
+    // back to real time, the camera where the capture left it
+    m_isPathAnimating = false;
+    m_sim.setPathAnimating(false);
+    m_sim.start();
+}
 
-    // instancing attribute for rocks
-    glBindVertexArray(m_rockMesh->vao);
-    glGenBuffers(1, &m_rockInstanceVBO);
-    glBindBuffer(GL_ARRAY_BUFFER, m_rockInstanceVBO);
+bool Realtime::renderPoster(const std::string &path, int width, int height)
+{
+    TRACE_SCOPE("poster");
+    QElapsedTimer timer;
+    timer.start();
 
-    for (int i = 0; i < 4; ++i)
-    {
-        GLuint loc = 2 + i;
-        glEnableVertexAttribArray(loc);
-        glVertexAttribPointer(loc, 4, GL_FLOAT, GL_FALSE,
-                              stride, (void *)(i * vec4Size));
-        glVertexAttribDivisor(loc, 1);
-    }
-    glBindVertexArray(0);
+    GLint maxDims[2] = {0, 0};
+    glGetIntegerv(GL_MAX_VIEWPORT_DIMS, maxDims);
+    const int tileSize = std::min(POSTER_TILE, std::min(maxDims[0], maxDims[1]) - 2 * POSTER_MARGIN);
+    const int renderSize = tileSize + 2 * POSTER_MARGIN;
+    TileLayout layout(width, height, tileSize, POSTER_MARGIN);
 
-    // Camera initial values (will be overridden by scene & settings)
-    m_cam.aspect = (height() > 0) ? float(width()) / float(height()) : 1.f;
-    m_cam.nearP = settings.nearPlane;
-    m_cam.farP = settings.farPlane;
+    StripedImageWriter out;
+    if (!out.open(path, width, height))
+        return false;
 
-    m_particleSystem = new ParticleSystem();
-    m_particleSystem->init();
+    GLint prevFBO = 0;
+    GLint prevViewport[4];
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &prevFBO);
+    glGetIntegerv(GL_VIEWPORT, prevViewport);
+    const float prevAspect = m_cam.aspect;
+    m_cam.aspect = float(width) / float(height);
 
-    // --- Camera Path Initialization ---
-    // Define a simple circular path around the center
-    // Keyframe 0: Start
-    m_cameraPath.addKeyframe(glm::vec3(0, 10, 20), glm::quat(glm::vec3(glm::radians(-20.f), 0, 0)), 0.0f);
-    // Keyframe 1: Left side
-    m_cameraPath.addKeyframe(glm::vec3(-20, 15, 0), glm::quat(glm::vec3(glm::radians(-15.f), glm::radians(-90.f), 0)), 5.0f);
-    // Keyframe 2: Back
-    m_cameraPath.addKeyframe(glm::vec3(0, 20, -20), glm::quat(glm::vec3(glm::radians(-25.f), glm::radians(-180.f), 0)), 10.0f);
-    // Keyframe 3: Right side
-    m_cameraPath.addKeyframe(glm::vec3(20, 15, 0), glm::quat(glm::vec3(glm::radians(-15.f), glm::radians(-270.f), 0)), 15.0f);
-    // Keyframe 4: Return to start
-    m_cameraPath.addKeyframe(glm::vec3(0, 10, 20), glm::quat(glm::vec3(glm::radians(-20.f), glm::radians(-360.f), 0)), 20.0f);
+    // one tile target, reused; the passes inside renderFrame size theirs to it
+    RenderTarget color = m_rtPool.acquire(GL_RGBA8, renderSize, renderSize);
+    RenderTarget depth = m_rtPool.acquire(GL_DEPTH_COMPONENT24, renderSize, renderSize);
+    GLuint fbo = m_rtPool.framebuffer(color, depth);
 
-    m_glInitialized = true;
+    // memory: one tile readback and one stripe of the poster, whatever its size
+    std::vector<unsigned char> tilePixels(std::size_t(renderSize) * renderSize * 4);
+    std::vector<unsigned char> stripe(std::size_t(width) * tileSize * 3);
 
-    // post-processing setup
-    try
-    {
-        m_progPost = ShaderLoader::createShaderProgram(
-            ":/resources/shaders/post.vert",
-            ":/resources/shaders/post.frag");
-    }
-    catch (const std::exception &e)
+    bool ok = true;
+    for (int row = 0; row < layout.rows() && ok; ++row)
     {
-        qWarning("Post shader compile/link error: %s", e.what());
-        m_progPost = 0;
-    }
-
-    // fullscreen quad
-    createScreenQuad();
+        int stripeRows = 0;
+        for (int col = 0; col < layout.columns(); ++col)
+        {
+            RenderTile tile = layout.tile(row, col);
+            stripeRows = tile.height;
+            m_cam.window = layout.ndcWindow(tile);
+            m_posterTile = glm::ivec4(layout.windowOrigin(tile), width, height);
 
-    // initialize the scene FBO (current viewport size)
-    GLint vp[4];
-    glGetIntegerv(GL_VIEWPORT, vp);
-    ensureSceneFBO(vp[2], vp[3]);
-
-    // Initialize FBO dimensions
-    m_fbo_width = m_sceneWidth * m_devicePixelRatio;
-    m_fbo_height = m_sceneHeight * m_devicePixelRatio;
-
-    // Create and initialize reflection FBO
-    glGenTextures(1, &m_reflectionFBO_texture);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, m_reflectionFBO_texture);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, m_fbo_width, m_fbo_height, 0,
-                 GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glBindTexture(GL_TEXTURE_2D, 0);
+            glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+            glViewport(0, 0, tile.renderWidth(), tile.renderHeight());
+            renderFrame(); // ends with fbo bound again
 
-    glGenRenderbuffers(1, &m_reflectionFBO_renderbuffer);
-    glBindRenderbuffer(GL_RENDERBUFFER, m_reflectionFBO_renderbuffer);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, m_fbo_width, m_fbo_height);
-    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+            glPixelStorei(GL_PACK_ALIGNMENT, 4);
+            glReadPixels(0, 0, tile.renderWidth(), tile.renderHeight(), GL_RGBA, GL_UNSIGNED_BYTE, tilePixels.data());
 
-    glGenFramebuffers(1, &m_reflectionFBO);
-    glBindFramebuffer(GL_FRAMEBUFFER, m_reflectionFBO);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_reflectionFBO_texture, 0);
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, m_reflectionFBO_renderbuffer);
+            // crop the margin; GL rows run up, the stripe's down
+            for (int y = 0; y < tile.height; ++y)
+            {
+                const int srcRow = tile.renderHeight() - 1 - (tile.margin + y);
+                const unsigned char *src =
+                    tilePixels.data() + (std::size_t(srcRow) * tile.renderWidth() + tile.margin) * 4;
+                unsigned char *dst = stripe.data() + (std::size_t(y) * width + tile.x) * 3;
+                for (int x = 0; x < tile.width; ++x)
+                    std::memcpy(dst + x * 3, src + x * 4, 3);
+            }
 
-    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-    {
-        std::cerr << "Error: Reflection FBO is not complete!" << std::endl;
+            // every tile is a full frame's worth of transient GL objects
+            GLResources::endFrame();
+        }
+        ok = out.writeRows(stripe.data(), stripeRows);
     }
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
-    // Create and initialize refraction FBO
-    glGenTextures(1, &m_refractionFBO_texture);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, m_refractionFBO_texture);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, m_fbo_width, m_fbo_height, 0,
-                 GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glBindTexture(GL_TEXTURE_2D, 0);
-
-    // Create depth texture for refraction FBO
-    glGenTextures(1, &m_refractionDepthTexture);
-    glBindTexture(GL_TEXTURE_2D, m_refractionDepthTexture);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, m_fbo_width, m_fbo_height, 0,
-                 GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glBindTexture(GL_TEXTURE_2D, 0);
+    m_posterTile = glm::ivec4(0);
+    m_cam.window = glm::vec4(-1.f, -1.f, 1.f, 1.f);
+    m_cam.aspect = prevAspect;
+    m_rtPool.release(color);
+    m_rtPool.release(depth);
+    glBindFramebuffer(GL_FRAMEBUFFER, prevFBO);
+    glViewport(prevViewport[0], prevViewport[1], prevViewport[2], prevViewport[3]);
+
+    ok = out.close() && ok;
+    if (ok)
+        std::cout << "[poster] " << width << "x" << height << " in " << layout.columns() * layout.rows()
+                  << " tiles of " << tileSize << " px (+" << POSTER_MARGIN << " margin) written to " << path
+                  << " in " << timer.elapsed() << " ms" << std::endl;
+    return ok;
+}
 
-    glGenFramebuffers(1, &m_refractionFBO);
-    glBindFramebuffer(GL_FRAMEBUFFER, m_refractionFBO);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_refractionFBO_texture, 0);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, m_refractionDepthTexture, 0);
+void Realtime::finishStatsRecording()
+{
+    renderStats.stopRecording();
+    renderStats.writeJson(RENDER_STATS_JSON);
+}
 
-    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-    {
-        std::cerr << "Error: Refraction FBO is not complete!" << std::endl;
-    }
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+std::string Realtime::qualityStatus() const
+{
+    char buf[256];
+    std::snprintf(buf, sizeof(buf), "Tier: %s (cpu %.1f ms / gpu %.1f ms, budget %.1f ms)\n%s",
+                  m_quality.level().name, m_quality.smoothedCpuMs(), m_quality.smoothedGpuMs(),
+                  m_quality.targetMs(), m_quality.lastDecision().c_str());
+    return buf;
+}
 
-    m_texWaterNormal = loadTexture2D(":/resources/textures/normalMap.png", false);
-    m_waterDUDVTexture = loadTexture2D(":/resources/textures/waterDUDV.png", false);
+PassPolicy Realtime::mainViewPolicy() const
+{
+    const QualityLevel &q = m_quality.level();
+    PassPolicy p = PassPolicy::mainView();
+    p.terrainLod = q.terrainLod;
+    p.leafMaxDist = q.leafMaxDist;
+    p.branchMaxDist = q.branchMaxDist;
+    return p;
 }
 
-void Realtime::paintGL() {
+void Realtime::renderFrame() {
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     if (!m_progTerrain || !m_progWater || !m_progSky) {
         // qWarning("No scene shader loaded");
         return;
     }
 
+    // one horizon per frame: main view and refraction share the camera position
+    if (m_enableHorizonCulling && m_drawForest)
+    {
+        TRACE_SCOPE("horizon update");
+        m_horizonCuller.update(m_cam.eye);
+    }
+
     GLint prevFBO = 0;
     glGetIntegerv(GL_FRAMEBUFFER_BINDING, &prevFBO);
 
@@ -1845,60 +2393,97 @@ void Realtime::paintGL() {
         h = height() * m_devicePixelRatio;
     }
 
+    // scene-file point/spot lights for the main view (reflection and refraction skip them)
+    updateLightClusters(w, h);
+
+    // due sky LUT work, then the aerial-perspective volume for this camera;
+    // every pass below binds its own framebuffer and viewport. The weather
+    // checkboxes change the preset without settingsChanged(), so the params
+    // are handed over every frame (unchanged ones are ignored).
+    renderStats.beginPass("atmosphere");
+    m_atmosphere.setParams(atmosphereFor(settings.colorGradePreset));
+    m_atmosphere.setSun(-sunDirection());
+    m_atmosphere.update(m_cam.proj() * m_cam.view(), m_cam.eye, m_cam.farP);
+    renderStats.endPass();
+
     // If the post shader fails to compile: draw directly onto the screen.
     if (!m_progPost)
     {
         glBindFramebuffer(GL_FRAMEBUFFER, prevFBO);
         glViewport(0, 0, w, h);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        glEnable(GL_DEPTH_TEST);
+        glState.enable(GL_DEPTH_TEST);
+        renderStats.beginPass("scene");
         renderScene();
+        renderStats.endPass();
         return;
     }
 
-    // Reflection & Refraction pass
+    // evict pooled targets that went unused for a while (e.g. after a resize)
+    m_rtPool.beginFrame();
+
+    // Reflection & Refraction pass (scene size, scaled down by the quality tier)
+    float waterScale = m_quality.level().reflectionScale;
+    m_fbo_width = std::max(1, int(w * waterScale));
+    m_fbo_height = std::max(1, int(h * waterScale));
+    renderStats.beginPass("reflection");
     renderReflection();
+    renderStats.beginPass("refraction");
     renderRefraction();
+    renderStats.endPass();
 
     // Scene pass: Draw to m_fboScene
-    ensureSceneFBO(w, h);
+    acquireSceneTargets(w, h);
     glBindFramebuffer(GL_FRAMEBUFFER, m_fboScene);
     glViewport(0, 0, w, h);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    glEnable(GL_DEPTH_TEST);
+    glState.enable(GL_DEPTH_TEST);
 
+    renderStats.beginPass("scene");
     renderScene();
+    renderStats.beginPass("water");
     renderWater();
+    renderStats.endPass();
+    releaseWaterTargets();
 
     glBindFramebuffer(GL_FRAMEBUFFER, prevFBO);
     glViewport(0, 0, w, h);
-    glDisable(GL_DEPTH_TEST);
+    glState.disable(GL_DEPTH_TEST);
 
     if (!m_progPost) {
         // fallback if shader failed
+        releaseSceneTargets();
         return;
     }
 
-    glUseProgram(m_progPost);
+    renderStats.beginPass("post");
+    glState.useProgram(m_progPost);
 
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, m_texSceneColor);
-    glUniform1i(glGetUniformLocation(m_progPost, "uSceneColor"), 0);
+    glState.activeTexture(GL_TEXTURE0);
+    statBindTexture(GL_TEXTURE_2D, m_rtSceneColor.tex);
+    statUniform(glUniform1i, glGetUniformLocation(m_progPost, "uSceneColor"), 0);
+    glm::vec2 sceneScale = m_rtSceneColor.uvScale();
+    statUniform(glUniform2fv, glGetUniformLocation(m_progPost, "uUVScale"), 1, &sceneScale[0]);
 
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, m_texSceneDepth);
-    glUniform1i(glGetUniformLocation(m_progPost, "uSceneDepth"), 1);
+    glState.activeTexture(GL_TEXTURE1);
+    statBindTexture(GL_TEXTURE_2D, m_rtSceneDepth.tex);
+    statUniform(glUniform1i, glGetUniformLocation(m_progPost, "uSceneDepth"), 1);
 
-    bool applyLUT = m_enableColorLUT && (m_texColorLUT > 0);
+    // whole grade chain lives in one baked LUT; pick up the latest bake first
+    requestGradeLUT();
+    pollGradeLUT();
+    bool applyLUT = !m_lutIsIdentity && (m_texColorLUT > 0);
 
-    glActiveTexture(GL_TEXTURE2);
-    glBindTexture(GL_TEXTURE_3D, m_texColorLUT);
-    glUniform1i(glGetUniformLocation(m_progPost, "uColorLUT"), 2);
+    glState.activeTexture(GL_TEXTURE2);
+    statBindTexture(GL_TEXTURE_3D, m_texColorLUT);
+    statUniform(glUniform1i, glGetUniformLocation(m_progPost, "uColorLUT"), 2);
+    statUniform(glUniform1f, glGetUniformLocation(m_progPost, "uLUTSize"), float(m_lutTexSize));
 
-    glUniform1i(glGetUniformLocation(m_progPost, "uEnableColorGrading"), applyLUT);
+    statUniform(glUniform1i, glGetUniformLocation(m_progPost, "uEnableColorGrading"), applyLUT);
 
-    glUniform1f(glGetUniformLocation(m_progPost, "uNear"), m_cam.nearP);
-    glUniform1f(glGetUniformLocation(m_progPost, "uFar"), m_cam.farP);
+    statUniform(glUniform1i, glGetUniformLocation(m_progPost, "uDoFMaxSamples"), m_quality.level().dofMaxSamples);
+    statUniform(glUniform1f, glGetUniformLocation(m_progPost, "uNear"), m_cam.nearP);
+    statUniform(glUniform1f, glGetUniformLocation(m_progPost, "uFar"), m_cam.farP);
 
     // Depth of Field parameters
     if (settings.enableDoF) {
@@ -1909,59 +2494,73 @@ void Realtime::paintGL() {
         // Blur strength
         float blurStrength = settings.blurStrength;
         
-        glUniform1f(glGetUniformLocation(m_progPost, "uFocusDistance"), focusDist);
-        glUniform1f(glGetUniformLocation(m_progPost, "uBlurStrength"), blurStrength);
+        statUniform(glUniform1f, glGetUniformLocation(m_progPost, "uFocusDistance"), focusDist);
+        statUniform(glUniform1f, glGetUniformLocation(m_progPost, "uBlurStrength"), blurStrength);
     } else {
         // Disable DoF by setting blur strength to 0
-        glUniform1f(glGetUniformLocation(m_progPost, "uFocusDistance"), m_cam.nearP + 1.0f);
-        glUniform1f(glGetUniformLocation(m_progPost, "uBlurStrength"), 0.0f);
+        statUniform(glUniform1f, glGetUniformLocation(m_progPost, "uFocusDistance"), m_cam.nearP + 1.0f);
+        statUniform(glUniform1f, glGetUniformLocation(m_progPost, "uBlurStrength"), 0.0f);
     }
 
-    // Select the preset and exposure based on the two checkboxes in the UI
-    int preset = settings.colorGradePreset; // 0 = none, 1 = cold, 3 = rainy
-    float exposure = 0.0f;
-    float strength = 0.0f; // color intensity
+    // Draw a full-screen quad, and output the processed result to prevFBO (screen or screenshot FBO).
+    m_screenQuad.draw();
+    renderStats.endPass();
+    releaseSceneTargets();
+
+    glState.activeTexture(GL_TEXTURE2); statBindTexture(GL_TEXTURE_3D, 0);
+    glState.activeTexture(GL_TEXTURE1); statBindTexture(GL_TEXTURE_2D, 0);
+    glState.activeTexture(GL_TEXTURE0); statBindTexture(GL_TEXTURE_2D, 0);
+    glState.enable(GL_DEPTH_TEST);
+}
+
+void Realtime::requestGradeLUT()
+{
+    if (!m_lutBaker)
+        return;
+
+    LUTUtils::GradeParams p;
+
+    // The weather presets (checkboxes) don't grade: their look comes from the
+    // atmosphere and particles. Exposure stays 0.
 
-    if (preset == 1)
+    // Adjustable: neutral lift/gamma/gain and tint
+    p.lift = glm::vec3(0.0f);
+    p.gamma = glm::vec3(1.0f);
+    p.gain = glm::vec3(1.0f);
+    p.tint = glm::vec3(1.0f);
+
+    // 'L' toggles the creative LUT ('2' picks its preset, or a .cube file from settings)
+    if (m_enableColorLUT)
     {
-        // Cold Blue Snow Mountain
-        exposure = 0.18f;
-        strength = 0.85f;
+        p.stylePreset = m_lutPreset;
+        p.cubeFile = settings.lutFilePath;
     }
-    else if (preset == 3)
+
+    m_lutBaker->request(p, m_lutSize);
+}
+
+void Realtime::pollGradeLUT()
+{
+    if (!m_lutBaker)
+        return;
+
+    int size = 0;
+    bool identity = true;
+    std::vector<float> data;
+    if (!m_lutBaker->takeResult(size, data, identity))
+        return;
+    renderStats.bufferUpload(data.size() * sizeof(float));
+
+    if (m_texColorLUT && size == m_lutTexSize)
     {
-        // Rainy
-        exposure = -0.18f;
-        strength = 0.90f;
+        LUTUtils::updateLUT3DTexture(m_texColorLUT, size, data);
     }
     else
     {
-        // Default
-        exposure = 0.0f;
-        strength = 0.0f;
+        m_texColorLUT = GLTexture::adopt(LUTUtils::createLUT3DTexture(size, data));
+        m_lutTexSize = size;
     }
-
-    glUniform1f(glGetUniformLocation(m_progPost, "uExposure"), exposure);
-
-    // Adjustable: neutral lift/gamma/gain specs (modified in shader post.frag)
-    glUniform3f(glGetUniformLocation(m_progPost, "uLift"), 0.0f, 0.0f, 0.0f);
-    glUniform3f(glGetUniformLocation(m_progPost, "uGamma"), 1.0f, 1.0f, 1.0f);
-    glUniform3f(glGetUniformLocation(m_progPost, "uGain"), 1.0f, 1.0f, 1.0f);
-
-    // Transmit preset + intensity
-    glUniform1i(glGetUniformLocation(m_progPost, "uGradePreset"), preset);
-    glUniform1f(glGetUniformLocation(m_progPost, "uGradeStrength"), strength);
-
-    // Adjustable: default tint (modified in shader post.frag)
-    glUniform3f(glGetUniformLocation(m_progPost, "uTint"), 1.0f, 1.0f, 1.0f);
-
-    // Draw a full-screen quad, and output the processed result to prevFBO (screen or screenshot FBO).
-    m_screenQuad.draw();
-
-    glActiveTexture(GL_TEXTURE2); glBindTexture(GL_TEXTURE_3D, 0);
-    glActiveTexture(GL_TEXTURE1); glBindTexture(GL_TEXTURE_2D, 0);
-    glActiveTexture(GL_TEXTURE0); glBindTexture(GL_TEXTURE_2D, 0);
-    glEnable(GL_DEPTH_TEST);
+    m_lutIsIdentity = identity;
 }
 
 void Realtime::resizeGL(int w, int h)
@@ -1976,15 +2575,24 @@ void Realtime::resizeGL(int w, int h)
 
 void Realtime::sceneChanged()
 {
+    if (!m_glInitialized)
+        return; // initializeGL() loads settings.sceneFilePath itself
+
     makeCurrent();
-    // Parse the current scene file into m_rd
-    RenderData rd;
-    if (!SceneParser::parse(settings.sceneFilePath, rd))
-    {
-        doneCurrent();
-        update();
-        return;
-    }
+    glState.invalidate(); // Qt may have used the context since our last frame
+    loadSceneFile();
+    doneCurrent();
+    update(); // asks for a PaintGL() call to occur
+}
+
+bool Realtime::loadSceneFile()
+{
+    TRACE_SCOPE("loadSceneFile");
+
+    // Parse the current scene file (or its cache) into m_rd
+    FlatScene rd;
+    if (!SceneParser::parseFlat(settings.sceneFilePath, rd))
+        return false;
 
     m_rd = std::move(rd);
 
@@ -2003,6 +2611,7 @@ void Realtime::sceneChanged()
     m_cam.look = f;
     m_cam.up = u;
     m_cam.fovyRad = C.heightAngle;
+    m_sim.setPose({pos, f, u}); // the next frames render the simulation's pose
 
     m_cam.aspect = (height() > 0) ? float(width()) / float(height()) : m_cam.aspect;
 
@@ -2010,12 +2619,19 @@ void Realtime::sceneChanged()
     m_cam.nearP = std::max(EPS, settings.nearPlane);
     m_cam.farP = std::max(m_cam.nearP + EPS, settings.farPlane);
 
-    doneCurrent();
-    update(); // asks for a PaintGL() call to occur
+    // scene shapes draw with the default shader, which is otherwise loaded in the background
+    m_startup.require(m_taskDefaultShader);
+    rebuildDrawListFromRenderData(SCENE_TESS_P1, SCENE_TESS_P2);
+    uploadLights(m_prog, m_rd.lights);
+
+    std::cout << "[scene] " << m_drawList.size() << " shapes, " << m_rd.lights.size() << " lights from "
+              << settings.sceneFilePath << std::endl;
+    return true;
 }
 
 void Realtime::settingsChanged()
 {
+    TRACE_SCOPE("settingsChanged");
 
     if (!m_glInitialized)
     {
@@ -2025,81 +2641,45 @@ void Realtime::settingsChanged()
     }
 
     makeCurrent();
+    glState.invalidate(); // Qt may have used the context since our last frame
 
     // Update camera near/far immediately
     m_cam.nearP = std::max(EPS, settings.nearPlane);
     m_cam.farP = std::max(m_cam.nearP + EPS, settings.farPlane);
 
-    // map UI -> Terrain Parameters
-    TerrainGenerator::TerrainParams P;
-
-    // P1: mountain roughness / frequency
-    P.baseFreq = 0.25f * powf(2.f, (settings.shapeParameter1 - 5) / 3.f);
-
-    // P2: mountian heights
-    P.heightScale = 0.12f * settings.shapeParameter2;
-
-    // P3: terrain distortion and river curvature (EC3 trigger)
-    int s3 = glm::clamp(settings.shapeParameter3, 1, 5);
-    float t3 = (s3 - 1) / 4.f; // 0..1
-
-    // domain warping makes the terrain more "organic"
-    P.warpStrength = glm::mix(0.10f, 0.45f, t3);
-
-    // EC1 cliff, EC2 crater
-    P.cliffSteps = settings.extraCredit1 ? 5 : 1;
-    P.enableCraters = settings.extraCredit2;
-    P.enableCraters = settings.extraCredit2;
-    // Adjustable:
-    if (P.enableCraters)
-    {
-        P.craterDensity = 4.0f; // slightly thinner
-        P.craterRadius = 0.05f;
-        P.craterDepth = 0.32f; // dig deeper -> bottom of the pit will be below sea level more
-    }
-
-    P.enableRivers = settings.extraCredit3;
-    if (P.enableRivers)
-    {
-        // frequency: higher -> the more meandering the river.
-        P.riverFreq = glm::mix(0.5f, 1.4f, t3);
-        // ridged deg: greater -> sharper trough
-        P.riverSharp = glm::mix(1.0f, 2.5f, t3);
-        // threshold: the larger t3 is -> the wider the river.
-        P.riverThresh = glm::mix(0.92f, 0.75f, t3);
-        // depth
-        P.riverDepth = glm::mix(0.04f, 0.18f, t3);
-    }
-    else
-    {
-        P.riverDepth = 0.0f;
-    }
-
-    // water level & overall offset
-    P.seaLevel = -0.1f;
-    P.oceanBias = 0.0f; // Aborted
 
-    m_terrainParams = P;
+    // map UI -> Terrain Parameters
+    TerrainGenerator::TerrainSliders sliders;
+    sliders.roughness = settings.shapeParameter1;
+    sliders.height = settings.shapeParameter2;
+    sliders.distortion = settings.shapeParameter3;
+    sliders.cliffs = settings.extraCredit1;
+    sliders.craters = settings.extraCredit2;
+    sliders.rivers = settings.extraCredit3;
+
+    m_terrainParams = TerrainGenerator::paramsFromSliders(sliders);
     m_terrainGen.setParams(m_terrainParams);
 
     // calc. sea height / height under world scale for texture coloring
     m_seaHeightWorld = m_terrainParams.seaLevel * m_terrainParams.heightScale * 10.f;
     m_heightScaleWorld = m_terrainParams.heightScale * 10.f;
 
-    std::vector<float> interlPNC = m_terrainGen.generateTerrain();
-    m_terrainMesh.uploadinterleavedPNC(interlPNC);
+    uploadTerrainMeshes();
 
     rebuildWaterMesh();
 
     m_drawForest = settings.extraCredit4;
     if (m_drawForest)
     {
+        m_startup.require(m_taskForest);
         buildForest();
         buildRocks();
     }
     else
     {
         m_forestBranches.clear();
+        m_forestTrees.clear();
+        m_vegetationCells.clear();
         m_rocks.clear();
         m_rockInstanceCount = 0;
     }
@@ -2115,12 +2695,19 @@ void Realtime::keyPressEvent(QKeyEvent *event)
     if (event->key() == Qt::Key_P)
     {
         m_isPathAnimating = !m_isPathAnimating;
+        m_sim.setPathAnimating(m_isPathAnimating);
         if (m_isPathAnimating)
         {
-            m_pathTimer.start();
+            // one loop of the camera path is the benchmark run
+            renderStats.startRecording();
+        }
+        else if (renderStats.recording())
+        {
+            finishStatsRecording(); // stopped early: keep what we have
         }
     }
     m_keyMap[Qt::Key(event->key())] = true;
+    updateMoveKeys();
 
     // Fog toggle
     if (event->key() == Qt::Key_F) {
@@ -2134,11 +2721,41 @@ void Realtime::keyPressEvent(QKeyEvent *event)
         update();
     }
 
-    // LUT Preset 2: Cool/Blue
+    // Render stats overlay toggle
+    if (event->key() == Qt::Key_I && m_statsOverlay) {
+        m_statsOverlay->setVisible(!m_statsOverlay->isVisible());
+        update();
+    }
+
+    // CPU trace capture: T starts, T again writes TRACE_JSON (chrome://tracing / Perfetto)
+    if (event->key() == Qt::Key_T && !event->isAutoRepeat()) {
+        if (Tracer::active())
+            Tracer::writeJson(TRACE_JSON);
+        else
+            Tracer::start();
+    }
+
+    // Frame capture: C records one camera-path loop to CAPTURE_DIR, C again stops early
+    if (event->key() == Qt::Key_C && !event->isAutoRepeat()) {
+        makeCurrent();
+        if (m_capture.active())
+            stopCapture();
+        else
+            startCapture(settings.captureDir.empty() ? CAPTURE_DIR : settings.captureDir);
+        doneCurrent();
+        update();
+    }
+
+    // Horizon culling toggle (vegetation behind terrain ridges)
+    if (event->key() == Qt::Key_H) {
+        m_enableHorizonCulling = !m_enableHorizonCulling;
+        std::cout << "[horizon] culling " << (m_enableHorizonCulling ? "on" : "off") << "\n";
+        update();
+    }
+
+    // LUT Preset 2: Cool/Blue (baked on the worker, picked up in paintGL)
     if (event->key() == Qt::Key_2) {
-        std::vector<float> lutData = LUTUtils::generateStyledLUT(m_lutSize, 2);
-        glDeleteTextures(1, &m_texColorLUT);
-        m_texColorLUT = LUTUtils::createLUT3DTexture(m_lutSize, lutData);
+        m_lutPreset = 2;
         update();
     }
 }
@@ -2146,6 +2763,7 @@ void Realtime::keyPressEvent(QKeyEvent *event)
 void Realtime::keyReleaseEvent(QKeyEvent *event)
 {
     m_keyMap[Qt::Key(event->key())] = false;
+    updateMoveKeys();
 }
 
 void Realtime::mousePressEvent(QMouseEvent *event)
@@ -2180,16 +2798,10 @@ void Realtime::mouseMoveEvent(QMouseEvent *event)
         const float kSensitivity = 0.0035f;
 
         // Yaw: rotate around world +Y by -deltaX (right drag -> look to the right)
-        if (deltaX != 0.0f)
-        {
-            m_cam.yaw(-deltaX * kSensitivity);
-        }
-
         // Pitch: rotate around camera "right" by -deltaY (up drag -> look up)
-        if (deltaY != 0.0f)
-        {
-            m_cam.pitch(-deltaY * kSensitivity);
-        }
+        // both applied by the simulation at its next step
+        if (deltaX != 0 || deltaY != 0)
+            m_sim.look(-deltaX * kSensitivity, -deltaY * kSensitivity);
 
         update(); // asks for a PaintGL() call to occur
     }
@@ -2197,83 +2809,44 @@ void Realtime::mouseMoveEvent(QMouseEvent *event)
 
 void Realtime::timerEvent(QTimerEvent *event)
 {
-    int elapsedms = m_elapsedTimer.elapsed();
-    float dt = elapsedms * 0.001f;
-    m_elapsedTimer.restart();
-
-    // Use deltaTime and m_keyMap here to move around
-    // Clamp dt to avoid huge jumps if the app was paused
-    dt = std::min(dt, 0.1f);
-
-    m_time += dt; // water animation time var.
-
-    if (m_isPathAnimating)
-    {
-        float t = m_pathTimer.elapsed() / 1000.0f;
-        // Loop every 20 seconds
-        t = fmod(t, 20.0f);
-
-        CameraPath::Pose pose = m_cameraPath.evaluate(t);
-        m_cam.eye = pose.position;
-        m_cam.look = pose.rotation * glm::vec3(0, 0, -1);
-        m_cam.up = pose.rotation * glm::vec3(0, 1, 0);
-
-        update();
-        return; // Skip manual control
-    }
+    if (m_capture.active())
+        return; // paintGL advances the capture clock and schedules the next frame
 
-    // Target speed: 5 world-space units per second (spec requirement)
-    const float speed = 5.0f;
+    // one loop of the camera path, in simulated time, is the benchmark run
+    if (renderStats.recording() && m_simFrame && m_simFrame->pathAnimating &&
+        m_simFrame->pathTime >= CAMERA_PATH_SECONDS)
+        finishStatsRecording();
 
-    // Camera basis: forward (look), right (perpendicular to look & up), and world up
-    glm::vec3 fwd = glm::normalize(m_cam.look);
-    glm::vec3 right = glm::normalize(glm::cross(fwd, m_cam.up));
-    const glm::vec3 worldUp(0.f, 1.f, 0.f);
+    update(); // asks for a PaintGL() call to occur
+}
 
-    // Accumulate intent based on keys held
-    glm::vec3 move(0.f);
+void Realtime::updateMoveKeys()
+{
+    unsigned keys = 0;
     if (m_keyMap[Qt::Key_W])
-        move += fwd; // forward
+        keys |= Simulation::Forward;
     if (m_keyMap[Qt::Key_S])
-        move -= fwd; // backward
+        keys |= Simulation::Back;
     if (m_keyMap[Qt::Key_D])
-        move += right; // right
+        keys |= Simulation::Right;
     if (m_keyMap[Qt::Key_A])
-        move -= right; // left
+        keys |= Simulation::Left;
     if (m_keyMap[Qt::Key_Space])
-        move += worldUp; // up in world space
+        keys |= Simulation::Up; // up in world space
     if (m_keyMap[Qt::Key_Control])
-        move -= worldUp; // down in world space
-
-    // Normalize so diagonals are not faster, then apply speed and delta time
-    if (glm::length2(move) > 0.f)
-    {
-        move = glm::normalize(move) * (speed * dt);
-        m_cam.translateWorld(move);
-    }
-
-    // Update Particles
-    if (m_particleSystem)
-    {
-        // Check settings for type change
-        int targetType = -1;
-        if (settings.colorGradePreset == 1)
-            targetType = 0; // Snow
-        else if (settings.colorGradePreset == 3)
-            targetType = 1; // Rain
-
-        
-
-        if (targetType != -1 && targetType != m_currentParticleType)
-        {
-            m_currentParticleType = targetType;
-            m_particleSystem->setType(m_currentParticleType);
-        }
-
-        m_particleSystem->update(dt);
-    }
+        keys |= Simulation::Down;
+    m_sim.setMoveKeys(keys);
+}
 
-    update(); // asks for a PaintGL() call to occur
+void Realtime::applySimFrame(const SimFrame &frame, float alpha)
+{
+    SimPose pose = Simulation::interpolate(frame, alpha);
+    m_cam.eye = pose.eye;
+    m_cam.look = pose.look;
+    m_cam.up = pose.up;
+    m_time = float(Simulation::renderTime(frame, alpha)); // water animation time var.
+    m_simFrame = &frame;
+    m_simAlpha = alpha;
 }
 
 // DO NOT EDIT
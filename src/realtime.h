@@ -9,12 +9,17 @@
 
 #include <unordered_map>
 #include <QElapsedTimer>
+#include <QImage>
+#include <QLabel>
 #include <QOpenGLWidget>
 #include <QTime>
 #include <QTimer>
 
 #include <unordered_map>
+#include "utils/gl_handle.h"
 #include "utils/gl_mesh.h"
+#include "utils/gl_state.h"
+#include "utils/light_clusters.h"
 #include "utils/sceneparser.h"
 #include "utils/shaderloader.h" // shader program builder
 #include "camera.h"             // Camera class (view/proj, yaw/pitch/move)
@@ -22,9 +27,25 @@
 // #include "terrain/voxel_chunk.h"
 #include "terrain/terraingenerator.h"
 #include "vegetation/lsystem_tree.h"
+#include "vegetation/forest_placement.h"
+#include "vegetation/rock_placement.h"
 #include "particles/particlesystem.h"
 #include "utils/camera_path.h"
+#include "utils/pass_policy.h"
+#include "utils/frustum.h"
+#include "terrain/horizon_culler.h"
 #include "lut_utils.h"
+#include "post/frame_capture.h"
+#include "post/lut_baker.h"
+#include "post/render_target_pool.h"
+#include "simulation.h"
+#include "sky/atmosphere.h"
+#include "utils/quality_governor.h"
+#include "utils/mem_tracker.h"
+#include "utils/render_stats.h"
+#include "utils/startup_graph.h"
+#include "utils/trace.h"
+#include "utils/world_cache.h"
 
 class Realtime : public QOpenGLWidget
 {
@@ -34,6 +55,9 @@ public:
     void sceneChanged();
     void settingsChanged();
     void saveViewportImage(std::string filePath);
+    std::string qualityStatus() const; // current tier + last governor decision, for the UI
+
+    static constexpr float CAMERA_PATH_SECONDS = 20.f; // one loop of the camera path (key P, capture)
 
 public slots:
     void tick(QTimerEvent *event); // Called once per tick of m_timer
@@ -53,12 +77,36 @@ private:
 
     // Camera Path
     CameraPath m_cameraPath;
-    QElapsedTimer m_pathTimer;
     bool m_isPathAnimating = false;
 
+    // Camera motion, particles and m_time advance on the simulation thread
+    // at a fixed step; each frame renders its newest state, interpolated
+    Simulation m_sim;
+    const SimFrame *m_simFrame = nullptr; // what this frame renders
+    float m_simAlpha = 1.f;               // between m_simFrame's previous and current step
+    int m_simGradePreset = -1;            // colorGradePreset the particle type was last set for
+    void applySimFrame(const SimFrame &frame, float alpha);
+    void updateMoveKeys();
+
+    // Frame capture (key C, or --capture): one loop of the camera path on a
+    // fixed clock, every frame read back asynchronously and written to disk
+    static constexpr const char *CAPTURE_DIR = "capture"; // key C without --capture
+    FrameCapture m_capture;
+    int m_captureFps = 30;
+    int m_captureEnd = 0; // one past the last frame to render
+    bool m_quitAfterCapture = false; // started from the command line
+    void startCapture(const std::string &dir);
+    void stopCapture();
+
+    // Poster (--poster): one still far larger than the window, rendered in
+    // tiles through the normal frame and streamed to disk a tile row at a time
+    static constexpr int POSTER_TILE = 1024;  // kept pixels per tile side
+    static constexpr int POSTER_MARGIN = 64;  // rendered around each tile for the screen-space passes, then cropped
+    glm::ivec4 m_posterTile{0};               // while rendering a tile: its window origin and the poster size
+    bool renderPoster(const std::string &path, int width, int height);
+
     // Tick Related Variables
-    int m_timer;                  // Stores timer which attempts to run ~60 times per second
-    QElapsedTimer m_elapsedTimer; // Stores timer which keeps track of actual time between frames
+    int m_timer; // Stores timer which attempts to run ~60 times per second
 
     // Input Related Variables
     bool m_mouseDown = false;                   // Stores state of left mouse button
@@ -121,13 +169,43 @@ private:
     };
 
     // Runtime state
-    GLuint m_prog = 0; // shader program handle
+    GLProgram m_prog; // shader program handle
     Camera m_cam;      // CPU-side camera (view/proj + motion)
 
-    RenderData m_rd;                                              // parsed scene data (camera/global/lights/shapes)
+    FlatScene m_rd;                                               // parsed scene data (camera/global/lights/shapes)
     std::unordered_map<MeshKey, GLMesh, MeshKeyHash> m_meshCache; // shared geometries
     std::vector<DrawItem> m_drawList;                             // per-instance draw commands
 
+    // m_drawList grouped by (mesh, material): each batch is one instanced
+    // draw whose model/normal matrices sit in m_sceneInstanceUBO at offset.
+    // Regrouped only when an item changes LOD band.
+    struct SceneBatch
+    {
+        GLMesh *mesh = nullptr;
+        MaterialCPU mat;
+        GLintptr offset = 0; // bytes into m_sceneInstanceUBO
+        GLsizei count = 0;   // at most SCENE_MAX_INSTANCES
+    };
+    static constexpr int SCENE_MAX_INSTANCES = 128; // 128 x 128 B = the 16 KB every GL 4.1 UBO allows
+    static constexpr int SCENE_TESS_P1 = 24;        // full-detail tessellation of scene-file shapes
+    static constexpr int SCENE_TESS_P2 = 24;
+    std::vector<SceneBatch> m_sceneBatches;
+    GLBuffer m_sceneInstanceUBO;
+    bool m_sceneBatchesDirty = false;
+
+    // Scene-file point and spot lights, culled into a view-space cluster grid
+    // each frame and read by the terrain, forest and default shaders
+    // (clustered_lights.glsl). The lights are uploaded once per scene load.
+    std::vector<ClusterLight> m_clusterLights;
+    LightClusterGrid m_lightClusters;
+    GLBuffer m_clusterLightUBO;     // ClusterLights block
+    GLBuffer m_clusterDataBuffer;   // LightClusterGrid::gpuData(), rewritten per frame
+    GLTexture m_clusterDataTex;     // R32UI buffer texture over m_clusterDataBuffer
+    glm::vec4 m_clusterWindow{0.f, 0.f, 1.f, 1.f}; // uClusterWindow
+    GLint m_clusterDataLimit = 0;   // GL_MAX_TEXTURE_BUFFER_SIZE
+    bool m_clusterGridValid = false; // built and uploaded for this frame
+    bool m_clusterOverflowReported = false;
+
     // terrain
     // reserved for infinite generation (if needed)
     // data for a single tile: its own mesh + model matrix
@@ -138,7 +216,22 @@ private:
     };
 
     GLMesh m_terrainMesh;
-    GLuint m_progTerrain = 0;
+    GLMesh m_terrainMeshLod[2]; // coarser copies for secondary passes (grid step 2, 4)
+
+    // terrain is emitted as NxN patches; per LOD: world-space AABBs stored contiguously
+    // and the matching vertex ranges, ready for glMultiDrawArrays
+    static constexpr int TERRAIN_PATCHES_PER_SIDE = 16;
+    struct TerrainPatchSet
+    {
+        std::vector<AABB> bounds;
+        std::vector<GLint> first;
+        std::vector<GLsizei> count;
+    };
+    TerrainPatchSet m_terrainPatches[3]; // LOD 0 (full), 1, 2
+    std::vector<GLint> m_visibleFirst;     // scratch for the per-view visible ranges
+    std::vector<GLsizei> m_visibleCount;
+    void drawTerrainPatches(int lod, const glm::mat4 &viewProj, const PassPolicy &policy);
+    GLProgram m_progTerrain;
     bool m_hasTerrain = false;
     bool m_terrainWire = false;
     glm::mat4 m_terrainModel = glm::mat4(1.f); // single-block reference model matrix (R*S*T)
@@ -150,69 +243,69 @@ private:
     TerrainGenerator::TerrainParams m_terrainParams; // save the most recent setParams value
 
     // terrain textures
-    GLuint m_texGrassAlbedo = 0;
-    GLuint m_texRockAlbedo = 0;
-    GLuint m_texBeachAlbedo = 0;
-    GLuint m_texRockHighAlbedo = 0;
-    GLuint m_texSnowAlbedo = 0;
+    GLTexture m_texGrassAlbedo;
+    GLTexture m_texRockAlbedo;
+    GLTexture m_texBeachAlbedo;
+    GLTexture m_texRockHighAlbedo;
+    GLTexture m_texSnowAlbedo;
 
     // normal/disp
-    GLuint m_texGrassNormal = 0;
-    GLuint m_texRockNormal = 0;
-    GLuint m_texBeachNormal = 0;
-    GLuint m_texRockHighNormal = 0;
-    GLuint m_texSnowNormal = 0;
-
-    GLuint m_texGrassRough = 0;
-    GLuint m_texRockRough = 0;
-    GLuint m_texBeachRough = 0;
-    GLuint m_texRockHighRough = 0;
-    GLuint m_texSnowRough = 0;
+    GLTexture m_texGrassNormal;
+    GLTexture m_texRockNormal;
+    GLTexture m_texBeachNormal;
+    GLTexture m_texRockHighNormal;
+    GLTexture m_texSnowNormal;
+
+    GLTexture m_texGrassRough;
+    GLTexture m_texRockRough;
+    GLTexture m_texBeachRough;
+    GLTexture m_texRockHighRough;
+    GLTexture m_texSnowRough;
 
     // --- water ---
     GLMesh m_waterMesh;
-    GLuint m_progWater = 0;
-    GLuint m_texWaterNormal = 0;
+    GLProgram m_progWater;
+    GLTexture m_texWaterNormal;
     float m_time = 0.f; // time used for rolling UV
     float WATER_HEIGHT = 0.f;
 
-    GLuint m_reflectionFBO;
-    GLuint m_reflectionFBO_texture;
-    GLuint m_reflectionFBO_renderbuffer;
-    GLuint m_refractionFBO;
-    GLuint m_refractionFBO_texture;
-    GLuint m_refractionFBO_renderbuffer;
-    GLuint m_refractionDepthTexture; // Depth texture for refraction FBO
-    int m_fbo_width;
-    int m_fbo_height;
-    glm::vec4 m_currentClipPlane;
+    // reflection / refraction targets come from m_rtPool every frame
+    RenderTarget m_rtReflection;      // color, read by renderWater()
+    RenderTarget m_rtReflectionDepth; // transient, released right after renderReflection()
+    RenderTarget m_rtRefraction;      // color, read by renderWater()
+    RenderTarget m_rtRefractionDepth; // read by renderWater(); aliases the reflection depth
+    int m_fbo_width = 0;
+    int m_fbo_height = 0;
+    glm::mat4 m_refractionProj{1.f}; // oblique projection used for the refraction pass
 
     // Water textures
-    GLuint m_normalMapTexture; // Normal map texture for water
-    GLuint m_waterDUDVTexture; // DUDV map texture for water
+    GLTexture m_normalMapTexture; // Normal map texture for water
+    GLTexture m_waterDUDVTexture; // DUDV map texture for water
 
-    // fog
+    // fog: the atmosphere's aerial perspective on terrain and water (F)
     bool m_enableFog = true;
     bool m_enableHeightFog = true;
-    float m_fogDensity = 0.05f;
     float m_fogHeightFalloff = 0.08f;
     float m_fogStart = 0.0f;
-    glm::vec3 m_fogColor = glm::vec3(0.5f, 0.6f, 0.7f);
 
-    // LUT
-    GLuint m_texColorLUT = 0;
-    int    m_lutSize = 32;
+    // LUT: exposure, lift/gamma/gain, tint and style LUT baked into one texture
+    GLTexture m_texColorLUT;
+    int    m_lutSize = 32;       // 32 or 64
+    int    m_lutTexSize = 0;     // size of the currently allocated texture
     bool   m_enableColorLUT = false;
     int    m_lutPreset = 0;
+    bool   m_lutIsIdentity = true; // skip the lookup when the baked LUT is a no-op
+    LUTBaker *m_lutBaker = nullptr;
+    void requestGradeLUT(); // build GradeParams from settings and queue a bake if they changed
+    void pollGradeLUT();    // upload a finished bake (GL thread)
 
-    // skybox
+    // skybox: sky.frag reads the atmosphere's sky-view LUT
     GLMesh *m_skyCube = nullptr;
-    GLuint m_progSky = 0;
-    GLuint m_texSkySunny = 0; // 晴天 Cubemap
-    GLuint m_texSkyRainy = 0; // 雨天 Cubemap
+    GLProgram m_progSky;
+    Atmosphere m_atmosphere; // sky, and the fog of everything under it
 
     // --- Vegetation / L-system forest ---
-    GLuint m_progForest = 0;
+    GLProgram m_progForest;
     GLMesh *m_treeCylinderMesh = nullptr; // shared cylinder geometry (from mesh cache)
     GLMesh *m_leafMesh = nullptr;
     GLMesh *m_rockMesh = nullptr;
@@ -221,34 +314,88 @@ private:
     std::vector<glm::mat4> m_forestLeaves;
     std::vector<glm::mat4> m_rocks;
 
-    GLuint m_texRockObjAlbedo = 0; // Rock texture
+    // per-tree slices of the branch / leaf instance buffers, for per-pass distance cut-offs
+    using ForestTree = ForestTreeRange;
+    std::vector<ForestTree> m_forestTrees;
+
+    // coarse grid of trees for horizon culling: a whole cell is rejected first
+    static constexpr int VEGETATION_CELLS_PER_SIDE = 16;
+    struct VegetationCell
+    {
+        AABB bounds;
+        std::vector<int> trees; // indices into m_forestTrees
+    };
+    std::vector<VegetationCell> m_vegetationCells;
+    std::vector<int> m_visibleTrees; // scratch, sorted so instance runs coalesce
+    void buildVegetationCells();
+
+    // terrain horizon seen from the camera, rebuilt once per frame
+    HorizonCuller m_horizonCuller;
+    bool m_enableHorizonCulling = true;
+    void updateHorizonHeightField(); // after the terrain changes
+
+    // contiguous range of instances drawn with one call
+    struct InstanceRun
+    {
+        GLint first = 0;
+        GLsizei count = 0;
+    };
+    // what one pass draws of the forest; limit* = false means "draw every instance"
+    struct ForestRuns
+    {
+        bool limitTrees = false;
+        bool limitRocks = false;
+        std::vector<InstanceRun> branches, leaves, rocks;
+    };
+    // frustum / water plane / distance / horizon culling of trees and rocks for one pass
+    void collectForestRuns(const glm::mat4 &viewProj, const PassPolicy &policy, ForestRuns &out);
+    // draw instance runs by re-pointing the per-instance mat4 attributes (no baseInstance in GL 4.1)
+    void drawInstanceRuns(GLMesh *mesh, GLuint instanceVBO, const std::vector<InstanceRun> &runs);
+    // new instance buffer bound to mesh's attributes 2..5; the previous one is retired
+    void uploadInstanceMatrices(GLMesh *mesh, GLBuffer &vbo, const glm::mat4 *models, std::size_t count);
+
+    GLTexture m_texRockObjAlbedo; // Rock texture
 
     // specs for branch / leave instance rendering
-    GLuint m_branchInstanceVBO = 0;
-    GLuint m_leafInstanceVBO = 0;
-    GLuint m_rockInstanceVBO = 0;
+    GLBuffer m_branchInstanceVBO;
+    GLBuffer m_leafInstanceVBO;
+    GLBuffer m_rockInstanceVBO;
     GLsizei m_branchInstanceCount = 0;
     GLsizei m_leafInstanceCount = 0;
     GLsizei m_rockInstanceCount = 0;
 
+    // --- Frame timing / quality governor ---
+    static constexpr int GPU_TIMER_FRAMES = 3; // results are read this many frames late, no stall
+    GLuint m_gpuTimers[GPU_TIMER_FRAMES] = {0, 0, 0};
+    bool m_gpuTimerPending[GPU_TIMER_FRAMES] = {false, false, false};
+    int m_gpuTimerFrame = 0;
+    float m_lastGpuMs = -1.f; // -1 until the first result arrives
+    QualityGovernor m_quality;
+    PassPolicy mainViewPolicy() const; // PassPolicy::mainView() scaled by the current quality tier
+
+    // --- Render stats ---
+    static constexpr const char *RENDER_STATS_JSON = "render_stats.json"; // written after a camera-path run
+    QLabel *m_statsOverlay = nullptr; // draw calls / triangles / ... per pass, key I
+    void finishStatsRecording();
+    static constexpr const char *TRACE_JSON = "trace.json"; // CPU zones, key T toggles the capture
+    static constexpr double STARTUP_UPLOAD_BUDGET_MS = 2.0; // background uploads per frame (at least one task)
+
     // --- Post-processing / FBO ---
+    RenderTargetPool m_rtPool; // every offscreen target is acquired from here
+    RenderTarget m_rtSceneColor;
+    RenderTarget m_rtSceneDepth;
     GLuint m_fboScene = 0;
-    GLuint m_texSceneColor = 0;
-    GLuint m_texSceneDepth = 0;
-    int m_sceneWidth = 0;
-    int m_sceneHeight = 0;
 
     // GLuint m_fboPingPong[2] = {0, 0};
     // GLuint m_texPingPong[2] = {0, 0};
 
-    GLuint m_progPost = 0; // bus post-process shader
+    GLProgram m_progPost; // bus post-process shader
     GLMesh m_screenQuad;   // full-screen triangles/quadrilaterals
 
     // helpers
 
     // Particle System
-    ParticleSystem *m_particleSystem = nullptr;
-    int m_currentParticleType = -1;
+    ParticleSystem *m_particleSystem = nullptr; // draws m_simFrame's particles
 
     // Get or create a shared GLMesh for a primitive (by type + p1 + p2). Never duplicates buffers.
     GLMesh *getOrCreateMesh(const ScenePrimitive &prim, int p1, int p2);
@@ -256,9 +403,25 @@ private:
     // Rebuild m_drawList from m_rd using current tessellation (p1,p2)
     void rebuildDrawListFromRenderData(int p1, int p2);
 
-    // Upload lights from m_rd.lights into shader uniform arrays (uDirs/uPoints/uSpots)
+    // parse settings.sceneFilePath into m_rd / m_drawList and take its camera (GL context current)
+    bool loadSceneFile();
+
+    // per frame: move items between distance bands (with hysteresis), then regroup if any moved
+    void updateSceneLod();
+    void rebuildSceneBatches();
+    void drawSceneItems(const glm::vec3 &sunDir, const glm::vec3 &sunColor, const glm::vec3 &ambColor);
+
+    // Directional lights from m_rd.lights into the uDirs uniform array; point
+    // and spot lights into m_clusterLights and the ClusterLights block
     void uploadLights(GLuint prog, const std::vector<SceneLightData> &lights);
 
+    // bin m_clusterLights for the main camera and a w x h viewport
+    void updateLightClusters(int w, int h);
+    // once after linking: ClusterLights block binding and the uClusterData unit
+    void bindClusterInputs(GLuint prog);
+    // per pass; enabled only where the grid matches the camera (the main view)
+    void setClusterUniforms(GLuint prog, bool enabled);
+
     // (Optional) clear all GL meshes in cache (used in finish() or when forcing rebuild)
     void destroyMeshCache();
 
@@ -268,19 +431,48 @@ private:
     void buildForest(); // Generate/Rebuild Forest
     void buildRocks();  // Generate/Rebuild Rocks
 
-    GLuint loadTexture2D(const QString &path, bool srgb = false);
-    GLuint loadCubemap(const std::vector<QString> &faces); // 加载 Cubemap 的辅助函数
+    GLTexture loadTexture2D(const QString &path, bool srgb = false);
+
+    // decode (any thread) and upload (GL thread) halves of the loaders above
+    static QImage decodeTexture2D(const QString &path);
+    GLTexture uploadTexture2D(const QImage &img, bool srgb = false);
+
+    // shader program or 0 (with a warning) when it fails to build
+    static GLProgram buildProgram(const char *vert, const char *frag, const char *label);
+
+    // branch / leaf / rock meshes, their instance buffers and the forest shader
+    void initForestResources();
+
+    // Startup: initializeGL loads what the first frame draws; the rest is
+    // prepared in the background after it (or on first use) and uploaded a few
+    // tasks per frame.
+    StartupGraph m_startup;
+    StartupGraph::Task m_taskForest = -1;
+    StartupGraph::Task m_taskDefaultShader = -1; // scene-file shapes
+    QElapsedTimer m_startupTimer;  // from construction
+    float m_firstFrameMs = -1.f;   // construction -> first frame finished on the GPU
+    bool m_startupLogged = false;  // background loading report printed
 
     void rebuildWaterMesh();
 
-    void ensureSceneFBO(int w, int h); // create/resize scene FBO （color+depth texture）
-    void destroySceneFBO();
+    void acquireSceneTargets(int w, int h); // scene color (RGBA16F) + depth from the pool
+    void releaseSceneTargets();
+    void releaseWaterTargets(); // reflection/refraction color + refraction depth
 
     void createScreenQuad(); // create [-1,1]^2 full-screen triangular grid
     void renderScene();
+    void renderFrame(); // everything paintGL draws; paintGL wraps it in the frame timers
 
     glm::mat4 createMirroredViewMatrix(float waterHeight);
-    void renderSceneObject(const glm::mat4 &viewMatrix);
+    void renderSceneObject(const glm::mat4 &viewMatrix, const glm::mat4 &projMatrix,
+                           const PassPolicy &policy = PassPolicy::mainView());
+    void uploadTerrainMeshes(); // full-res terrain + coarse LODs from m_terrainGen
+
+    // the CPU half of uploadTerrainMeshes(), safe off the GL thread; read
+    // from settings.cacheDir when a previous run left it there
+    using TerrainBuild = TerrainMeshData;
+    TerrainBuild buildTerrainMeshes();
+    void applyTerrainMeshes(TerrainBuild &build);
     void renderReflection();
     void renderRefraction();
     void renderWater();
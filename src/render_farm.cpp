@@ -0,0 +1,198 @@
+#include "render_farm.h"
+
+#include <QElapsedTimer>
+#include <QProcessEnvironment>
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+RenderFarm::RenderFarm(QString program, QStringList workerArgs, std::string outDir, FrameWriter::Format format,
+                       int firstFrame, int endFrame, int fps, int workers)
+    : m_program(std::move(program)), m_workerArgs(std::move(workerArgs)), m_outDir(std::move(outDir)),
+      m_format(format), m_first(firstFrame), m_end(endFrame), m_fps(std::max(1, fps))
+{
+    const int count = std::max(1, std::min(workers, m_end - m_first));
+    m_workers.resize(count);
+    for (int i = 0; i < count; ++i)
+        m_workers[i].id = i;
+
+    // one contiguous range per worker: each pays the startup once
+    const int total = m_end - m_first;
+    for (int i = 0; i < count; ++i)
+    {
+        Range r;
+        r.first = m_first + int(std::int64_t(total) * i / count);
+        r.end = m_first + int(std::int64_t(total) * (i + 1) / count);
+        if (r.first < r.end)
+            m_queue.push_back(r);
+    }
+}
+
+int RenderFarm::run()
+{
+    QElapsedTimer timer;
+    timer.start();
+    std::cout << "[farm] frames " << m_first << " to " << m_end - 1 << " on " << m_workers.size()
+              << " workers into " << m_outDir << std::endl;
+
+    // otherwise a worker that dies before writing anything looks finished
+    if (!removeStaleFrames())
+        return 1;
+
+    for (;;)
+    {
+        bool running = false;
+        for (Worker &w : m_workers)
+        {
+            if (w.process)
+            {
+                running = true;
+                continue;
+            }
+            // the rest wait for the first worker to fill the shared cache
+            if (m_queue.empty() || (!m_warm && running))
+                continue;
+            launch(w, m_queue.front());
+            m_queue.pop_front();
+            running = true;
+        }
+        if (!running && m_queue.empty())
+            break;
+
+        for (Worker &w : m_workers)
+            if (w.process)
+                pump(w);
+    }
+
+    const bool ok = m_failedFrames == 0 && assemble();
+    const double seconds = double(timer.elapsed()) * 1e-3;
+    std::cout << "[farm] " << (ok ? "done" : "FAILED") << " after " << seconds << " s ("
+              << double(m_end - m_first) / std::max(seconds, 1e-3) << " frames/s)";
+    if (m_failedFrames > 0)
+        std::cout << ", " << m_failedFrames << " frames given up on";
+    std::cout << std::endl;
+    return ok ? 0 : 1;
+}
+
+void RenderFarm::launch(Worker &worker, const Range &range)
+{
+    QStringList args = m_workerArgs;
+    args << "--capture-range" << QString("%1:%2").arg(range.first).arg(range.end);
+
+    QProcessEnvironment env = QProcessEnvironment::systemEnvironment();
+    if (!env.contains("QT_QPA_PLATFORM"))
+        env.insert("QT_QPA_PLATFORM", "offscreen");
+
+    worker.range = range;
+    worker.process = std::make_unique<QProcess>();
+    worker.process->setProgram(m_program);
+    worker.process->setArguments(args);
+    worker.process->setProcessEnvironment(env);
+    worker.process->setProcessChannelMode(QProcess::MergedChannels);
+    worker.process->start();
+    std::cout << "[farm] worker " << worker.id << ": frames " << range.first << " to " << range.end - 1
+              << (range.attempt > 1 ? " (retry)" : "") << std::endl;
+}
+
+void RenderFarm::pump(Worker &worker)
+{
+    QProcess &p = *worker.process;
+    p.waitForReadyRead(50);
+    while (p.canReadLine())
+    {
+        std::string line = p.readLine().trimmed().toStdString();
+        std::cout << "[farm " << worker.id << "] " << line << "\n";
+        // workers start capturing only once terrain and forest are loaded (and cached)
+        if (line.rfind("[capture] frames", 0) == 0)
+            m_warm = true;
+    }
+    if (p.state() == QProcess::NotRunning)
+        finished(worker);
+}
+
+void RenderFarm::finished(Worker &worker)
+{
+    QProcess &p = *worker.process;
+    const QByteArray rest = p.readAll();
+    if (!rest.isEmpty())
+        std::cout << "[farm " << worker.id << "] " << rest.trimmed().toStdString() << "\n";
+    const bool clean = p.exitStatus() == QProcess::NormalExit && p.exitCode() == 0;
+    m_warm = true; // whatever the outcome, no point holding the others back now
+
+    // requeue whatever is missing, in runs of consecutive frames
+    const Range &r = worker.range;
+    int missing = 0;
+    for (int i = r.first; i < r.end;)
+    {
+        if (frameExists(i))
+        {
+            ++i;
+            continue;
+        }
+        Range retry{i, i, r.attempt + 1};
+        while (retry.end < r.end && !frameExists(retry.end))
+            ++retry.end;
+        missing += retry.end - retry.first;
+        if (retry.attempt <= MAX_ATTEMPTS)
+            m_queue.push_back(retry);
+        else
+            m_failedFrames += retry.end - retry.first;
+        i = retry.end;
+    }
+
+    if (!clean || missing > 0)
+        std::cout << "[farm] worker " << worker.id << " "
+                  << (clean ? "exited" : (p.exitStatus() == QProcess::CrashExit ? "crashed" : "failed")) << " with "
+                  << missing << " of frames " << r.first << " to " << r.end - 1 << " missing"
+                  << (r.attempt < MAX_ATTEMPTS ? ", requeued" : "") << std::endl;
+    worker.process.reset();
+}
+
+bool RenderFarm::frameExists(int index) const
+{
+    std::error_code ec;
+    return std::filesystem::is_regular_file(std::filesystem::path(m_outDir) / FrameWriter::fileName(index, m_format),
+                                            ec);
+}
+
+bool RenderFarm::removeStaleFrames()
+{
+    int removed = 0;
+    for (int i = m_first; i < m_end; ++i)
+    {
+        const std::filesystem::path file = std::filesystem::path(m_outDir) / FrameWriter::fileName(i, m_format);
+        std::error_code ec;
+        if (std::filesystem::remove(file, ec))
+            ++removed;
+        else if (ec)
+        {
+            std::cerr << "[farm] could not remove the old " << file.string() << ": " << ec.message() << std::endl;
+            return false;
+        }
+    }
+    if (removed > 0)
+        std::cout << "[farm] removed " << removed << " frames left from an earlier run" << std::endl;
+    return true;
+}
+
+bool RenderFarm::assemble()
+{
+    const std::filesystem::path list = std::filesystem::path(m_outDir) / "frames.ffconcat";
+    std::ofstream out(list);
+    out << "ffconcat version 1.0\n";
+    for (int i = m_first; i < m_end; ++i)
+    {
+        if (!frameExists(i))
+        {
+            std::cerr << "[farm] frame " << i << " is missing" << std::endl;
+            return false;
+        }
+        out << "file " << FrameWriter::fileName(i, m_format) << "\nduration " << 1.0 / m_fps << "\n";
+    }
+    if (!out.flush())
+        return false;
+    std::cout << "[farm] sequence listed in " << list.string() << std::endl;
+    return true;
+}
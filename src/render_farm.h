@@ -0,0 +1,72 @@
+#pragma once
+
+#include <QProcess>
+#include <QString>
+#include <QStringList>
+
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "post/frame_capture.h"
+
+// Coordinator of an offline capture (--capture <dir> --farm <n>) spread over
+// n worker processes of this executable. Each worker renders one range of
+// frames (--capture-range) with its own GL context - headless unless
+// QT_QPA_PLATFORM says otherwise - into the shared output directory, and
+// reads the terrain and forest from a shared --cache-dir, which the first
+// worker fills before the others start.
+//
+// Frames are only ever complete files (FrameWriter renames them into
+// place), and any left in the directory from an earlier run are deleted
+// before the first worker starts, so a frame file means it was rendered by
+// this run. When a worker fails the frames of its range that are missing
+// go back on the queue as new ranges, up to MAX_ATTEMPTS times. Once every
+// range is done the sequence is checked in order and listed in
+// <dir>/frames.ffconcat.
+class RenderFarm
+{
+public:
+    static constexpr int MAX_ATTEMPTS = 3;
+
+    // workerArgs: this process's arguments minus --farm / --capture-range
+    RenderFarm(QString program, QStringList workerArgs, std::string outDir, FrameWriter::Format format,
+               int firstFrame, int endFrame, int fps, int workers);
+
+    // blocks until every range is rendered or given up on; the exit code
+    int run();
+
+private:
+    struct Range
+    {
+        int first = 0;
+        int end = 0; // exclusive
+        int attempt = 1;
+    };
+
+    struct Worker
+    {
+        int id = 0;
+        std::unique_ptr<QProcess> process;
+        Range range;
+    };
+
+    void launch(Worker &worker, const Range &range);
+    void pump(Worker &worker); // forward its output, handle its exit
+    void finished(Worker &worker);
+    bool frameExists(int index) const;
+    bool removeStaleFrames(); // frames [first, end) of this format from an earlier run
+    bool assemble(); // every frame present, in order -> frames.ffconcat
+
+    QString m_program;
+    QStringList m_workerArgs;
+    std::string m_outDir;
+    FrameWriter::Format m_format;
+    int m_first, m_end, m_fps;
+
+    std::vector<Worker> m_workers;
+    std::deque<Range> m_queue;
+    bool m_warm = false; // the first worker has filled the cache
+    int m_failedFrames = 0;
+};
@@ -31,11 +31,32 @@ struct Settings
     // Post‑processing / color grading
     // 0 = off, 1 = cold blue, 3 = rainy / overcast
     int colorGradePreset = 0;
+    std::string lutFilePath; // optional .cube file baked on top of the grade (empty = none)
 
     // Depth of Field
     bool enableDoF = false;     // 开关
     float focusDistance = 15.0f; // 焦距，默认 15
     float blurStrength = 2.0f;   // 模糊强度，默认 2
+
+    // Quality governor: scale water targets / DoF / particles / vegetation / terrain to fit the budget
+    bool autoQuality = false;
+    float frameBudgetMs = 16.6f;
+
+    // Frame capture (--capture <dir>): one loop of the camera path rendered on a
+    // fixed clock of captureFps and written as PNG (or raw PPM) frames
+    std::string captureDir;
+    int captureFps = 30;
+    bool captureRaw = false;
+    int captureFirst = 0;  // --capture-range <first>:<end>, frames [first, end)
+    int captureEnd = -1;   // -1: one loop of the path
+
+    // Shared cache of generated terrain meshes and forest (--cache-dir); empty = off
+    std::string cacheDir;
+
+    // Poster (--poster <file.ppm>): one tiled still of the current view, any size
+    std::string posterPath;
+    int posterWidth = 7680;
+    int posterHeight = 4320;
 };
 
 // The global Settings object, will be initialized by MainWindow
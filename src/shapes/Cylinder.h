@@ -3,11 +3,15 @@
 #include <vector>
 #include <glm/glm.hpp>
 
+#include "utils/mesh_optimizer.h"
+
 class Cylinder
 {
 public:
     void updateParams(int param1, int param2);
     std::vector<float> generateShape() { return m_vertexData; }
+    // welded and vertex-cache ordered, for indexed draws
+    IndexedMesh generateIndexedShape() const { return buildIndexedMesh(m_vertexData); }
 
 private:
     void insertVec3(std::vector<float> &data, glm::vec3 v);
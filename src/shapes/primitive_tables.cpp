@@ -0,0 +1,328 @@
+#include "primitive_tables.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <utility>
+
+#include "utils/constexpr_math.h"
+#include "utils/mesh_optimizer.h"
+
+// The generators below follow Sphere.cpp, Cylinder.cpp and Cube.cpp step by
+// step (same corner order, winding checks and normals) with constexpr math;
+// keep them in sync when those change.
+
+namespace
+{
+constexpr float PI_F = float(cx::PI);
+constexpr float TWO_PI_F = float(2.0 * cx::PI);
+
+struct V3
+{
+    float x = 0.f, y = 0.f, z = 0.f;
+};
+
+constexpr V3 operator+(V3 a, V3 b) { return {a.x + b.x, a.y + b.y, a.z + b.z}; }
+constexpr V3 operator-(V3 a, V3 b) { return {a.x - b.x, a.y - b.y, a.z - b.z}; }
+constexpr V3 operator*(float s, V3 a) { return {s * a.x, s * a.y, s * a.z}; }
+constexpr float dot(V3 a, V3 b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+constexpr V3 cross(V3 a, V3 b) { return {a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x}; }
+constexpr V3 normalize(V3 a) { return float(1.0 / cx::sqrt(double(dot(a, a)))) * a; }
+constexpr float fsin(float a) { return float(cx::sin(a)); }
+constexpr float fcos(float a) { return float(cx::cos(a)); }
+
+template <std::size_t N>
+struct Soup
+{
+    std::array<float, N * 6> data{};
+    std::size_t size = 0; // vertices written
+
+    constexpr void add(V3 p, V3 n)
+    {
+        float *d = data.data() + size++ * 6;
+        d[0] = p.x, d[1] = p.y, d[2] = p.z;
+        d[3] = n.x, d[4] = n.y, d[5] = n.z;
+    }
+};
+
+// ---- Sphere (radius 0.5, p1 latitude bands, p2 wedges) ----
+
+constexpr std::size_t sphereVertices(int p1, int p2)
+{
+    return std::size_t(std::max(2, p1)) * std::max(3, p2) * 6;
+}
+
+template <std::size_t N>
+constexpr void sphereTile(Soup<N> &s, V3 tl, V3 tr, V3 bl, V3 br)
+{
+    V3 nFace = cross(bl - tl, tr - tl);
+    V3 nAvg = normalize(tl + tr + bl + br);
+    if (dot(nFace, nAvg) < 0.f)
+        std::swap(tr, bl);
+    s.add(tl, normalize(tl));
+    s.add(bl, normalize(bl));
+    s.add(tr, normalize(tr));
+    s.add(tr, normalize(tr));
+    s.add(bl, normalize(bl));
+    s.add(br, normalize(br));
+}
+
+template <int P1, int P2>
+constexpr auto sphereSoup()
+{
+    Soup<sphereVertices(P1, P2)> s;
+    const int p1 = std::max(2, P1);
+    const int p2 = std::max(3, P2);
+    const float r = 0.5f;
+    const float dphi = PI_F / p1;
+    const float dtheta = TWO_PI_F / p2;
+    auto sph = [&](float phi, float theta) {
+        return V3{r * fsin(phi) * fcos(theta), r * fcos(phi), -r * fsin(phi) * fsin(theta)};
+    };
+    for (int k = 0; k < p2; ++k)
+    {
+        float th0 = k * dtheta, th1 = (k + 1) * dtheta;
+        for (int i = 0; i < p1; ++i)
+        {
+            float phiTop = i * dphi, phiBot = (i + 1) * dphi;
+            sphereTile(s, sph(phiTop, th0), sph(phiTop, th1), sph(phiBot, th0), sph(phiBot, th1));
+        }
+    }
+    return s;
+}
+
+// ---- Cylinder (radius 0.5, height 1, p1 bands / cap rings, p2 wedges) ----
+
+constexpr std::size_t cylinderVertices(int p1, int p2)
+{
+    p1 = std::max(1, p1);
+    // side: 2 triangles per band; each cap: 1 at the centre + 2 per outer ring
+    return std::size_t(std::max(3, p2)) * (p1 * 6 + 2 * (3 + (p1 - 1) * 6));
+}
+
+template <int P1, int P2>
+constexpr auto cylinderSoup()
+{
+    Soup<cylinderVertices(P1, P2)> s;
+    const int p1 = std::max(1, P1);
+    const int p2 = std::max(3, P2);
+    const float radius = 0.5f, yTop = 0.5f, yBot = -0.5f;
+    auto cyl = [](float r, float y, float th) { return V3{r * fcos(th), y, r * fsin(th)}; };
+
+    const float dth = TWO_PI_F / float(p2);
+    for (int k = 0; k < p2; ++k)
+    {
+        const float th0 = k * dth, th1 = (k + 1) * dth;
+
+        // side strip
+        const float dy = (yTop - yBot) / float(p1);
+        const V3 n0 = normalize({fcos(th0), 0.f, fsin(th0)});
+        const V3 n1 = normalize({fcos(th1), 0.f, fsin(th1)});
+        for (int i = 0; i < p1; ++i)
+        {
+            const float y0 = yTop - i * dy, y1 = yTop - (i + 1) * dy;
+            V3 p00 = cyl(radius, y0, th0), p01 = cyl(radius, y0, th1);
+            V3 p10 = cyl(radius, y1, th0), p11 = cyl(radius, y1, th1);
+            V3 n00 = n0, n01 = n1, n10 = n0, n11 = n1;
+            V3 nFace = cross(p10 - p00, p01 - p00);
+            V3 nAvg = normalize({p00.x + p01.x + p10.x + p11.x, 0.f, p00.z + p01.z + p10.z + p11.z});
+            if (dot(nFace, nAvg) < 0.f)
+            {
+                std::swap(p01, p10);
+                std::swap(n01, n10);
+            }
+            s.add(p00, n00), s.add(p10, n10), s.add(p01, n01);
+            s.add(p10, n10), s.add(p11, n11), s.add(p01, n01);
+        }
+
+        // top cap, then bottom cap
+        for (bool isTop : {true, false})
+        {
+            const float y = isTop ? yTop : yBot;
+            const V3 nCap = isTop ? V3{0.f, 1.f, 0.f} : V3{0.f, -1.f, 0.f};
+            for (int i = 0; i < p1; ++i)
+            {
+                const float rInner = radius * (float(i) / p1);
+                const float rOuter = radius * (float(i + 1) / p1);
+                if (rInner < 1e-6f)
+                {
+                    V3 center{0.f, y, 0.f};
+                    V3 c10 = cyl(rOuter, y, th0), c11 = cyl(rOuter, y, th1);
+                    if (dot(cross(c10 - center, c11 - center), nCap) < 0.f)
+                        std::swap(c10, c11);
+                    s.add(center, nCap), s.add(c10, nCap), s.add(c11, nCap);
+                }
+                else
+                {
+                    V3 c00 = cyl(rInner, y, th0), c01 = cyl(rInner, y, th1);
+                    V3 c10 = cyl(rOuter, y, th0), c11 = cyl(rOuter, y, th1);
+                    if (dot(cross(c10 - c00, c01 - c00), nCap) < 0.f)
+                        std::swap(c10, c01);
+                    s.add(c00, nCap), s.add(c10, nCap), s.add(c01, nCap);
+                    s.add(c10, nCap), s.add(c11, nCap), s.add(c01, nCap);
+                }
+            }
+        }
+    }
+    return s;
+}
+
+// ---- Cube (unit, p1 x p1 tiles per face) ----
+
+constexpr std::size_t cubeVertices(int p1)
+{
+    return std::size_t(6) * std::max(1, p1) * std::max(1, p1) * 6;
+}
+
+template <int P1>
+constexpr auto cubeSoup()
+{
+    Soup<cubeVertices(P1)> s;
+    const int p = std::max(1, P1);
+    // topLeft, topRight, bottomLeft, bottomRight of each face, as in Cube::setVertexData()
+    constexpr V3 faces[6][4] = {
+        {{-0.5f, 0.5f, 0.5f}, {0.5f, 0.5f, 0.5f}, {-0.5f, -0.5f, 0.5f}, {0.5f, -0.5f, 0.5f}},
+        {{0.5f, 0.5f, -0.5f}, {-0.5f, 0.5f, -0.5f}, {0.5f, -0.5f, -0.5f}, {-0.5f, -0.5f, -0.5f}},
+        {{0.5f, 0.5f, 0.5f}, {0.5f, 0.5f, -0.5f}, {0.5f, -0.5f, 0.5f}, {0.5f, -0.5f, -0.5f}},
+        {{-0.5f, 0.5f, -0.5f}, {-0.5f, 0.5f, 0.5f}, {-0.5f, -0.5f, -0.5f}, {-0.5f, -0.5f, 0.5f}},
+        {{-0.5f, 0.5f, -0.5f}, {0.5f, 0.5f, -0.5f}, {-0.5f, 0.5f, 0.5f}, {0.5f, 0.5f, 0.5f}},
+        {{-0.5f, -0.5f, 0.5f}, {0.5f, -0.5f, 0.5f}, {-0.5f, -0.5f, -0.5f}, {0.5f, -0.5f, -0.5f}},
+    };
+    auto lerp = [](V3 a, V3 b, float t) { return a + t * (b - a); };
+    for (const auto &f : faces)
+    {
+        auto bilerp = [&](float u, float v) { return lerp(lerp(f[0], f[1], u), lerp(f[2], f[3], u), v); };
+        for (int j = 0; j < p; ++j)
+        {
+            float t0 = float(j) / p, t1 = float(j + 1) / p;
+            for (int i = 0; i < p; ++i)
+            {
+                float s0 = float(i) / p, s1 = float(i + 1) / p;
+                V3 tl = bilerp(s0, t0), tr = bilerp(s1, t0), bl = bilerp(s0, t1), br = bilerp(s1, t1);
+                V3 n = normalize(cross(bl - tl, tr - tl));
+                s.add(tl, n), s.add(bl, n), s.add(tr, n);
+                s.add(tr, n), s.add(bl, n), s.add(br, n);
+            }
+        }
+    }
+    return s;
+}
+
+// ---- weld + MeshOrder passes, then trim to the used size ----
+
+template <std::size_t N>
+struct Welded
+{
+    std::array<float, N * 6> vertices{};
+    std::array<std::uint16_t, N> indices{};
+    std::size_t vertexCount = 0;
+    std::size_t indexCount = 0;
+};
+
+template <std::size_t N>
+constexpr Welded<N> weldAndOrder(const Soup<N> &soup)
+{
+    static_assert(N <= 0xFFFF, "baked tables use 16-bit indices");
+    Welded<N> w;
+
+    // bitwise compare, like weldVertices(); O(n^2) is fine at these sizes
+    std::array<std::uint16_t, N> remap{};
+    for (std::size_t v = 0; v < soup.size; ++v)
+    {
+        const float *src = soup.data.data() + v * 6;
+        std::size_t found = w.vertexCount;
+        for (std::size_t u = 0; u < w.vertexCount && found == w.vertexCount; ++u)
+        {
+            bool same = true;
+            for (int k = 0; k < 6 && same; ++k)
+                same = std::bit_cast<std::uint32_t>(w.vertices[u * 6 + k]) == std::bit_cast<std::uint32_t>(src[k]);
+            if (same)
+                found = u;
+        }
+        if (found == w.vertexCount)
+        {
+            for (int k = 0; k < 6; ++k)
+                w.vertices[found * 6 + k] = src[k];
+            ++w.vertexCount;
+        }
+        remap[v] = std::uint16_t(found);
+    }
+    for (std::size_t t = 0; t + 2 < soup.size; t += 3)
+    {
+        std::uint16_t a = remap[t], b = remap[t + 1], c = remap[t + 2];
+        if (a == b || b == c || a == c)
+            continue;
+        w.indices[w.indexCount++] = a;
+        w.indices[w.indexCount++] = b;
+        w.indices[w.indexCount++] = c;
+    }
+
+    MeshOrder::vertexCache(w.indices.data(), w.indexCount, w.vertexCount);
+    std::array<float, N * 6> ordered{};
+    w.vertexCount = MeshOrder::vertexFetch(w.indices.data(), w.indexCount, w.vertices.data(), ordered.data(),
+                                           w.vertexCount, 6);
+    w.vertices = ordered;
+    return w;
+}
+
+template <std::size_t V, std::size_t I>
+struct Baked
+{
+    std::array<float, V * 6> vertices{};
+    std::array<std::uint16_t, I> indices{};
+};
+
+template <std::size_t V, std::size_t I, std::size_t N>
+constexpr Baked<V, I> trim(const Welded<N> &w)
+{
+    Baked<V, I> b;
+    for (std::size_t i = 0; i < V * 6; ++i)
+        b.vertices[i] = w.vertices[i];
+    for (std::size_t i = 0; i < I; ++i)
+        b.indices[i] = w.indices[i];
+    return b;
+}
+
+// the full-size Welded results are only used to size the trimmed tables
+constexpr auto SKY_CUBE_W = weldAndOrder(cubeSoup<1>());
+constexpr auto SKY_CUBE = trim<SKY_CUBE_W.vertexCount, SKY_CUBE_W.indexCount>(SKY_CUBE_W);
+
+constexpr auto TREE_CYLINDER_W = weldAndOrder(cylinderSoup<3, 8>());
+constexpr auto TREE_CYLINDER = trim<TREE_CYLINDER_W.vertexCount, TREE_CYLINDER_W.indexCount>(TREE_CYLINDER_W);
+
+constexpr auto LEAF_SPHERE_W = weldAndOrder(sphereSoup<3, 6>());
+constexpr auto LEAF_SPHERE = trim<LEAF_SPHERE_W.vertexCount, LEAF_SPHERE_W.indexCount>(LEAF_SPHERE_W);
+
+constexpr auto ROCK_SPHERE_W = weldAndOrder(sphereSoup<4, 8>());
+constexpr auto ROCK_SPHERE = trim<ROCK_SPHERE_W.vertexCount, ROCK_SPHERE_W.indexCount>(ROCK_SPHERE_W);
+
+template <class B>
+constexpr PrimitiveTable tableOf(const B &b)
+{
+    return {b.vertices.data(), b.vertices.size() / 6, b.indices.data(), b.indices.size()};
+}
+
+constexpr PrimitiveTable SKY_CUBE_TABLE = tableOf(SKY_CUBE);
+constexpr PrimitiveTable TREE_CYLINDER_TABLE = tableOf(TREE_CYLINDER);
+constexpr PrimitiveTable LEAF_SPHERE_TABLE = tableOf(LEAF_SPHERE);
+constexpr PrimitiveTable ROCK_SPHERE_TABLE = tableOf(ROCK_SPHERE);
+}
+
+const PrimitiveTable *findPrimitiveTable(PrimitiveType type, int p1, int p2)
+{
+    switch (type)
+    {
+    case PrimitiveType::PRIMITIVE_CUBE:
+        return p1 == 1 ? &SKY_CUBE_TABLE : nullptr; // the cube ignores p2
+    case PrimitiveType::PRIMITIVE_CYLINDER:
+        return p1 == 3 && p2 == 8 ? &TREE_CYLINDER_TABLE : nullptr;
+    case PrimitiveType::PRIMITIVE_SPHERE:
+        if (p1 == 3 && p2 == 6)
+            return &LEAF_SPHERE_TABLE;
+        if (p1 == 4 && p2 == 8)
+            return &ROCK_SPHERE_TABLE;
+        return nullptr;
+    default:
+        return nullptr;
+    }
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "utils/scenedata.h"
+
+// Primitive meshes the renderer always builds (sky cube, tree cylinder,
+// leaf and rock spheres), tessellated, welded and vertex-cache ordered at
+// compile time. The tables hold the same geometry generateIndexedShape()
+// produces for those parameters; any other (type, p1, p2) returns nullptr
+// and goes through the runtime generators.
+struct PrimitiveTable
+{
+    const float *vertices; // interleaved position + normal
+    std::size_t vertexCount;
+    const std::uint16_t *indices;
+    std::size_t indexCount;
+};
+
+const PrimitiveTable *findPrimitiveTable(PrimitiveType type, int p1, int p2);
@@ -0,0 +1,267 @@
+#include "simulation.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <glm/gtx/norm.hpp>
+
+#include "utils/trace.h"
+
+using Clock = std::chrono::steady_clock;
+
+Simulation::Simulation() = default;
+
+Simulation::~Simulation()
+{
+    stop();
+}
+
+void Simulation::setPath(const CameraPath &path, float loopSeconds)
+{
+    m_path = path;
+    m_pathSeconds = std::max(loopSeconds, float(STEP));
+}
+
+void Simulation::reset(const SimPose &pose, bool pathAnimating)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_inputMutex);
+        if (m_input.particleType >= 0)
+            m_particleType = m_input.particleType;
+        m_input.yaw = m_input.pitch = 0.f;
+        m_input.hasPose = false;
+        m_input.pathToggle = -1;
+    }
+
+    m_step = 0;
+    m_camera.eye = pose.eye;
+    m_camera.look = pose.look;
+    m_camera.up = pose.up;
+    m_pathAnimating = pathAnimating;
+    m_pathStart = 0;
+    if (m_pathAnimating)
+    {
+        CameraPath::Pose p = m_path.evaluate(0.f);
+        m_camera.eye = p.position;
+        m_camera.look = p.rotation * glm::vec3(0, 0, -1);
+        m_camera.up = p.rotation * glm::vec3(0, 1, 0);
+    }
+    m_prevPose = this->pose();
+
+    // the type first: respawning consumes random numbers, so only then reseed
+    m_particles.setType(std::max(m_particleType, 0));
+    m_particles.seed(PARTICLE_SEED);
+    m_particles.initParticles();
+
+    publish(Clock::now());
+}
+
+void Simulation::start()
+{
+    if (running())
+        return;
+    m_quit = false;
+    m_thread = std::thread(&Simulation::loop, this);
+}
+
+void Simulation::stop()
+{
+    if (!running())
+        return;
+    {
+        std::lock_guard<std::mutex> lock(m_wakeMutex);
+        m_quit = true;
+    }
+    m_wake.notify_all();
+    m_thread.join();
+}
+
+void Simulation::runUntil(double t)
+{
+    bool stepped = false;
+    while (double(m_step) * STEP < t - 1e-9)
+    {
+        step();
+        stepped = true;
+    }
+    if (stepped)
+        publish(Clock::now());
+}
+
+void Simulation::setMoveKeys(unsigned keys)
+{
+    std::lock_guard<std::mutex> lock(m_inputMutex);
+    m_input.keys = keys;
+}
+
+void Simulation::look(float yawRadians, float pitchRadians)
+{
+    std::lock_guard<std::mutex> lock(m_inputMutex);
+    m_input.yaw += yawRadians;
+    m_input.pitch += pitchRadians;
+}
+
+void Simulation::setPose(const SimPose &pose)
+{
+    std::lock_guard<std::mutex> lock(m_inputMutex);
+    m_input.hasPose = true;
+    m_input.pose = pose;
+}
+
+void Simulation::setPathAnimating(bool on)
+{
+    std::lock_guard<std::mutex> lock(m_inputMutex);
+    m_input.pathToggle = on ? 1 : 0;
+}
+
+void Simulation::setParticleType(int type)
+{
+    std::lock_guard<std::mutex> lock(m_inputMutex);
+    if (type >= 0)
+        m_input.particleType = type;
+}
+
+const SimFrame &Simulation::latest()
+{
+    m_frames.acquire();
+    return m_frames.front();
+}
+
+float Simulation::alpha(const SimFrame &frame)
+{
+    const double since = std::chrono::duration<double>(Clock::now() - frame.due).count();
+    return float(std::clamp(since / STEP, 0.0, 1.0));
+}
+
+float Simulation::alphaAt(const SimFrame &frame, double t)
+{
+    return float(std::clamp(1.0 - (frame.time - t) / STEP, 0.0, 1.0));
+}
+
+SimPose Simulation::interpolate(const SimFrame &frame, float alpha)
+{
+    SimPose p;
+    p.eye = glm::mix(frame.prevPose.eye, frame.pose.eye, alpha);
+    p.look = glm::normalize(glm::mix(frame.prevPose.look, frame.pose.look, alpha));
+    p.up = glm::normalize(glm::mix(frame.prevPose.up, frame.pose.up, alpha));
+    return p;
+}
+
+void Simulation::loop()
+{
+    Tracer::setThreadName("simulation");
+    FixedStepClock clock(STEP, MAX_STEPS_PER_WAKE);
+    Clock::time_point last = Clock::now();
+
+    while (!m_quit)
+    {
+        const Clock::time_point now = Clock::now();
+        const int steps = clock.advance(std::chrono::duration<double>(now - last).count());
+        last = now;
+        if (steps > 0)
+        {
+            TRACE_SCOPE("simulation steps");
+            for (int i = 0; i < steps; ++i)
+                step();
+            // the last step fell due the accumulated remainder ago
+            publish(now - std::chrono::duration_cast<Clock::duration>(
+                              std::chrono::duration<double>(clock.alpha() * STEP)));
+        }
+
+        std::unique_lock<std::mutex> lock(m_wakeMutex);
+        m_wake.wait_for(lock, std::chrono::duration<double>(clock.untilNextStep()), [this] { return m_quit.load(); });
+    }
+}
+
+void Simulation::step()
+{
+    Input in;
+    {
+        std::lock_guard<std::mutex> lock(m_inputMutex);
+        in = m_input;
+        m_input.yaw = m_input.pitch = 0.f;
+        m_input.hasPose = false;
+        m_input.pathToggle = -1;
+    }
+
+    m_prevPose = pose();
+    bool jumped = false; // a teleport, not a move: nothing to interpolate across
+    if (in.hasPose)
+    {
+        m_camera.eye = in.pose.eye;
+        m_camera.look = in.pose.look;
+        m_camera.up = in.pose.up;
+        jumped = true;
+    }
+    if (in.pathToggle >= 0 && bool(in.pathToggle) != m_pathAnimating)
+    {
+        m_pathAnimating = in.pathToggle == 1;
+        m_pathStart = m_step;
+        jumped = m_pathAnimating;
+    }
+    if (in.particleType >= 0 && in.particleType != m_particleType)
+    {
+        m_particleType = in.particleType;
+        m_particles.setType(m_particleType);
+    }
+
+    const float dt = float(STEP);
+    if (m_pathAnimating)
+    {
+        // a function of the step count: the same step always has the same pose
+        const double t = double(m_step + 1 - m_pathStart) * STEP;
+        CameraPath::Pose p = m_path.evaluate(float(std::fmod(t, double(m_pathSeconds))));
+        m_camera.eye = p.position;
+        m_camera.look = p.rotation * glm::vec3(0, 0, -1);
+        m_camera.up = p.rotation * glm::vec3(0, 1, 0);
+    }
+    else
+    {
+        if (in.yaw != 0.f)
+            m_camera.yaw(in.yaw);
+        if (in.pitch != 0.f)
+            m_camera.pitch(in.pitch);
+
+        // camera basis: forward (look), right (perpendicular to look & up), and world up
+        const glm::vec3 fwd = glm::normalize(m_camera.look);
+        const glm::vec3 right = glm::normalize(glm::cross(fwd, m_camera.up));
+        const glm::vec3 worldUp(0.f, 1.f, 0.f);
+
+        glm::vec3 move(0.f);
+        if (in.keys & Forward)
+            move += fwd;
+        if (in.keys & Back)
+            move -= fwd;
+        if (in.keys & Right)
+            move += right;
+        if (in.keys & Left)
+            move -= right;
+        if (in.keys & Up)
+            move += worldUp;
+        if (in.keys & Down)
+            move -= worldUp;
+
+        // normalized so diagonals are not faster
+        if (glm::length2(move) > 0.f)
+            m_camera.translateWorld(glm::normalize(move) * (MOVE_SPEED * dt));
+    }
+    if (jumped)
+        m_prevPose = pose();
+
+    m_particles.update(dt);
+    ++m_step;
+}
+
+void Simulation::publish(Clock::time_point due)
+{
+    SimFrame &f = m_frames.back();
+    f.step = m_step;
+    f.time = double(m_step) * STEP;
+    f.due = due;
+    f.pose = pose();
+    f.prevPose = m_prevPose;
+    f.pathAnimating = m_pathAnimating;
+    f.pathTime = m_pathAnimating ? double(m_step - m_pathStart) * STEP : 0.0;
+    m_particles.snapshot(f.particles);
+    m_frames.publish();
+}
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+#include <glm/glm.hpp>
+
+#include "camera.h"
+#include "particles/particlesystem.h"
+#include "utils/camera_path.h"
+#include "utils/fixed_step.h"
+
+// Camera placement as the simulation moves it
+struct SimPose
+{
+    glm::vec3 eye{0.f, 0.f, 5.f};
+    glm::vec3 look{0.f, 0.f, -1.f};
+    glm::vec3 up{0.f, 1.f, 0.f};
+};
+
+// One published simulation step: everything the renderer reads from it
+struct SimFrame
+{
+    std::uint64_t step = 0; // steps taken since reset()
+    double time = 0.0;      // step * Simulation::STEP
+    std::chrono::steady_clock::time_point due; // wall time the step fell due (threaded mode)
+    SimPose pose, prevPose; // after this step and the one before
+    bool pathAnimating = false;
+    double pathTime = 0.0; // seconds since the camera path started
+    ParticleFrame particles;
+};
+
+// The moving parts of the world - camera motion (keys, mouse look, the
+// camera path), particles and the time the water animates with - stepped at
+// a fixed STEP on a thread of their own, independent of how often and how
+// smoothly the GUI thread renders. Each step is published as a SimFrame;
+// the renderer takes the newest one and interpolates between its previous
+// and current state, alpha() of the way, so motion stays smooth at any
+// frame rate. The state after n steps depends only on the inputs and n,
+// not on timer jitter: particles draw from a seeded generator.
+//
+// For offline rendering (frame capture) stop() the thread and drive it
+// with runUntil(), which steps synchronously.
+class Simulation
+{
+public:
+    static constexpr double STEP = 1.0 / 60.0;
+    static constexpr int MAX_STEPS_PER_WAKE = 6; // 0.1 s; beyond that the world slows down
+    static constexpr unsigned PARTICLE_SEED = 1337;
+    static constexpr float MOVE_SPEED = 5.f; // world units per second
+
+    enum MoveKey : unsigned
+    {
+        Forward = 1,
+        Back = 2,
+        Left = 4,
+        Right = 8,
+        Up = 16,
+        Down = 32
+    };
+
+    Simulation();
+    ~Simulation();
+
+    Simulation(const Simulation &) = delete;
+    Simulation &operator=(const Simulation &) = delete;
+
+    // while stopped: the path the camera follows when animating, looped every loopSeconds
+    void setPath(const CameraPath &path, float loopSeconds);
+    // while stopped: back to step 0 at pose, particles respawned from the seed; publishes
+    void reset(const SimPose &pose, bool pathAnimating);
+
+    void start(); // steps in real time on its own thread from now on
+    void stop();
+    bool running() const { return m_thread.joinable(); }
+
+    // while stopped: steps until the simulated time reaches t; publishes
+    void runUntil(double t);
+
+    // input from any thread, applied at the next step
+    void setMoveKeys(unsigned keys);
+    void look(float yawRadians, float pitchRadians); // accumulated until then
+    void setPose(const SimPose &pose);
+    void setPathAnimating(bool on); // on restarts the path from its beginning
+    void setParticleType(int type); // 0 snow, 1 rain, -1 keep the current one
+
+    // render thread: the newest published step, valid until the next call
+    const SimFrame &latest();
+
+    // how far the render time is between frame.prevPose and frame.pose
+    static float alpha(const SimFrame &frame); // now, in threaded mode
+    static float alphaAt(const SimFrame &frame, double t);
+    static SimPose interpolate(const SimFrame &frame, float alpha);
+    static double renderTime(const SimFrame &frame, float alpha) { return frame.time - (1.0 - alpha) * STEP; }
+
+private:
+    struct Input
+    {
+        unsigned keys = 0;
+        float yaw = 0.f, pitch = 0.f;
+        bool hasPose = false;
+        SimPose pose;
+        int pathToggle = -1; // -1 none, else the new state
+        int particleType = -1;
+    };
+
+    void loop();
+    void step();
+    void publish(std::chrono::steady_clock::time_point due);
+    SimPose pose() const { return {m_camera.eye, m_camera.look, m_camera.up}; }
+
+    // owned by whichever thread steps (the simulation thread while running)
+    CameraPath m_path;
+    float m_pathSeconds = 1.f;
+    Camera m_camera; // for its yaw / pitch / translate helpers
+    SimPose m_prevPose;
+    std::uint64_t m_step = 0;
+    bool m_pathAnimating = false;
+    std::uint64_t m_pathStart = 0; // step the path started at
+    ParticleSystem m_particles;
+    int m_particleType = -1;
+
+    std::mutex m_inputMutex;
+    Input m_input;
+
+    SnapshotExchange<SimFrame> m_frames;
+
+    std::thread m_thread;
+    std::mutex m_wakeMutex;
+    std::condition_variable m_wake;
+    std::atomic<bool> m_quit{false};
+};
@@ -0,0 +1,350 @@
+#include "atmosphere.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#include "utils/gl_state.h"
+#include "utils/render_stats.h"
+#include "utils/shaderloader.h"
+#include "utils/trace.h"
+
+namespace
+{
+    GLProgram buildPass(const char *frag)
+    {
+        try
+        {
+            return GLProgram::adopt(ShaderLoader::createShaderProgram(":/resources/shaders/atmosphere.vert", frag));
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "[sky] " << frag << " compile/link error: " << e.what() << std::endl;
+            return {};
+        }
+    }
+
+    GLTexture makeLut(GLenum target, int w, int h, int d = 1)
+    {
+        GLTexture tex = GLTexture::create();
+        glState.bindTexture(target, tex);
+        if (target == GL_TEXTURE_3D)
+            glTexImage3D(target, 0, GL_RGBA16F, w, h, d, 0, GL_RGBA, GL_HALF_FLOAT, nullptr);
+        else
+            glTexImage2D(target, 0, GL_RGBA16F, w, h, 0, GL_RGBA, GL_HALF_FLOAT, nullptr);
+        glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(target, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+        glState.bindTexture(target, 0);
+        return tex;
+    }
+
+    // layer < 0: a 2D texture, else that slice of a 3D one
+    GLFramebuffer makeTarget(GLuint tex, int layer = -1)
+    {
+        GLFramebuffer fbo = GLFramebuffer::create();
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        if (layer < 0)
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, tex, 0);
+        else
+            glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, tex, 0, layer);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cerr << "[sky] LUT framebuffer incomplete" << std::endl;
+        return fbo;
+    }
+}
+
+bool Atmosphere::init()
+{
+    TRACE_SCOPE("Atmosphere::init");
+    destroy();
+
+    m_progTransmittance = buildPass(":/resources/shaders/atmosphere_transmittance.frag");
+    m_progMultiScattering = buildPass(":/resources/shaders/atmosphere_multiscattering.frag");
+    m_progSkyView = buildPass(":/resources/shaders/atmosphere_skyview.frag");
+    m_progAerial = buildPass(":/resources/shaders/atmosphere_aerial.frag");
+    if (!m_progTransmittance || !m_progMultiScattering || !m_progSkyView || !m_progAerial)
+    {
+        destroy();
+        return false;
+    }
+    m_emptyVAO = GLVertexArray::create();
+
+    m_transmittance = makeLut(GL_TEXTURE_2D, TRANSMITTANCE_W, TRANSMITTANCE_H);
+    m_multiScattering = makeLut(GL_TEXTURE_2D, MULTI_SCATTERING_SIZE, MULTI_SCATTERING_SIZE);
+    for (GLTexture &tex : m_skyView)
+        tex = makeLut(GL_TEXTURE_2D, SKY_VIEW_W, SKY_VIEW_H);
+    m_aerial = makeLut(GL_TEXTURE_3D, AERIAL_SIZE, AERIAL_SIZE, AERIAL_SIZE);
+
+    m_fboTransmittance = makeTarget(m_transmittance);
+    m_fboMultiScattering = makeTarget(m_multiScattering);
+    for (int i = 0; i < 2; ++i)
+        m_fboSkyView[i] = makeTarget(m_skyView[i]);
+    for (int i = 0; i < AERIAL_SIZE; ++i)
+        m_fboAerial[i] = makeTarget(m_aerial, i);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    m_transmittanceDirty = m_multiScatteringDirty = true;
+    m_skyViewShown = SkyViewKey();
+    m_skyViewRow = SKY_VIEW_H;
+    m_ready = true;
+    return true;
+}
+
+void Atmosphere::destroy()
+{
+    m_ready = false;
+    for (GLProgram *prog : {&m_progTransmittance, &m_progMultiScattering, &m_progSkyView, &m_progAerial})
+        prog->reset();
+    m_emptyVAO.reset();
+    for (GLFramebuffer &fbo : m_fboAerial)
+        fbo.reset();
+    for (GLFramebuffer &fbo : m_fboSkyView)
+        fbo.reset();
+    m_fboTransmittance.reset();
+    m_fboMultiScattering.reset();
+    for (GLTexture &tex : m_skyView)
+        tex.reset();
+    m_transmittance.reset();
+    m_multiScattering.reset();
+    m_aerial.reset();
+}
+
+void Atmosphere::setParams(const AtmosphereParams &params)
+{
+    if (params == m_params)
+        return;
+    m_params = params;
+    ++m_paramsVersion;
+    m_transmittanceDirty = true;
+}
+
+void Atmosphere::setSun(const glm::vec3 &towardsSun)
+{
+    m_sun = glm::normalize(towardsSun);
+}
+
+void Atmosphere::setWorldScale(float kmPerUnit, float seaLevelY)
+{
+    m_kmPerUnit = std::max(kmPerUnit, 1e-6f);
+    m_seaLevelY = seaLevelY;
+}
+
+void Atmosphere::update(const glm::mat4 &viewProj, const glm::vec3 &eye, float farDistance)
+{
+    if (!m_ready)
+        return;
+    TRACE_SCOPE("atmosphere");
+    glState.disable(GL_BLEND);
+    glState.disable(GL_DEPTH_TEST);
+
+    step(eye);
+    renderAerialPerspective(viewProj, eye, farDistance);
+
+    glState.enable(GL_DEPTH_TEST); // what the scene passes expect
+}
+
+void Atmosphere::bake(const glm::vec3 &eye)
+{
+    if (!m_ready)
+        return;
+    TRACE_SCOPE("Atmosphere::bake");
+    glState.disable(GL_BLEND);
+    glState.disable(GL_DEPTH_TEST);
+    while (step(eye))
+    {
+    }
+    glState.enable(GL_DEPTH_TEST);
+}
+
+bool Atmosphere::step(const glm::vec3 &eye)
+{
+    if (m_transmittanceDirty)
+    {
+        renderTransmittance();
+        m_transmittanceDirty = false;
+        m_multiScatteringDirty = true;
+        return true;
+    }
+    if (m_multiScatteringDirty)
+    {
+        renderMultiScattering();
+        m_multiScatteringDirty = false;
+        return true;
+    }
+
+    // a refresh under way is finished first, even if its key is already out
+    // of date: restarting would never finish while the sun keeps moving
+    if (m_skyViewRow >= SKY_VIEW_H)
+    {
+        SkyViewKey key = skyViewKey(eye);
+        if (key == m_skyViewShown)
+            return false;
+        m_skyViewPending = key;
+        m_skyViewRow = 0;
+    }
+    const int rows = (SKY_VIEW_H + SKY_VIEW_SLICES - 1) / SKY_VIEW_SLICES;
+    renderSkyViewRows(m_skyViewRow, std::min(rows, SKY_VIEW_H - m_skyViewRow));
+    m_skyViewRow += rows;
+    if (m_skyViewRow >= SKY_VIEW_H)
+    {
+        m_skyViewFront ^= 1;
+        m_skyViewShown = m_skyViewPending;
+    }
+    return true;
+}
+
+Atmosphere::SkyViewKey Atmosphere::skyViewKey(const glm::vec3 &eye) const
+{
+    SkyViewKey key;
+    key.sun = m_sun;
+    key.altitudeBand = int(std::floor(std::max(0.f, (eye.y - m_seaLevelY) * m_kmPerUnit) / ALTITUDE_BAND_KM));
+    key.paramsVersion = m_paramsVersion;
+    return key;
+}
+
+float Atmosphere::viewHeight(int altitudeBand) const
+{
+    return m_params.bottomRadius + (float(altitudeBand) + 0.5f) * ALTITUDE_BAND_KM;
+}
+
+void Atmosphere::setParamUniforms(GLuint prog) const
+{
+    auto loc = [&](const char *name) { return glGetUniformLocation(prog, name); };
+    const AtmosphereParams &p = m_params;
+    const glm::vec3 mieExtinction = p.mieScattering + p.mieAbsorption;
+    statUniform(glUniform1f, loc("uBottomRadius"), p.bottomRadius);
+    statUniform(glUniform1f, loc("uTopRadius"), p.topRadius);
+    statUniform(glUniform3fv, loc("uRayleighScattering"), 1, &p.rayleighScattering[0]);
+    statUniform(glUniform1f, loc("uRayleighScaleHeight"), p.rayleighScaleHeight);
+    statUniform(glUniform3fv, loc("uMieScattering"), 1, &p.mieScattering[0]);
+    statUniform(glUniform3fv, loc("uMieExtinction"), 1, &mieExtinction[0]);
+    statUniform(glUniform1f, loc("uMieScaleHeight"), p.mieScaleHeight);
+    statUniform(glUniform1f, loc("uMieG"), p.mieG);
+    statUniform(glUniform3fv, loc("uOzoneAbsorption"), 1, &p.ozoneAbsorption[0]);
+    statUniform(glUniform3fv, loc("uGroundAlbedo"), 1, &p.groundAlbedo[0]);
+    statUniform(glUniform3fv, loc("uSunDirection"), 1, &m_sun[0]);
+    statUniform(glUniform3fv, loc("uSunIlluminance"), 1, &p.sunIlluminance[0]);
+}
+
+void Atmosphere::bindLuts(GLuint prog) const
+{
+    glState.activeTexture(GL_TEXTURE0);
+    statBindTexture(GL_TEXTURE_2D, m_transmittance);
+    statUniform(glUniform1i, glGetUniformLocation(prog, "uTransmittanceLut"), 0);
+    glState.activeTexture(GL_TEXTURE1);
+    statBindTexture(GL_TEXTURE_2D, m_multiScattering);
+    statUniform(glUniform1i, glGetUniformLocation(prog, "uMultiScatteringLut"), 1);
+}
+
+void Atmosphere::drawFullscreen() const
+{
+    glState.bindVertexArray(m_emptyVAO);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    renderStats.draw(GL_TRIANGLES, 3);
+}
+
+void Atmosphere::renderTransmittance()
+{
+    TRACE_SCOPE("sky: transmittance");
+    glBindFramebuffer(GL_FRAMEBUFFER, m_fboTransmittance);
+    glViewport(0, 0, TRANSMITTANCE_W, TRANSMITTANCE_H);
+    glState.useProgram(m_progTransmittance);
+    setParamUniforms(m_progTransmittance);
+    statUniform(glUniform2f, glGetUniformLocation(m_progTransmittance, "uLutSize"), float(TRANSMITTANCE_W),
+                float(TRANSMITTANCE_H));
+    drawFullscreen();
+}
+
+void Atmosphere::renderMultiScattering()
+{
+    TRACE_SCOPE("sky: multiple scattering");
+    glBindFramebuffer(GL_FRAMEBUFFER, m_fboMultiScattering);
+    glViewport(0, 0, MULTI_SCATTERING_SIZE, MULTI_SCATTERING_SIZE);
+    glState.useProgram(m_progMultiScattering);
+    setParamUniforms(m_progMultiScattering);
+    bindLuts(m_progMultiScattering); // reads only the transmittance
+    statUniform(glUniform2f, glGetUniformLocation(m_progMultiScattering, "uLutSize"), float(MULTI_SCATTERING_SIZE),
+                float(MULTI_SCATTERING_SIZE));
+    drawFullscreen();
+}
+
+void Atmosphere::renderSkyViewRows(int firstRow, int rowCount)
+{
+    TRACE_SCOPE("sky: sky view");
+    glBindFramebuffer(GL_FRAMEBUFFER, m_fboSkyView[m_skyViewFront ^ 1]);
+    glViewport(0, 0, SKY_VIEW_W, SKY_VIEW_H);
+    glEnable(GL_SCISSOR_TEST);
+    glScissor(0, firstRow, SKY_VIEW_W, rowCount);
+
+    glState.useProgram(m_progSkyView);
+    setParamUniforms(m_progSkyView);
+    bindLuts(m_progSkyView);
+    // the pending key's sun, not m_sun: every band of one refresh sees the same sky
+    statUniform(glUniform3fv, glGetUniformLocation(m_progSkyView, "uSunDirection"), 1, &m_skyViewPending.sun[0]);
+    statUniform(glUniform2f, glGetUniformLocation(m_progSkyView, "uLutSize"), float(SKY_VIEW_W), float(SKY_VIEW_H));
+    statUniform(glUniform1f, glGetUniformLocation(m_progSkyView, "uViewHeight"),
+                viewHeight(m_skyViewPending.altitudeBand));
+    drawFullscreen();
+
+    glDisable(GL_SCISSOR_TEST);
+}
+
+void Atmosphere::renderAerialPerspective(const glm::mat4 &viewProj, const glm::vec3 &eye, float farDistance)
+{
+    TRACE_SCOPE("sky: aerial perspective");
+    m_aerialViewProj = viewProj;
+    m_aerialKmPerSlice = std::max(farDistance * m_kmPerUnit, 1e-3f) / float(AERIAL_SIZE);
+
+    glViewport(0, 0, AERIAL_SIZE, AERIAL_SIZE);
+    glState.useProgram(m_progAerial);
+    setParamUniforms(m_progAerial);
+    bindLuts(m_progAerial);
+
+    auto loc = [&](const char *name) { return glGetUniformLocation(m_progAerial, name); };
+    const glm::mat4 invViewProj = glm::inverse(viewProj);
+    statUniform(glUniform2f, loc("uLutSize"), float(AERIAL_SIZE), float(AERIAL_SIZE));
+    statUniform(glUniform1f, loc("uSliceCount"), float(AERIAL_SIZE));
+    statUniform(glUniform1f, loc("uKmPerSlice"), m_aerialKmPerSlice);
+    statUniform(glUniformMatrix4fv, loc("uInvViewProj"), 1, GL_FALSE, &invViewProj[0][0]);
+    statUniform(glUniform3fv, loc("uCameraPos"), 1, &eye[0]);
+    statUniform(glUniform1f, loc("uKmPerUnit"), m_kmPerUnit);
+    statUniform(glUniform1f, loc("uSeaLevelY"), m_seaLevelY);
+
+    const GLint locSlice = loc("uSlice");
+    for (int slice = 0; slice < AERIAL_SIZE; ++slice)
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, m_fboAerial[slice]);
+        statUniform(glUniform1f, locSlice, float(slice));
+        drawFullscreen();
+    }
+}
+
+void Atmosphere::bindSky(GLuint prog, GLint firstUnit) const
+{
+    setParamUniforms(prog);
+    glState.activeTexture(GL_TEXTURE0 + firstUnit);
+    statBindTexture(GL_TEXTURE_2D, m_skyView[m_skyViewFront]);
+    statUniform(glUniform1i, glGetUniformLocation(prog, "uSkyViewLut"), firstUnit);
+    glState.activeTexture(GL_TEXTURE0 + firstUnit + 1);
+    statBindTexture(GL_TEXTURE_2D, m_transmittance);
+    statUniform(glUniform1i, glGetUniformLocation(prog, "uTransmittanceLut"), firstUnit + 1);
+
+    statUniform(glUniform1f, glGetUniformLocation(prog, "uViewHeight"), viewHeight(m_skyViewShown.altitudeBand));
+    statUniform(glUniform1f, glGetUniformLocation(prog, "uSunDiskCos"), std::cos(SUN_ANGULAR_RADIUS));
+    statUniform(glUniform1f, glGetUniformLocation(prog, "uSunDiskLuminance"), SUN_DISK_LUMINANCE);
+}
+
+void Atmosphere::bindAerialPerspective(GLuint prog, GLint unit, const glm::vec3 &eye) const
+{
+    auto loc = [&](const char *name) { return glGetUniformLocation(prog, name); };
+    glState.activeTexture(GL_TEXTURE0 + unit);
+    statBindTexture(GL_TEXTURE_3D, m_aerial);
+    statUniform(glUniform1i, loc("uAerialPerspective"), unit);
+    statUniform(glUniformMatrix4fv, loc("uAerialViewProj"), 1, GL_FALSE, &m_aerialViewProj[0][0]);
+    statUniform(glUniform3fv, loc("uAerialEye"), 1, &eye[0]);
+    statUniform(glUniform1f, loc("uAerialKmPerUnit"), m_kmPerUnit);
+    statUniform(glUniform1f, loc("uAerialKmPerSlice"), m_aerialKmPerSlice);
+}
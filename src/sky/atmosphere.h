@@ -0,0 +1,135 @@
+#pragma once
+
+#ifdef __APPLE__
+#define GL_SILENCE_DEPRECATION
+#endif
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <array>
+
+#include "utils/gl_handle.h"
+
+// What the air is made of, in kilometres (resources/shaders/atmosphere.glsl).
+// The defaults are Earth on a clear day.
+struct AtmosphereParams
+{
+    float bottomRadius = 6360.f;
+    float topRadius = 6460.f;
+    glm::vec3 rayleighScattering{5.802e-3f, 13.558e-3f, 33.1e-3f}; // per km at the ground
+    float rayleighScaleHeight = 8.f;
+    glm::vec3 mieScattering{3.996e-3f};
+    glm::vec3 mieAbsorption{0.444e-3f};
+    float mieScaleHeight = 1.2f;
+    float mieG = 0.8f;
+    glm::vec3 ozoneAbsorption{0.650e-3f, 1.881e-3f, 0.085e-3f};
+    glm::vec3 groundAlbedo{0.3f};
+    glm::vec3 sunIlluminance{10.f}; // in the units the scene is lit in
+
+    bool operator==(const AtmosphereParams &) const = default;
+};
+
+// Sky and aerial perspective from precomputed scattering LUTs (Hillaire 2020),
+// all rendered on the GPU with full-screen fragment passes:
+//  - transmittance (TRANSMITTANCE_W x TRANSMITTANCE_H) and multiple scattering
+//    (MULTI_SCATTERING_SIZE^2): depend on the params only;
+//  - sky view (SKY_VIEW_W x SKY_VIEW_H): the sky around the camera, for one sun
+//    direction and camera altitude band; sky.frag reads the sky from it;
+//  - aerial perspective (AERIAL_SIZE^3 froxels over the camera frustum): what
+//    the air between the eye and a surface adds and takes away; terrain,
+//    forest, water and scene items read their fog from it.
+//
+// update() runs once per frame and keeps its cost about the same from frame
+// to frame: the aerial-perspective volume is rebuilt every time (it follows
+// the camera), and LUT work is only done when something it depends on
+// changed, one step per frame - transmittance, then multiple scattering, then
+// the sky view a band of rows at a time into a back texture that replaces the
+// visible one only once complete. bake() does all of it at once.
+class Atmosphere
+{
+public:
+    static constexpr int TRANSMITTANCE_W = 256;
+    static constexpr int TRANSMITTANCE_H = 64;
+    static constexpr int MULTI_SCATTERING_SIZE = 32;
+    static constexpr int SKY_VIEW_W = 192;
+    static constexpr int SKY_VIEW_H = 108;
+    static constexpr int SKY_VIEW_SLICES = 4;        // frames a sky-view refresh is spread over
+    static constexpr int AERIAL_SIZE = 32;           // froxels across, down and deep
+    static constexpr float ALTITUDE_BAND_KM = 0.5f;  // camera height change that redoes the sky view
+    static constexpr float SUN_ANGULAR_RADIUS = 0.0045f; // radians, about the real sun's
+    static constexpr float SUN_DISK_LUMINANCE = 20.f;    // relative to the illuminance
+
+    Atmosphere() = default;
+    Atmosphere(const Atmosphere &) = delete;
+    Atmosphere &operator=(const Atmosphere &) = delete;
+
+    // programs and LUT textures; needs a current context. False if a shader failed.
+    bool init();
+    void destroy();
+    bool ready() const { return m_ready; }
+
+    void setParams(const AtmosphereParams &params); // redoes every LUT
+    void setSun(const glm::vec3 &towardsSun);       // redoes the sky view
+    // world units to km, and where on the world's y axis the ground sphere is
+    void setWorldScale(float kmPerUnit, float seaLevelY);
+
+    // Once per frame before anything samples it, for the camera the frame is
+    // seen through. Leaves its own framebuffers and the viewport bound.
+    void update(const glm::mat4 &viewProj, const glm::vec3 &eye, float farDistance);
+    // every pending LUT step now (startup), the sky view for a camera at eye
+    void bake(const glm::vec3 &eye);
+
+    // sky.frag: the sky-view and transmittance LUTs on units firstUnit and firstUnit + 1
+    void bindSky(GLuint prog, GLint firstUnit) const;
+    // aerial_perspective.glsl on unit; eye is the eye of the pass drawing
+    void bindAerialPerspective(GLuint prog, GLint unit, const glm::vec3 &eye) const;
+
+private:
+    struct SkyViewKey
+    {
+        glm::vec3 sun{0.f};
+        int altitudeBand = 0;
+        int paramsVersion = -1;
+        bool operator==(const SkyViewKey &) const = default;
+    };
+
+    void setParamUniforms(GLuint prog) const;
+    void bindLuts(GLuint prog) const; // transmittance on 0, multiple scattering on 1
+    void drawFullscreen() const;
+    void renderTransmittance();
+    void renderMultiScattering();
+    void renderSkyViewRows(int firstRow, int rowCount);
+    void renderAerialPerspective(const glm::mat4 &viewProj, const glm::vec3 &eye, float farDistance);
+    SkyViewKey skyViewKey(const glm::vec3 &eye) const;
+    float viewHeight(int altitudeBand) const;
+    // one step of pending LUT work; false when there is none
+    bool step(const glm::vec3 &eye);
+
+    AtmosphereParams m_params;
+    int m_paramsVersion = 0;
+    glm::vec3 m_sun{0.f, 1.f, 0.f};
+    float m_kmPerUnit = 0.5f;
+    float m_seaLevelY = 0.f;
+
+    GLProgram m_progTransmittance, m_progMultiScattering, m_progSkyView, m_progAerial;
+    GLVertexArray m_emptyVAO; // the full-screen triangle comes from gl_VertexID
+
+    GLTexture m_transmittance, m_multiScattering;
+    std::array<GLTexture, 2> m_skyView; // front (sampled), back (being refreshed)
+    GLTexture m_aerial;
+    GLFramebuffer m_fboTransmittance, m_fboMultiScattering;
+    std::array<GLFramebuffer, 2> m_fboSkyView;
+    std::array<GLFramebuffer, AERIAL_SIZE> m_fboAerial; // one per depth slice
+
+    bool m_ready = false;
+    bool m_transmittanceDirty = true;
+    bool m_multiScatteringDirty = true;
+    int m_skyViewFront = 0;
+    SkyViewKey m_skyViewShown;   // what the front texture holds
+    SkyViewKey m_skyViewPending; // what the back texture is being filled with
+    int m_skyViewRow = SKY_VIEW_H; // next back-texture row; SKY_VIEW_H = no refresh under way
+
+    // the camera the aerial-perspective volume was built for
+    glm::mat4 m_aerialViewProj{1.f};
+    float m_aerialKmPerSlice = 1.f;
+};
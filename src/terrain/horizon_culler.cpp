@@ -0,0 +1,171 @@
+#include "horizon_culler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "utils/mem_tracker.h"
+#include "utils/parallel.h"
+
+namespace
+{
+constexpr float TWO_PI = 6.28318530718f;
+
+// height margin: the rendered mesh is piecewise linear, the culler samples bilinearly
+constexpr float HEIGHT_MARGIN = 0.25f;
+}
+
+void HorizonCuller::setHeightField(std::vector<float> heights, int n,
+                                   const glm::vec2 &origin, const glm::vec2 &axisI, const glm::vec2 &axisJ)
+{
+    m_heights = std::move(heights);
+    m_n = n;
+    m_origin = origin;
+    m_gridToWorld = glm::mat2(axisI, axisJ);
+    m_worldToGrid = glm::inverse(m_gridToWorld);
+    m_maxHeight = m_heights.empty() ? 0.f : *std::max_element(m_heights.begin(), m_heights.end());
+
+    // march roughly one grid cell per step
+    m_stepLen = std::max(1e-3f, std::min(glm::length(axisI), glm::length(axisJ)));
+    m_valid = false;
+}
+
+void HorizonCuller::clear()
+{
+    m_heights.clear();
+    m_n = 0;
+    m_horizon.clear();
+    m_valid = false;
+}
+
+float HorizonCuller::heightAt(const glm::vec2 &xz) const
+{
+    glm::vec2 g = m_worldToGrid * (xz - m_origin);
+    g = glm::clamp(g, glm::vec2(0.f), glm::vec2(float(m_n)));
+    int i0 = std::min(int(g.x), m_n - 1);
+    int j0 = std::min(int(g.y), m_n - 1);
+    float fx = g.x - i0;
+    float fy = g.y - j0;
+
+    const int stride = m_n + 1;
+    float h00 = m_heights[i0 * stride + j0];
+    float h10 = m_heights[(i0 + 1) * stride + j0];
+    float h01 = m_heights[i0 * stride + j0 + 1];
+    float h11 = m_heights[(i0 + 1) * stride + j0 + 1];
+    return glm::mix(glm::mix(h00, h10, fx), glm::mix(h01, h11, fx), fy);
+}
+
+void HorizonCuller::update(const glm::vec3 &eye)
+{
+    m_valid = false;
+    if (!hasHeightField())
+        return;
+
+    m_eye = eye;
+    MemTagScope memTag(MemTracker::Terrain);
+
+    // farthest distance from the eye to any corner of the heightfield
+    float maxDist = 0.f;
+    for (int c = 0; c < 4; ++c)
+    {
+        glm::vec2 corner = m_origin + m_gridToWorld * glm::vec2((c & 1) ? m_n : 0, (c & 2) ? m_n : 0);
+        maxDist = std::max(maxDist, glm::length(corner - glm::vec2(eye.x, eye.z)));
+    }
+    m_steps = std::max(1, int(std::ceil(maxDist / m_stepLen)));
+    m_horizon.assign(std::size_t(AZIMUTH_BUCKETS) * m_steps, -std::numeric_limits<float>::infinity());
+
+    glm::vec2 eyeXZ(eye.x, eye.z);
+
+    parallelForPooled(0, AZIMUTH_BUCKETS, [&](int b)
+                {
+        float az = (b + 0.5f) * TWO_PI / AZIMUTH_BUCKETS;
+        glm::vec2 dir(std::cos(az), std::sin(az));
+        float *row = &m_horizon[std::size_t(b) * m_steps];
+
+        float best = -std::numeric_limits<float>::infinity();
+        for (int k = 0; k < m_steps; ++k)
+        {
+            float d = (k + 1) * m_stepLen;
+            glm::vec2 p = eyeXZ + dir * d;
+
+            // outside the heightfield nothing occludes any more
+            glm::vec2 g = m_worldToGrid * (p - m_origin);
+            if (g.x >= 0.f && g.y >= 0.f && g.x <= m_n && g.y <= m_n)
+            {
+                float slope = (heightAt(p) - HEIGHT_MARGIN - eye.y) / d;
+                best = std::max(best, slope);
+            }
+            row[k] = best;
+        } },
+                /*minPerThread*/ 32);
+
+    m_valid = true;
+}
+
+bool HorizonCuller::boxOccluded(const glm::vec3 &bmin, const glm::vec3 &bmax) const
+{
+    if (!m_valid)
+        return false;
+
+    // eye inside the box footprint: can't be hidden
+    glm::vec2 eyeXZ(m_eye.x, m_eye.z);
+    glm::vec2 closest = glm::clamp(eyeXZ, glm::vec2(bmin.x, bmin.z), glm::vec2(bmax.x, bmax.z));
+    float dNear = glm::length(closest - eyeXZ);
+    if (dNear < 2.f * m_stepLen)
+        return false;
+
+    // anything higher than every occluder is visible
+    if (bmax.y >= m_maxHeight && bmax.y >= m_eye.y)
+        return false;
+
+    // steepest slope any point of the box can have as seen from the eye
+    float dy = bmax.y - m_eye.y;
+    float dFar = 0.f;
+    for (int c = 0; c < 4; ++c)
+    {
+        glm::vec2 corner((c & 1) ? bmax.x : bmin.x, (c & 2) ? bmax.z : bmin.z);
+        dFar = std::max(dFar, glm::length(corner - eyeXZ));
+    }
+    float boxSlope = (dy >= 0.f) ? dy / dNear : dy / dFar;
+
+    // occluders must lie strictly in front of the box: one step of slack
+    int k = int(dNear / m_stepLen) - 2;
+    if (k < 0)
+        return false;
+    k = std::min(k, m_steps - 1);
+
+    // azimuth range covered by the box footprint
+    glm::vec2 center(0.5f * (bmin.x + bmax.x), 0.5f * (bmin.z + bmax.z));
+    float azC = std::atan2(center.y - eyeXZ.y, center.x - eyeXZ.x);
+    float lo = 0.f, hi = 0.f;
+    for (int c = 0; c < 4; ++c)
+    {
+        glm::vec2 corner((c & 1) ? bmax.x : bmin.x, (c & 2) ? bmax.z : bmin.z);
+        float a = std::atan2(corner.y - eyeXZ.y, corner.x - eyeXZ.x) - azC;
+        a = std::remainder(a, TWO_PI); // wrap into [-pi, pi]
+        lo = std::min(lo, a);
+        hi = std::max(hi, a);
+    }
+
+    auto bucketOf = [](float az)
+    {
+        float t = az / TWO_PI;
+        t -= std::floor(t);
+        return std::min(AZIMUTH_BUCKETS - 1, int(t * AZIMUTH_BUCKETS));
+    };
+    // each bucket is one sampled ray: also require the rays on either side so
+    // terrain between two rays can't hide something it doesn't actually cover
+    int b0 = bucketOf(azC + lo) - 1 + AZIMUTH_BUCKETS;
+    int span = int(std::ceil((hi - lo) / TWO_PI * AZIMUTH_BUCKETS)) + 2;
+    if (span >= AZIMUTH_BUCKETS)
+        return false;
+
+    // hidden only if the horizon is above the box in every bucket it covers
+    for (int s = 0; s <= span; ++s)
+    {
+        int b = (b0 + s) % AZIMUTH_BUCKETS;
+        if (m_horizon[std::size_t(b) * m_steps + k] <= boxSlope)
+            return false;
+    }
+    return true;
+}
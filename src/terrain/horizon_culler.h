@@ -0,0 +1,51 @@
+#pragma once
+
+#include <vector>
+#include <glm/glm.hpp>
+
+// Horizon-based occlusion culling against the terrain heightfield.
+//
+// Each frame update() marches the height grid outward from the eye along
+// AZIMUTH_BUCKETS directions (in parallel) and records, per direction and per
+// distance step, the steepest elevation slope (dy / distance) seen so far.
+// An object is hidden when even its highest point, taken at its nearest
+// distance, stays below the horizon formed by the terrain in front of it.
+// Approximate: the horizon is only known along the sampled rays, so a notch
+// in a ridge narrower than the ray spacing can still report an object behind
+// it as hidden. Requiring the rays on either side of the object as well and
+// lowering the sampled terrain by a small margin make such misses rare, not impossible.
+class HorizonCuller
+{
+public:
+    static constexpr int AZIMUTH_BUCKETS = 256;
+
+    // heights: (n+1)^2 world-space y values, row-major over (i, j).
+    // Sample (i, j) sits at world xz = origin + i * axisI + j * axisJ.
+    void setHeightField(std::vector<float> heights, int n,
+                        const glm::vec2 &origin, const glm::vec2 &axisI, const glm::vec2 &axisJ);
+    void clear();
+    bool hasHeightField() const { return m_n > 0; }
+
+    // rebuild the horizon for this eye position
+    void update(const glm::vec3 &eye);
+
+    // true if the world-space box is entirely hidden behind terrain
+    bool boxOccluded(const glm::vec3 &bmin, const glm::vec3 &bmax) const;
+
+private:
+    float heightAt(const glm::vec2 &xz) const; // bilinear, clamped to the grid
+
+    std::vector<float> m_heights;
+    int m_n = 0;
+    glm::vec2 m_origin{0.f};
+    glm::mat2 m_gridToWorld{1.f};
+    glm::mat2 m_worldToGrid{1.f};
+    float m_maxHeight = 0.f;
+
+    // horizon
+    glm::vec3 m_eye{0.f};
+    float m_stepLen = 1.f; // march step in world units
+    int m_steps = 0;       // distance steps per bucket
+    std::vector<float> m_horizon; // [bucket * m_steps + k] = max slope within distance (k + 1) * m_stepLen
+    bool m_valid = false;
+};
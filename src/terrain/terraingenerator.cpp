@@ -2,7 +2,14 @@
 
 #include <cmath>
 #include <cstdlib>
+#include <algorithm>
+#include <limits>
 #include "glm/glm.hpp"
+#include "glm/gtc/constants.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+#include "utils/parallel.h"
+#include "utils/mem_tracker.h"
+#include "utils/trace.h"
 
 // helpers: fbm & terrace
 inline float fbm(TerrainGenerator *self,
@@ -36,6 +43,67 @@ void TerrainGenerator::setParams(const TerrainParams &p) {
     m_params = p;
 }
 
+// map UI sliders -> terrain parameters
+TerrainGenerator::TerrainParams TerrainGenerator::paramsFromSliders(const TerrainSliders &s) {
+    TerrainParams P;
+
+    // P1: mountain roughness / frequency
+    P.baseFreq = 0.25f * powf(2.f, (s.roughness - 5) / 3.f);
+
+    // P2: mountian heights
+    P.heightScale = 0.12f * s.height;
+
+    // P3: terrain distortion and river curvature (EC3 trigger)
+    int s3 = glm::clamp(s.distortion, 1, 5);
+    float t3 = (s3 - 1) / 4.f; // 0..1
+
+    // domain warping makes the terrain more "organic"
+    P.warpStrength = glm::mix(0.10f, 0.45f, t3);
+
+    // EC1 cliff, EC2 crater
+    P.cliffSteps = s.cliffs ? 5 : 1;
+    P.enableCraters = s.craters;
+    // Adjustable:
+    if (P.enableCraters)
+    {
+        P.craterDensity = 4.0f; // slightly thinner
+        P.craterRadius = 0.05f;
+        P.craterDepth = 0.32f; // dig deeper -> bottom of the pit will be below sea level more
+    }
+
+    P.enableRivers = s.rivers;
+    if (P.enableRivers)
+    {
+        // frequency: higher -> the more meandering the river.
+        P.riverFreq = glm::mix(0.5f, 1.4f, t3);
+        // ridged deg: greater -> sharper trough
+        P.riverSharp = glm::mix(1.0f, 2.5f, t3);
+        // threshold: the larger t3 is -> the wider the river.
+        P.riverThresh = glm::mix(0.92f, 0.75f, t3);
+        // depth
+        P.riverDepth = glm::mix(0.04f, 0.18f, t3);
+    }
+    else
+    {
+        P.riverDepth = 0.0f;
+    }
+
+    // water level & overall offset
+    P.seaLevel = -0.1f;
+    P.oceanBias = 0.0f; // Aborted
+
+    return P;
+}
+
+// z-up (lab07) -> y-up (project) : translate center, scale, rotate -90° around +X
+glm::mat4 TerrainGenerator::worldModel() {
+    glm::mat4 T = glm::translate(glm::mat4(1.f), glm::vec3(-0.5f, -0.5f, 0.f));
+    glm::mat4 S = glm::scale(glm::mat4(1.f), glm::vec3(120.f, 120.f, 10.f));
+    glm::mat4 R = glm::rotate(glm::mat4(1.f),
+                              -glm::half_pi<float>(), glm::vec3(1, 0, 0));
+    return R * S * T;
+}
+
 // ctor / dtor
 TerrainGenerator::TerrainGenerator()
 {
@@ -44,13 +112,20 @@ TerrainGenerator::TerrainGenerator()
     m_resolution = 256;
 
     m_lookupSize = 1024;
-    m_randVecLookup.reserve(m_lookupSize);
 
-    std::srand(1230);
-    for (int i = 0; i < m_lookupSize; i++) {
-        m_randVecLookup.push_back(glm::vec2(std::rand() * 2.0 / RAND_MAX - 1.0,
-                                            std::rand() * 2.0 / RAND_MAX - 1.0));
-    }
+    // built once: std::rand is global state, and generators may be created
+    // concurrently (batch tool workers)
+    static const std::vector<glm::vec2> lookup = [size = m_lookupSize] {
+        std::vector<glm::vec2> table;
+        table.reserve(size);
+        std::srand(1230);
+        for (int i = 0; i < size; i++) {
+            table.push_back(glm::vec2(std::rand() * 2.0 / RAND_MAX - 1.0,
+                                      std::rand() * 2.0 / RAND_MAX - 1.0));
+        }
+        return table;
+    }();
+    m_randVecLookup = lookup;
 }
 
 TerrainGenerator::~TerrainGenerator()
@@ -79,49 +154,88 @@ static void addVertex(const glm::vec3 &pos,
 
 // ===== mesh generation =============================================
 
-std::vector<float> TerrainGenerator::generateTerrain()
+std::vector<float> TerrainGenerator::generateTerrain(int step, int patchesPerSide,
+                                                     std::vector<TerrainPatch> *outPatches)
 {
+    TRACE_SCOPE("generateTerrain");
+    MemTagScope memTag(MemTracker::Terrain);
+    step = std::max(1, step);
+    patchesPerSide = std::max(1, patchesPerSide);
+    int cells = (m_resolution + step - 1) / step;
+
     std::vector<float> verts;
-    verts.reserve(m_resolution * m_resolution * 6 * 9); // 6 verts * 9 floats
+    verts.reserve(cells * cells * 6 * 9); // 6 verts * 9 floats
+    if (outPatches) {
+        outPatches->clear();
+        outPatches->reserve(patchesPerSide * patchesPerSide);
+    }
 
     const float uvScale = 30.0f; // Adjustible: number of times the texture tiled.
 
-    for (int x = 0; x < m_resolution; x++) {
-        for (int y = 0; y < m_resolution; y++) {
-            int x1 = x;
-            int y1 = y;
-            int x2 = x + 1;
-            int y2 = y + 1;
-
-            glm::vec3 p1 = getPosition(x1, y1);
-            glm::vec3 p2 = getPosition(x2, y1);
-            glm::vec3 p3 = getPosition(x2, y2);
-            glm::vec3 p4 = getPosition(x1, y2);
-
-            glm::vec3 n1 = getNormal(x1, y1);
-            glm::vec3 n2 = getNormal(x2, y1);
-            glm::vec3 n3 = getNormal(x2, y2);
-            glm::vec3 n4 = getNormal(x1, y2);
-
-            // apply uniform UV light over [0,1], then scale up the uvScale and repeat.
-            glm::vec2 uv1 = glm::vec2(float(x1) / m_resolution,
-                                      float(y1) / m_resolution) * uvScale;
-            glm::vec2 uv2 = glm::vec2(float(x2) / m_resolution,
-                                      float(y1) / m_resolution) * uvScale;
-            glm::vec2 uv3 = glm::vec2(float(x2) / m_resolution,
-                                      float(y2) / m_resolution) * uvScale;
-            glm::vec2 uv4 = glm::vec2(float(x1) / m_resolution,
-                                      float(y2) / m_resolution) * uvScale;
-
-            // tri 1: p1 p2 p3
-            addVertex(p1, n1, uv1, verts);
-            addVertex(p2, n2, uv2, verts);
-            addVertex(p3, n3, uv3, verts);
-
-            // tri 2: p1 p3 p4
-            addVertex(p1, n1, uv1, verts);
-            addVertex(p3, n3, uv3, verts);
-            addVertex(p4, n4, uv4, verts);
+    // patch edges in grid units, snapped to the LOD step so every LOD splits the same way
+    auto patchEdge = [&](int i) {
+        int e = (cells * i / patchesPerSide) * step;
+        return std::min(e, m_resolution);
+    };
+
+    for (int px = 0; px < patchesPerSide; px++) {
+        for (int py = 0; py < patchesPerSide; py++) {
+            TRACE_SCOPE("terrain patch"); // noise + normals + vertex emission
+            int x0 = patchEdge(px), x1e = patchEdge(px + 1);
+            int y0 = patchEdge(py), y1e = patchEdge(py + 1);
+
+            TerrainPatch patch;
+            patch.first = int(verts.size() / 9);
+            patch.aabbMin = glm::vec3(std::numeric_limits<float>::max());
+            patch.aabbMax = glm::vec3(-std::numeric_limits<float>::max());
+
+            for (int x = x0; x < x1e; x += step) {
+                for (int y = y0; y < y1e; y += step) {
+                    int x1 = x;
+                    int y1 = y;
+                    int x2 = std::min(x + step, m_resolution);
+                    int y2 = std::min(y + step, m_resolution);
+
+                    glm::vec3 p1 = getPosition(x1, y1);
+                    glm::vec3 p2 = getPosition(x2, y1);
+                    glm::vec3 p3 = getPosition(x2, y2);
+                    glm::vec3 p4 = getPosition(x1, y2);
+
+                    glm::vec3 n1 = getNormal(x1, y1);
+                    glm::vec3 n2 = getNormal(x2, y1);
+                    glm::vec3 n3 = getNormal(x2, y2);
+                    glm::vec3 n4 = getNormal(x1, y2);
+
+                    // apply uniform UV light over [0,1], then scale up the uvScale and repeat.
+                    glm::vec2 uv1 = glm::vec2(float(x1) / m_resolution,
+                                              float(y1) / m_resolution) * uvScale;
+                    glm::vec2 uv2 = glm::vec2(float(x2) / m_resolution,
+                                              float(y1) / m_resolution) * uvScale;
+                    glm::vec2 uv3 = glm::vec2(float(x2) / m_resolution,
+                                              float(y2) / m_resolution) * uvScale;
+                    glm::vec2 uv4 = glm::vec2(float(x1) / m_resolution,
+                                              float(y2) / m_resolution) * uvScale;
+
+                    // tri 1: p1 p2 p3
+                    addVertex(p1, n1, uv1, verts);
+                    addVertex(p2, n2, uv2, verts);
+                    addVertex(p3, n3, uv3, verts);
+
+                    // tri 2: p1 p3 p4
+                    addVertex(p1, n1, uv1, verts);
+                    addVertex(p3, n3, uv3, verts);
+                    addVertex(p4, n4, uv4, verts);
+
+                    for (const glm::vec3 &p : {p1, p2, p3, p4}) {
+                        patch.aabbMin = glm::min(patch.aabbMin, p);
+                        patch.aabbMax = glm::max(patch.aabbMax, p);
+                    }
+                }
+            }
+
+            patch.count = int(verts.size() / 9) - patch.first;
+            if (outPatches && patch.count > 0)
+                outPatches->push_back(patch);
         }
     }
     return verts;
@@ -257,6 +371,23 @@ glm::vec3 TerrainGenerator::sampleSurfacePos(float x, float y) const {
     return glm::vec3(x, y, h);
 }
 
+std::vector<float> TerrainGenerator::heightGrid(int n) const {
+    TRACE_SCOPE("heightGrid");
+    MemTagScope memTag(MemTracker::Terrain);
+    n = std::max(1, n);
+    const int stride = n + 1;
+    std::vector<float> heights(std::size_t(stride) * stride);
+
+    // getHeight only reads the lookup table and params: rows are independent
+    TerrainGenerator *self = const_cast<TerrainGenerator*>(this);
+    parallelFor(0, stride, [&](int i) {
+        for (int j = 0; j < stride; ++j)
+            heights[std::size_t(i) * stride + j] = self->getHeight(float(i) / n, float(j) / n);
+    }, /*minPerThread*/ 16);
+
+    return heights;
+}
+
 // normal from neighbor ring
 glm::vec3 TerrainGenerator::getNormal(int row, int col)
 {
@@ -12,7 +12,20 @@ public:
     ~TerrainGenerator();
 
     int getResolution() { return m_resolution; }
-    std::vector<float> generateTerrain();
+    // contiguous vertex range of one terrain patch + its bounds (local space)
+    struct TerrainPatch {
+        glm::vec3 aabbMin;
+        glm::vec3 aabbMax;
+        int first = 0;  // first vertex
+        int count = 0;  // vertex count
+    };
+
+    // step > 1 skips grid lines for a coarser LOD of the same surface
+    // (step 2 -> 1/4 of the triangles, step 4 -> 1/16).
+    // Vertices are emitted patch by patch (patchesPerSide^2 patches) so each
+    // patch is one contiguous range; its range and bounds go to outPatches.
+    std::vector<float> generateTerrain(int step = 1, int patchesPerSide = 1,
+                                       std::vector<TerrainPatch> *outPatches = nullptr);
 
     struct TerrainParams {
         // base fBm
@@ -62,10 +75,28 @@ public:
 
     void setParams(const TerrainParams& p);
 
+    // the UI sliders / extra-credit toggles that drive TerrainParams
+    struct TerrainSliders {
+        int  roughness  = 1;     // settings.shapeParameter1
+        int  height     = 1;     // settings.shapeParameter2
+        int  distortion = 1;     // settings.shapeParameter3 (1..5)
+        bool cliffs     = false; // extraCredit1
+        bool craters    = false; // extraCredit2
+        bool rivers     = false; // extraCredit3
+    };
+    static TerrainParams paramsFromSliders(const TerrainSliders& s);
+
+    // local (x, y in [0,1], z = height) -> world, y-up, 120 x 120 units
+    static glm::mat4 worldModel();
+
     float sampleHeight01(float x, float y) const;
 
     glm::vec3 sampleSurfacePos(float x, float y) const;
 
+    // unclamped surface heights on an (n+1)^2 grid over [0,1]^2, row-major
+    // [i * (n + 1) + j] = height at (i / n, j / n); same surface the mesh uses
+    std::vector<float> heightGrid(int n) const;
+
     // Perlin noise
     float computePerlin(float x, float y);
 
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cmath>
+#include <type_traits>
+
+// sqrt / sin / cos usable in constant expressions (std:: ones are not until
+// C++26). At run time they forward to <cmath>; during constant evaluation
+// they use Newton steps and a range-reduced Taylor series, accurate to a few
+// ulp of double, which is far below the float precision of the results.
+namespace cx
+{
+constexpr double PI = 3.14159265358979323846;
+
+constexpr double sqrt(double x)
+{
+    if (!std::is_constant_evaluated())
+        return std::sqrt(x);
+    if (!(x > 0.0))
+        return 0.0;
+    double r = x > 1.0 ? x : 1.0;
+    for (int i = 0; i < 64; ++i)
+    {
+        double next = 0.5 * (r + x / r);
+        if (next == r)
+            break;
+        r = next;
+    }
+    return r;
+}
+
+namespace detail
+{
+// x reduced to [-pi, pi]
+constexpr double reduceAngle(double x)
+{
+    double turns = x / (2.0 * PI);
+    long long k = static_cast<long long>(turns + (turns >= 0.0 ? 0.5 : -0.5));
+    return x - double(k) * 2.0 * PI;
+}
+
+// sum of (-1)^k x^(2k+p) / (2k+p)!, p = 1 for sin and 0 for cos
+constexpr double taylor(double x, int p)
+{
+    double term = p ? x : 1.0;
+    double sum = term;
+    for (int n = p + 1; n < 40; n += 2)
+    {
+        term *= -x * x / (double(n) * double(n + 1));
+        sum += term;
+    }
+    return sum;
+}
+}
+
+constexpr double sin(double x)
+{
+    if (!std::is_constant_evaluated())
+        return std::sin(x);
+    return detail::taylor(detail::reduceAngle(x), 1);
+}
+
+constexpr double cos(double x)
+{
+    if (!std::is_constant_evaluated())
+        return std::cos(x);
+    return detail::taylor(detail::reduceAngle(x), 0);
+}
+}
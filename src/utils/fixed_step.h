@@ -0,0 +1,75 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <mutex>
+
+// Accumulator for a fixed-timestep loop: real time goes in, whole steps of
+// a constant length come out, and the remainder carries over to the next
+// call. Given the same number of steps a simulation ends up in the same
+// state however its wall-clock time was sliced.
+class FixedStepClock
+{
+public:
+    // more than maxSteps due at once (a stall, a breakpoint) drops the excess:
+    // the simulation falls behind real time instead of spiralling trying to catch up
+    explicit FixedStepClock(double step, int maxSteps = 8) : m_step(step), m_maxSteps(std::max(1, maxSteps)) {}
+
+    // adds elapsed seconds; returns how many steps are due now
+    int advance(double seconds)
+    {
+        m_accumulator += std::max(0.0, seconds);
+        const int steps = int(m_accumulator / m_step);
+        m_accumulator -= double(steps) * m_step;
+        return std::min(steps, m_maxSteps); // a backlog is dropped, the phase kept
+    }
+
+    double step() const { return m_step; }
+    // time already accumulated towards the next step, as a fraction of a step in [0, 1)
+    double alpha() const { return m_accumulator / m_step; }
+    double untilNextStep() const { return m_step - m_accumulator; }
+    void reset() { m_accumulator = 0.0; }
+
+private:
+    double m_step;
+    int m_maxSteps;
+    double m_accumulator = 0.0;
+};
+
+// Hands the latest state from one producer thread to one consumer thread.
+// Double buffering - one slot being written, one being read - plus a spare
+// that holds the newest complete state, so neither side ever waits for the
+// other to finish with a slot: publish() and acquire() only swap indices.
+// States the consumer did not get to in time are overwritten, never queued.
+template <class T>
+class SnapshotExchange
+{
+public:
+    // producer: the slot to fill, then publish() it
+    T &back() { return m_slots[m_back]; }
+    void publish()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::swap(m_back, m_ready);
+        m_fresh = true;
+    }
+
+    // consumer: switches front() to the newest published state, if there is
+    // one it has not seen; front() stays valid until the next acquire()
+    bool acquire()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_fresh)
+            return false;
+        std::swap(m_front, m_ready);
+        m_fresh = false;
+        return true;
+    }
+    const T &front() const { return m_slots[m_front]; }
+
+private:
+    std::array<T, 3> m_slots;
+    int m_back = 0, m_ready = 1, m_front = 2;
+    bool m_fresh = false;
+    std::mutex m_mutex;
+};
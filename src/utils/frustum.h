@@ -0,0 +1,92 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <limits>
+
+// Axis-aligned bounding box
+struct AABB
+{
+    glm::vec3 min{0.f};
+    glm::vec3 max{0.f};
+
+    // bounds of this box after an affine transform (8-corner form)
+    AABB transformed(const glm::mat4 &M) const
+    {
+        AABB out;
+        out.min = glm::vec3(std::numeric_limits<float>::max());
+        out.max = glm::vec3(-std::numeric_limits<float>::max());
+        for (int i = 0; i < 8; ++i)
+        {
+            glm::vec3 c((i & 1) ? max.x : min.x,
+                        (i & 2) ? max.y : min.y,
+                        (i & 4) ? max.z : min.z);
+            glm::vec3 w = glm::vec3(M * glm::vec4(c, 1.f));
+            out.min = glm::min(out.min, w);
+            out.max = glm::max(out.max, w);
+        }
+        return out;
+    }
+};
+
+// True if the box lies entirely on the negative side of plane (n, d): dot(n, p) + d < 0
+inline bool aabbOutsidePlane(const glm::vec4 &plane, const glm::vec3 &bmin, const glm::vec3 &bmax)
+{
+    // the corner furthest along the plane normal
+    glm::vec3 p(plane.x >= 0.f ? bmax.x : bmin.x,
+                plane.y >= 0.f ? bmax.y : bmin.y,
+                plane.z >= 0.f ? bmax.z : bmin.z);
+    return plane.x * p.x + plane.y * p.y + plane.z * p.z + plane.w < 0.f;
+}
+
+// View frustum as six inward-facing planes, extracted from a view-projection
+// matrix (Gribb/Hartmann). Works with any OpenGL-style projection, including
+// the oblique ones used by the water passes.
+struct Frustum
+{
+    glm::vec4 planes[6]; // left, right, bottom, top, near, far
+
+    static Frustum fromMatrix(const glm::mat4 &viewProj)
+    {
+        // rows of the (column-major) matrix
+        glm::vec4 r0(viewProj[0][0], viewProj[1][0], viewProj[2][0], viewProj[3][0]);
+        glm::vec4 r1(viewProj[0][1], viewProj[1][1], viewProj[2][1], viewProj[3][1]);
+        glm::vec4 r2(viewProj[0][2], viewProj[1][2], viewProj[2][2], viewProj[3][2]);
+        glm::vec4 r3(viewProj[0][3], viewProj[1][3], viewProj[2][3], viewProj[3][3]);
+
+        Frustum f;
+        f.planes[0] = r3 + r0;
+        f.planes[1] = r3 - r0;
+        f.planes[2] = r3 + r1;
+        f.planes[3] = r3 - r1;
+        f.planes[4] = r3 + r2;
+        f.planes[5] = r3 - r2;
+        for (glm::vec4 &p : f.planes)
+        {
+            float len = glm::length(glm::vec3(p));
+            if (len > 0.f)
+                p /= len;
+        }
+        return f;
+    }
+
+    bool intersects(const glm::vec3 &bmin, const glm::vec3 &bmax) const
+    {
+        for (const glm::vec4 &p : planes)
+        {
+            if (aabbOutsidePlane(p, bmin, bmax))
+                return false;
+        }
+        return true;
+    }
+    bool intersects(const AABB &b) const { return intersects(b.min, b.max); }
+
+    bool intersectsSphere(const glm::vec3 &c, float r) const
+    {
+        for (const glm::vec4 &p : planes)
+        {
+            if (glm::dot(glm::vec3(p), c) + p.w < -r)
+                return false;
+        }
+        return true;
+    }
+};
@@ -0,0 +1,151 @@
+#include "gl_handle.h"
+
+#include <cstdio>
+#include <deque>
+#include <vector>
+
+#include "gl_state.h"
+
+namespace GLResources
+{
+namespace
+{
+constexpr int KIND_COUNT = int(GLKind::Count);
+
+struct Retired
+{
+    GLKind kind;
+    GLuint name;
+};
+
+// names retired during one frame, deleted once its fence signals
+struct Batch
+{
+    GLsync fence = nullptr;
+    std::vector<Retired> names;
+};
+
+int s_live[KIND_COUNT] = {};
+std::vector<Retired> s_current; // retired since the last endFrame()
+std::deque<Batch> s_batches;    // oldest first
+int s_pending = 0;
+
+void destroy(const Retired &r)
+{
+    switch (r.kind)
+    {
+    case GLKind::Buffer:
+        glDeleteBuffers(1, &r.name);
+        break;
+    case GLKind::VertexArray:
+        glDeleteVertexArrays(1, &r.name);
+        glState.onVertexArrayDeleted(r.name);
+        break;
+    case GLKind::Texture:
+        glDeleteTextures(1, &r.name);
+        glState.onTextureDeleted(r.name);
+        break;
+    case GLKind::Framebuffer:
+        glDeleteFramebuffers(1, &r.name);
+        break;
+    default:
+        glDeleteProgram(r.name);
+        glState.onProgramDeleted(r.name);
+        break;
+    }
+    --s_live[int(r.kind)];
+    --s_pending;
+}
+
+void destroyBatch(Batch &b)
+{
+    for (const Retired &r : b.names)
+        destroy(r);
+    if (b.fence)
+        glDeleteSync(b.fence);
+}
+
+const char *shortName(GLKind kind)
+{
+    static const char *names[KIND_COUNT] = {"buf", "vao", "tex", "fbo", "prog"};
+    return names[int(kind)];
+}
+}
+
+void noteCreated(GLKind kind)
+{
+    ++s_live[int(kind)];
+}
+
+void retire(GLKind kind, GLuint name)
+{
+    if (!name)
+        return;
+    s_current.push_back({kind, name});
+    ++s_pending;
+}
+
+void endFrame()
+{
+    if (!s_current.empty())
+    {
+        Batch b;
+        b.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        b.names.swap(s_current);
+        s_batches.push_back(std::move(b));
+    }
+
+    // fences signal in order: stop at the first one still pending (never waits)
+    while (!s_batches.empty())
+    {
+        Batch &b = s_batches.front();
+        GLenum status = glClientWaitSync(b.fence, 0, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+            break;
+        destroyBatch(b);
+        s_batches.pop_front();
+    }
+}
+
+void flush()
+{
+    for (Batch &b : s_batches)
+        destroyBatch(b);
+    s_batches.clear();
+    Batch rest;
+    rest.names.swap(s_current);
+    destroyBatch(rest);
+}
+
+int live(GLKind kind)
+{
+    return s_live[int(kind)];
+}
+
+int pendingDeletes()
+{
+    return s_pending;
+}
+
+std::string summary()
+{
+    char buf[160];
+    std::snprintf(buf, sizeof(buf), "gl: %d buf / %d vao / %d tex / %d fbo / %d prog (%d pending delete)",
+                  s_live[0], s_live[1], s_live[2], s_live[3], s_live[4], s_pending);
+    return buf;
+}
+
+std::string leakReport()
+{
+    std::string out;
+    char buf[32];
+    for (int k = 0; k < KIND_COUNT; ++k)
+    {
+        if (s_live[k] == 0)
+            continue;
+        std::snprintf(buf, sizeof(buf), "%s%d %s", out.empty() ? "" : ", ", s_live[k], shortName(GLKind(k)));
+        out += buf;
+    }
+    return out.empty() ? out : "leaked: " + out;
+}
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <string>
+#include <utility>
+
+// Move-only owners for GL object names. Dropping a handle (destructor,
+// reset() or move-assignment) does not delete the object straight away: the
+// name goes to a deletion queue that GLResources::endFrame() drains once a
+// fence shows the GPU has finished every frame that could still use it, so a
+// release never waits on in-flight work.
+//
+// Every handle is counted per kind while it is alive; after teardown
+// GLResources::leakReport() lists whatever is left. GL thread only.
+
+enum class GLKind
+{
+    Buffer,
+    VertexArray,
+    Texture,
+    Framebuffer,
+    Program,
+    Count
+};
+
+namespace GLResources
+{
+// queue a name for deletion after the current frame (0 is ignored)
+void retire(GLKind kind, GLuint name);
+
+// once per frame, after the frame's commands: fence this frame's
+// retirements and delete the batches whose fence has signalled
+void endFrame();
+
+// delete every queued name now (shutdown, with the context current)
+void flush();
+
+int live(GLKind kind);
+int pendingDeletes();
+
+// "gl: 12 buf / 5 vao / ..." for the stats overlay
+std::string summary();
+
+// non-empty when handles are still alive, e.g. "leaked: 2 buf, 1 tex"
+std::string leakReport();
+
+// internal
+void noteCreated(GLKind kind);
+}
+
+template <GLKind K>
+class GLHandle
+{
+public:
+    GLHandle() = default;
+    ~GLHandle() { reset(); }
+
+    GLHandle(GLHandle &&o) noexcept : m_name(std::exchange(o.m_name, 0)) {}
+    GLHandle &operator=(GLHandle &&o) noexcept
+    {
+        if (this != &o)
+        {
+            reset();
+            m_name = std::exchange(o.m_name, 0);
+        }
+        return *this;
+    }
+    GLHandle(const GLHandle &) = delete;
+    GLHandle &operator=(const GLHandle &) = delete;
+
+    static GLHandle create();
+
+    // take ownership of a name made elsewhere (shader loader, LUT utils)
+    static GLHandle adopt(GLuint name)
+    {
+        GLHandle h;
+        h.m_name = name;
+        if (name)
+            GLResources::noteCreated(K);
+        return h;
+    }
+
+    GLuint get() const { return m_name; }
+    operator GLuint() const { return m_name; }
+
+    void reset()
+    {
+        if (m_name)
+            GLResources::retire(K, std::exchange(m_name, 0));
+    }
+
+private:
+    GLuint m_name = 0;
+};
+
+using GLBuffer = GLHandle<GLKind::Buffer>;
+using GLVertexArray = GLHandle<GLKind::VertexArray>;
+using GLTexture = GLHandle<GLKind::Texture>;
+using GLFramebuffer = GLHandle<GLKind::Framebuffer>;
+using GLProgram = GLHandle<GLKind::Program>;
+
+template <GLKind K>
+GLHandle<K> GLHandle<K>::create()
+{
+    GLuint name = 0;
+    if constexpr (K == GLKind::Buffer)
+        glGenBuffers(1, &name);
+    else if constexpr (K == GLKind::VertexArray)
+        glGenVertexArrays(1, &name);
+    else if constexpr (K == GLKind::Texture)
+        glGenTextures(1, &name);
+    else if constexpr (K == GLKind::Framebuffer)
+        glGenFramebuffers(1, &name);
+    else
+        name = glCreateProgram();
+    return adopt(name);
+}
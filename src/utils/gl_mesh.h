@@ -2,6 +2,10 @@
 #include <GL/glew.h>
 #include <vector>
 #include <cstddef>
+#include "gl_handle.h"
+#include "gl_state.h"
+#include "mesh_optimizer.h"
+#include "render_stats.h"
 
 // Interleaved vertex: position(3) + normal(3)
 // fitting our lab8 tessellation design
@@ -10,21 +14,34 @@ struct GLVertexPN {
     GLfloat nx, ny, nz;   // normal
 };
 
+// Move-only; re-uploading or destroying retires the old buffers through the
+// deferred deletion queue (gl_handle.h).
 struct GLMesh{
-    GLuint vao = 0, vbo = 0;
+    GLVertexArray vao;
+    GLBuffer vbo;
+    GLBuffer ebo;             // only for meshes uploaded with uploadIndexedPN
     GLsizei vertexCount =0;
+    GLsizei indexCount =0;    // 0: non-indexed, draw vertexCount vertices
+    GLenum indexType = GL_UNSIGNED_INT;
+
+    // vertices (or indices) one draw call submits
+    GLsizei elementCount() const { return indexCount ? indexCount : vertexCount; }
 
     //upload interleaved float array [px, py, pz, nx, ny, ...]
     void uploadinterleavedPN(const std::vector<float> & interlPN){
-        if (vao || vbo) destroy();
-        glGenVertexArrays(1, &vao);
-        glBindVertexArray(vao);
+        uploadinterleavedPN(interlPN.data(), interlPN.size() / 6);
+    }
+
+    void uploadinterleavedPN(const float * interlPN, std::size_t count){
+        if (vao || vbo || ebo) destroy();
+        vao = GLVertexArray::create();
+        glState.bindVertexArray(vao);
 
-        glGenBuffers(1, &vbo);
+        vbo = GLBuffer::create();
         glBindBuffer(GL_ARRAY_BUFFER, vbo);
-        glBufferData(GL_ARRAY_BUFFER,
-                     interlPN.size()*sizeof(GLfloat),
-                     interlPN.data(), GL_STATIC_DRAW);
+        statBufferData(GL_ARRAY_BUFFER,
+                       count*sizeof(GLVertexPN),
+                       interlPN, GL_STATIC_DRAW);
 
         const GLsizei stride = sizeof(GLVertexPN); // 6 floats (24B)
 
@@ -36,21 +53,52 @@ struct GLMesh{
         glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride,
                               reinterpret_cast<void*>(offsetof(GLVertexPN, nx)));
 
-        glBindVertexArray(0);
-        vertexCount = static_cast<GLsizei>(interlPN.size() / 6);
+        glState.bindVertexArray(0);
+        vertexCount = static_cast<GLsizei>(count);
+    }
+
+    //upload a welded PN mesh (shapes' generateIndexedShape); the element
+    //buffer is VAO state, so draws need nothing extra bound
+    void uploadIndexedPN(const IndexedMesh & mesh){
+        if (mesh.vertexCount() <= 0xFFFF) {
+            // primitives stay well under 64k vertices: half the index bytes
+            std::vector<GLushort> shortIdx(mesh.indices.begin(), mesh.indices.end());
+            uploadIndexedPN(mesh.vertices.data(), mesh.vertexCount(), shortIdx.data(), shortIdx.size());
+            return;
+        }
+        uploadinterleavedPN(mesh.vertices.data(), mesh.vertexCount());
+        uploadIndices(mesh.indices.data(), mesh.indices.size()*sizeof(GLuint), GL_UNSIGNED_INT);
+        indexCount = static_cast<GLsizei>(mesh.indices.size());
+    }
+
+    //straight from static arrays (shapes/primitive_tables.h)
+    void uploadIndexedPN(const float * interlPN, std::size_t count,
+                         const GLushort * indices, std::size_t nIndices){
+        uploadinterleavedPN(interlPN, count);
+        uploadIndices(indices, nIndices*sizeof(GLushort), GL_UNSIGNED_SHORT);
+        indexCount = static_cast<GLsizei>(nIndices);
+    }
+
+    void uploadIndices(const void * indices, std::size_t bytes, GLenum type){
+        glState.bindVertexArray(vao);
+        ebo = GLBuffer::create();
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+        statBufferData(GL_ELEMENT_ARRAY_BUFFER, bytes, indices, GL_STATIC_DRAW);
+        glState.bindVertexArray(0);
+        indexType = type;
     }
 
     //upload interleaved float array [px, py, pz, nx, ny, cr, cg, cb]  for voxel terrian generation
     void uploadinterleavedPNC(const std::vector<float> & interlPNC){
-        if (vao || vbo) destroy();
-        glGenVertexArrays(1, &vao);
-        glBindVertexArray(vao);
+        if (vao || vbo || ebo) destroy();
+        vao = GLVertexArray::create();
+        glState.bindVertexArray(vao);
 
-        glGenBuffers(1, &vbo);
+        vbo = GLBuffer::create();
         glBindBuffer(GL_ARRAY_BUFFER, vbo);
-        glBufferData(GL_ARRAY_BUFFER,
-                     interlPNC.size()*sizeof(GLfloat),
-                     interlPNC.data(), GL_STATIC_DRAW);
+        statBufferData(GL_ARRAY_BUFFER,
+                       interlPNC.size()*sizeof(GLfloat),
+                       interlPNC.data(), GL_STATIC_DRAW);
 
         const GLsizei stride = 9 * sizeof(GLfloat); // 9 floats (36B)
 
@@ -63,28 +111,41 @@ struct GLMesh{
         glEnableVertexAttribArray(2); // a_col
         glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, stride, (void*)(6*sizeof(GLfloat)));
 
-        glBindVertexArray(0);
+        glState.bindVertexArray(0);
         vertexCount = static_cast<GLsizei>(interlPNC.size() / 9);
     }
 
     void draw() const {
-        glBindVertexArray(vao);
-        glDrawArrays(GL_TRIANGLES, 0, vertexCount);
-        glBindVertexArray(0);
+        renderStats.draw(GL_TRIANGLES, elementCount());
+        glState.bindVertexArray(vao);
+        if (indexCount)
+            glDrawElements(GL_TRIANGLES, indexCount, indexType, nullptr);
+        else
+            glDrawArrays(GL_TRIANGLES, 0, vertexCount);
     }
 
     void drawInstanced(GLsizei instanceCount) const {
         if (instanceCount <= 0) return;
-        glBindVertexArray(vao);
-        glDrawArraysInstanced(GL_TRIANGLES, 0, vertexCount, instanceCount);
-        glBindVertexArray(0);
+        glState.bindVertexArray(vao);
+        submitInstanced(instanceCount);
+    }
+
+    //the draw call alone, for callers that already bound vao and changed
+    //its instance attributes (Realtime::drawInstanceRuns)
+    void submitInstanced(GLsizei instanceCount) const {
+        renderStats.draw(GL_TRIANGLES, elementCount(), instanceCount);
+        if (indexCount)
+            glDrawElementsInstanced(GL_TRIANGLES, indexCount, indexType, nullptr, instanceCount);
+        else
+            glDrawArraysInstanced(GL_TRIANGLES, 0, vertexCount, instanceCount);
     }
 
     void destroy() {
-        if(vbo) glDeleteBuffers(1, &vbo);
-        if (vao) glDeleteVertexArrays(1, &vao);
-        vao = vbo = 0;
+        ebo.reset();
+        vbo.reset();
+        vao.reset();
         vertexCount = 0;
+        indexCount = 0;
     }
 };
 
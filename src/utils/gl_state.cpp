@@ -0,0 +1,191 @@
+#include "gl_state.h"
+
+#include "render_stats.h"
+
+GLStateCache glState;
+
+void GLStateCache::invalidate()
+{
+    m_program = UNKNOWN;
+    m_vao = UNKNOWN;
+    m_activeUnit = UNKNOWN;
+    for (auto &unit : m_textures)
+        for (GLuint &tex : unit)
+            tex = UNKNOWN;
+    m_blend = m_depthTest = m_cull = m_depthMask = UNKNOWN_FLAG;
+    m_depthFunc = m_blendSrc = m_blendDst = m_cullFace = UNKNOWN;
+}
+
+void GLStateCache::useProgram(GLuint program)
+{
+    if (program == m_program)
+    {
+        renderStats.redundantState();
+        return;
+    }
+    m_program = program;
+    renderStats.stateChange();
+    glUseProgram(program);
+}
+
+void GLStateCache::bindVertexArray(GLuint vao)
+{
+    if (vao == m_vao)
+    {
+        renderStats.redundantState();
+        return;
+    }
+    m_vao = vao;
+    renderStats.stateChange();
+    glBindVertexArray(vao);
+}
+
+void GLStateCache::activeTexture(GLenum unit)
+{
+    if (unit == m_activeUnit)
+    {
+        renderStats.redundantState();
+        return;
+    }
+    m_activeUnit = unit;
+    renderStats.stateChange();
+    glActiveTexture(unit);
+}
+
+int GLStateCache::targetSlot(GLenum target)
+{
+    switch (target)
+    {
+    case GL_TEXTURE_2D:
+        return 0;
+    case GL_TEXTURE_3D:
+        return 1;
+    case GL_TEXTURE_CUBE_MAP:
+        return 2;
+    default:
+        return -1;
+    }
+}
+
+void GLStateCache::bindTexture(GLenum target, GLuint tex)
+{
+    int slot = targetSlot(target);
+    int unit = m_activeUnit == UNKNOWN ? -1 : int(m_activeUnit - GL_TEXTURE0);
+    GLuint *cached = (slot >= 0 && unit >= 0 && unit < MAX_UNITS) ? &m_textures[unit][slot] : nullptr;
+    if (cached && *cached == tex)
+    {
+        renderStats.redundantState();
+        return;
+    }
+    if (cached)
+        *cached = tex;
+    renderStats.textureBind();
+    glBindTexture(target, tex);
+}
+
+void GLStateCache::setCap(GLenum cap, bool on)
+{
+    std::int8_t *cached = nullptr;
+    switch (cap)
+    {
+    case GL_BLEND:
+        cached = &m_blend;
+        break;
+    case GL_DEPTH_TEST:
+        cached = &m_depthTest;
+        break;
+    case GL_CULL_FACE:
+        cached = &m_cull;
+        break;
+    default:
+        break;
+    }
+
+    if (cached && *cached == std::int8_t(on))
+    {
+        renderStats.redundantState();
+        return;
+    }
+    if (cached)
+        *cached = std::int8_t(on);
+    renderStats.stateChange();
+    if (on)
+        glEnable(cap);
+    else
+        glDisable(cap);
+}
+
+void GLStateCache::depthMask(GLboolean write)
+{
+    if (m_depthMask == std::int8_t(write ? 1 : 0))
+    {
+        renderStats.redundantState();
+        return;
+    }
+    m_depthMask = std::int8_t(write ? 1 : 0);
+    renderStats.stateChange();
+    glDepthMask(write);
+}
+
+void GLStateCache::depthFunc(GLenum func)
+{
+    if (func == m_depthFunc)
+    {
+        renderStats.redundantState();
+        return;
+    }
+    m_depthFunc = func;
+    renderStats.stateChange();
+    glDepthFunc(func);
+}
+
+void GLStateCache::blendFunc(GLenum src, GLenum dst)
+{
+    if (src == m_blendSrc && dst == m_blendDst)
+    {
+        renderStats.redundantState();
+        return;
+    }
+    m_blendSrc = src;
+    m_blendDst = dst;
+    renderStats.stateChange();
+    glBlendFunc(src, dst);
+}
+
+void GLStateCache::cullFace(GLenum face)
+{
+    if (face == m_cullFace)
+    {
+        renderStats.redundantState();
+        return;
+    }
+    m_cullFace = face;
+    renderStats.stateChange();
+    glCullFace(face);
+}
+
+void GLStateCache::onProgramDeleted(GLuint program)
+{
+    // a program still in use stays current until replaced; just stop trusting it
+    if (program == m_program)
+        m_program = UNKNOWN;
+}
+
+void GLStateCache::onVertexArrayDeleted(GLuint vao)
+{
+    if (vao == m_vao)
+        m_vao = 0;
+}
+
+void GLStateCache::onTextureDeleted(GLuint tex)
+{
+    for (auto &unit : m_textures)
+        for (GLuint &bound : unit)
+            if (bound == tex)
+                bound = 0;
+}
+
+void statBindTexture(GLenum target, GLuint tex)
+{
+    glState.bindTexture(target, tex);
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <cstdint>
+
+// Shadow copy of the binding and fixed-function state the renderer changes
+// per draw: program, VAO, texture units, blend, depth and cull. Calls that
+// would leave the state as it is are skipped and counted in renderStats
+// (redundantState), the ones issued count as stateChanges / textureBinds.
+//
+// The cache is only right while every change to that state goes through it.
+// Qt uses the context between our frames, so invalidate() runs at the start
+// of paintGL and after each makeCurrent(); the first call of every kind after
+// that is always issued. GL thread only.
+class GLStateCache
+{
+public:
+    static constexpr int MAX_UNITS = 32;
+
+    GLStateCache() { invalidate(); }
+    void invalidate();
+
+    void useProgram(GLuint program);
+    void bindVertexArray(GLuint vao);
+    void activeTexture(GLenum unit); // GL_TEXTURE0 + i
+    void bindTexture(GLenum target, GLuint tex); // on the active unit
+
+    void enable(GLenum cap) { setCap(cap, true); }
+    void disable(GLenum cap) { setCap(cap, false); }
+    void depthMask(GLboolean write);
+    void depthFunc(GLenum func);
+    void blendFunc(GLenum src, GLenum dst);
+    void cullFace(GLenum face);
+
+    // a deleted object is unbound by GL; keep the shadow in step so a
+    // recycled name is bound again (called by the deletion queue)
+    void onProgramDeleted(GLuint program);
+    void onVertexArrayDeleted(GLuint vao);
+    void onTextureDeleted(GLuint tex);
+
+private:
+    static constexpr GLuint UNKNOWN = 0xFFFFFFFFu;
+    static constexpr std::int8_t UNKNOWN_FLAG = -1;
+
+    // GL_BLEND, GL_DEPTH_TEST and GL_CULL_FACE are cached; other caps pass through
+    void setCap(GLenum cap, bool on);
+    static int targetSlot(GLenum target); // -1 for targets that are not cached
+
+    GLuint m_program = UNKNOWN;
+    GLuint m_vao = UNKNOWN;
+    GLenum m_activeUnit = UNKNOWN;
+    GLuint m_textures[MAX_UNITS][3]; // 2D, 3D, cube map
+    std::int8_t m_blend = UNKNOWN_FLAG;
+    std::int8_t m_depthTest = UNKNOWN_FLAG;
+    std::int8_t m_cull = UNKNOWN_FLAG;
+    std::int8_t m_depthMask = UNKNOWN_FLAG;
+    GLenum m_depthFunc = UNKNOWN;
+    GLenum m_blendSrc = UNKNOWN;
+    GLenum m_blendDst = UNKNOWN;
+    GLenum m_cullFace = UNKNOWN;
+};
+
+// the global cache for the one GL context (like `renderStats`)
+extern GLStateCache glState;
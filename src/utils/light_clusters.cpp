@@ -0,0 +1,121 @@
+#include "light_clusters.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "utils/parallel.h"
+#include "utils/trace.h"
+
+namespace
+{
+constexpr float UNBOUNDED_RADIUS = 1e18f; // r * r still fits a float
+
+// tile range [first, last] covered by the normalised-device interval [lo, hi]
+void tileRange(float lo, float hi, int tiles, int &first, int &last)
+{
+    auto tile = [tiles](float ndc)
+    { return int(std::clamp((ndc * 0.5f + 0.5f) * tiles, 0.f, float(tiles - 1))); };
+    first = tile(lo);
+    last = tile(hi);
+}
+}
+
+float lightInfluenceRadius(const glm::vec3 &atten, const glm::vec3 &color, float cutoff)
+{
+    float peak = std::max(color.r, std::max(color.g, color.b));
+    if (peak <= 0.f || peak < cutoff)
+        return 0.f;
+
+    // solve q d^2 + l d + c = peak / cutoff for the positive d
+    float k = peak / cutoff;
+    float c = atten.x, l = atten.y, q = atten.z;
+    if (c >= k)
+        return 0.f;
+    if (q > 1e-6f)
+        return (-l + std::sqrt(l * l - 4.f * q * (c - k))) / (2.f * q);
+    if (l > 1e-6f)
+        return (k - c) / l;
+    return UNBOUNDED_RADIUS;
+}
+
+void LightClusterGrid::build(const std::vector<ClusterLight> &lights, const glm::mat4 &view, float fovy,
+                             float aspect, float nearP, float farP)
+{
+    TRACE_SCOPE("light clusters");
+    m_cells.resize(CLUSTER_COUNT);
+
+    const float logRatio = std::log(farP / nearP);
+    m_zScale = SLICES / logRatio;
+    m_zBias = SLICES * std::log(nearP) / logRatio;
+    const float tanY = std::tan(0.5f * fovy);
+    const float tanX = tanY * aspect;
+
+    // view-space bounding spheres, shared by every slice
+    std::vector<glm::vec4> spheres(lights.size());
+    for (std::size_t i = 0; i < lights.size(); ++i)
+    {
+        glm::vec4 c = view * glm::vec4(glm::vec3(lights[i].posType), 1.f);
+        spheres[i] = glm::vec4(glm::vec3(c), std::min(lights[i].dirRadius.w, UNBOUNDED_RADIUS));
+    }
+
+    // one slice per task: each writes only its own clusters
+    parallelForPooled(0, SLICES, [&](int s)
+    {
+        const float dA = nearP * std::exp(float(s) / m_zScale);
+        const float dB = nearP * std::exp(float(s + 1) / m_zScale);
+        std::vector<std::uint32_t> *slice = m_cells.data() + s * TILES_X * TILES_Y;
+        for (int t = 0; t < TILES_X * TILES_Y; ++t)
+            slice[t].clear();
+
+        for (std::size_t i = 0; i < spheres.size(); ++i)
+        {
+            const glm::vec3 c(spheres[i]);
+            const float r = spheres[i].w;
+            const float e0 = std::max(dA, -c.z - r);
+            const float e1 = std::min(dB, -c.z + r);
+            if (e0 > e1)
+                continue;
+
+            // screen extent of the sphere's box over [e0, e1]: x / depth is
+            // extremal at one of the two depths
+            float xLo = (c.x - r) / ((c.x - r < 0.f ? e0 : e1) * tanX);
+            float xHi = (c.x + r) / ((c.x + r > 0.f ? e0 : e1) * tanX);
+            float yLo = (c.y - r) / ((c.y - r < 0.f ? e0 : e1) * tanY);
+            float yHi = (c.y + r) / ((c.y + r > 0.f ? e0 : e1) * tanY);
+            if (xHi < -1.f || xLo > 1.f || yHi < -1.f || yLo > 1.f)
+                continue;
+            int x0, x1, y0, y1;
+            tileRange(xLo, xHi, TILES_X, x0, x1);
+            tileRange(yLo, yHi, TILES_Y, y0, y1);
+
+            // refine against each froxel's view-space box
+            for (int y = y0; y <= y1; ++y)
+            {
+                float ny0 = -1.f + 2.f * y / TILES_Y, ny1 = -1.f + 2.f * (y + 1) / TILES_Y;
+                float yMin = std::min(ny0 * dA, ny0 * dB) * tanY;
+                float yMax = std::max(ny1 * dA, ny1 * dB) * tanY;
+                for (int x = x0; x <= x1; ++x)
+                {
+                    float nx0 = -1.f + 2.f * x / TILES_X, nx1 = -1.f + 2.f * (x + 1) / TILES_X;
+                    glm::vec3 bmin(std::min(nx0 * dA, nx0 * dB) * tanX, yMin, -dB);
+                    glm::vec3 bmax(std::max(nx1 * dA, nx1 * dB) * tanX, yMax, -dA);
+                    glm::vec3 d = glm::clamp(c, bmin, bmax) - c;
+                    if (glm::dot(d, d) <= r * r)
+                        slice[x + TILES_X * y].push_back(std::uint32_t(i));
+                }
+            }
+        }
+    }, 4);
+
+    // (offset, count) table, then the lists back to back
+    m_gpuData.assign(2 * CLUSTER_COUNT, 0u);
+    m_maxPerCluster = 0;
+    for (int c = 0; c < CLUSTER_COUNT; ++c)
+    {
+        const std::vector<std::uint32_t> &cell = m_cells[c];
+        m_gpuData[2 * c] = std::uint32_t(m_gpuData.size());
+        m_gpuData[2 * c + 1] = std::uint32_t(cell.size());
+        m_gpuData.insert(m_gpuData.end(), cell.begin(), cell.end());
+        m_maxPerCluster = std::max(m_maxPerCluster, int(cell.size()));
+    }
+}
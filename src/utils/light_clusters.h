@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// Clustered forward lighting for scene-file point and spot lights. The view
+// frustum is cut into TILES_X x TILES_Y screen tiles and SLICES depth slices
+// (exponential in view depth, so clusters stay roughly cube-shaped); each
+// frame build() lists, per cluster, the lights whose bounding sphere reaches
+// it. Shaders (resources/shaders/clustered_lights.glsl) then only loop over
+// the lights of the fragment's own cluster.
+//
+// Spot lights are bounded by their full sphere, not the cone: a few extra
+// clusters each, but no per-cone math on the CPU.
+
+// One light as the shaders read it: four vec4s, std140-compatible, so an
+// array of these is the ClusterLights uniform block as-is. World space.
+struct ClusterLight
+{
+    glm::vec4 posType;       // position, w = 0 point / 1 spot
+    glm::vec4 colorAngle;    // rgb, w = spot outer half-angle (radians)
+    glm::vec4 attenPenumbra; // constant, linear, quadratic; w = spot penumbra
+    glm::vec4 dirRadius;     // spot direction (away from the light), w = influence radius
+};
+
+// Distance past which min(1, 1 / (c + l d + q d^2)) * max(color) drops below
+// cutoff; a huge finite value for lights that never fall off.
+float lightInfluenceRadius(const glm::vec3 &atten, const glm::vec3 &color, float cutoff = 1.f / 256.f);
+
+class LightClusterGrid
+{
+public:
+    static constexpr int TILES_X = 16;
+    static constexpr int TILES_Y = 9;
+    static constexpr int SLICES = 24;
+    static constexpr int CLUSTER_COUNT = TILES_X * TILES_Y * SLICES;
+
+    // Assign lights to the clusters of a symmetric perspective camera
+    // (fovy in radians, aspect = width / height). Slices run in parallel.
+    void build(const std::vector<ClusterLight> &lights, const glm::mat4 &view, float fovy, float aspect,
+               float nearP, float farP);
+
+    // What the shaders fetch: (offset, count) per cluster, cluster
+    // x + TILES_X * (y + TILES_Y * slice), then the light index lists the
+    // offsets point at. Offsets index this same array.
+    const std::vector<std::uint32_t> &gpuData() const { return m_gpuData; }
+
+    // slice = log(depth) * zScale() - zBias(), as in clustered_lights.glsl
+    float zScale() const { return m_zScale; }
+    float zBias() const { return m_zBias; }
+
+    int maxLightsPerCluster() const { return m_maxPerCluster; }
+    std::size_t lightReferences() const { return m_gpuData.size() - 2 * CLUSTER_COUNT; }
+
+private:
+    std::vector<std::vector<std::uint32_t>> m_cells; // light list per cluster, kept for its capacity
+    std::vector<std::uint32_t> m_gpuData;
+    float m_zScale = 0.f;
+    float m_zBias = 0.f;
+    int m_maxPerCluster = 0;
+};
@@ -0,0 +1,177 @@
+#include "mem_tracker.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+namespace MemTracker
+{
+namespace
+{
+struct Counters
+{
+    std::atomic<std::int64_t> current{0};
+    std::atomic<std::int64_t> peak{0};
+    std::atomic<std::uint64_t> allocations{0};
+    std::atomic<std::int64_t> live{0};
+};
+
+// constant-initialised: usable by allocations made during static init
+Counters s_tags[TagCount];
+Counters s_total;
+thread_local Tag t_tag = Untagged;
+
+#if MEM_TRACKING_ENABLED
+void raisePeak(std::atomic<std::int64_t> &peak, std::int64_t value)
+{
+    std::int64_t seen = peak.load(std::memory_order_relaxed);
+    while (value > seen && !peak.compare_exchange_weak(seen, value, std::memory_order_relaxed))
+    {
+    }
+}
+
+void add(Counters &c, std::int64_t bytes)
+{
+    std::int64_t now = c.current.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    raisePeak(c.peak, now);
+    c.allocations.fetch_add(1, std::memory_order_relaxed);
+    c.live.fetch_add(1, std::memory_order_relaxed);
+}
+
+void remove(Counters &c, std::int64_t bytes)
+{
+    c.current.fetch_sub(bytes, std::memory_order_relaxed);
+    c.live.fetch_sub(1, std::memory_order_relaxed);
+}
+#endif
+
+TagStats read(const Counters &c)
+{
+    TagStats s;
+    s.currentBytes = c.current.load(std::memory_order_relaxed);
+    s.peakBytes = c.peak.load(std::memory_order_relaxed);
+    s.allocations = c.allocations.load(std::memory_order_relaxed);
+    s.liveAllocations = c.live.load(std::memory_order_relaxed);
+    return s;
+}
+
+void formatBytes(char *buf, std::size_t size, std::int64_t bytes)
+{
+    double b = double(bytes);
+    if (b >= 1024.0 * 1024.0)
+        std::snprintf(buf, size, "%.1f MB", b / (1024.0 * 1024.0));
+    else if (b >= 1024.0)
+        std::snprintf(buf, size, "%.1f KB", b / 1024.0);
+    else
+        std::snprintf(buf, size, "%lld B", (long long)bytes);
+}
+}
+
+#if MEM_TRACKING_ENABLED
+// In front of every block; 16 bytes keeps malloc's alignment for the caller.
+struct alignas(16) BlockHeader
+{
+    std::size_t size;
+    Tag tag;
+};
+static_assert(sizeof(BlockHeader) == 16, "header must preserve 16-byte alignment");
+
+void *allocate(std::size_t size)
+{
+    auto *h = static_cast<BlockHeader *>(std::malloc(sizeof(BlockHeader) + size));
+    if (!h)
+        return nullptr;
+    h->size = size;
+    h->tag = t_tag;
+    add(s_tags[h->tag], std::int64_t(size));
+    add(s_total, std::int64_t(size));
+    return h + 1;
+}
+
+void release(void *p)
+{
+    if (!p)
+        return;
+    BlockHeader *h = static_cast<BlockHeader *>(p) - 1;
+    remove(s_tags[h->tag], std::int64_t(h->size));
+    remove(s_total, std::int64_t(h->size));
+    std::free(h);
+}
+#endif
+
+const char *tagName(Tag tag)
+{
+    static const char *names[TagCount] = {"untagged", "terrain", "lsystem", "forest",
+                                          "rocks", "particles", "upload"};
+    return tag < TagCount ? names[tag] : "?";
+}
+
+bool enabled() { return MEM_TRACKING_ENABLED != 0; }
+
+TagStats stats(Tag tag) { return read(s_tags[tag < TagCount ? tag : Untagged]); }
+TagStats total() { return read(s_total); }
+
+void resetPeaks()
+{
+    for (Counters &c : s_tags)
+        c.peak.store(c.current.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    s_total.peak.store(s_total.current.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+std::string summary()
+{
+    if (!enabled())
+        return "memory tracking off";
+
+    std::string out = "heap (current / peak / allocs)\n";
+    char cur[32], peak[32], line[128];
+    for (int t = 0; t < TagCount; ++t)
+    {
+        TagStats s = stats(Tag(t));
+        if (s.allocations == 0)
+            continue;
+        formatBytes(cur, sizeof(cur), s.currentBytes);
+        formatBytes(peak, sizeof(peak), s.peakBytes);
+        std::snprintf(line, sizeof(line), "  %-9s %10s / %10s / %llu\n", tagName(Tag(t)), cur, peak,
+                      (unsigned long long)s.allocations);
+        out += line;
+    }
+    TagStats s = total();
+    formatBytes(cur, sizeof(cur), s.currentBytes);
+    formatBytes(peak, sizeof(peak), s.peakBytes);
+    std::snprintf(line, sizeof(line), "  %-9s %10s / %10s / %llu", "total", cur, peak,
+                  (unsigned long long)s.allocations);
+    out += line;
+    return out;
+}
+
+Tag currentTag() { return t_tag; }
+void setCurrentTag(Tag tag) { t_tag = tag; }
+}
+
+#if MEM_TRACKING_ENABLED
+// Global allocation hook. Over-aligned new/delete keep the default
+// implementation (they never reach these functions).
+void *operator new(std::size_t size)
+{
+    if (void *p = MemTracker::allocate(size))
+        return p;
+    throw std::bad_alloc();
+}
+void *operator new[](std::size_t size)
+{
+    if (void *p = MemTracker::allocate(size))
+        return p;
+    throw std::bad_alloc();
+}
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept { return MemTracker::allocate(size); }
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept { return MemTracker::allocate(size); }
+
+void operator delete(void *p) noexcept { MemTracker::release(p); }
+void operator delete[](void *p) noexcept { MemTracker::release(p); }
+void operator delete(void *p, std::size_t) noexcept { MemTracker::release(p); }
+void operator delete[](void *p, std::size_t) noexcept { MemTracker::release(p); }
+void operator delete(void *p, const std::nothrow_t &) noexcept { MemTracker::release(p); }
+void operator delete[](void *p, const std::nothrow_t &) noexcept { MemTracker::release(p); }
+#endif
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Heap accounting by subsystem. Global operator new/delete are replaced (in
+// mem_tracker.cpp) to stamp every allocation with the calling thread's current
+// tag; MemTagScope sets that tag for a scope. Frees are charged back to the tag
+// the block was allocated under, wherever they happen. malloc and memory owned
+// by the driver are not seen.
+//
+// Every allocation then pays for a header and shared atomic counters, so it
+// is opt-in: configure with -DENABLE_MEMORY_TRACKING=ON. Otherwise the default
+// allocator stays, scopes compile to nothing and every counter reads zero.
+
+#ifndef MEM_TRACKING_ENABLED
+#define MEM_TRACKING_ENABLED 0
+#endif
+
+namespace MemTracker
+{
+enum Tag : std::uint8_t
+{
+    Untagged,
+    Terrain,    // terrain meshes, height fields
+    LSystem,    // per-tree strings and turtle output while a tree grows
+    Forest,     // flattened branch / leaf instances
+    Rocks,
+    Particles,
+    Upload,     // temporary CPU copies made only to feed glBufferData
+    TagCount
+};
+
+struct TagStats
+{
+    std::int64_t currentBytes = 0;
+    std::int64_t peakBytes = 0;
+    std::uint64_t allocations = 0; // total since start
+    std::int64_t liveAllocations = 0;
+};
+
+const char *tagName(Tag tag);
+bool enabled();
+
+TagStats stats(Tag tag);
+TagStats total(); // all tags; its peak is the peak of the sum, not a sum of peaks
+
+// peaks restart from the current values (e.g. before a rebuild or a benchmark)
+void resetPeaks();
+
+// multi-line "tag: current / peak / count" text, for the stats overlay
+std::string summary();
+
+Tag currentTag();
+void setCurrentTag(Tag tag);
+}
+
+class MemTagScope
+{
+public:
+#if MEM_TRACKING_ENABLED
+    explicit MemTagScope(MemTracker::Tag tag) : m_previous(MemTracker::currentTag())
+    {
+        MemTracker::setCurrentTag(tag);
+    }
+    ~MemTagScope() { MemTracker::setCurrentTag(m_previous); }
+#else
+    explicit MemTagScope(MemTracker::Tag) {}
+#endif
+    MemTagScope(const MemTagScope &) = delete;
+    MemTagScope &operator=(const MemTagScope &) = delete;
+
+private:
+#if MEM_TRACKING_ENABLED
+    MemTracker::Tag m_previous;
+#endif
+};
@@ -0,0 +1,82 @@
+#include "mesh_optimizer.h"
+
+#include <string_view>
+#include <unordered_map>
+
+IndexedMesh weldVertices(const std::vector<float> &soup, int floatsPerVertex)
+{
+    IndexedMesh mesh;
+    mesh.floatsPerVertex = floatsPerVertex;
+    if (floatsPerVertex <= 0)
+        return mesh;
+
+    const std::size_t stride = std::size_t(floatsPerVertex) * sizeof(float);
+    const std::size_t count = soup.size() / floatsPerVertex / 3 * 3;
+
+    // keyed on the raw bytes, so only exact copies merge
+    std::unordered_map<std::string_view, std::uint32_t> seen;
+    seen.reserve(count);
+    std::vector<std::uint32_t> remap(count);
+    for (std::size_t v = 0; v < count; ++v)
+    {
+        const float *src = soup.data() + v * floatsPerVertex;
+        std::string_view key(reinterpret_cast<const char *>(src), stride);
+        auto [it, inserted] = seen.emplace(key, std::uint32_t(mesh.vertexCount()));
+        if (inserted)
+            mesh.vertices.insert(mesh.vertices.end(), src, src + floatsPerVertex);
+        remap[v] = it->second;
+    }
+
+    mesh.indices.reserve(count);
+    for (std::size_t t = 0; t < count; t += 3)
+    {
+        std::uint32_t a = remap[t], b = remap[t + 1], c = remap[t + 2];
+        if (a == b || b == c || a == c)
+            continue;
+        mesh.indices.insert(mesh.indices.end(), {a, b, c});
+    }
+    return mesh;
+}
+
+void optimizeVertexCache(std::vector<std::uint32_t> &indices, std::size_t vertexCount)
+{
+    MeshOrder::vertexCache(indices.data(), indices.size(), vertexCount);
+}
+
+void optimizeVertexFetch(IndexedMesh &mesh)
+{
+    std::vector<float> vertices(mesh.vertices.size());
+    std::size_t used = MeshOrder::vertexFetch(mesh.indices.data(), mesh.indices.size(), mesh.vertices.data(),
+                                              vertices.data(), mesh.vertexCount(), mesh.floatsPerVertex);
+    vertices.resize(used * mesh.floatsPerVertex); // unreferenced vertices are dropped
+    mesh.vertices.swap(vertices);
+}
+
+float averageCacheMissRatio(const std::vector<std::uint32_t> &indices, std::size_t vertexCount,
+                            int cacheSize)
+{
+    if (indices.size() < 3)
+        return 0.f;
+
+    // FIFO: a hit does not refresh the entry, like the hardware caches
+    std::vector<std::size_t> insertedAt(vertexCount, 0);
+    std::size_t clock = 0, misses = 0;
+    for (std::uint32_t v : indices)
+    {
+        if (insertedAt[v] == 0 || clock - insertedAt[v] >= std::size_t(cacheSize))
+        {
+            ++clock;
+            insertedAt[v] = clock;
+            ++misses;
+        }
+    }
+    return float(misses) / float(indices.size() / 3);
+}
+
+IndexedMesh buildIndexedMesh(const std::vector<float> &soup, int floatsPerVertex)
+{
+    IndexedMesh mesh = weldVertices(soup, floatsPerVertex);
+    optimizeVertexCache(mesh.indices, mesh.vertexCount());
+    optimizeVertexFetch(mesh);
+    return mesh;
+}
@@ -0,0 +1,219 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "constexpr_math.h"
+
+// Indexed triangle lists for the primitive generators (shapes/*), which emit
+// non-indexed triangle soups. buildIndexedMesh() welds the soup, then
+// reorders the triangles for the post-transform vertex cache (Forsyth's
+// linear-speed algorithm) and the vertices for fetch locality.
+//
+// The reordering passes are constexpr templates (MeshOrder, below) so the
+// baked primitive tables (shapes/primitive_tables.cpp) run the same code at
+// compile time.
+//
+// There is no overdraw pass: the primitives are convex and drawn with back
+// faces culled, so no two visible triangles of one mesh ever overlap.
+
+struct IndexedMesh
+{
+    std::vector<float> vertices; // floatsPerVertex floats each
+    std::vector<std::uint32_t> indices;
+    int floatsPerVertex = 6;
+
+    std::size_t vertexCount() const { return floatsPerVertex ? vertices.size() / floatsPerVertex : 0; }
+};
+
+// Merge bit-identical vertices of a triangle soup. Triangles that collapse
+// (two corners welded together, e.g. at a sphere pole) are dropped.
+IndexedMesh weldVertices(const std::vector<float> &soup, int floatsPerVertex);
+
+// Reorder triangles (in place) so consecutive ones share cached vertices.
+void optimizeVertexCache(std::vector<std::uint32_t> &indices, std::size_t vertexCount);
+
+// Renumber vertices in first-use order so the fetches walk memory forward.
+void optimizeVertexFetch(IndexedMesh &mesh);
+
+// Average cache miss ratio: transformed vertices per triangle for a FIFO
+// post-transform cache of cacheSize entries (1.0 is about the best a
+// closed mesh gets, 3.0 is a soup).
+float averageCacheMissRatio(const std::vector<std::uint32_t> &indices, std::size_t vertexCount,
+                            int cacheSize = 16);
+
+// weld + optimizeVertexCache + optimizeVertexFetch
+IndexedMesh buildIndexedMesh(const std::vector<float> &soup, int floatsPerVertex = 6);
+
+namespace MeshOrder
+{
+namespace detail
+{
+// Forsyth's scoring constants ("Linear-Speed Vertex Cache Optimisation")
+constexpr int CACHE_SIZE = 32; // modelled LRU cache, larger than any real one
+constexpr float LAST_TRI_SCORE = 0.75f;
+constexpr float VALENCE_BOOST_SCALE = 2.0f;
+
+constexpr float vertexScore(int cachePos, int liveTris)
+{
+    if (liveTris == 0)
+        return -1.f; // nothing left to draw with this vertex
+
+    float score = 0.f;
+    if (cachePos >= 0)
+    {
+        if (cachePos < 3)
+            score = LAST_TRI_SCORE; // used by the last triangle: no gain from its exact slot
+        else
+        {
+            // (1 - x)^1.5, with x the normalised position past the last triangle
+            double d = 1.0 - double(cachePos - 3) / (CACHE_SIZE - 3);
+            score = float(d * cx::sqrt(d));
+        }
+    }
+    // favour vertices with few triangles left (valence^-0.5) so they are finished off
+    return score + VALENCE_BOOST_SCALE * float(1.0 / cx::sqrt(double(liveTris)));
+}
+}
+
+// Reorder the triangles of indices[0, indexCount) in place; see optimizeVertexCache()
+template <class Index>
+constexpr void vertexCache(Index *indices, std::size_t indexCount, std::size_t vertexCount)
+{
+    using detail::CACHE_SIZE;
+    const std::size_t triCount = indexCount / 3;
+    if (triCount < 2 || vertexCount == 0)
+        return;
+
+    // vertex -> triangles using it, as one flat array (CSR)
+    std::vector<int> liveTris(vertexCount, 0);
+    for (std::size_t i = 0; i < triCount * 3; ++i)
+        ++liveTris[indices[i]];
+    std::vector<std::size_t> adjStart(vertexCount + 1, 0);
+    for (std::size_t v = 0; v < vertexCount; ++v)
+        adjStart[v + 1] = adjStart[v] + liveTris[v];
+    std::vector<std::uint32_t> adj(triCount * 3);
+    {
+        std::vector<std::size_t> fill(adjStart.begin(), adjStart.end() - 1);
+        for (std::size_t t = 0; t < triCount; ++t)
+            for (int k = 0; k < 3; ++k)
+                adj[fill[indices[3 * t + k]]++] = std::uint32_t(t);
+    }
+
+    std::vector<int> cachePos(vertexCount, -1);
+    std::vector<float> vScore(vertexCount);
+    for (std::size_t v = 0; v < vertexCount; ++v)
+        vScore[v] = detail::vertexScore(-1, liveTris[v]);
+
+    std::vector<float> tScore(triCount);
+    std::vector<char> emitted(triCount, 0);
+    for (std::size_t t = 0; t < triCount; ++t)
+        tScore[t] = vScore[indices[3 * t]] + vScore[indices[3 * t + 1]] + vScore[indices[3 * t + 2]];
+
+    // drop an emitted triangle from a vertex's live list (kept at the front)
+    auto removeTri = [&](std::uint32_t v, std::uint32_t t)
+    {
+        std::uint32_t *begin = adj.data() + adjStart[v];
+        std::uint32_t *end = begin + liveTris[v];
+        std::uint32_t *it = std::find(begin, end, t);
+        std::swap(*it, *(end - 1));
+        --liveTris[v];
+    };
+
+    std::vector<Index> out;
+    out.reserve(triCount * 3);
+    std::vector<std::uint32_t> cache, next;
+    cache.reserve(CACHE_SIZE + 3);
+    next.reserve(CACHE_SIZE + 3);
+
+    std::size_t scanFrom = 0; // fallback cursor, only moves forward
+    auto bestOverall = [&]() -> long
+    {
+        long pick = -1;
+        float pickScore = -1.f;
+        while (scanFrom < triCount && emitted[scanFrom])
+            ++scanFrom;
+        for (std::size_t t = scanFrom; t < triCount; ++t)
+            if (!emitted[t] && tScore[t] > pickScore)
+            {
+                pickScore = tScore[t];
+                pick = long(t);
+            }
+        return pick;
+    };
+    long best = bestOverall();
+
+    while (best >= 0)
+    {
+        const std::uint32_t tri[3] = {std::uint32_t(indices[3 * best]), std::uint32_t(indices[3 * best + 1]),
+                                      std::uint32_t(indices[3 * best + 2])};
+        for (std::uint32_t v : tri)
+            out.push_back(Index(v));
+        emitted[best] = 1;
+        for (std::uint32_t v : tri)
+            removeTri(v, std::uint32_t(best));
+
+        // LRU update: the triangle's vertices move to the front
+        next.assign(tri, tri + 3);
+        for (std::uint32_t v : cache)
+            if (v != tri[0] && v != tri[1] && v != tri[2])
+                next.push_back(v);
+        for (std::size_t i = 0; i < next.size(); ++i)
+        {
+            cachePos[next[i]] = i < CACHE_SIZE ? int(i) : -1;
+            if (i >= CACHE_SIZE)
+                vScore[next[i]] = detail::vertexScore(-1, liveTris[next[i]]);
+        }
+        if (next.size() > CACHE_SIZE)
+            next.resize(CACHE_SIZE);
+        cache.swap(next);
+
+        // rescore what the cache touches and take the best of those
+        for (std::uint32_t v : cache)
+            vScore[v] = detail::vertexScore(cachePos[v], liveTris[v]);
+        best = -1;
+        float bestScore = -1.f;
+        for (std::uint32_t v : cache)
+            for (int i = 0; i < liveTris[v]; ++i)
+            {
+                std::uint32_t t = adj[adjStart[v] + i];
+                const Index *tv = indices + 3 * t;
+                tScore[t] = vScore[tv[0]] + vScore[tv[1]] + vScore[tv[2]];
+                if (tScore[t] > bestScore)
+                {
+                    bestScore = tScore[t];
+                    best = long(t);
+                }
+            }
+        if (best < 0)
+            best = bestOverall(); // cache exhausted: start a new region
+    }
+
+    std::copy(out.begin(), out.end(), indices);
+}
+
+// Copy the vertices of in (floatsPerVertex floats each) to out in first-use
+// order and renumber indices to match; returns how many were used.
+template <class Index>
+constexpr std::size_t vertexFetch(Index *indices, std::size_t indexCount, const float *in, float *out,
+                                  std::size_t vertexCount, int floatsPerVertex)
+{
+    constexpr std::uint32_t UNUSED = 0xFFFFFFFFu;
+    std::vector<std::uint32_t> remap(vertexCount, UNUSED);
+    std::uint32_t used = 0;
+    for (std::size_t i = 0; i < indexCount; ++i)
+    {
+        Index &idx = indices[i];
+        if (remap[idx] == UNUSED)
+        {
+            std::copy(in + std::size_t(idx) * floatsPerVertex, in + std::size_t(idx + 1) * floatsPerVertex,
+                      out + std::size_t(used) * floatsPerVertex);
+            remap[idx] = used++;
+        }
+        idx = Index(remap[idx]);
+    }
+    return used;
+}
+}
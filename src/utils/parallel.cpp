@@ -0,0 +1,108 @@
+#include "parallel.h"
+
+#include "utils/trace.h"
+
+WorkerPool &WorkerPool::shared()
+{
+    static WorkerPool pool(int(std::max(1u, std::thread::hardware_concurrency())) - 1);
+    return pool;
+}
+
+WorkerPool::WorkerPool(int workers)
+{
+    m_threads.reserve(std::max(0, workers));
+    for (int i = 0; i < workers; ++i)
+        m_threads.emplace_back(&WorkerPool::loop, this);
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_quit = true;
+    }
+    m_wake.notify_all();
+    for (std::thread &t : m_threads)
+        t.join();
+}
+
+void WorkerPool::run(int chunks, void (*chunk)(void *, int), void *ctx)
+{
+    if (chunks <= 0)
+        return;
+
+    std::lock_guard<std::mutex> submit(m_submit);
+    std::uint64_t job;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        job = ++m_job;
+        m_chunk = chunk;
+        m_ctx = ctx;
+        m_tag = MemTracker::currentTag();
+        m_chunks = chunks;
+        m_next = 0;
+        m_remaining = chunks;
+    }
+    m_wake.notify_all();
+
+    // the caller works too, then waits for chunks still running elsewhere
+    int t;
+    while (claim(job, t))
+    {
+        chunk(ctx, t);
+        finish();
+    }
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_done.wait(lock, [this] { return m_remaining == 0; });
+}
+
+bool WorkerPool::claim(std::uint64_t job, int &t)
+{
+    // checked against the job as well: a worker slow to notice the end of
+    // one job must not take chunks of the next with the old function
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_job != job || m_next >= m_chunks)
+        return false;
+    t = m_next++;
+    return true;
+}
+
+void WorkerPool::finish()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (--m_remaining == 0)
+        m_done.notify_all();
+}
+
+void WorkerPool::loop()
+{
+    Tracer::setThreadName("worker");
+    t_inParallelWorker = true;
+
+    std::uint64_t seen = 0;
+    while (true)
+    {
+        void (*chunk)(void *, int);
+        void *ctx;
+        MemTracker::Tag tag;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait(lock, [&] { return m_quit || m_job != seen; });
+            if (m_quit)
+                return;
+            seen = m_job;
+            chunk = m_chunk;
+            ctx = m_ctx;
+            tag = m_tag;
+        }
+
+        MemTagScope memTag(tag);
+        int t;
+        while (claim(seen, t))
+        {
+            chunk(ctx, t);
+            finish();
+        }
+    }
+}
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "utils/mem_tracker.h"
+
+// true while the current thread is already one of several workers; nested
+// parallelFor calls then run inline instead of oversubscribing the cores
+inline thread_local bool t_inParallelWorker = false;
+
+// Marks the current thread as a worker for its lifetime (e.g. a batch job
+// thread that owns one core).
+struct ParallelWorkerScope
+{
+    bool previous;
+    ParallelWorkerScope() : previous(t_inParallelWorker) { t_inParallelWorker = true; }
+    ~ParallelWorkerScope() { t_inParallelWorker = previous; }
+    ParallelWorkerScope(const ParallelWorkerScope &) = delete;
+    ParallelWorkerScope &operator=(const ParallelWorkerScope &) = delete;
+};
+
+// Split [begin, end) into contiguous chunks and run fn(i) for every index,
+// one chunk per hardware thread (the calling thread takes the first chunk).
+// The threads are spawned and joined per call: meant for one-shot work such
+// as generation. Work done every frame goes through parallelForPooled.
+// Runs inline when the range is smaller than minPerThread * 2, only one
+// core is available or the caller is itself a worker. fn must be safe to
+// call concurrently for different i. Workers inherit the caller's MemTagScope.
+template <class Fn>
+void parallelFor(int begin, int end, Fn &&fn, int minPerThread = 1)
+{
+    int count = end - begin;
+    if (count <= 0)
+        return;
+
+    int hw = std::max(1u, std::thread::hardware_concurrency());
+    int threads = std::min(hw, std::max(1, count / std::max(1, minPerThread)));
+    if (threads <= 1 || t_inParallelWorker)
+    {
+        for (int i = begin; i < end; ++i)
+            fn(i);
+        return;
+    }
+
+    const MemTracker::Tag tag = MemTracker::currentTag();
+    auto runChunk = [&](int t)
+    {
+        ParallelWorkerScope worker;
+        MemTagScope memTag(tag);
+        int b = begin + int((long long)count * t / threads);
+        int e = begin + int((long long)count * (t + 1) / threads);
+        for (int i = b; i < e; ++i)
+            fn(i);
+    };
+
+    std::vector<std::thread> workers;
+    workers.reserve(threads - 1);
+    for (int t = 1; t < threads; ++t)
+        workers.emplace_back(runChunk, t);
+    runChunk(0);
+    for (std::thread &w : workers)
+        w.join();
+}
+
+// A fixed set of worker threads, started once and reused by every
+// parallelForPooled call, so per-frame work does not pay for thread creation.
+// One job runs at a time; other submitters wait for it. Workers count as
+// parallel workers (nested parallelFor calls run inline) and take on the
+// submitter's MemTagScope for each job.
+class WorkerPool
+{
+public:
+    // hardware_concurrency() - 1 workers (the submitting thread is the last one)
+    static WorkerPool &shared();
+
+    explicit WorkerPool(int workers);
+    ~WorkerPool();
+    WorkerPool(const WorkerPool &) = delete;
+    WorkerPool &operator=(const WorkerPool &) = delete;
+
+    int threadCount() const { return int(m_threads.size()) + 1; } // workers and the caller
+
+    // chunk(ctx, t) for every t in [0, chunks), spread over the workers and
+    // the calling thread; returns once all of them have finished
+    void run(int chunks, void (*chunk)(void *, int), void *ctx);
+
+private:
+    void loop();
+    bool claim(std::uint64_t job, int &t); // next chunk of that job, if any is left
+    void finish();
+
+    std::vector<std::thread> m_threads;
+    std::mutex m_submit; // one job at a time
+
+    std::mutex m_mutex; // everything below
+    std::condition_variable m_wake, m_done;
+    std::uint64_t m_job = 0; // bumped per run()
+    void (*m_chunk)(void *, int) = nullptr;
+    void *m_ctx = nullptr;
+    MemTracker::Tag m_tag = MemTracker::Untagged;
+    int m_chunks = 0;
+    int m_next = 0;      // next chunk to hand out
+    int m_remaining = 0; // chunks not finished yet
+    bool m_quit = false;
+};
+
+// parallelFor on the shared WorkerPool: same chunking and fallbacks, no
+// threads created per call.
+template <class Fn>
+void parallelForPooled(int begin, int end, Fn &&fn, int minPerThread = 1)
+{
+    int count = end - begin;
+    if (count <= 0)
+        return;
+
+    WorkerPool &pool = WorkerPool::shared();
+    int threads = std::min(pool.threadCount(), std::max(1, count / std::max(1, minPerThread)));
+    if (threads <= 1 || t_inParallelWorker)
+    {
+        for (int i = begin; i < end; ++i)
+            fn(i);
+        return;
+    }
+
+    auto runChunk = [&](int t)
+    {
+        ParallelWorkerScope worker;
+        int b = begin + int((long long)count * t / threads);
+        int e = begin + int((long long)count * (t + 1) / threads);
+        for (int i = b; i < e; ++i)
+            fn(i);
+    };
+    pool.run(threads, [](void *ctx, int t) { (*static_cast<decltype(runChunk) *>(ctx))(t); }, &runChunk);
+}
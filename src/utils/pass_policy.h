@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <glm/glm.hpp>
+
+// What a render pass draws and how detailed. The main view draws everything at
+// full detail; the water reflection/refraction views are distorted by the DUDV
+// map anyway, so they get coarser terrain, short vegetation ranges and no
+// particles.
+struct PassPolicy
+{
+    enum ObjectBits : std::uint32_t
+    {
+        Sky = 1u << 0,
+        Terrain = 1u << 1,
+        Water = 1u << 2,
+        Branches = 1u << 3,
+        Leaves = 1u << 4,
+        Rocks = 1u << 5,
+        Particles = 1u << 6,
+        All = 0xffffffffu
+    };
+
+    std::uint32_t objectMask = All;
+
+    // 0 = full-resolution terrain, 1 = every 2nd grid line, 2 = every 4th
+    int terrainLod = 0;
+
+    // per-tree / per-rock cut-off from the (pass) eye, world units
+    float branchMaxDist = std::numeric_limits<float>::infinity();
+    float leafMaxDist = std::numeric_limits<float>::infinity();
+    float rockMaxDist = std::numeric_limits<float>::infinity();
+
+    // keep only what is on the positive side of clipPlane (water passes)
+    bool useClipPlane = false;
+    glm::vec4 clipPlane{0.f};
+
+    // reject vegetation hidden behind terrain ridges; the horizon is built from
+    // the real camera position, so only passes seen from it may use it
+    bool horizonCull = true;
+
+    bool draws(std::uint32_t bits) const { return (objectMask & bits) != 0; }
+
+    static PassPolicy mainView() { return PassPolicy(); }
+
+    // Mirrored view: everything above the water, but cheap.
+    static PassPolicy reflection(float waterHeight)
+    {
+        PassPolicy p;
+        p.useClipPlane = true;
+        p.clipPlane = glm::vec4(0.f, 1.f, 0.f, -waterHeight); // keep above water
+        p.objectMask = Sky | Terrain | Branches | Leaves | Rocks;
+        p.terrainLod = 2;
+        p.branchMaxDist = 60.f;
+        p.leafMaxDist = 25.f;
+        p.rockMaxDist = 40.f;
+        p.horizonCull = false; // mirrored eye
+        return p;
+    }
+
+    // Seen through the water surface: only what lies below it can show up,
+    // so trees (always planted above sea level) are skipped entirely.
+    static PassPolicy refraction(float waterHeight)
+    {
+        PassPolicy p;
+        p.useClipPlane = true;
+        p.clipPlane = glm::vec4(0.f, -1.f, 0.f, waterHeight); // keep below water
+        p.objectMask = Sky | Terrain | Rocks;
+        p.terrainLod = 1;
+        p.rockMaxDist = 30.f;
+        return p;
+    }
+};
@@ -0,0 +1,132 @@
+#include "quality_governor.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+
+namespace
+{
+constexpr float EMA_ALPHA = 0.1f;
+
+// Each tier gives up one more thing than the one above it: the cheapest to
+// lose visually goes first (water targets are distorted anyway), terrain
+// detail goes last.
+QualityLevel makeTier(int tier)
+{
+    QualityLevel q;
+    if (tier >= 1)
+    {
+        q.name = "High";
+        q.reflectionScale = 0.75f;
+    }
+    if (tier >= 2)
+    {
+        q.name = "Medium";
+        q.dofMaxSamples = 8;
+        q.particleFraction = 0.5f;
+    }
+    if (tier >= 3)
+    {
+        q.name = "Low";
+        q.reflectionScale = 0.5f;
+        q.leafMaxDist = 60.f;
+    }
+    if (tier >= 4)
+    {
+        q.name = "Lower";
+        q.dofMaxSamples = 4;
+        q.particleFraction = 0.25f;
+        q.leafMaxDist = 35.f;
+        q.branchMaxDist = 90.f;
+    }
+    if (tier >= 5)
+    {
+        q.name = "Minimum";
+        q.terrainLod = 1;
+        q.leafMaxDist = 25.f;
+        q.branchMaxDist = 60.f;
+    }
+    return q;
+}
+}
+
+const QualityLevel &QualityGovernor::tierLevel(int tier)
+{
+    static const QualityLevel tiers[TIER_COUNT] = {
+        makeTier(0), makeTier(1), makeTier(2), makeTier(3), makeTier(4), makeTier(5)};
+    return tiers[std::clamp(tier, 0, TIER_COUNT - 1)];
+}
+
+void QualityGovernor::setEnabled(bool on)
+{
+    if (on == m_enabled)
+        return;
+    m_enabled = on;
+    m_tier = 0;
+    m_primed = false;
+    m_overFrames = m_underFrames = 0;
+    m_cooldown = 0;
+    m_upgradeFrames = UPGRADE_FRAMES;
+    m_lastDecision = on ? "governor on, starting at Ultra" : "governor off";
+    std::cout << "[quality] " << m_lastDecision << "\n";
+}
+
+bool QualityGovernor::addFrame(float cpuMs, float gpuMs)
+{
+    if (!m_primed)
+    {
+        m_cpuMs = cpuMs;
+        m_gpuMs = std::max(gpuMs, 0.f);
+        m_primed = true;
+    }
+    else
+    {
+        m_cpuMs += EMA_ALPHA * (cpuMs - m_cpuMs);
+        if (gpuMs >= 0.f)
+            m_gpuMs += EMA_ALPHA * (gpuMs - m_gpuMs);
+    }
+    // counters saturate: past their thresholds only "long enough" matters
+    m_framesSinceUpgrade = std::min(m_framesSinceUpgrade + 1, UNDONE_UPGRADE_FRAMES);
+
+    if (!m_enabled)
+        return false;
+    if (m_cooldown > 0)
+    {
+        --m_cooldown;
+        return false;
+    }
+
+    float frameMs = std::max(m_cpuMs, m_gpuMs);
+    m_overFrames = (frameMs > m_targetMs * DEGRADE_RATIO) ? std::min(m_overFrames + 1, DEGRADE_FRAMES) : 0;
+    m_underFrames = (frameMs < m_targetMs * UPGRADE_RATIO) ? std::min(m_underFrames + 1, MAX_UPGRADE_FRAMES) : 0;
+
+    if (m_overFrames >= DEGRADE_FRAMES && m_tier < TIER_COUNT - 1)
+    {
+        // the last upgrade didn't fit: be slower to try it again
+        if (m_framesSinceUpgrade < UNDONE_UPGRADE_FRAMES)
+            m_upgradeFrames = std::min(m_upgradeFrames * 2, MAX_UPGRADE_FRAMES);
+        changeTier(m_tier + 1, "over budget", frameMs);
+        return true;
+    }
+    if (m_underFrames >= m_upgradeFrames && m_tier > 0)
+    {
+        changeTier(m_tier - 1, "headroom", frameMs);
+        m_framesSinceUpgrade = 0;
+        return true;
+    }
+    return false;
+}
+
+void QualityGovernor::changeTier(int tier, const char *why, float frameMs)
+{
+    const char *from = level().name;
+    m_tier = tier;
+    m_overFrames = m_underFrames = 0;
+    m_cooldown = COOLDOWN_FRAMES;
+
+    char buf[160];
+    std::snprintf(buf, sizeof(buf), "%s -> %s (%s: %.1f ms vs %.1f ms budget, cpu %.1f / gpu %.1f)",
+                  from, level().name, why, frameMs, m_targetMs, m_cpuMs, m_gpuMs);
+    m_lastDecision = buf;
+    std::cout << "[quality] " << m_lastDecision << "\n";
+}
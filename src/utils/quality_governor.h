@@ -0,0 +1,74 @@
+#pragma once
+
+#include <limits>
+#include <string>
+
+// Knobs the governor is allowed to turn, in the order it turns them.
+struct QualityLevel
+{
+    const char *name = "Ultra";
+    float reflectionScale = 1.f; // water reflection/refraction targets relative to the viewport
+    int dofMaxSamples = 16;      // cap on the post.frag Poisson taps
+    float particleFraction = 1.f;
+    float leafMaxDist = std::numeric_limits<float>::infinity();   // main view
+    float branchMaxDist = std::numeric_limits<float>::infinity(); // main view
+    int terrainLod = 0;          // main view
+};
+
+// Keeps the frame time near a budget by stepping through a ranked list of
+// quality tiers. Feed it the CPU and GPU time of every frame; the slower of
+// the two is smoothed and compared against the budget:
+//  - over budget * DEGRADE_RATIO for DEGRADE_FRAMES frames -> one tier down
+//  - under budget * UPGRADE_RATIO for m_upgradeFrames frames -> one tier up
+// After every change it waits COOLDOWN_FRAMES frames, and an upgrade that has
+// to be undone right away doubles the wait before the next try, so it does
+// not oscillate between two tiers.
+class QualityGovernor
+{
+public:
+    static constexpr int TIER_COUNT = 6;
+    static constexpr float DEGRADE_RATIO = 1.10f;
+    static constexpr float UPGRADE_RATIO = 0.75f;
+    static constexpr int DEGRADE_FRAMES = 20;
+    static constexpr int UPGRADE_FRAMES = 120;
+    static constexpr int MAX_UPGRADE_FRAMES = 960;
+    static constexpr int COOLDOWN_FRAMES = 60;
+    static constexpr int UNDONE_UPGRADE_FRAMES = COOLDOWN_FRAMES + DEGRADE_FRAMES * 2; // "right away" above
+
+    static const QualityLevel &tierLevel(int tier);
+
+    void setTargetMs(float ms) { m_targetMs = ms; }
+    float targetMs() const { return m_targetMs; }
+
+    // off = always the top tier
+    void setEnabled(bool on);
+    bool enabled() const { return m_enabled; }
+
+    // returns true if the tier changed this frame; gpuMs < 0 = no GPU sample yet
+    bool addFrame(float cpuMs, float gpuMs);
+
+    int tier() const { return m_tier; }
+    const QualityLevel &level() const { return tierLevel(m_tier); }
+    const std::string &lastDecision() const { return m_lastDecision; }
+    float smoothedCpuMs() const { return m_cpuMs; }
+    float smoothedGpuMs() const { return m_gpuMs; }
+
+private:
+    void changeTier(int tier, const char *why, float frameMs);
+
+    bool m_enabled = false;
+    float m_targetMs = 16.6f;
+    int m_tier = 0;
+
+    float m_cpuMs = 0.f; // exponential moving averages
+    float m_gpuMs = 0.f;
+    bool m_primed = false;
+
+    int m_overFrames = 0;
+    int m_underFrames = 0;
+    int m_cooldown = 0;
+    int m_upgradeFrames = UPGRADE_FRAMES;
+    int m_framesSinceUpgrade = UNDONE_UPGRADE_FRAMES; // saturates there
+
+    std::string m_lastDecision = "governor off";
+};
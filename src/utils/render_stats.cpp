@@ -0,0 +1,216 @@
+#include "render_stats.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include "utils/trace.h"
+
+RenderStats renderStats;
+
+RenderCounters &RenderCounters::operator+=(const RenderCounters &o)
+{
+    drawCalls += o.drawCalls;
+    triangles += o.triangles;
+    instances += o.instances;
+    textureBinds += o.textureBinds;
+    stateChanges += o.stateChanges;
+    redundantState += o.redundantState;
+    uniformUploads += o.uniformUploads;
+    bufferBytes += o.bufferBytes;
+    return *this;
+}
+
+void RenderStats::beginFrame()
+{
+    m_frame = FrameStats();
+    m_frame.frame = m_frameIndex;
+    m_pass = -1;
+    m_other = RenderCounters();
+}
+
+void RenderStats::endFrame(float cpuMs, float gpuMs)
+{
+    closeTraceZone();
+    m_pass = -1;
+    if (m_other.drawCalls || m_other.textureBinds || m_other.stateChanges || m_other.redundantState ||
+        m_other.uniformUploads || m_other.bufferBytes)
+        m_frame.passes.push_back({"other", m_other});
+
+    m_frame.total = RenderCounters();
+    for (const PassStats &p : m_frame.passes)
+        m_frame.total += p.counters;
+    m_frame.cpuMs = cpuMs;
+    m_frame.gpuMs = gpuMs;
+
+    m_last = m_frame;
+    if (m_recording)
+        m_recorded.push_back(m_frame);
+    ++m_frameIndex;
+}
+
+void RenderStats::closeTraceZone()
+{
+    if (m_traceName)
+        Tracer::record(m_traceName, m_traceBegin, Tracer::nowNs());
+    m_traceName = nullptr;
+}
+
+void RenderStats::beginPass(const char *name)
+{
+    closeTraceZone();
+    if (TRACE_ENABLED && Tracer::active())
+    {
+        m_traceName = name;
+        m_traceBegin = Tracer::nowNs();
+    }
+
+    // a pass can be entered several times a frame; keep one entry per name
+    for (int i = 0; i < int(m_frame.passes.size()); ++i)
+    {
+        if (m_frame.passes[i].name == name)
+        {
+            m_pass = i;
+            return;
+        }
+    }
+    m_frame.passes.push_back({name, RenderCounters()});
+    m_pass = int(m_frame.passes.size()) - 1;
+}
+
+void RenderStats::endPass()
+{
+    closeTraceZone();
+    m_pass = -1;
+}
+
+RenderCounters &RenderStats::current()
+{
+    return (m_pass >= 0) ? m_frame.passes[m_pass].counters : m_other;
+}
+
+void RenderStats::draw(GLenum mode, GLsizei vertices, GLsizei instances)
+{
+    if (vertices <= 0 || instances <= 0)
+        return;
+
+    std::uint64_t tris = 0;
+    switch (mode)
+    {
+    case GL_TRIANGLES:
+        tris = std::uint64_t(vertices / 3);
+        break;
+    case GL_TRIANGLE_STRIP:
+    case GL_TRIANGLE_FAN:
+        tris = vertices >= 3 ? std::uint64_t(vertices - 2) : 0;
+        break;
+    default: // points / lines
+        break;
+    }
+
+    RenderCounters &c = current();
+    c.drawCalls++;
+    c.instances += std::uint64_t(instances);
+    c.triangles += tris * std::uint64_t(instances);
+}
+
+std::string RenderStats::summary() const
+{
+    auto line = [](std::ostringstream &out, const std::string &name, const RenderCounters &c)
+    {
+        char buf[224];
+        std::snprintf(buf, sizeof(buf),
+                      "%-10s draws %5llu  tris %9llu  inst %8llu  tex %4llu  state %4llu  skip %4llu  unif %5llu  buf %7.1f KB\n",
+                      name.c_str(),
+                      (unsigned long long)c.drawCalls, (unsigned long long)c.triangles,
+                      (unsigned long long)c.instances, (unsigned long long)c.textureBinds,
+                      (unsigned long long)c.stateChanges, (unsigned long long)c.redundantState,
+                      (unsigned long long)c.uniformUploads, c.bufferBytes / 1024.0);
+        out << buf;
+    };
+
+    std::ostringstream out;
+    char head[96];
+    std::snprintf(head, sizeof(head), "frame %llu  cpu %.2f ms  gpu %.2f ms\n",
+                  (unsigned long long)m_last.frame, m_last.cpuMs, m_last.gpuMs);
+    out << head;
+    for (const PassStats &p : m_last.passes)
+        line(out, p.name, p.counters);
+    line(out, "total", m_last.total);
+    return out.str();
+}
+
+void RenderStats::startRecording()
+{
+    m_recorded.clear();
+    m_recording = true;
+}
+
+bool RenderStats::writeJson(const std::string &path) const
+{
+    std::ofstream out(path);
+    if (!out)
+    {
+        std::cerr << "Error: could not write render stats to " << path << std::endl;
+        return false;
+    }
+
+    auto counters = [&](const RenderCounters &c)
+    {
+        out << "{\"drawCalls\": " << c.drawCalls
+            << ", \"triangles\": " << c.triangles
+            << ", \"instances\": " << c.instances
+            << ", \"textureBinds\": " << c.textureBinds
+            << ", \"stateChanges\": " << c.stateChanges
+            << ", \"redundantState\": " << c.redundantState
+            << ", \"uniformUploads\": " << c.uniformUploads
+            << ", \"bufferBytes\": " << c.bufferBytes << "}";
+    };
+
+    // per-frame records plus an average over the run
+    RenderCounters sum;
+    double cpuSum = 0.0, gpuSum = 0.0;
+    int gpuFrames = 0;
+
+    out << "{\n  \"frames\": [\n";
+    for (std::size_t i = 0; i < m_recorded.size(); ++i)
+    {
+        const FrameStats &f = m_recorded[i];
+        out << "    {\"frame\": " << f.frame << ", \"cpuMs\": " << f.cpuMs << ", \"gpuMs\": " << f.gpuMs
+            << ", \"total\": ";
+        counters(f.total);
+        out << ", \"passes\": {";
+        for (std::size_t p = 0; p < f.passes.size(); ++p)
+        {
+            out << (p ? ", " : "") << "\"" << f.passes[p].name << "\": ";
+            counters(f.passes[p].counters);
+        }
+        out << "}}" << (i + 1 < m_recorded.size() ? "," : "") << "\n";
+
+        sum += f.total;
+        cpuSum += f.cpuMs;
+        if (f.gpuMs >= 0.f)
+        {
+            gpuSum += f.gpuMs;
+            ++gpuFrames;
+        }
+    }
+
+    std::size_t n = std::max<std::size_t>(1, m_recorded.size());
+    out << "  ],\n  \"summary\": {\"frames\": " << m_recorded.size()
+        << ", \"avgCpuMs\": " << cpuSum / n
+        << ", \"avgGpuMs\": " << (gpuFrames ? gpuSum / gpuFrames : -1.0)
+        << ", \"avgDrawCalls\": " << double(sum.drawCalls) / n
+        << ", \"avgTriangles\": " << double(sum.triangles) / n
+        << ", \"avgInstances\": " << double(sum.instances) / n
+        << ", \"avgTextureBinds\": " << double(sum.textureBinds) / n
+        << ", \"avgStateChanges\": " << double(sum.stateChanges) / n
+        << ", \"avgRedundantState\": " << double(sum.redundantState) / n
+        << ", \"avgUniformUploads\": " << double(sum.uniformUploads) / n
+        << ", \"avgBufferBytes\": " << double(sum.bufferBytes) / n << "}\n}\n";
+
+    std::cout << "[stats] wrote " << m_recorded.size() << " frames to " << path << "\n";
+    return true;
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// What a frame (or one pass of it) asked the GPU to do.
+struct RenderCounters
+{
+    std::uint64_t drawCalls = 0;
+    std::uint64_t triangles = 0;
+    std::uint64_t instances = 0;
+    std::uint64_t textureBinds = 0;
+    std::uint64_t stateChanges = 0;   // program / VAO / unit / blend / depth / cull calls issued
+    std::uint64_t redundantState = 0; // the same calls skipped by the state cache (gl_state.h)
+    std::uint64_t uniformUploads = 0;
+    std::uint64_t bufferBytes = 0; // glBufferData / glBufferSubData / texture uploads
+
+    RenderCounters &operator+=(const RenderCounters &o);
+};
+
+struct PassStats
+{
+    std::string name;
+    RenderCounters counters;
+};
+
+struct FrameStats
+{
+    std::uint64_t frame = 0;
+    float cpuMs = 0.f;
+    float gpuMs = -1.f; // -1 = no timer result
+    RenderCounters total;
+    std::vector<PassStats> passes; // in submission order; work outside any pass goes to "other"
+};
+
+// Collects RenderCounters per pass and per frame. Fed by the counting
+// wrappers below (and GLMesh::draw / drawInstanced). GL thread only.
+// Pass brackets also show up as zones in a running trace capture.
+//
+//   beginFrame();  beginPass("scene"); ...draws...; endPass();  endFrame(cpu, gpu);
+//   lastFrame() -> numbers of the frame that just finished
+//   startRecording(); ...frames...; writeJson("render_stats.json");
+class RenderStats
+{
+public:
+    void beginFrame();
+    void endFrame(float cpuMs, float gpuMs);
+    void beginPass(const char *name);
+    void endPass();
+
+    void draw(GLenum mode, GLsizei vertices, GLsizei instances = 1);
+    void textureBind() { current().textureBinds++; }
+    void stateChange() { current().stateChanges++; }
+    void redundantState() { current().redundantState++; }
+    void uniformUpload() { current().uniformUploads++; }
+    void bufferUpload(std::size_t bytes) { current().bufferBytes += bytes; }
+
+    const FrameStats &lastFrame() const { return m_last; }
+    std::string summary() const; // multi-line text of lastFrame(), for the overlay
+
+    // keep every frame between start and stop for a JSON dump
+    void startRecording();
+    void stopRecording() { m_recording = false; }
+    bool recording() const { return m_recording; }
+    std::size_t recordedFrames() const { return m_recorded.size(); }
+    bool writeJson(const std::string &path) const;
+
+private:
+    RenderCounters &current();
+
+    FrameStats m_frame;
+    FrameStats m_last;
+    int m_pass = -1; // index into m_frame.passes, -1 = "other"
+    const char *m_traceName = nullptr; // open pass zone, see utils/trace.h
+    std::int64_t m_traceBegin = 0;
+    void closeTraceZone();
+    RenderCounters m_other;
+    std::uint64_t m_frameIndex = 0;
+
+    bool m_recording = false;
+    std::vector<FrameStats> m_recorded;
+};
+
+// the global collector (like `settings`)
+extern RenderStats renderStats;
+
+// ---- thin counting wrappers around the GL calls the renderer uses -----------
+
+// binds through the state cache on the active unit; only real binds are counted as such
+void statBindTexture(GLenum target, GLuint tex);
+
+// statUniform(glUniform1f, loc, v) == glUniform1f(loc, v), counted
+template <class Fn, class... Args>
+inline void statUniform(Fn fn, Args... args)
+{
+    renderStats.uniformUpload();
+    fn(args...);
+}
+
+inline void statBufferData(GLenum target, GLsizeiptr size, const void *data, GLenum usage)
+{
+    renderStats.bufferUpload(std::size_t(size));
+    glBufferData(target, size, data, usage);
+}
+
+inline void statBufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void *data)
+{
+    renderStats.bufferUpload(std::size_t(size));
+    glBufferSubData(target, offset, size, data);
+}
@@ -0,0 +1,451 @@
+#include "scene_flatten.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <unordered_map>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "utils/parallel.h"
+#include "utils/trace.h"
+
+namespace
+{
+// primitives and lights in a subtree, counted once per node (template
+// groups are shared between parents)
+struct SubtreeCounts
+{
+    std::size_t prims = 0;
+    std::size_t lights = 0;
+};
+using CountMap = std::unordered_map<const SceneNode *, SubtreeCounts>;
+
+const SubtreeCounts &countSubtree(const SceneNode *node, CountMap &counts)
+{
+    auto it = counts.find(node);
+    if (it != counts.end())
+        return it->second;
+    SubtreeCounts c{node->primitives.size(), node->lights.size()};
+    for (const SceneNode *child : node->children)
+    {
+        const SubtreeCounts &cc = countSubtree(child, counts);
+        c.prims += cc.prims;
+        c.lights += cc.lights;
+    }
+    return counts.emplace(node, c).first->second;
+}
+
+// a subtree still to walk: where its node's output starts, and the CTM above it
+struct SubtreeTask
+{
+    const SceneNode *node;
+    glm::mat4 parentCTM;
+    std::size_t primAt;
+    std::size_t lightAt;
+};
+
+// enough independent subtrees to keep every core busy with uneven sizes
+constexpr std::size_t TARGET_TASKS = 64;
+constexpr std::size_t MIN_TASK_PRIMS = 256; // smaller subtrees are not split further
+
+class Flattener
+{
+public:
+    Flattener(FlatScene &out, const CountMap &counts, std::vector<const ScenePrimitive *> &sources)
+        : m_out(out), m_counts(counts), m_sources(sources)
+    {
+    }
+
+    // the node's own primitives and lights; returns its CTM
+    glm::mat4 emitNode(const SubtreeTask &t) const
+    {
+        glm::mat4 ctm = t.parentCTM * nodeTransform(*t.node);
+        std::size_t p = t.primAt;
+        for (const ScenePrimitive *prim : t.node->primitives)
+        {
+            m_out.ctms[p] = ctm;
+            m_out.types[p] = prim->type;
+            m_sources[p] = prim;
+            ++p;
+        }
+        std::size_t l = t.lightAt;
+        for (const SceneLight *light : t.node->lights)
+            m_out.lights[l++] = worldLight(*light, ctm);
+        return ctm;
+    }
+
+    // tasks for the node's children, laid out after its own output
+    void childTasks(const SubtreeTask &t, const glm::mat4 &ctm, std::vector<SubtreeTask> &tasks) const
+    {
+        std::size_t p = t.primAt + t.node->primitives.size();
+        std::size_t l = t.lightAt + t.node->lights.size();
+        for (const SceneNode *child : t.node->children)
+        {
+            tasks.push_back({child, ctm, p, l});
+            const SubtreeCounts &c = m_counts.at(child);
+            p += c.prims;
+            l += c.lights;
+        }
+    }
+
+    void walk(const SubtreeTask &t) const
+    {
+        glm::mat4 ctm = emitNode(t);
+        std::size_t p = t.primAt + t.node->primitives.size();
+        std::size_t l = t.lightAt + t.node->lights.size();
+        for (const SceneNode *child : t.node->children)
+        {
+            walk({child, ctm, p, l});
+            const SubtreeCounts &c = m_counts.at(child);
+            p += c.prims;
+            l += c.lights;
+        }
+    }
+
+private:
+    FlatScene &m_out;
+    const CountMap &m_counts;
+    std::vector<const ScenePrimitive *> &m_sources;
+};
+
+template <class T>
+void writePod(std::ofstream &out, const T &v)
+{
+    out.write(reinterpret_cast<const char *>(&v), sizeof(T));
+}
+
+template <class T>
+void writeArray(std::ofstream &out, const std::vector<T> &v)
+{
+    writePod(out, std::uint32_t(v.size()));
+    out.write(reinterpret_cast<const char *>(v.data()), std::streamsize(v.size() * sizeof(T)));
+}
+
+void writeString(std::ofstream &out, const std::string &s)
+{
+    writePod(out, std::uint32_t(s.size()));
+    out.write(s.data(), std::streamsize(s.size()));
+}
+
+void writeFileMap(std::ofstream &out, const SceneFileMap &m)
+{
+    writePod(out, std::uint8_t(m.isUsed));
+    writeString(out, m.filename);
+    writePod(out, m.repeatU);
+    writePod(out, m.repeatV);
+}
+
+// Reads the cache back from memory (the file is loaded in one go). Every
+// read is bounds-checked, so a truncated or damaged cache just fails.
+struct CacheReader
+{
+    const char *at;
+    const char *end;
+
+    bool bytes(void *dst, std::size_t n)
+    {
+        if (std::size_t(end - at) < n)
+            return false;
+        std::memcpy(dst, at, n);
+        at += n;
+        return true;
+    }
+    template <class T>
+    bool pod(T &v)
+    {
+        return bytes(&v, sizeof(T));
+    }
+    template <class T>
+    bool array(std::vector<T> &v)
+    {
+        std::uint32_t n = 0;
+        if (!pod(n) || std::size_t(end - at) / sizeof(T) < n)
+            return false;
+        v.resize(n);
+        return bytes(v.data(), std::size_t(n) * sizeof(T));
+    }
+    bool string(std::string &s)
+    {
+        std::uint32_t n = 0;
+        if (!pod(n) || std::size_t(end - at) < n)
+            return false;
+        s.assign(at, n);
+        at += n;
+        return true;
+    }
+    bool fileMap(SceneFileMap &m)
+    {
+        std::uint8_t used = 0;
+        bool ok = pod(used) && string(m.filename) && pod(m.repeatU) && pod(m.repeatV);
+        m.isUsed = used != 0;
+        return ok;
+    }
+};
+
+// Value equality for a primitive's material (and mesh file), so the
+// identical materials a scene file spells out for every primitive collapse
+// into one. Floats compare by bit pattern.
+struct SameMaterial
+{
+    static bool same(const void *a, const void *b, std::size_t n) { return std::memcmp(a, b, n) == 0; }
+    static bool sameMap(const SceneFileMap &a, const SceneFileMap &b)
+    {
+        return a.isUsed == b.isUsed && a.filename == b.filename && same(&a.repeatU, &b.repeatU, sizeof(float)) &&
+               same(&a.repeatV, &b.repeatV, sizeof(float));
+    }
+    bool operator()(const ScenePrimitive *pa, const ScenePrimitive *pb) const
+    {
+        const SceneMaterial &a = pa->material, &b = pb->material;
+        bool meshA = pa->type == PrimitiveType::PRIMITIVE_MESH, meshB = pb->type == PrimitiveType::PRIMITIVE_MESH;
+        return meshA == meshB && (!meshA || pa->meshfile == pb->meshfile) &&
+               same(&a.cAmbient, &b.cAmbient, sizeof(SceneColor)) && same(&a.cDiffuse, &b.cDiffuse, sizeof(SceneColor)) &&
+               same(&a.cSpecular, &b.cSpecular, sizeof(SceneColor)) && same(&a.shininess, &b.shininess, sizeof(float)) &&
+               same(&a.cReflective, &b.cReflective, sizeof(SceneColor)) &&
+               same(&a.cTransparent, &b.cTransparent, sizeof(SceneColor)) && same(&a.ior, &b.ior, sizeof(float)) &&
+               sameMap(a.textureMap, b.textureMap) && same(&a.blend, &b.blend, sizeof(float)) &&
+               same(&a.cEmissive, &b.cEmissive, sizeof(SceneColor)) && sameMap(a.bumpMap, b.bumpMap);
+    }
+};
+
+// FNV-1a over the colours and shininess, which tell materials apart in
+// practice; SameMaterial settles the rest
+struct MaterialHash
+{
+    std::size_t operator()(const ScenePrimitive *p) const
+    {
+        const SceneMaterial &m = p->material;
+        std::uint64_t h = 1469598103934665603ull;
+        auto mix = [&h](const void *data, std::size_t n)
+        {
+            const unsigned char *c = static_cast<const unsigned char *>(data);
+            for (std::size_t i = 0; i < n; ++i)
+                h = (h ^ c[i]) * 1099511628211ull;
+        };
+        mix(&m.cAmbient, sizeof(SceneColor));
+        mix(&m.cDiffuse, sizeof(SceneColor));
+        mix(&m.cSpecular, sizeof(SceneColor));
+        mix(&m.shininess, sizeof(float));
+        return std::size_t(h);
+    }
+};
+
+// identifies the source revision the cache was built from
+bool sourceStamp(const std::string &path, std::uint64_t &size, std::int64_t &mtime)
+{
+    std::error_code ec;
+    size = std::filesystem::file_size(path, ec);
+    if (ec)
+        return false;
+    auto t = std::filesystem::last_write_time(path, ec);
+    mtime = std::int64_t(t.time_since_epoch().count());
+    return !ec;
+}
+
+// "ATSC" v1: u32 version, u32 sizeof(SceneLightData), u64 source size,
+// i64 source mtime, globalData, cameraData, then u32-counted arrays:
+// lights, ctms, types, materialIndex, and per material its fields (strings
+// as u32 length + bytes) followed by its mesh file
+constexpr std::uint32_t CACHE_VERSION = 1;
+}
+
+glm::mat4 nodeTransform(const SceneNode &node)
+{
+    glm::mat4 local(1.0f);
+    for (const SceneTransformation *t : node.transformations)
+    {
+        switch (t->type)
+        {
+        case TransformationType::TRANSFORMATION_TRANSLATE:
+            local = glm::translate(local, t->translate);
+            break;
+        case TransformationType::TRANSFORMATION_SCALE:
+            local = glm::scale(local, t->scale);
+            break;
+        case TransformationType::TRANSFORMATION_ROTATE:
+            local = glm::rotate(local, t->angle, t->rotate);
+            break;
+        case TransformationType::TRANSFORMATION_MATRIX:
+            local *= t->matrix;
+            break;
+        }
+    }
+    return local;
+}
+
+SceneLightData worldLight(const SceneLight &l, const glm::mat4 &ctm)
+{
+    SceneLightData L{};
+    L.id = l.id;
+    L.type = l.type;
+    L.color = l.color;
+    L.function = l.function;
+    L.penumbra = l.penumbra;
+    L.angle = l.angle;
+
+    // directional lights have no position, point lights no direction
+    if (L.type != LightType::LIGHT_DIRECTIONAL)
+        L.pos = ctm * glm::vec4(0, 0, 0, 1);
+    if (L.type != LightType::LIGHT_POINT)
+    {
+        // only the direction matters, not the scale the CTM puts on it
+        glm::vec3 dirW = glm::vec3(ctm * glm::vec4(glm::vec3(l.dir), 0.0f));
+        if (glm::length(dirW) > 0.0f)
+            dirW = glm::normalize(dirW);
+        L.dir = glm::vec4(dirW, 0.0f);
+    }
+    return L;
+}
+
+void flattenSceneGraph(const SceneNode *root, FlatScene &out)
+{
+    TRACE_SCOPE("flattenSceneGraph");
+    out.lights.clear();
+    out.ctms.clear();
+    out.types.clear();
+    out.materialIndex.clear();
+    out.materials.clear();
+    out.meshFiles.clear();
+    if (!root)
+        return;
+
+    CountMap counts;
+    const SubtreeCounts total = countSubtree(root, counts);
+    out.lights.resize(total.lights);
+    out.ctms.resize(total.prims);
+    out.types.resize(total.prims);
+    std::vector<const ScenePrimitive *> sources(total.prims);
+    Flattener flat(out, counts, sources);
+
+    // split the top of the tree until there are enough subtrees to share out
+    std::vector<SubtreeTask> tasks{{root, glm::mat4(1.f), 0, 0}}, next;
+    while (tasks.size() < TARGET_TASKS)
+    {
+        next.clear();
+        bool split = false;
+        for (const SubtreeTask &t : tasks)
+        {
+            if (t.node->children.empty() || counts.at(t.node).prims < MIN_TASK_PRIMS)
+            {
+                next.push_back(t);
+                continue;
+            }
+            flat.childTasks(t, flat.emitNode(t), next);
+            split = true;
+        }
+        tasks.swap(next);
+        if (!split)
+            break;
+    }
+    parallelFor(0, int(tasks.size()), [&](int i) { flat.walk(tasks[i]); });
+
+    // materials: one per distinct value, in first-use order
+    std::unordered_map<const ScenePrimitive *, std::uint32_t, MaterialHash, SameMaterial> index;
+    out.materialIndex.resize(total.prims);
+    for (std::size_t i = 0; i < total.prims; ++i)
+    {
+        auto [it, inserted] = index.try_emplace(sources[i], std::uint32_t(out.materials.size()));
+        if (inserted)
+        {
+            out.materials.push_back(sources[i]->material);
+            out.meshFiles.push_back(sources[i]->type == PrimitiveType::PRIMITIVE_MESH ? sources[i]->meshfile
+                                                                                      : std::string());
+        }
+        out.materialIndex[i] = it->second;
+    }
+}
+
+bool writeSceneCache(const std::string &cachePath, const std::string &sourcePath, const FlatScene &scene)
+{
+    std::uint64_t size = 0;
+    std::int64_t mtime = 0;
+    if (!sourceStamp(sourcePath, size, mtime))
+        return false;
+
+    std::ofstream out(cachePath, std::ios::binary);
+    if (!out)
+        return false;
+    out.write("ATSC", 4);
+    writePod(out, CACHE_VERSION);
+    writePod(out, std::uint32_t(sizeof(SceneLightData)));
+    writePod(out, size);
+    writePod(out, mtime);
+    writePod(out, scene.globalData);
+    writePod(out, scene.cameraData);
+    writeArray(out, scene.lights);
+    writeArray(out, scene.ctms);
+    writeArray(out, scene.types);
+    writeArray(out, scene.materialIndex);
+
+    writePod(out, std::uint32_t(scene.materials.size()));
+    for (std::size_t i = 0; i < scene.materials.size(); ++i)
+    {
+        const SceneMaterial &m = scene.materials[i];
+        writePod(out, m.cAmbient);
+        writePod(out, m.cDiffuse);
+        writePod(out, m.cSpecular);
+        writePod(out, m.shininess);
+        writePod(out, m.cReflective);
+        writePod(out, m.cTransparent);
+        writePod(out, m.ior);
+        writeFileMap(out, m.textureMap);
+        writePod(out, m.blend);
+        writePod(out, m.cEmissive);
+        writeFileMap(out, m.bumpMap);
+        writeString(out, scene.meshFiles[i]);
+    }
+    return bool(out);
+}
+
+bool readSceneCache(const std::string &cachePath, const std::string &sourcePath, FlatScene &scene)
+{
+    std::uint64_t size = 0;
+    std::int64_t mtime = 0;
+    if (!sourceStamp(sourcePath, size, mtime))
+        return false;
+
+    std::ifstream in(cachePath, std::ios::binary | std::ios::ate);
+    if (!in)
+        return false;
+    std::vector<char> data(std::size_t(in.tellg()));
+    in.seekg(0);
+    if (!in.read(data.data(), std::streamsize(data.size())))
+        return false;
+
+    CacheReader r{data.data(), data.data() + data.size()};
+    char magic[4] = {};
+    std::uint32_t version = 0, lightBytes = 0;
+    std::uint64_t cachedSize = 0;
+    std::int64_t cachedMtime = 0;
+    if (!r.bytes(magic, 4) || std::memcmp(magic, "ATSC", 4) != 0 || !r.pod(version) || version != CACHE_VERSION ||
+        !r.pod(lightBytes) || lightBytes != sizeof(SceneLightData) || !r.pod(cachedSize) ||
+        !r.pod(cachedMtime) || cachedSize != size || cachedMtime != mtime)
+        return false;
+
+    FlatScene s;
+    std::uint32_t materialCount = 0;
+    if (!r.pod(s.globalData) || !r.pod(s.cameraData) || !r.array(s.lights) || !r.array(s.ctms) ||
+        !r.array(s.types) || !r.array(s.materialIndex) || !r.pod(materialCount) ||
+        s.types.size() != s.ctms.size() || s.materialIndex.size() != s.ctms.size())
+        return false;
+
+    // each material takes at least 100 bytes, so this bounds the allocation
+    if (std::size_t(r.end - r.at) / 100 < materialCount)
+        return false;
+    s.materials.resize(materialCount);
+    s.meshFiles.resize(materialCount);
+    for (std::uint32_t i = 0; i < materialCount; ++i)
+    {
+        SceneMaterial &m = s.materials[i];
+        if (!r.pod(m.cAmbient) || !r.pod(m.cDiffuse) || !r.pod(m.cSpecular) || !r.pod(m.shininess) ||
+            !r.pod(m.cReflective) || !r.pod(m.cTransparent) || !r.pod(m.ior) || !r.fileMap(m.textureMap) ||
+            !r.pod(m.blend) || !r.pod(m.cEmissive) || !r.fileMap(m.bumpMap) || !r.string(s.meshFiles[i]))
+            return false;
+    }
+    for (std::uint32_t mi : s.materialIndex)
+        if (mi >= materialCount)
+            return false;
+
+    scene = std::move(s);
+    return true;
+}
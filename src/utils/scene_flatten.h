@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "scenedata.h"
+
+// A parsed scene with its graph flattened away: world-space lights and, per
+// primitive, parallel arrays (CTM, type, material index) in the depth-first
+// order SceneParser::parse() produces its RenderShapeData list in.
+struct FlatScene
+{
+    SceneGlobalData globalData{};
+    SceneCameraData cameraData{};
+    std::vector<SceneLightData> lights;
+
+    std::vector<glm::mat4> ctms;
+    std::vector<PrimitiveType> types;
+    std::vector<std::uint32_t> materialIndex; // into materials and meshFiles
+
+    // one entry per distinct material (with mesh file): scene files repeat
+    // the same material inline for every primitive
+    std::vector<SceneMaterial> materials;
+    std::vector<std::string> meshFiles; // empty unless PRIMITIVE_MESH
+
+    std::size_t shapeCount() const { return ctms.size(); }
+};
+
+// Product of a node's transformations, in file order
+glm::mat4 nodeTransform(const SceneNode &node);
+
+// A light of the graph moved to world space by its node's CTM
+SceneLightData worldLight(const SceneLight &light, const glm::mat4 &ctm);
+
+// Fill out's lights and per-primitive arrays from the graph under root
+// (globalData / cameraData are left alone). Subtrees are walked in
+// parallel, each writing a slice sized by a counting pass, so the order
+// does not depend on the thread count.
+void flattenSceneGraph(const SceneNode *root, FlatScene &out);
+
+// Binary copy of a FlatScene for sourcePath, tied to that file's size and
+// modification time: readSceneCache() fails once the source has changed,
+// or for a cache written by a build with another FlatScene layout.
+bool writeSceneCache(const std::string &cachePath, const std::string &sourcePath, const FlatScene &scene);
+bool readSceneCache(const std::string &cachePath, const std::string &sourcePath, FlatScene &scene);
@@ -1,6 +1,5 @@
 #include "sceneparser.h"
 #include "scenefilereader.h"
-#include <glm/gtx/transform.hpp>
 
 #include <chrono>
 #include <iostream>
@@ -10,23 +9,7 @@ static void travNode(SceneNode* node, const glm::mat4& pCTM, RenderData& out){
     if (!node) return;
 
     // construct current CTM (follow the node's internal sequence)
-    glm::mat4 local(1.0f);
-    for (SceneTransformation* t : node->transformations){
-        switch (t -> type){
-        case TransformationType::TRANSFORMATION_TRANSLATE:
-            local *= glm::translate(t->translate);
-            break;
-        case TransformationType::TRANSFORMATION_SCALE:
-            local *= glm::scale(t->scale);
-            break;
-        case TransformationType::TRANSFORMATION_ROTATE:
-            local *= glm::rotate(t->angle, t->rotate);
-            break;
-        case TransformationType::TRANSFORMATION_MATRIX:
-            local *= t->matrix;
-            break;
-        }
-    }
+    glm::mat4 local = nodeTransform(*node);
 
     // current CTM
     glm::mat4 ctm = pCTM * local;
@@ -41,26 +24,7 @@ static void travNode(SceneNode* node, const glm::mat4& pCTM, RenderData& out){
 
     // lights for current node, write in RenderData.lights (converted into world space)
     for (const SceneLight* l : node->lights) {
-        SceneLightData L{}; // we have to put SceneLightData info into RenderData.lights container
-        L.id = l->id;
-        L.type = l->type;
-        L.color = l->color;
-        L.function = l->function;
-        L.penumbra = l->penumbra;
-        L.angle = l->angle;
-
-        // location: calculated except for directional light by def
-        if (L.type != LightType::LIGHT_DIRECTIONAL){
-            L.pos = ctm * glm::vec4(0,0,0,1);
-        }
-        // location: calculated except for point light by def
-        if (L.type != LightType::LIGHT_POINT){
-            glm::vec3 dirW = glm::vec3(ctm * glm::vec4(glm::vec3(l->dir), 0.0f));
-            // Normalize since the dir of light only need unit vec. (avoid ''unwanted'' transformation by ctm)
-            if (glm::length(dirW) > 0.0f) dirW = glm::normalize(dirW);
-            L.dir = glm::vec4(dirW, 0.0f);
-        }
-        out.lights.push_back(std::move(L));
+        out.lights.push_back(worldLight(*l, ctm));
     }
 
     // traverse children node
@@ -92,3 +56,39 @@ bool SceneParser::parse(std::string filepath, RenderData &renderData) {
 
     return true;
 }
+
+bool SceneParser::parseFlat(std::string filepath, FlatScene &scene, bool useCache) {
+    using Clock = std::chrono::steady_clock;
+    auto ms = [](Clock::time_point a, Clock::time_point b) {
+        return std::chrono::duration<double, std::milli>(b - a).count();
+    };
+    const std::string cachePath = filepath + ".atsc";
+
+    auto t0 = Clock::now();
+    if (useCache && readSceneCache(cachePath, filepath, scene)) {
+        std::cout << "[scene] " << scene.shapeCount() << " shapes from cache " << cachePath << " in "
+                  << ms(t0, Clock::now()) << " ms" << std::endl;
+        return true;
+    }
+
+    ScenefileReader fileReader = ScenefileReader(filepath);
+    if (!fileReader.readJSON()) {
+        return false;
+    }
+    auto t1 = Clock::now();
+
+    scene.cameraData = fileReader.getCameraData();
+    scene.globalData = fileReader.getGlobalData();
+    flattenSceneGraph(fileReader.getRootNode(), scene);
+    auto t2 = Clock::now();
+
+    std::cout << "[scene] parsed " << filepath << " in " << ms(t0, t1) << " ms, flattened "
+              << scene.shapeCount() << " shapes / " << scene.materials.size() << " materials in "
+              << ms(t1, t2) << " ms" << std::endl;
+
+    // a read-only scene folder just means no cache next time
+    if (useCache && !writeSceneCache(cachePath, filepath, scene)) {
+        std::cout << "[scene] could not write cache " << cachePath << std::endl;
+    }
+    return true;
+}
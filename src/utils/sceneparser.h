@@ -1,6 +1,7 @@
 #pragma once
 
 #include "scenedata.h"
+#include "scene_flatten.h"
 #include <vector>
 #include <string>
 
@@ -26,4 +27,9 @@ public:
     // @param renderData  On return, this will contain the metadata of the loaded scene.
     // @return            A boolean value indicating whether the parse was successful.
     static bool parse(std::string filepath, RenderData &renderData);
+
+    // Parse the scene straight into flat arrays (see FlatScene). Unless
+    // useCache is false, a binary copy is kept next to the file as
+    // <filepath>.atsc and used instead of the JSON while the file is unchanged.
+    static bool parseFlat(std::string filepath, FlatScene &scene, bool useCache = true);
 };
@@ -8,6 +8,8 @@
 #include <QFile>
 #include <QTextStream>
 #include <iostream>
+#include <sstream>
+#include <string>
 
 class ShaderLoader{
 public:
@@ -46,18 +48,10 @@ public:
 
 private:
     static GLuint createShader(GLenum shaderType, const char *filepath){
-        GLuint shaderID = glCreateShader(shaderType);
-
         // Read shader file.
-        std::string code;
-        QString filepathStr = QString(filepath);
-        QFile file(filepathStr);
-        if (file.open(QIODevice::ReadOnly | QIODevice::Text)) {
-            QTextStream stream(&file);
-            code = stream.readAll().toStdString();
-        }else{
-            throw std::runtime_error(std::string("Failed to open shader: ")+filepath);
-        }
+        std::string code = readSource(filepath, 0);
+
+        GLuint shaderID = glCreateShader(shaderType);
 
         // Compile shader code.
         const char *codePtr = code.c_str();
@@ -81,4 +75,38 @@ private:
 
         return shaderID;
     }
+
+    // File contents with each line of the form #include "name" replaced by
+    // that file, resolved next to the including one. GLSL has no #include of
+    // its own; this is only meant for shared snippets (e.g. clustered_lights.glsl).
+    static std::string readSource(const std::string &path, int depth){
+        if (depth > 8)
+            throw std::runtime_error("Shader includes nested too deeply: " + path);
+
+        std::string text;
+        QFile file(QString::fromStdString(path));
+        if (file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+            QTextStream stream(&file);
+            text = stream.readAll().toStdString();
+        }else{
+            throw std::runtime_error("Failed to open shader: " + path);
+        }
+
+        const std::string dir = path.substr(0, path.rfind('/') + 1);
+        std::string code, line;
+        std::istringstream lines(text);
+        while (std::getline(lines, line)) {
+            std::size_t first = line.find_first_not_of(" \t");
+            if (first != std::string::npos && line.compare(first, 8, "#include") == 0) {
+                std::size_t q0 = line.find('"', first), q1 = line.rfind('"');
+                if (q0 == std::string::npos || q1 <= q0)
+                    throw std::runtime_error("Malformed #include in " + path + ": " + line);
+                code += readSource(dir + line.substr(q0 + 1, q1 - q0 - 1), depth + 1);
+            } else {
+                code += line;
+            }
+            code += '\n';
+        }
+        return code;
+    }
 };
@@ -0,0 +1,251 @@
+#include "startup_graph.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+#include "utils/trace.h"
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+double msSince(Clock::time_point t0)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+}
+
+const char *stageName(StartupGraph::Stage stage)
+{
+    switch (stage)
+    {
+    case StartupGraph::Stage::Critical:
+        return "critical";
+    case StartupGraph::Stage::Background:
+        return "background";
+    default:
+        return "on demand";
+    }
+}
+}
+
+StartupGraph::~StartupGraph()
+{
+    cancel();
+}
+
+StartupGraph::Task StartupGraph::add(std::string name, Stage stage, std::function<void()> prepare,
+                                     std::function<void()> upload, std::vector<Task> deps)
+{
+    Task id = Task(m_nodes.size());
+    auto node = std::make_unique<Node>();
+    node->name = std::move(name);
+    node->stage = stage;
+    node->prepare = std::move(prepare);
+    node->upload = std::move(upload);
+    // only earlier tasks, which keeps the graph acyclic
+    for (Task d : deps)
+        if (d >= 0 && d < id)
+            node->deps.push_back(d);
+    if (!node->prepare)
+        node->state = State::Prepared;
+    m_nodes.push_back(std::move(node));
+    return id;
+}
+
+bool StartupGraph::claim(Node &node)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (node.state != State::Pending)
+        return false;
+    node.state = State::Preparing;
+    return true;
+}
+
+void StartupGraph::prepareNode(Node &node)
+{
+    if (!claim(node))
+        return;
+
+    auto t0 = Clock::now();
+    {
+        TraceZone zone(node.name.c_str());
+        node.prepare();
+    }
+    double ms = msSince(t0);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    node.state = State::Prepared;
+    node.prepareMs = ms;
+    m_prepared.notify_all();
+}
+
+void StartupGraph::finish(Task task)
+{
+    Node &node = *m_nodes[task];
+    if (done(task))
+        return;
+
+    for (Task d : node.deps)
+        finish(d);
+
+    // run the prepare step here unless another thread already has it
+    prepareNode(node);
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_prepared.wait(lock, [&] { return node.state == State::Prepared; });
+    }
+
+    auto t0 = Clock::now();
+    if (node.upload)
+    {
+        TraceZone zone(node.name.c_str());
+        node.upload();
+    }
+    double ms = msSince(t0);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    node.state = State::Done;
+    node.uploadMs = ms;
+}
+
+void StartupGraph::runCritical()
+{
+    TRACE_SCOPE("startup critical");
+    auto t0 = Clock::now();
+
+    // critical tasks plus everything they depend on, in id order
+    std::vector<bool> wanted(m_nodes.size(), false);
+    for (int i = int(m_nodes.size()) - 1; i >= 0; --i)
+    {
+        if (m_nodes[i]->stage == Stage::Critical)
+            wanted[i] = true;
+        if (wanted[i])
+            for (Task d : m_nodes[i]->deps)
+                wanted[d] = true;
+    }
+    std::vector<Task> todo;
+    for (Task i = 0; i < Task(m_nodes.size()); ++i)
+        if (wanted[i])
+            todo.push_back(i);
+
+    // Prepare steps fan out over helper threads. They are not marked as
+    // parallelFor workers, so a prepare step may still parallelise itself.
+    std::atomic<std::size_t> next{0};
+    auto drain = [&] {
+        for (std::size_t i; (i = next.fetch_add(1)) < todo.size();)
+            prepareNode(*m_nodes[todo[i]]);
+    };
+    int hw = int(std::max(1u, std::thread::hardware_concurrency()));
+    int helpers = std::min(hw, int(todo.size())) - 1;
+    std::vector<std::thread> threads;
+    for (int i = 0; i < helpers; ++i)
+        threads.emplace_back([&] {
+            Tracer::setThreadName("startup loader");
+            drain();
+        });
+
+    // GL-only steps (shader builds) overlap with the helpers' decoding
+    for (Task t : todo)
+        if (!m_nodes[t]->prepare)
+            finish(t);
+    drain();
+    for (std::thread &t : threads)
+        t.join();
+    for (Task t : todo)
+        finish(t);
+
+    m_criticalMs = msSince(t0);
+}
+
+void StartupGraph::start()
+{
+    if (m_loader.joinable())
+        return;
+    m_stop = false;
+    m_loader = std::thread([this] { loaderLoop(); });
+}
+
+void StartupGraph::loaderLoop()
+{
+    Tracer::setThreadName("startup loader");
+    for (auto &node : m_nodes)
+    {
+        if (m_stop)
+            return;
+        if (node->stage == Stage::Background)
+            prepareNode(*node);
+    }
+}
+
+int StartupGraph::pump(double budgetMs)
+{
+    auto t0 = Clock::now();
+    int uploaded = 0;
+    for (Task t = 0; t < Task(m_nodes.size()); ++t)
+    {
+        Node &node = *m_nodes[t];
+        if (node.stage != Stage::Background)
+            continue;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (node.state != State::Prepared)
+                continue;
+            bool depsDone = std::all_of(node.deps.begin(), node.deps.end(),
+                                        [&](Task d) { return m_nodes[d]->state == State::Done; });
+            if (!depsDone)
+                continue;
+        }
+        finish(t);
+        ++uploaded;
+        if (msSince(t0) >= budgetMs)
+            break;
+    }
+    return uploaded;
+}
+
+void StartupGraph::require(Task task)
+{
+    if (task < 0 || task >= Task(m_nodes.size()))
+        return;
+    finish(task);
+}
+
+void StartupGraph::cancel()
+{
+    m_stop = true;
+    if (m_loader.joinable())
+        m_loader.join();
+}
+
+bool StartupGraph::done(Task task) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return task >= 0 && task < Task(m_nodes.size()) && m_nodes[task]->state == State::Done;
+}
+
+bool StartupGraph::backgroundPending() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return std::any_of(m_nodes.begin(), m_nodes.end(), [](const std::unique_ptr<Node> &n) {
+        return n->stage == Stage::Background && n->state != State::Done;
+    });
+}
+
+std::string StartupGraph::report() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::string out;
+    char line[256];
+    for (const auto &node : m_nodes)
+    {
+        if (node->state != State::Done)
+            std::snprintf(line, sizeof(line), "  %-44s %-10s not loaded\n", node->name.c_str(),
+                          stageName(node->stage));
+        else
+            std::snprintf(line, sizeof(line), "  %-44s %-10s prepare %7.1f ms  upload %7.1f ms\n",
+                          node->name.c_str(), stageName(node->stage), node->prepareMs, node->uploadMs);
+        out += line;
+    }
+    return out;
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Startup work as a small dependency graph. Each task has an optional CPU
+// "prepare" step (file decoding, mesh generation; runs on any thread) and an
+// optional "upload" step that runs on the calling (GL) thread.
+//
+//   Critical    needed by the first frame: runCritical() prepares them on all
+//               cores and uploads them before returning
+//   Background  prepared on a loader thread after start(), uploaded a few per
+//               frame by pump()
+//   OnDemand    left alone until require()
+//
+// require() finishes any task immediately (running or waiting for its prepare
+// step), so a resource is never missing when code asks for it. Dependencies
+// order the upload steps only; a task may depend on tasks added before it, and
+// a Background task only on Critical or Background ones. Add every task before
+// runCritical().
+class StartupGraph
+{
+public:
+    enum class Stage
+    {
+        Critical,
+        Background,
+        OnDemand
+    };
+    using Task = int;
+
+    StartupGraph() = default;
+    ~StartupGraph();
+    StartupGraph(const StartupGraph &) = delete;
+    StartupGraph &operator=(const StartupGraph &) = delete;
+
+    Task add(std::string name, Stage stage, std::function<void()> prepare,
+             std::function<void()> upload, std::vector<Task> deps = {});
+
+    void runCritical();
+    void start();               // begin preparing Background tasks
+    int pump(double budgetMs);  // upload ready Background tasks; at least one if any is ready
+    void require(Task task);
+    void cancel();              // stop the loader thread (before GL teardown)
+
+    bool done(Task task) const;
+    bool backgroundPending() const;
+    double criticalMs() const { return m_criticalMs; }
+
+    // one line per task: stage, prepare / upload time
+    std::string report() const;
+
+private:
+    enum class State
+    {
+        Pending,
+        Preparing,
+        Prepared,
+        Done
+    };
+
+    struct Node
+    {
+        std::string name;
+        Stage stage;
+        std::function<void()> prepare;
+        std::function<void()> upload;
+        std::vector<Task> deps;
+        State state = State::Pending;
+        double prepareMs = 0.0;
+        double uploadMs = 0.0;
+    };
+
+    bool claim(Node &node);
+    void prepareNode(Node &node);
+    void finish(Task task);
+    void loaderLoop();
+
+    std::vector<std::unique_ptr<Node>> m_nodes;
+    mutable std::mutex m_mutex; // node states and timings
+    std::condition_variable m_prepared;
+    std::thread m_loader;
+    std::atomic<bool> m_stop{false};
+    double m_criticalMs = 0.0;
+};
@@ -0,0 +1,62 @@
+#include "striped_image_writer.h"
+
+#include <algorithm>
+#include <iostream>
+
+StripedImageWriter::~StripedImageWriter()
+{
+    if (m_file)
+        close();
+}
+
+bool StripedImageWriter::open(const std::string &path, int width, int height)
+{
+    if (m_file)
+        close();
+    if (width <= 0 || height <= 0)
+        return false;
+
+    m_file = std::fopen(path.c_str(), "wb");
+    if (!m_file)
+    {
+        std::cerr << "[image] cannot open " << path << " for writing" << std::endl;
+        return false;
+    }
+    m_path = path;
+    m_width = width;
+    m_height = height;
+    m_rowsWritten = 0;
+    m_ok = std::fprintf(m_file, "P6\n%d %d\n255\n", width, height) > 0;
+    return m_ok;
+}
+
+bool StripedImageWriter::writeRows(const unsigned char *rgb, int rows)
+{
+    if (!m_file || !m_ok)
+        return false;
+    rows = std::min(rows, m_height - m_rowsWritten);
+    if (rows <= 0)
+        return false;
+
+    const std::size_t bytes = std::size_t(m_width) * 3 * std::size_t(rows);
+    m_ok = std::fwrite(rgb, 1, bytes, m_file) == bytes;
+    if (m_ok)
+        m_rowsWritten += rows;
+    return m_ok;
+}
+
+bool StripedImageWriter::close()
+{
+    if (!m_file)
+        return false;
+    bool ok = m_ok && m_rowsWritten == m_height;
+    ok = (std::fclose(m_file) == 0) && ok;
+    m_file = nullptr;
+    if (!ok)
+    {
+        std::cerr << "[image] " << m_path << ": only " << m_rowsWritten << " of " << m_height
+                  << " rows written, removed" << std::endl;
+        std::remove(m_path.c_str());
+    }
+    return ok;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdio>
+#include <string>
+
+// Writes an RGB image to disk a stripe of rows at a time, top row first, so
+// an image of any size needs only one stripe in memory. The file is a binary
+// PPM (P6): a fixed header then raw rows, which is what lets it be streamed
+// without knowing the pixels in advance.
+class StripedImageWriter
+{
+public:
+    StripedImageWriter() = default;
+    ~StripedImageWriter(); // closes; an unfinished image is removed
+
+    StripedImageWriter(const StripedImageWriter &) = delete;
+    StripedImageWriter &operator=(const StripedImageWriter &) = delete;
+
+    bool open(const std::string &path, int width, int height);
+
+    // rows x width tightly packed RGB pixels, continuing where the last call stopped
+    bool writeRows(const unsigned char *rgb, int rows);
+
+    // true if every row was written and flushed to disk
+    bool close();
+
+    int width() const { return m_width; }
+    int height() const { return m_height; }
+    int rowsWritten() const { return m_rowsWritten; }
+
+private:
+    std::FILE *m_file = nullptr;
+    std::string m_path;
+    int m_width = 0;
+    int m_height = 0;
+    int m_rowsWritten = 0;
+    bool m_ok = false;
+};
@@ -0,0 +1,49 @@
+#include "tile_layout.h"
+
+#include <algorithm>
+
+TileLayout::TileLayout(int imageWidth, int imageHeight, int tileSize, int margin)
+    : m_width(std::max(1, imageWidth)), m_height(std::max(1, imageHeight)), m_tileSize(std::max(1, tileSize)),
+      m_margin(std::max(0, margin))
+{
+    m_columns = (m_width + m_tileSize - 1) / m_tileSize;
+    m_rows = (m_height + m_tileSize - 1) / m_tileSize;
+}
+
+RenderTile TileLayout::tile(int row, int column) const
+{
+    RenderTile t;
+    t.x = column * m_tileSize;
+    t.y = row * m_tileSize;
+    t.width = std::min(m_tileSize, m_width - t.x);
+    t.height = std::min(m_tileSize, m_height - t.y);
+    t.margin = m_margin;
+    return t;
+}
+
+glm::vec4 TileLayout::ndcWindow(const RenderTile &t) const
+{
+    float left = float(t.x - t.margin) / float(m_width);
+    float right = float(t.x + t.width + t.margin) / float(m_width);
+    float top = float(t.y - t.margin) / float(m_height);
+    float bottom = float(t.y + t.height + t.margin) / float(m_height);
+    // image rows run down, NDC y runs up
+    return glm::vec4(2.f * left - 1.f, 1.f - 2.f * bottom, 2.f * right - 1.f, 1.f - 2.f * top);
+}
+
+glm::ivec2 TileLayout::windowOrigin(const RenderTile &t) const
+{
+    return glm::ivec2(t.x - t.margin, m_height - (t.y + t.height + t.margin));
+}
+
+glm::mat4 windowMatrix(const glm::vec4 &window)
+{
+    float l = window.x, b = window.y, r = window.z, t = window.w;
+    glm::mat4 m(1.f);
+    m[0][0] = 2.f / (r - l);
+    m[1][1] = 2.f / (t - b);
+    // times clip w, so it applies after the perspective divide
+    m[3][0] = -(r + l) / (r - l);
+    m[3][1] = -(t + b) / (t - b);
+    return m;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+// Splits a width x height image into tiles rendered one at a time, for
+// images larger than any framebuffer. Each tile is rendered with a margin
+// of extra pixels on every side (cropped again afterwards) so screen-space
+// effects near its edges - depth of field, water distortion - see the same
+// neighbourhood they would in one big render, and the seams do not show.
+//
+// Image coordinates are pixels with y down from the top row; tiles are
+// numbered row by row from the top, so a tile row is a horizontal stripe
+// of the final image.
+struct RenderTile
+{
+    int x = 0, y = 0;          // top-left of the kept (inner) rectangle
+    int width = 0, height = 0; // kept size
+    int margin = 0;
+
+    int renderWidth() const { return width + 2 * margin; }
+    int renderHeight() const { return height + 2 * margin; }
+};
+
+class TileLayout
+{
+public:
+    TileLayout(int imageWidth, int imageHeight, int tileSize, int margin);
+
+    int columns() const { return m_columns; }
+    int rows() const { return m_rows; }
+    RenderTile tile(int row, int column) const;
+
+    // (left, bottom, right, top) in NDC of the full image covered by the
+    // tile's render rectangle, margin included; past [-1, 1] at the borders
+    glm::vec4 ndcWindow(const RenderTile &t) const;
+
+    // Bottom-left of the tile's render rectangle in GL window coordinates of
+    // the full image (y up), i.e. what gl_FragCoord in the tile is offset by
+    glm::ivec2 windowOrigin(const RenderTile &t) const;
+
+private:
+    int m_width, m_height;
+    int m_tileSize, m_margin;
+    int m_columns, m_rows;
+};
+
+// Maps the NDC sub-rectangle window = (left, bottom, right, top) onto the
+// whole of [-1, 1]^2: windowMatrix(w) * proj renders just that part of proj's
+// view (an off-centre frustum). Depth is unchanged.
+glm::mat4 windowMatrix(const glm::vec4 &window);
@@ -0,0 +1,226 @@
+#include "trace.h"
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Tracer
+{
+std::atomic<bool> g_active{false};
+
+namespace
+{
+// record() calls between their g_active check and their ring write; stop()
+// waits for it to reach zero so writeJson() and start() see quiet rings
+std::atomic<int> s_recording{0};
+}
+
+namespace
+{
+struct Event
+{
+    const char *name;
+    std::int64_t beginNs;
+    std::int64_t endNs;
+};
+
+// Written only by the thread that owns it, and only while a capture runs;
+// read by writeJson() once stop() has let the last write finish. A thread hands its ring back on exit so short-lived
+// workers (parallelFor) reuse rings instead of growing the set.
+struct ThreadRing
+{
+    int tid = 0;
+    std::string name;
+    std::vector<Event> events; // RING_CAPACITY slots
+    std::atomic<std::uint64_t> written{0};
+    bool inUse = false;
+};
+
+std::mutex s_ringsMutex; // guards the ring list and hand-out, never the hot path
+std::vector<std::unique_ptr<ThreadRing>> s_rings;
+std::int64_t s_captureStartNs = 0;
+
+ThreadRing *acquireRing(const char *threadName)
+{
+    std::lock_guard<std::mutex> lock(s_ringsMutex);
+    for (auto &ring : s_rings)
+    {
+        if (!ring->inUse)
+        {
+            ring->inUse = true;
+            ring->name = threadName ? threadName : "";
+            return ring.get();
+        }
+    }
+    auto ring = std::make_unique<ThreadRing>();
+    ring->tid = int(s_rings.size()) + 1;
+    ring->name = threadName ? threadName : "";
+    ring->events.resize(RING_CAPACITY);
+    ring->inUse = true;
+    s_rings.push_back(std::move(ring));
+    return s_rings.back().get();
+}
+
+struct RingHandle
+{
+    ThreadRing *ring = nullptr;
+    ~RingHandle()
+    {
+        if (!ring)
+            return;
+        std::lock_guard<std::mutex> lock(s_ringsMutex);
+        ring->inUse = false;
+    }
+};
+
+thread_local RingHandle t_ring;
+thread_local const char *t_threadName = nullptr; // applied when the ring is acquired
+
+ThreadRing &threadRing()
+{
+    if (!t_ring.ring)
+        t_ring.ring = acquireRing(t_threadName);
+    return *t_ring.ring;
+}
+
+void writeEscaped(std::ostream &out, const char *s)
+{
+    for (; *s; ++s)
+    {
+        if (*s == '"' || *s == '\\')
+            out << '\\';
+        out << *s;
+    }
+}
+}
+
+std::int64_t nowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+void record(const char *name, std::int64_t beginNs, std::int64_t endNs)
+{
+    // announced before the check (both seq_cst): either stop() waits for this
+    // write, or this sees the capture is over. A zone still open at stop()
+    // is dropped.
+    s_recording.fetch_add(1);
+    if (g_active.load())
+    {
+        ThreadRing &ring = threadRing();
+        std::uint64_t n = ring.written.load(std::memory_order_relaxed);
+        ring.events[n % RING_CAPACITY] = Event{name, beginNs, endNs};
+        ring.written.store(n + 1, std::memory_order_release);
+    }
+    s_recording.fetch_sub(1, std::memory_order_release);
+}
+
+void start()
+{
+    if (active())
+        stop(); // the rings are only reset while nothing writes to them
+    {
+        std::lock_guard<std::mutex> lock(s_ringsMutex);
+        for (auto &ring : s_rings)
+            ring->written.store(0, std::memory_order_relaxed);
+        s_captureStartNs = nowNs();
+    }
+    g_active.store(true, std::memory_order_release);
+    std::cout << "[trace] capture started\n";
+}
+
+void stop()
+{
+    g_active.store(false);
+    while (s_recording.load(std::memory_order_acquire) != 0)
+        std::this_thread::yield(); // at most one event write per thread
+    std::cout << "[trace] capture stopped\n";
+}
+
+bool active()
+{
+    return g_active.load(std::memory_order_relaxed);
+}
+
+void setThreadName(const char *name)
+{
+    // threads that never record an event never get a ring
+    t_threadName = name;
+    if (t_ring.ring)
+    {
+        std::lock_guard<std::mutex> lock(s_ringsMutex);
+        t_ring.ring->name = name;
+    }
+}
+
+std::uint64_t droppedEvents()
+{
+    std::lock_guard<std::mutex> lock(s_ringsMutex);
+    std::uint64_t dropped = 0;
+    for (auto &ring : s_rings)
+    {
+        std::uint64_t n = ring->written.load(std::memory_order_acquire);
+        if (n > std::uint64_t(RING_CAPACITY))
+            dropped += n - RING_CAPACITY;
+    }
+    return dropped;
+}
+
+bool writeJson(const std::string &path)
+{
+    if (active())
+        stop();
+
+    std::ofstream out(path);
+    if (!out)
+    {
+        std::cerr << "Error: could not write " << path << std::endl;
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(s_ringsMutex);
+    out << std::fixed;
+    out.precision(3);
+    out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+    bool first = true;
+    std::size_t count = 0;
+    for (auto &ring : s_rings)
+    {
+        if (!ring->name.empty())
+        {
+            out << (first ? "" : ",\n") << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": "
+                << ring->tid << ", \"args\": {\"name\": \"";
+            writeEscaped(out, ring->name.c_str());
+            out << "\"}}";
+            first = false;
+        }
+
+        std::uint64_t n = ring->written.load(std::memory_order_acquire);
+        std::uint64_t begin = n > std::uint64_t(RING_CAPACITY) ? n - RING_CAPACITY : 0;
+        for (std::uint64_t i = begin; i < n; ++i)
+        {
+            const Event &e = ring->events[i % RING_CAPACITY];
+            if (e.beginNs < s_captureStartNs)
+                continue; // zone opened before this capture started
+            // microseconds with ns precision, relative to start()
+            out << (first ? "" : ",\n") << "{\"name\": \"";
+            writeEscaped(out, e.name);
+            out << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << ring->tid
+                << ", \"ts\": " << double(e.beginNs - s_captureStartNs) * 1e-3
+                << ", \"dur\": " << double(e.endNs - e.beginNs) * 1e-3 << "}";
+            first = false;
+            ++count;
+        }
+    }
+    out << "\n]}\n";
+
+    std::cout << "[trace] wrote " << count << " events to " << path << "\n";
+    return bool(out);
+}
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// CPU event tracer writing the Chrome trace format (chrome://tracing, Perfetto).
+//
+// TRACE_SCOPE("name") records one complete event for the enclosing scope while
+// a capture is running. Each thread appends to its own fixed-size ring (no
+// locks on the hot path; the oldest events are overwritten when it wraps), and
+// the rings are collected by Tracer::writeJson() after stop(). stop() waits
+// for event writes already under way; zones still open at that point are
+// dropped. Names must be string literals or otherwise outlive the capture.
+//
+// Configure with -DENABLE_TRACING=OFF to compile every zone away.
+
+#ifndef TRACE_ENABLED
+#define TRACE_ENABLED 1
+#endif
+
+namespace Tracer
+{
+// events kept per thread; older ones are dropped once a ring wraps
+constexpr int RING_CAPACITY = 1 << 15;
+
+void start();
+void stop();
+bool active();
+
+// label for the calling thread in the trace viewer (string literal)
+void setThreadName(const char *name);
+
+// events dropped to ring wrap-around during the last capture
+std::uint64_t droppedEvents();
+
+// Chrome trace JSON of the last capture (stops a running one first)
+bool writeJson(const std::string &path);
+
+// internal
+extern std::atomic<bool> g_active;
+std::int64_t nowNs();
+void record(const char *name, std::int64_t beginNs, std::int64_t endNs);
+}
+
+class TraceZone
+{
+public:
+    explicit TraceZone(const char *name)
+        : m_name(Tracer::g_active.load(std::memory_order_relaxed) ? name : nullptr),
+          m_begin(m_name ? Tracer::nowNs() : 0)
+    {
+    }
+    ~TraceZone()
+    {
+        if (m_name)
+            Tracer::record(m_name, m_begin, Tracer::nowNs());
+    }
+    TraceZone(const TraceZone &) = delete;
+    TraceZone &operator=(const TraceZone &) = delete;
+
+private:
+    const char *m_name;
+    std::int64_t m_begin;
+};
+
+#if TRACE_ENABLED
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_SCOPE(name) TraceZone TRACE_CONCAT(traceZone_, __LINE__)(name)
+#else
+#define TRACE_SCOPE(name) ((void)0)
+#endif
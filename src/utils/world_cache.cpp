@@ -0,0 +1,239 @@
+#include "world_cache.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+
+namespace
+{
+// bump when generation changes what the same parameters produce
+constexpr std::uint32_t GENERATOR_VERSION = 1;
+constexpr std::uint32_t TERRAIN_VERSION = 1;
+constexpr std::uint32_t FOREST_VERSION = 1;
+
+// FNV-1a over parameter values, field by field (struct bytes include padding)
+struct KeyHash
+{
+    std::uint64_t h = 1469598103934665603ull;
+
+    template <class T>
+    KeyHash &add(const T &v)
+    {
+        unsigned char bytes[sizeof(T)];
+        std::memcpy(bytes, &v, sizeof(T));
+        for (unsigned char b : bytes)
+            h = (h ^ b) * 1099511628211ull;
+        return *this;
+    }
+};
+
+KeyHash &addTerrain(KeyHash &k, const TerrainGenerator::TerrainParams &p)
+{
+    return k.add(p.octaves).add(p.baseFreq).add(p.lacunarity).add(p.gain).add(p.heightScale).add(p.warpStrength)
+        .add(p.cliffSteps).add(p.cliffSmooth).add(p.enableRivers).add(p.riverFreq).add(p.riverSharp)
+        .add(p.riverThresh).add(p.riverDepth).add(p.seaLevel).add(p.oceanBias).add(p.valleyWidth)
+        .add(p.valleyDepth).add(p.valleyMeander).add(p.lakeRadius).add(p.lakeDepth).add(p.enableCraters)
+        .add(p.craterDensity).add(p.craterRadius).add(p.craterDepth).add(p.seed).add(GENERATOR_VERSION);
+}
+
+std::string cacheName(const std::string &dir, const char *prefix, std::uint64_t key, const char *ext)
+{
+    char name[64];
+    std::snprintf(name, sizeof(name), "%s_%016llx.%s", prefix, (unsigned long long)key, ext);
+    return (std::filesystem::path(dir) / name).string();
+}
+
+template <class T>
+void writePod(std::ofstream &out, const T &v)
+{
+    out.write(reinterpret_cast<const char *>(&v), sizeof(T));
+}
+
+template <class T>
+void writeArray(std::ofstream &out, const std::vector<T> &v)
+{
+    writePod(out, std::uint64_t(v.size()));
+    out.write(reinterpret_cast<const char *>(v.data()), std::streamsize(v.size() * sizeof(T)));
+}
+
+template <class T>
+bool readPod(std::ifstream &in, T &v)
+{
+    return bool(in.read(reinterpret_cast<char *>(&v), sizeof(T)));
+}
+
+template <class T>
+bool readArray(std::ifstream &in, std::vector<T> &v, std::uint64_t remaining)
+{
+    std::uint64_t n = 0;
+    if (!readPod(in, n) || n > remaining / sizeof(T))
+        return false;
+    v.resize(std::size_t(n));
+    return bool(in.read(reinterpret_cast<char *>(v.data()), std::streamsize(n * sizeof(T))));
+}
+
+// write through a uniquely named temporary, then rename over path
+template <class WriteFn>
+bool writeAtomically(const std::string &path, WriteFn write)
+{
+    std::error_code ec;
+    std::filesystem::path target(path);
+    if (target.has_parent_path())
+        std::filesystem::create_directories(target.parent_path(), ec);
+
+    char suffix[32];
+    std::snprintf(suffix, sizeof(suffix), ".%08x.tmp", unsigned(std::random_device{}()));
+    const std::string tmp = path + suffix;
+    bool ok;
+    {
+        std::ofstream out(tmp, std::ios::binary);
+        ok = out && write(out) && out.flush();
+    }
+    if (ok)
+        std::filesystem::rename(tmp, target, ec);
+    if (!ok || ec)
+    {
+        std::filesystem::remove(tmp, ec);
+        return false;
+    }
+    return true;
+}
+
+std::uint64_t fileSize(std::ifstream &in)
+{
+    in.seekg(0, std::ios::end);
+    std::uint64_t size = std::uint64_t(in.tellg());
+    in.seekg(0);
+    return size;
+}
+} // namespace
+
+std::string terrainCachePath(const std::string &dir, const TerrainGenerator::TerrainParams &params, int resolution,
+                             int patchesPerSide)
+{
+    KeyHash k;
+    addTerrain(k, params).add(resolution).add(patchesPerSide).add(TerrainMeshData::LODS);
+    return cacheName(dir, "terrain", k.h, "attm");
+}
+
+std::string forestCachePath(const std::string &dir, const TerrainGenerator::TerrainParams &terrain,
+                            const ForestPlacementParams &placement)
+{
+    KeyHash k;
+    addTerrain(k, terrain)
+        .add(placement.coverage)
+        .add(placement.treeSize)
+        .add(placement.leafDensity)
+        .add(placement.seaLevel)
+        .add(placement.heightScale)
+        .add(placement.seed);
+    return cacheName(dir, "forest", k.h, "atfr");
+}
+
+// "ATTM" v1: u32 lods, then per LOD u64 + f32 vertices, u64 + patches (raw TerrainPatch)
+bool writeTerrainCache(const std::string &path, const TerrainMeshData &terrain)
+{
+    return writeAtomically(path, [&](std::ofstream &out) {
+        out.write("ATTM", 4);
+        writePod(out, TERRAIN_VERSION);
+        writePod(out, std::uint32_t(TerrainMeshData::LODS));
+        for (int lod = 0; lod < TerrainMeshData::LODS; ++lod)
+        {
+            writeArray(out, terrain.vertices[lod]);
+            writeArray(out, terrain.patches[lod]);
+        }
+        return bool(out);
+    });
+}
+
+bool readTerrainCache(const std::string &path, TerrainMeshData &terrain)
+{
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+        return false;
+    const std::uint64_t size = fileSize(in);
+
+    char magic[4] = {};
+    std::uint32_t version = 0, lods = 0;
+    if (!in.read(magic, 4) || std::memcmp(magic, "ATTM", 4) != 0 || !readPod(in, version) ||
+        version != TERRAIN_VERSION || !readPod(in, lods) || lods != std::uint32_t(TerrainMeshData::LODS))
+        return false;
+
+    TerrainMeshData t;
+    for (int lod = 0; lod < TerrainMeshData::LODS; ++lod)
+        if (!readArray(in, t.vertices[lod], size) || !readArray(in, t.patches[lod], size))
+            return false;
+    terrain = std::move(t);
+    return true;
+}
+
+bool writeForestFile(const std::string &path, const ForestInstances &forest)
+{
+    return writeAtomically(path, [&](std::ofstream &out) {
+        out.write("ATFR", 4);
+        writePod(out, FOREST_VERSION);
+        writePod(out, std::uint32_t(forest.branches.size()));
+        writePod(out, std::uint32_t(forest.leaves.size()));
+        writePod(out, std::uint32_t(forest.trees.size()));
+        for (const BranchInstance &b : forest.branches)
+        {
+            out.write(reinterpret_cast<const char *>(&b.model[0][0]), sizeof(float) * 16);
+            writePod(out, b.radius);
+        }
+        out.write(reinterpret_cast<const char *>(forest.leaves.data()),
+                  std::streamsize(forest.leaves.size() * sizeof(glm::mat4)));
+        for (const ForestTreeRange &t : forest.trees)
+        {
+            out.write(reinterpret_cast<const char *>(&t.center[0]), sizeof(float) * 3);
+            writePod(out, t.radius);
+            writePod(out, std::int32_t(t.branchFirst));
+            writePod(out, std::int32_t(t.branchCount));
+            writePod(out, std::int32_t(t.leafFirst));
+            writePod(out, std::int32_t(t.leafCount));
+        }
+        return bool(out);
+    });
+}
+
+bool readForestFile(const std::string &path, ForestInstances &forest)
+{
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+        return false;
+    const std::uint64_t size = fileSize(in);
+
+    char magic[4] = {};
+    std::uint32_t version = 0, branches = 0, leaves = 0, trees = 0;
+    if (!in.read(magic, 4) || std::memcmp(magic, "ATFR", 4) != 0 || !readPod(in, version) ||
+        version != FOREST_VERSION || !readPod(in, branches) || !readPod(in, leaves) || !readPod(in, trees))
+        return false;
+    // 68 / 64 / 32 bytes per record
+    if (std::uint64_t(branches) * 68 + std::uint64_t(leaves) * 64 + std::uint64_t(trees) * 32 > size)
+        return false;
+
+    ForestInstances f;
+    f.branches.resize(branches);
+    for (BranchInstance &b : f.branches)
+        if (!in.read(reinterpret_cast<char *>(&b.model[0][0]), sizeof(float) * 16) || !readPod(in, b.radius))
+            return false;
+    f.leaves.resize(leaves);
+    if (!in.read(reinterpret_cast<char *>(f.leaves.data()), std::streamsize(f.leaves.size() * sizeof(glm::mat4))))
+        return false;
+    f.trees.resize(trees);
+    for (ForestTreeRange &t : f.trees)
+    {
+        std::int32_t v[4];
+        if (!in.read(reinterpret_cast<char *>(&t.center[0]), sizeof(float) * 3) || !readPod(in, t.radius) ||
+            !in.read(reinterpret_cast<char *>(v), sizeof(v)))
+            return false;
+        t.branchFirst = v[0];
+        t.branchCount = v[1];
+        t.leafFirst = v[2];
+        t.leafCount = v[3];
+    }
+    forest = std::move(f);
+    return true;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "terrain/terraingenerator.h"
+#include "vegetation/forest_placement.h"
+
+// On-disk copies of the generated world - terrain meshes and forest
+// instances - named after a hash of everything they are generated from, so
+// later runs and the render-farm workers (--farm) sharing a cache directory
+// skip regeneration. Files are written under a temporary name and renamed
+// into place: processes reading the directory never see half a file.
+
+// The CPU side of the terrain: interleaved PNC vertices and patch ranges per
+// LOD (steps 1, 2, 4), as TerrainGenerator::generateTerrain() returns them
+struct TerrainMeshData
+{
+    static constexpr int LODS = 3;
+    std::vector<float> vertices[LODS];
+    std::vector<TerrainGenerator::TerrainPatch> patches[LODS];
+};
+
+std::string terrainCachePath(const std::string &dir, const TerrainGenerator::TerrainParams &params, int resolution,
+                             int patchesPerSide);
+std::string forestCachePath(const std::string &dir, const TerrainGenerator::TerrainParams &terrain,
+                            const ForestPlacementParams &placement);
+
+bool writeTerrainCache(const std::string &path, const TerrainMeshData &terrain);
+bool readTerrainCache(const std::string &path, TerrainMeshData &terrain);
+
+// "ATFR" v1, the layout terrain_batch writes: u32 branchCount, leafCount,
+// treeCount; branches as f32 model[16] + f32 radius; leaves as f32 model[16];
+// trees as f32 center[3], f32 radius, i32 branchFirst, branchCount,
+// leafFirst, leafCount. All world space. clusters is not stored.
+bool writeForestFile(const std::string &path, const ForestInstances &forest);
+bool readForestFile(const std::string &path, ForestInstances &forest);
@@ -0,0 +1,307 @@
+#include "forest_placement.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "terrain/terraingenerator.h"
+#include "utils/mem_tracker.h"
+#include "utils/trace.h"
+
+namespace
+{
+constexpr float EPS = 1e-6f;
+
+float clamp01(float v) { return glm::clamp(v, 0.f, 1.f); }
+
+// *Tree location estimation: approximates computeGrassRockWeights in terrain.frag,
+// returns [0,1]: the closer to 1, the more it resembles grass.
+float grassWeightApprox(float hNorm, float slope)
+{
+    // rockBeach
+    float rockBeach = 1.f - glm::smoothstep(0.02f, 0.12f, hNorm);
+
+    // grassBand
+    float grassBand = glm::smoothstep(0.05f, 0.80f, hNorm);
+
+    // rockSlope
+    float rockSlope = glm::smoothstep(0.75f, 0.90f, slope);
+
+    float wRock = std::max(rockBeach, rockSlope);
+    float wGrass = grassBand * (1.f - 0.7f * rockSlope);
+
+    wGrass *= 1.4f;
+    wRock *= 0.7f;
+
+    float s = wGrass + wRock + EPS;
+    return wGrass / s;
+}
+}
+
+ForestPlacer::ForestPlacer(const TerrainGenerator &terrain, const glm::mat4 &terrainModel,
+                           const ForestPlacementParams &params)
+    : m_terrain(terrain), m_terrainModel(terrainModel), m_params(params), m_rng(params.seed)
+{
+    // Adjustable: basic params
+    m_baseParams.iterations = 4;
+    m_baseParams.stepLength = 0.055f;
+    m_baseParams.baseAngleDeg = 30.0f;
+    m_baseParams.angleJitterDeg = 15.0f;
+    m_baseParams.baseRadius = 0.018f;
+    m_baseParams.radiusDecay = 0.75f;
+    m_baseParams.leafDensity = 1.0f;
+
+    int s4 = std::max(1, params.coverage);
+    int s5 = std::max(1, params.treeSize);
+    int s6 = std::max(1, params.leafDensity);
+
+    float cov01 = clamp01((s4 - 1) / 99.f);
+    m_size01 = clamp01((s5 - 1) / 39.f);
+    m_leaf01 = clamp01((s6 - 1) / 39.f);
+
+    // Coverage -> Number of clusters / Radius / Number of trees per cluster
+
+    // cluster number
+    m_clusterCount = 12 + int(glm::mix(40.f, 160.f, cov01)); // s4=1 → 10 簇, s4=10 → 64, s4=25 → 154
+
+    // number of trees per cluster: The higher the density, the more trees per cluster.
+    m_treesPerClusterMin = 4 + int(glm::mix(3.f, 10.f, m_size01)); // 7 ~ 14
+    m_treesPerClusterMax = m_treesPerClusterMin + 4;
+
+    // cluster radius: The larger the cov, the more compact the cluster.
+    m_clusterRadiusBase = glm::mix(0.10f, 0.03f, cov01);
+
+    m_seaMargin = 0.02f * params.heightScale;
+}
+
+float ForestPlacer::surfaceHeight(glm::vec2 uv) const
+{
+    glm::vec3 pL = m_terrain.sampleSurfacePos(clamp01(uv.x), clamp01(uv.y));
+    return (m_terrainModel * glm::vec4(pL, 1.f)).y;
+}
+
+bool ForestPlacer::startCluster()
+{
+    while (++m_cluster < m_clusterCount)
+    {
+        // Find a center "above the sea surface"
+        bool foundCenter = false;
+        for (int tries = 0; tries < 32 && !foundCenter; ++tries)
+        {
+            glm::vec2 uv(rand01(), rand01());
+            if (surfaceHeight(uv) <= m_params.seaLevel + m_seaMargin)
+                continue;
+
+            m_centerUV = uv;
+            foundCenter = true;
+        }
+        if (!foundCenter)
+            continue;
+
+        m_clusterRadius = m_clusterRadiusBase * (0.7f + 0.6f * rand01());
+        m_bushesInCluster = m_treesPerClusterMin +
+                            int(rand01() * float(m_treesPerClusterMax - m_treesPerClusterMin + 1));
+        m_bush = 0;
+        return true;
+    }
+    return false;
+}
+
+bool ForestPlacer::next(TreePlacement &out)
+{
+    for (;;)
+    {
+        if (m_cluster < 0 || m_bush >= m_bushesInCluster)
+        {
+            if (!startCluster())
+                return false;
+        }
+        ++m_bush;
+
+        // Sample a point inside small disk
+        float ang = 2.f * float(M_PI) * rand01();
+        float r = m_clusterRadius * std::sqrt(rand01());
+        glm::vec2 uv = m_centerUV + r * glm::vec2(std::cos(ang), std::sin(ang));
+        uv.x = clamp01(uv.x);
+        uv.y = clamp01(uv.y);
+
+        glm::vec3 surfLocal = m_terrain.sampleSurfacePos(uv.x, uv.y);
+        glm::vec3 pWorld = glm::vec3(m_terrainModel * glm::vec4(surfLocal, 1.f));
+
+        if (pWorld.y <= m_params.seaLevel + m_seaMargin)
+            continue;
+
+        // height normalization
+        float hNorm = glm::clamp(
+            (pWorld.y - m_params.seaLevel) / std::max(m_params.heightScale, EPS),
+            0.0f, 1.0f);
+
+        // Estimate normal -> Estimate slope
+        const float eps = 1.0f / 512.0f;
+        float h0 = pWorld.y;
+        float hdx = surfaceHeight(glm::vec2(uv.x + eps, uv.y));
+        float hdy = surfaceHeight(glm::vec2(uv.x, uv.y + eps));
+
+        glm::vec3 dx = glm::vec3(eps, hdx - h0, 0.f);
+        glm::vec3 dz = glm::vec3(0.f, hdy - h0, eps);
+        glm::vec3 nWorld = glm::normalize(glm::cross(dz, dx));
+
+        // slope = 0 (flat), 1 (vertical)
+        float slope = glm::clamp(
+            1.0f - glm::dot(nWorld, glm::vec3(0, 1, 0)),
+            0.0f, 1.0f);
+
+        // grassland weight (0..1), height & slope considered together
+        float wGrass = grassWeightApprox(hNorm, slope);
+
+        // too steep will be banned directly;
+        // the rest will be determined by the weight of the grass.
+        if (slope > 0.96f)
+            continue; // almost vertical cliff has no trees.
+
+        // Adjustable: wGrass threshold: between 0.12 and 0.25.
+        if (wGrass < 0.18f)
+            continue;
+
+        // L-system parameters of tree
+        LSystemParams treeP = m_baseParams;
+
+        // Tree size slider (height/thickness/complexity)
+        treeP.stepLength *= (0.85f + 0.5f * rand01()) * glm::mix(0.7f, 1.4f, m_size01);
+        treeP.baseRadius *= glm::mix(0.7f, 1.3f, m_size01);
+
+        treeP.iterations = (m_size01 > 0.5f && rand01() < 0.5f) ? 3 : 2;
+
+        treeP.baseAngleDeg += (rand01() - 0.5f) * 12.0f;
+        treeP.angleJitterDeg *= (0.7f + 0.6f * rand01());
+        treeP.radiusDecay = glm::clamp(
+            m_baseParams.radiusDecay + (rand01() - 0.5f) * 0.2f,
+            0.6f, 0.95f);
+
+        // leafDensity slider： 0.5 ~ 2.0 times the leaf volume
+        treeP.leafDensity = glm::mix(0.5f, 2.0f, m_leaf01);
+
+        // grammar: randomly select one rule X
+        static const std::vector<std::string> xRules = {
+            "F[+FX][-FX][&FX][^FX]FX",
+            "F[+F&X][-F^X][+FX][&FX]X",
+            "F[+FX[&X]][-FX[^X]][&FX[+X]][^FX[-X]]X"};
+        int idx = int(rand01() * xRules.size());
+        if (idx >= (int)xRules.size())
+            idx = (int)xRules.size() - 1;
+
+        out.rules.clear();
+        out.rules['X'] = xRules[idx];
+        out.rules['F'] = "FF";
+        out.params = treeP;
+        out.position = pWorld;
+
+        // Random Size / Tilt / Orientation
+        // World Space Scaling: The size slider controls the overall size again
+        float treeScaleBase = glm::mix(0.12f, 0.28f, m_size01);
+        float treeScale = treeScaleBase * (0.8f + 0.4f * rand01());
+
+        // Adjustable: for controlling the size of the generating L-system tree
+        const float TREE_GLOBAL_SCALE = 20.f;
+        treeScale *= TREE_GLOBAL_SCALE;
+
+        float yaw = 2.f * float(M_PI) * rand01();
+        float tiltX = glm::radians((rand01() - 0.5f) * 8.f); // [-4°,4°]
+        float tiltZ = glm::radians((rand01() - 0.5f) * 8.f);
+
+        glm::mat4 T = glm::translate(glm::mat4(1.f), pWorld);
+        glm::mat4 R_yaw = glm::rotate(glm::mat4(1.f), yaw, glm::vec3(0, 1, 0));
+        glm::mat4 R_tiltX = glm::rotate(glm::mat4(1.f), tiltX, glm::vec3(1, 0, 0));
+        glm::mat4 R_tiltZ = glm::rotate(glm::mat4(1.f), tiltZ, glm::vec3(0, 0, 1));
+        glm::mat4 S = glm::scale(glm::mat4(1.f), glm::vec3(treeScale));
+
+        out.model = T * R_yaw * R_tiltZ * R_tiltX * S;
+
+        float bushScaleBase = 0.20f;
+        out.bushScale = bushScaleBase * (0.7f + 0.6f * rand01());
+        return true;
+    }
+}
+
+ForestInstances buildForestInstances(const TerrainGenerator &terrain, const glm::mat4 &terrainModel,
+                                     const ForestPlacementParams &params,
+                                     std::size_t maxBranches, std::size_t maxLeaves)
+{
+    TRACE_SCOPE("buildForestInstances");
+    MemTagScope memTag(MemTracker::Forest);
+    ForestInstances out;
+    ForestPlacer placer(terrain, terrainModel, params);
+
+    // unit-sized instance meshes: reach from the instance origin along its longest axis
+    auto instanceExtent = [](const glm::mat4 &M)
+    {
+        return std::max({glm::length(glm::vec3(M[0])), glm::length(glm::vec3(M[1])),
+                         glm::length(glm::vec3(M[2]))});
+    };
+
+    // one jitter stream per forest: the same inputs always grow the same trees
+    std::mt19937 growthRng(params.seed);
+
+    TreePlacement tp;
+    for (;;)
+    {
+        {
+            TRACE_SCOPE("tree placement");
+            if (!placer.next(tp))
+                break;
+        }
+
+        LSystemTree tree(tp.params, &growthRng);
+        tree.generate("X", tp.rules);
+
+        TRACE_SCOPE("tree flatten");
+
+        const auto &branches = tree.branches();
+        const auto &leaves = tree.leaves();
+        if (branches.empty())
+            continue;
+
+        const glm::vec3 &pWorld = tp.position;
+        const glm::mat4 &baseModel = tp.model;
+
+        ForestTreeRange range;
+        range.center = pWorld;
+        range.branchFirst = int(out.branches.size());
+        range.leafFirst = int(out.leaves.size());
+
+        // add all branches to the instance list
+        for (const BranchInstance &b : branches)
+        {
+            BranchInstance inst;
+            inst.radius = b.radius * tp.bushScale;
+            inst.model = baseModel * b.model;
+            out.branches.push_back(inst);
+            range.radius = std::max(range.radius,
+                                    glm::length(glm::vec3(inst.model[3]) - pWorld) +
+                                        instanceExtent(inst.model));
+        }
+
+        // all leaves
+        for (const LeafInstance &leaf : leaves)
+        {
+            glm::mat4 M = baseModel * leaf.model;
+            out.leaves.push_back(M);
+            range.radius = std::max(range.radius,
+                                    glm::length(glm::vec3(M[3]) - pWorld) + instanceExtent(M));
+        }
+
+        range.branchCount = int(out.branches.size()) - range.branchFirst;
+        range.leafCount = int(out.leaves.size()) - range.leafFirst;
+        out.trees.push_back(range);
+
+        if (out.branches.size() > maxBranches ||
+            out.leaves.size() > maxLeaves)
+        {
+            break;
+        }
+    }
+
+    out.clusters = placer.clusterCount();
+    return out;
+}
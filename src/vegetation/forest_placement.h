@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstddef>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "lsystem_tree.h"
+
+class TerrainGenerator;
+
+// Where the forest goes, independent of any GL resources: clusters of trees
+// on grassy, not-too-steep terrain above the sea. Each next() call yields one
+// tree (position, L-system parameters/rules and its world transform) in the
+// same order and with the same random sequence the renderer always used.
+struct ForestPlacementParams
+{
+    int coverage = 1;  // settings.shapeParameter4: clusters / coverage
+    int treeSize = 1;  // settings.shapeParameter5: tree size / complexity
+    int leafDensity = 1; // settings.shapeParameter6
+    float seaLevel = 0.f;  // world-space sea height used for the "above water" test
+    float heightScale = 1.f;
+    unsigned seed = 1337;
+};
+
+struct TreePlacement
+{
+    glm::vec3 position{0.f}; // world space, on the terrain surface
+    LSystemParams params;
+    std::unordered_map<char, std::string> rules;
+    glm::mat4 model{1.f};    // world transform of the tree's local space
+    float bushScale = 1.f;   // branch radius multiplier
+};
+
+class ForestPlacer
+{
+public:
+    ForestPlacer(const TerrainGenerator &terrain, const glm::mat4 &terrainModel,
+                 const ForestPlacementParams &params);
+
+    // false once every cluster has been visited
+    bool next(TreePlacement &out);
+
+    int clusterCount() const { return m_clusterCount; }
+
+private:
+    bool startCluster(); // pick the next cluster center; false if out of clusters
+    float rand01() { return m_dist01(m_rng); }
+    float surfaceHeight(glm::vec2 uv) const;
+
+    const TerrainGenerator &m_terrain;
+    glm::mat4 m_terrainModel;
+    ForestPlacementParams m_params;
+
+    std::mt19937 m_rng;
+    std::uniform_real_distribution<float> m_dist01{0.f, 1.f};
+
+    // derived from the sliders
+    float m_size01 = 0.f;
+    float m_leaf01 = 0.f;
+    int m_clusterCount = 0;
+    int m_treesPerClusterMin = 0;
+    int m_treesPerClusterMax = 0;
+    float m_clusterRadiusBase = 0.f;
+    float m_seaMargin = 0.f;
+    LSystemParams m_baseParams;
+
+    // iteration state
+    int m_cluster = -1;
+    glm::vec2 m_centerUV{0.f};
+    float m_clusterRadius = 0.f;
+    int m_bushesInCluster = 0;
+    int m_bush = 0;
+};
+
+// per-tree slice of the branch / leaf instance arrays
+struct ForestTreeRange
+{
+    glm::vec3 center{0.f};
+    float radius = 0.f; // bounding sphere around center, including instance extents
+    int branchFirst = 0;
+    int branchCount = 0;
+    int leafFirst = 0;
+    int leafCount = 0;
+};
+
+// every tree grown and flattened into world-space instances
+struct ForestInstances
+{
+    std::vector<BranchInstance> branches;
+    std::vector<glm::mat4> leaves;
+    std::vector<ForestTreeRange> trees;
+    int clusters = 0;
+};
+
+// Places, grows and flattens the whole forest. Stops after the tree that
+// pushes either instance list past its cap.
+ForestInstances buildForestInstances(const TerrainGenerator &terrain, const glm::mat4 &terrainModel,
+                                     const ForestPlacementParams &params,
+                                     std::size_t maxBranches = 800000,
+                                     std::size_t maxLeaves = 1600000);
@@ -3,14 +3,15 @@
 #include <random>
 #include <glm/gtc/constants.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include "utils/mem_tracker.h"
+#include "utils/trace.h"
 
 namespace {
 std::mt19937 s_rng(1337);
-std::uniform_real_distribution<float> s_jitter01(-1.f, 1.f);
 }
 
-LSystemTree::LSystemTree(const LSystemParams& p)
-    : m_params(p)
+LSystemTree::LSystemTree(const LSystemParams& p, std::mt19937* rng)
+    : m_params(p), m_rng(rng ? *rng : s_rng)
 {}
 
 void LSystemTree::rewrite(const std::unordered_map<char, std::string>& rules) {
@@ -83,8 +84,8 @@ void LSystemTree::interpret()
     // initial turtle: root at the origin, extending +Y
     t.pos     = glm::vec3(0.f);
     t.forward = glm::vec3(0.f, 1.f, 0.f);
-    // t.forward = glm::normalize(glm::vec3((s_jitter01(s_rng) * 0.15f),
-    //     1.f, (s_jitter01(s_rng) * 0.15f)));
+    // t.forward = glm::normalize(glm::vec3((m_jitter01(m_rng) * 0.15f),
+    //     1.f, (m_jitter01(m_rng) * 0.15f)));
     t.up      = glm::vec3(0.f, 0.f, 1.f);
     t.right   = glm::cross(t.forward, t.up);
     t.radius  = m_params.baseRadius;
@@ -93,7 +94,7 @@ void LSystemTree::interpret()
     float jitterMaxRad = glm::radians(m_params.angleJitterDeg);
 
     auto rotateAround = [&](float sign, const glm::vec3 &axis) {
-        float jitter = jitterMaxRad * s_jitter01(s_rng);
+        float jitter = jitterMaxRad * m_jitter01(m_rng);
         float a      = sign * (baseAngleRad + jitter);
         glm::mat4 R  = glm::rotate(glm::mat4(1.f), a, axis);
         t.forward    = glm::normalize(glm::vec3(R * glm::vec4(t.forward, 0.f)));
@@ -108,12 +109,12 @@ void LSystemTree::interpret()
         // Use forward + up directions, plus a little randomness.
         glm::vec3 twigBaseDir = glm::normalize(0.4f * t.forward + 0.8f * t.up);
         glm::vec3 jitterDir   = glm::normalize(
-            glm::vec3(s_jitter01(s_rng), s_jitter01(s_rng), s_jitter01(s_rng)));
+            glm::vec3(m_jitter01(m_rng), m_jitter01(m_rng), m_jitter01(m_rng)));
         glm::vec3 twigDir     = glm::normalize(twigBaseDir + 0.4f * jitterDir);
 
         // The length of the twig is somewhat random relative to the stepLength.
         float twigLen = 0.25f * m_params.stepLength *
-                        (0.7f + 0.6f * (0.5f + 0.5f * s_jitter01(s_rng))); // ≈ 0.175~0.325
+                        (0.7f + 0.6f * (0.5f + 0.5f * m_jitter01(m_rng))); // ≈ 0.175~0.325
         glm::vec3 twigEnd = center + twigDir * twigLen;
 
         BranchInstance twig;
@@ -138,8 +139,8 @@ void LSystemTree::interpret()
         float radiusScale = glm::mix(0.6f, 1.1f, 1.0f - rNorm);
 
         for (int i = 0; i < leafCount; ++i) {
-            float u = 0.5f * (s_jitter01(s_rng) + 1.0f); // [0,1]
-            float v = 0.5f * (s_jitter01(s_rng) + 1.0f);
+            float u = 0.5f * (m_jitter01(m_rng) + 1.0f); // [0,1]
+            float v = 0.5f * (m_jitter01(m_rng) + 1.0f);
 
             float ang = glm::two_pi<float>() * u;
 
@@ -158,11 +159,11 @@ void LSystemTree::interpret()
             // ellipsoidal leaflets, the size of which is also somewhat random.
             float baseScale = 0.010f;
             float s = baseScale * (0.7f + 0.8f * v); // 0.007~0.018
-            s *= (0.85f + 0.3f * s_jitter01(s_rng));
+            s *= (0.85f + 0.3f * m_jitter01(m_rng));
             glm::vec3 leafScale = glm::vec3(s, s * 0.55f, s);
 
             glm::mat4 M = glm::translate(glm::mat4(1.f), p);
-            float yaw   = glm::two_pi<float>() * 0.5f * (s_jitter01(s_rng) + 1.f);
+            float yaw   = glm::two_pi<float>() * 0.5f * (m_jitter01(m_rng) + 1.f);
             M = glm::rotate(M, yaw, t.up);
             M = glm::scale(M, leafScale);
 
@@ -203,7 +204,7 @@ void LSystemTree::interpret()
 
             // a cluster of small leaves may occasionally hang on slender branch,
             if (t.radius < m_params.baseRadius * 0.8f) {
-                float r = 0.5f * (s_jitter01(s_rng) + 1.0f);
+                float r = 0.5f * (m_jitter01(m_rng) + 1.0f);
                 if (r < 0.9f) {
                     emitLeafCluster(t.pos, t.radius);
                 }
@@ -234,7 +235,7 @@ void LSystemTree::interpret()
 
             // add a short random roll here to break the plane.
             {
-                float roll = jitterMaxRad * 0.7f * s_jitter01(s_rng); // +-(angleJitter*0.7)
+                float roll = jitterMaxRad * 0.7f * m_jitter01(m_rng); // +-(angleJitter*0.7)
 
                 // rotate around the current forward position, changing the up/right position.
                 glm::mat4 R = glm::rotate(glm::mat4(1.f), roll, t.forward);
@@ -260,7 +261,14 @@ void LSystemTree::interpret()
 void LSystemTree::generate(const std::string& axiom,
                            const std::unordered_map<char, std::string>& rules)
 {
+    MemTagScope memTag(MemTracker::LSystem);
     m_string = axiom;
-    rewrite(rules);
-    interpret();
+    {
+        TRACE_SCOPE("LSystem rewrite");
+        rewrite(rules);
+    }
+    {
+        TRACE_SCOPE("LSystem interpret");
+        interpret();
+    }
 }
@@ -1,4 +1,5 @@
 #pragma once
+#include <random>
 #include <string>
 #include <unordered_map>
 #include <vector>
@@ -28,7 +29,9 @@ struct LeafInstance {
 
 class LSystemTree {
 public:
-    explicit LSystemTree(const LSystemParams& p);
+    // rng: jitter source; nullptr = the process-wide stream (not thread-safe,
+    // and the result then depends on every tree grown before)
+    explicit LSystemTree(const LSystemParams& p, std::mt19937* rng = nullptr);
 
     // generate L-system string and interpret it as BranchInstance
     void generate(const std::string& axiom,
@@ -39,6 +42,8 @@ public:
 
 private:
     LSystemParams m_params;
+    std::mt19937& m_rng;
+    std::uniform_real_distribution<float> m_jitter01{-1.f, 1.f};
     std::string   m_string;
     std::vector<BranchInstance> m_branches;
     std::vector<LeafInstance> m_leaves;
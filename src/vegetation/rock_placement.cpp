@@ -0,0 +1,97 @@
+#include "rock_placement.h"
+
+#include <cmath>
+#include <random>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "terrain/terraingenerator.h"
+#include "utils/mem_tracker.h"
+#include "utils/trace.h"
+
+std::vector<glm::mat4> placeRocks(const TerrainGenerator &terrain, const glm::mat4 &terrainModel,
+                                  const RockPlacementParams &params)
+{
+    TRACE_SCOPE("placeRocks");
+    MemTagScope memTag(MemTracker::Rocks);
+    std::vector<glm::mat4> rocks;
+
+    std::mt19937 rng(params.seed); // Different seed
+    std::uniform_real_distribution<float> dist01(0.f, 1.f);
+
+    // Rock parameters
+    // Map slider (1-100) to rock count (e.g., 10 to 1000)
+    int rockCount = params.density * 10;
+    float seaHeightWorld = params.seaLevel;
+    float heightScale = params.heightScale;
+
+    auto clamp01 = [](float v)
+    { return glm::clamp(v, 0.f, 1.f); };
+
+    for (int i = 0; i < rockCount; ++i)
+    {
+        glm::vec2 uv(dist01(rng), dist01(rng));
+        glm::vec3 surfLocal = terrain.sampleSurfacePos(uv.x, uv.y);
+        glm::vec3 pWorld = glm::vec3(terrainModel * glm::vec4(surfLocal, 1.f));
+
+        // Don't place rocks underwater (or maybe some near the shore)
+        if (pWorld.y <= seaHeightWorld - 0.05f)
+            continue;
+
+        // Calculate slope
+        auto sampleHeightWorld = [&](float u, float v)
+        {
+            glm::vec2 uvc(clamp01(u), clamp01(v));
+            glm::vec3 pL = terrain.sampleSurfacePos(uvc.x, uvc.y);
+            glm::vec3 pW = glm::vec3(terrainModel * glm::vec4(pL, 1.f));
+            return pW.y;
+        };
+
+        const float eps = 1.0f / 512.0f;
+        float h0 = pWorld.y;
+        float hdx = sampleHeightWorld(uv.x + eps, uv.y);
+        float hdy = sampleHeightWorld(uv.x, uv.y + eps);
+
+        glm::vec3 dx = glm::vec3(eps, hdx - h0, 0.f);
+        glm::vec3 dz = glm::vec3(0.f, hdy - h0, eps);
+        glm::vec3 nWorld = glm::normalize(glm::cross(dz, dx));
+
+        float slope = glm::clamp(1.0f - glm::dot(nWorld, glm::vec3(0, 1, 0)), 0.0f, 1.0f);
+
+        // Place rocks on beaches or slopes, but not too steep
+        bool isBeach = (pWorld.y < seaHeightWorld + 0.1f * heightScale);
+        bool isSlope = (slope > 0.3f && slope < 0.8f);
+
+        if (!isBeach && !isSlope)
+        {
+            // Randomly place some on flat ground too, but fewer
+            if (dist01(rng) > 0.1f)
+                continue;
+        }
+
+        // Transform
+        float scaleBase = 0.5f + 1.5f * dist01(rng); // Random size
+        glm::vec3 scale(scaleBase);
+
+        // Deform slightly to look like a rock
+        scale.x *= 0.8f + 0.4f * dist01(rng);
+        scale.y *= 0.6f + 0.4f * dist01(rng); // Flatter
+        scale.z *= 0.8f + 0.4f * dist01(rng);
+
+        float yaw = 2.f * float(M_PI) * dist01(rng);
+        float pitch = 2.f * float(M_PI) * dist01(rng);
+        float roll = 2.f * float(M_PI) * dist01(rng);
+
+        glm::mat4 T = glm::translate(glm::mat4(1.f), pWorld);
+        glm::mat4 R = glm::rotate(glm::mat4(1.f), yaw, glm::vec3(0, 1, 0));
+        R = glm::rotate(R, pitch, glm::vec3(1, 0, 0));
+        R = glm::rotate(R, roll, glm::vec3(0, 0, 1));
+        glm::mat4 S = glm::scale(glm::mat4(1.f), scale);
+
+        // Sink the rock slightly into the ground
+        T = glm::translate(T, glm::vec3(0, -0.2f * scale.y, 0));
+
+        rocks.push_back(T * R * S);
+    }
+
+    return rocks;
+}
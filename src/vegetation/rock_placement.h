@@ -0,0 +1,20 @@
+#pragma once
+
+#include <vector>
+#include <glm/glm.hpp>
+
+class TerrainGenerator;
+
+// Scattered rocks: mostly on beaches and moderate slopes, a few on flat
+// ground, none under water. Same random sequence the renderer always used.
+struct RockPlacementParams
+{
+    int density = 1;       // settings.shapeParameter7; 10 candidate spots per step
+    float seaLevel = 0.f;  // world-space sea height
+    float heightScale = 1.f;
+    unsigned seed = 5678;
+};
+
+// world transforms of the unit rock mesh
+std::vector<glm::mat4> placeRocks(const TerrainGenerator &terrain, const glm::mat4 &terrainModel,
+                                  const RockPlacementParams &params);
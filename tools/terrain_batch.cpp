@@ -0,0 +1,366 @@
+// Headless batch generator: terrain heights, forest and rock instances for a
+// sweep of slider settings, one job per combination, spread over all cores.
+// Links only the GL/Qt-free core (TerrainCore), so it runs on build servers.
+//
+//   terrain_batch [--out <dir>] [--grid <cells>] [--jobs <n>] [--no-forest] [--no-rocks]
+//                 [--<param> <values>]...
+//
+// <values> is a number, a list "1,5,9" or an inclusive range "1:25" / "1:25:4";
+// every combination of the given values becomes one job. Parameters and their
+// defaults (the UI's initial slider positions):
+//   roughness 1  height 1  distortion 1  cliffs 0  craters 0  rivers 0
+//   coverage 25  tree-size 12  leaf-density 12  rock-density 25
+//   forest-seed 1337  rock-seed 5678
+//
+// Per job <dir>/<name>.heights.bin, .forest.bin and .rocks.bin are written
+// (little-endian, layouts below; .forest.bin is utils/world_cache.h's), plus
+// <dir>/manifest.json listing every job.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "terrain/terraingenerator.h"
+#include "utils/parallel.h"
+#include "utils/world_cache.h"
+#include "vegetation/forest_placement.h"
+#include "vegetation/rock_placement.h"
+
+namespace
+{
+constexpr std::uint32_t FORMAT_VERSION = 1;
+
+// swept parameters, in the order they appear in job names
+const std::vector<std::pair<std::string, int>> PARAM_DEFAULTS = {
+    {"roughness", 1}, {"height", 1}, {"distortion", 1},
+    {"cliffs", 0}, {"craters", 0}, {"rivers", 0},
+    {"coverage", 25}, {"tree-size", 12}, {"leaf-density", 12}, {"rock-density", 25},
+    {"forest-seed", 1337}, {"rock-seed", 5678}};
+
+struct Job
+{
+    std::string name;
+    std::map<std::string, int> values;
+};
+
+struct JobResult
+{
+    bool ok = false;
+    std::size_t branches = 0;
+    std::size_t leaves = 0;
+    std::size_t trees = 0;
+    std::size_t rocks = 0;
+    double ms = 0.0;
+};
+
+// "5", "1,5,9", "1:25" or "1:25:4"
+bool parseValues(const std::string &spec, std::vector<int> &out)
+{
+    out.clear();
+    std::stringstream ss(spec);
+    std::string item;
+    while (std::getline(ss, item, ','))
+    {
+        int a = 0, b = 0, step = 1;
+        char c1 = 0, c2 = 0;
+        std::istringstream is(item);
+        if (!(is >> a))
+            return false;
+        if (is >> c1)
+        {
+            if (c1 != ':' || !(is >> b))
+                return false;
+            if (is >> c2 && (c2 != ':' || !(is >> step) || step <= 0))
+                return false;
+            for (int v = a; v <= b; v += step)
+                out.push_back(v);
+        }
+        else
+        {
+            out.push_back(a);
+        }
+    }
+    return !out.empty();
+}
+
+template <class T>
+void writePod(std::ofstream &out, const T &v)
+{
+    out.write(reinterpret_cast<const char *>(&v), sizeof(T));
+}
+
+void writeMat4(std::ofstream &out, const glm::mat4 &m)
+{
+    out.write(reinterpret_cast<const char *>(&m[0][0]), sizeof(float) * 16);
+}
+
+// "ATHG" v1: u32 cells, f32 seaLevel (local h), f32 heightScale, f32 model[16]
+// (column-major, local -> world), then (cells+1)^2 f32 local heights, row-major
+// [i * (cells + 1) + j] at uv = (i / cells, j / cells), unclamped by the sea
+bool writeHeights(const std::string &path, int cells, const TerrainGenerator::TerrainParams &P,
+                  const glm::mat4 &model, const std::vector<float> &heights)
+{
+    std::ofstream out(path, std::ios::binary);
+    if (!out)
+        return false;
+    out.write("ATHG", 4);
+    writePod(out, FORMAT_VERSION);
+    writePod(out, std::uint32_t(cells));
+    writePod(out, P.seaLevel * P.heightScale);
+    writePod(out, P.heightScale);
+    writeMat4(out, model);
+    out.write(reinterpret_cast<const char *>(heights.data()), heights.size() * sizeof(float));
+    return bool(out);
+}
+
+// "ATRK" v1: u32 count, then count x f32 model[16] (world space)
+bool writeRocks(const std::string &path, const std::vector<glm::mat4> &rocks)
+{
+    std::ofstream out(path, std::ios::binary);
+    if (!out)
+        return false;
+    out.write("ATRK", 4);
+    writePod(out, FORMAT_VERSION);
+    writePod(out, std::uint32_t(rocks.size()));
+    for (const glm::mat4 &m : rocks)
+        writeMat4(out, m);
+    return bool(out);
+}
+
+JobResult runJob(const Job &job, const std::filesystem::path &dir, int gridCells,
+                 bool doForest, bool doRocks)
+{
+    auto t0 = std::chrono::steady_clock::now();
+    const auto &v = job.values;
+    JobResult r;
+
+    TerrainGenerator::TerrainSliders sliders;
+    sliders.roughness = v.at("roughness");
+    sliders.height = v.at("height");
+    sliders.distortion = v.at("distortion");
+    sliders.cliffs = v.at("cliffs") != 0;
+    sliders.craters = v.at("craters") != 0;
+    sliders.rivers = v.at("rivers") != 0;
+    TerrainGenerator::TerrainParams P = TerrainGenerator::paramsFromSliders(sliders);
+
+    TerrainGenerator gen;
+    gen.setParams(P);
+    const glm::mat4 model = TerrainGenerator::worldModel();
+
+    std::string base = (dir / job.name).string();
+    if (!writeHeights(base + ".heights.bin", gridCells, P, model, gen.heightGrid(gridCells)))
+    {
+        std::cerr << "Error: could not write " << base << ".heights.bin" << std::endl;
+        return r;
+    }
+
+    if (doForest)
+    {
+        // same inputs Realtime::buildForest passes
+        ForestPlacementParams placement;
+        placement.coverage = v.at("coverage");
+        placement.treeSize = v.at("tree-size");
+        placement.leafDensity = v.at("leaf-density");
+        placement.seaLevel = P.seaLevel;
+        placement.heightScale = P.heightScale;
+        placement.seed = unsigned(v.at("forest-seed"));
+
+        ForestInstances forest = buildForestInstances(gen, model, placement);
+        r.branches = forest.branches.size();
+        r.leaves = forest.leaves.size();
+        r.trees = forest.trees.size();
+        if (!writeForestFile(base + ".forest.bin", forest))
+        {
+            std::cerr << "Error: could not write " << base << ".forest.bin" << std::endl;
+            return r;
+        }
+    }
+
+    if (doRocks)
+    {
+        RockPlacementParams placement;
+        placement.density = v.at("rock-density");
+        placement.seaLevel = P.seaLevel;
+        placement.heightScale = P.heightScale;
+        placement.seed = unsigned(v.at("rock-seed"));
+
+        std::vector<glm::mat4> rocks = placeRocks(gen, model, placement);
+        r.rocks = rocks.size();
+        if (!writeRocks(base + ".rocks.bin", rocks))
+        {
+            std::cerr << "Error: could not write " << base << ".rocks.bin" << std::endl;
+            return r;
+        }
+    }
+
+    r.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+    r.ok = true;
+    return r;
+}
+
+bool writeManifest(const std::filesystem::path &path, const std::vector<Job> &jobs,
+                   const std::vector<JobResult> &results, int gridCells)
+{
+    std::ofstream out(path);
+    if (!out)
+        return false;
+    out << "{\n  \"version\": " << FORMAT_VERSION << ",\n  \"gridCells\": " << gridCells
+        << ",\n  \"jobs\": [\n";
+    for (std::size_t i = 0; i < jobs.size(); ++i)
+    {
+        const JobResult &r = results[i];
+        out << "    {\"name\": \"" << jobs[i].name << "\", \"ok\": " << (r.ok ? "true" : "false");
+        for (const auto &[key, def] : PARAM_DEFAULTS)
+            out << ", \"" << key << "\": " << jobs[i].values.at(key);
+        out << ", \"branches\": " << r.branches << ", \"leaves\": " << r.leaves
+            << ", \"trees\": " << r.trees << ", \"rocks\": " << r.rocks << ", \"ms\": " << r.ms << "}"
+            << (i + 1 < jobs.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+    return bool(out);
+}
+
+void usage()
+{
+    std::cerr << "usage: terrain_batch [--out <dir>] [--grid <cells>] [--jobs <n>] [--no-forest] [--no-rocks]\n"
+                 "                     [--<param> <value | a,b,c | from:to[:step]>]...\n"
+                 "params:";
+    for (const auto &[key, def] : PARAM_DEFAULTS)
+        std::cerr << " " << key << "(" << def << ")";
+    std::cerr << "\n";
+}
+}
+
+int main(int argc, char **argv)
+{
+    std::filesystem::path outDir = "terrain_out";
+    int gridCells = 256;
+    int jobCount = int(std::max(1u, std::thread::hardware_concurrency()));
+    bool doForest = true;
+    bool doRocks = true;
+
+    std::map<std::string, std::vector<int>> sweep;
+    for (const auto &[key, def] : PARAM_DEFAULTS)
+        sweep[key] = {def};
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--out" && hasValue)
+            outDir = argv[++i];
+        else if (arg == "--grid" && hasValue)
+            gridCells = std::clamp(std::atoi(argv[++i]), 1, 8192);
+        else if (arg == "--jobs" && hasValue)
+            jobCount = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--no-forest")
+            doForest = false;
+        else if (arg == "--no-rocks")
+            doRocks = false;
+        else if (arg.rfind("--", 0) == 0 && sweep.count(arg.substr(2)) && hasValue)
+        {
+            if (!parseValues(argv[++i], sweep[arg.substr(2)]))
+            {
+                std::cerr << "Error: bad value list for " << arg << ": " << argv[i] << std::endl;
+                return 1;
+            }
+        }
+        else
+        {
+            usage();
+            return 1;
+        }
+    }
+
+    // cartesian product of all swept values
+    std::vector<Job> jobs(1);
+    for (const auto &[key, def] : PARAM_DEFAULTS)
+    {
+        std::vector<Job> next;
+        for (const Job &job : jobs)
+        {
+            for (int value : sweep[key])
+            {
+                Job j = job;
+                j.values[key] = value;
+                next.push_back(std::move(j));
+            }
+        }
+        jobs = std::move(next);
+    }
+    for (std::size_t i = 0; i < jobs.size(); ++i)
+    {
+        char name[32];
+        std::snprintf(name, sizeof(name), "job_%05zu", i);
+        jobs[i].name = name;
+    }
+
+    std::error_code ec;
+    std::filesystem::create_directories(outDir, ec);
+    if (ec)
+    {
+        std::cerr << "Error: could not create " << outDir << ": " << ec.message() << std::endl;
+        return 1;
+    }
+
+    jobCount = std::min<int>(jobCount, int(jobs.size()));
+    std::cout << "[batch] " << jobs.size() << " jobs on " << jobCount << " threads -> " << outDir.string() << "\n";
+
+    // jobs differ a lot in cost (forest size), so workers pull them one at a time;
+    // with several workers each runs its job single-threaded
+    auto t0 = std::chrono::steady_clock::now();
+    std::vector<JobResult> results(jobs.size());
+    std::atomic<std::size_t> nextJob{0};
+    std::mutex logMutex;
+    auto runJobs = [&]
+    {
+        for (std::size_t i; (i = nextJob.fetch_add(1)) < jobs.size();)
+        {
+            results[i] = runJob(jobs[i], outDir, gridCells, doForest, doRocks);
+            std::lock_guard<std::mutex> lock(logMutex);
+            std::cout << "[batch] " << jobs[i].name << (results[i].ok ? "" : " FAILED")
+                      << ": trees=" << results[i].trees << ", rocks=" << results[i].rocks
+                      << " (" << int(results[i].ms) << " ms)\n";
+        }
+    };
+
+    if (jobCount == 1)
+    {
+        runJobs(); // a lone job may still use every core inside the generator
+    }
+    else
+    {
+        std::vector<std::thread> threads;
+        for (int t = 0; t < jobCount; ++t)
+            threads.emplace_back([&]
+                                 {
+                ParallelWorkerScope scope;
+                runJobs(); });
+        for (std::thread &t : threads)
+            t.join();
+    }
+
+    double totalMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+    int failed = int(std::count_if(results.begin(), results.end(), [](const JobResult &r) { return !r.ok; }));
+
+    if (!writeManifest(outDir / "manifest.json", jobs, results, gridCells))
+    {
+        std::cerr << "Error: could not write manifest" << std::endl;
+        return 1;
+    }
+    std::cout << "[batch] done: " << jobs.size() - failed << "/" << jobs.size() << " jobs in "
+              << int(totalMs) << " ms\n";
+    return failed ? 1 : 0;
+}